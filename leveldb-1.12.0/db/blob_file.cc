@@ -0,0 +1,298 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include "db/dbformat.h"
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "leveldb/iterator.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb
+{
+
+void BlobIndex::EncodeTo(std::string* dst) const
+{
+	PutVarint64(dst, file_number);
+	PutVarint64(dst, offset);
+	PutVarint64(dst, size);
+}
+
+bool BlobIndex::DecodeFrom(const Slice& src)
+{
+	Slice input = src;
+	return GetVarint64(&input, &file_number) && GetVarint64(&input, &offset)
+			&& GetVarint64(&input, &size) && input.empty();
+}
+
+BlobFileBuilder::BlobFileBuilder(Env* env, const std::string& dbname,
+		uint64_t number) :
+	env_(env), fname_(BlobFileName(dbname, number)), number_(number), file_(
+			NULL), offset_(0)
+{
+}
+
+BlobFileBuilder::~BlobFileBuilder()
+{
+	assert(file_ == NULL);
+}
+
+Status BlobFileBuilder::Add(const Slice& user_key, const Slice& value,
+		std::string* index)
+{
+	Status s;
+	if ( file_ == NULL )
+	{
+		assert(offset_ == 0);
+		s = env_->NewWritableFile(fname_, &file_);
+		if ( !s.ok() )
+		{
+			return s;
+		}
+	}
+
+	record_.assign(4, '\0'); // Room for the checksum
+	PutLengthPrefixedSlice(&record_, user_key);
+	PutLengthPrefixedSlice(&record_, value);
+	const uint32_t crc = crc32c::Value(record_.data() + 4, record_.size() - 4);
+	EncodeFixed32(&record_[0], crc32c::Mask(crc));
+	s = file_->Append(record_);
+	if ( s.ok() )
+	{
+		BlobIndex blob;
+		blob.file_number = number_;
+		blob.offset = offset_;
+		blob.size = record_.size();
+		index->clear();
+		blob.EncodeTo(index);
+		offset_ += record_.size();
+	}
+	return s;
+}
+
+Status BlobFileBuilder::Finish()
+{
+	Status s;
+	if ( file_ != NULL )
+	{
+		s = file_->Sync();
+		if ( s.ok() )
+		{
+			s = file_->Close();
+		}
+		delete file_;
+		file_ = NULL;
+	}
+	return s;
+}
+
+void BlobFileBuilder::Abandon()
+{
+	if ( file_ != NULL )
+	{
+		file_->Close();
+		delete file_;
+		file_ = NULL;
+		env_->DeleteFile(fname_);
+	}
+}
+
+static void DeleteFileEntry(const Slice& key, void* value)
+{
+	delete reinterpret_cast<RandomAccessFile*> (value);
+}
+
+BlobCache::BlobCache(const std::string& dbname, const Options* options,
+		int entries) :
+	env_(options->env), dbname_(dbname), cache_(NewLRUCache(entries))
+{
+}
+
+BlobCache::~BlobCache()
+{
+	delete cache_;
+}
+
+Status BlobCache::Get(const ReadOptions& options, const Slice& index,
+		std::string* value)
+{
+	BlobIndex blob;
+	if ( !blob.DecodeFrom(index) )
+	{
+		return Status::Corruption("bad blob index");
+	}
+
+	char buf[sizeof(blob.file_number)];
+	EncodeFixed64(buf, blob.file_number);
+	Slice key(buf, sizeof(buf));
+	Cache::Handle* handle = cache_->Lookup(key);
+	if ( handle == NULL )
+	{
+		RandomAccessFile* file;
+		Status s = env_->NewRandomAccessFile(
+				BlobFileName(dbname_, blob.file_number), &file);
+		if ( !s.ok() )
+		{
+			return s;
+		}
+		handle = cache_->Insert(key, file, 1, &DeleteFileEntry);
+	}
+	RandomAccessFile* file =
+			reinterpret_cast<RandomAccessFile*> (cache_->Value(handle));
+
+	std::string scratch;
+	scratch.resize(blob.size);
+	Slice record;
+	Status s = file->Read(blob.offset, blob.size, &record, &scratch[0]);
+	cache_->Release(handle);
+	if ( !s.ok() )
+	{
+		return s;
+	}
+	if ( record.size() != blob.size || record.size() < 4 )
+	{
+		return Status::Corruption("truncated blob record");
+	}
+	if ( options.verify_checksums )
+	{
+		const uint32_t crc = crc32c::Unmask(DecodeFixed32(record.data()));
+		if ( crc != crc32c::Value(record.data() + 4, record.size() - 4) )
+		{
+			return Status::Corruption("blob record checksum mismatch");
+		}
+	}
+	Slice input(record.data() + 4, record.size() - 4);
+	Slice user_key, v;
+	if ( !GetLengthPrefixedSlice(&input, &user_key) || !GetLengthPrefixedSlice(
+			&input, &v) )
+	{
+		return Status::Corruption("bad blob record");
+	}
+	value->assign(v.data(), v.size());
+	return Status::OK();
+}
+
+void BlobCache::Evict(uint64_t file_number)
+{
+	char buf[sizeof(file_number)];
+	EncodeFixed64(buf, file_number);
+	cache_->Erase(Slice(buf, sizeof(buf)));
+}
+
+namespace
+{
+class BlobResolvingIterator: public Iterator
+{
+	public:
+		BlobResolvingIterator(Iterator* iter, BlobCache* blob_cache,
+				const ReadOptions& options) :
+			iter_(iter), blob_cache_(blob_cache), options_(options),
+					is_blob_(false), resolved_(false)
+		{
+		}
+		virtual ~BlobResolvingIterator()
+		{
+			delete iter_;
+		}
+		// A blob that cannot be read ends the iteration, so that a scan
+		// stops at the value it could not get rather than go on past it
+		virtual bool Valid() const
+		{
+			return status_.ok() && iter_->Valid();
+		}
+		virtual void Seek(const Slice& target)
+		{
+			iter_->Seek(target);
+			Update();
+		}
+		virtual void SeekToFirst()
+		{
+			iter_->SeekToFirst();
+			Update();
+		}
+		virtual void SeekToLast()
+		{
+			iter_->SeekToLast();
+			Update();
+		}
+		virtual void Next()
+		{
+			iter_->Next();
+			Update();
+		}
+		virtual void Prev()
+		{
+			iter_->Prev();
+			Update();
+		}
+		virtual Slice key() const
+		{
+			return is_blob_ ? Slice(key_) : iter_->key();
+		}
+		virtual Slice value() const
+		{
+			if ( !is_blob_ )
+			{
+				return iter_->value();
+			}
+			if ( !resolved_ )
+			{
+				// Only read the blob if the value is actually wanted
+				resolved_ = true;
+				Status s = blob_cache_->Get(options_, iter_->value(), &value_);
+				if ( !s.ok() && status_.ok() )
+				{
+					status_ = s;
+				}
+			}
+			return value_;
+		}
+		virtual Status status() const
+		{
+			if ( !status_.ok() )
+			{
+				return status_;
+			}
+			return iter_->status();
+		}
+
+	private:
+		void Update()
+		{
+			is_blob_ = false;
+			resolved_ = false;
+			if ( Valid() )
+			{
+				const Slice k = iter_->key();
+				if ( k.size() >= 8 && static_cast<unsigned char> (k[k.size()
+						- 8]) == kTypeBlobIndex )
+				{
+					// Present the entry as the value it stands for
+					key_.assign(k.data(), k.size());
+					key_[k.size() - 8] = static_cast<char> (kTypeValue);
+					is_blob_ = true;
+				}
+			}
+		}
+
+		Iterator* const iter_;
+		BlobCache* const blob_cache_;
+		const ReadOptions options_;
+		bool is_blob_; // Current entry is a blob index
+		std::string key_; // Its key, retyped as kTypeValue
+		mutable bool resolved_; // value_ holds its value
+		mutable std::string value_;
+		mutable Status status_;
+};
+} // namespace
+
+Iterator* NewBlobResolvingIterator(Iterator* internal_iter,
+		BlobCache* blob_cache, const ReadOptions& options)
+{
+	return new BlobResolvingIterator(internal_iter, blob_cache, options);
+}
+
+} // namespace leveldb
@@ -0,0 +1,120 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Values of at least Options::min_blob_size bytes are kept out of the
+// tables, in append-only blob files, so that compactions only move a
+// small reference to them.  A blob file is a sequence of records:
+//
+//    checksum: fixed32      // masked crc32c of the rest of the record
+//    key: varstring         // user key the value was written for
+//    value: varstring
+//
+// In place of such a value a table holds an entry of kTypeBlobIndex whose
+// value is an encoded BlobIndex locating the record.
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_H_
+
+#include <string>
+#include <stdint.h>
+#include "leveldb/cache.h"
+#include "leveldb/options.h"
+#include "leveldb/status.h"
+
+namespace leveldb
+{
+
+class Env;
+class Iterator;
+class WritableFile;
+
+struct BlobIndex
+{
+		uint64_t file_number;
+		uint64_t offset; // Of the record in the file
+		uint64_t size; // Of the whole record
+
+		void EncodeTo(std::string* dst) const;
+		bool DecodeFrom(const Slice& input);
+};
+
+// Writes the records of one new blob file.  The file is created by the
+// first Add(), so a builder that is given no value leaves nothing behind.
+// Not thread-safe.
+class BlobFileBuilder
+{
+	public:
+		BlobFileBuilder(Env* env, const std::string& dbname, uint64_t number);
+
+		// REQUIRES: Finish() or Abandon() has been called if anything was added
+		~BlobFileBuilder();
+
+		// Append a record for user_key and value, and store the encoded
+		// BlobIndex of the record in *index.
+		Status Add(const Slice& user_key, const Slice& value,
+				std::string* index);
+
+		// Sync and close the file, if one was created.
+		Status Finish();
+
+		// Close and remove the file, if one was created.
+		void Abandon();
+
+		uint64_t number() const
+		{
+			return number_;
+		}
+
+		// Bytes written so far; zero if nothing was added
+		uint64_t FileSize() const
+		{
+			return offset_;
+		}
+
+	private:
+		Env* const env_;
+		const std::string fname_;
+		const uint64_t number_;
+		WritableFile* file_;
+		uint64_t offset_;
+		std::string record_;
+
+		// No copying allowed
+		BlobFileBuilder(const BlobFileBuilder&);
+		void operator=(const BlobFileBuilder&);
+};
+
+// Keeps recently read blob files open.  Thread-safe.
+class BlobCache
+{
+	public:
+		BlobCache(const std::string& dbname, const Options* options,
+				int entries);
+		~BlobCache();
+
+		// Read into *value the value of the record that the encoded BlobIndex
+		// "index" locates.
+		Status Get(const ReadOptions& options, const Slice& index,
+				std::string* value);
+
+		// Close the specified file, if it is open.
+		void Evict(uint64_t file_number);
+
+	private:
+		Env* const env_;
+		const std::string dbname_;
+		Cache* cache_;
+};
+
+// Return an iterator over the entries of *internal_iter, in which each
+// kTypeBlobIndex entry appears as a kTypeValue entry holding the value it
+// refers to.  Values are read from *blob_cache on demand; once one cannot
+// be read, the iterator is no longer Valid() and status() tells why.
+// Takes ownership of internal_iter.
+extern Iterator* NewBlobResolvingIterator(Iterator* internal_iter,
+		BlobCache* blob_cache, const ReadOptions& options);
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_H_
@@ -4,8 +4,10 @@
 
 #include "db/builder.h"
 
+#include "db/blob_file.h"
 #include "db/filename.h"
 #include "db/dbformat.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
@@ -16,14 +18,21 @@ namespace leveldb
 {
 
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-		TableCache* table_cache, Iterator* iter, FileMetaData* meta)
+		TableCache* table_cache, Iterator* iter, Iterator* range_del_iter,
+		BlobFileBuilder* blob, FileMetaData* meta)
 {
 	Status s;
 	meta->file_size = 0;
+	meta->num_range_deletions = 0;
+	meta->num_deletions = 0;
 	iter->SeekToFirst();
+	if ( range_del_iter != NULL )
+	{
+		range_del_iter->SeekToFirst();
+	}
 
 	std::string fname = TableFileName(dbname, meta->number);
-	if ( iter->Valid() )
+	if ( iter->Valid() || (range_del_iter != NULL && range_del_iter->Valid()) )
 	{
 		WritableFile* file;
 		s = env->NewWritableFile(fname, &file);
@@ -33,13 +42,61 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
 		}
 
 		TableBuilder* builder = new TableBuilder(options, file);
-		meta->smallest.DecodeFrom(iter->key());
+		bool has_bounds = iter->Valid();
+		std::string blob_key, blob_index;
 		for (; iter->Valid(); iter->Next())
 		{
 			Slice key = iter->key();
+			Slice value = iter->value();
+			ParsedInternalKey ikey;
+			if ( blob != NULL && value.size() >= options.min_blob_size
+					&& ParseInternalKey(key, &ikey) && ikey.type == kTypeValue )
+			{
+				// Keep the value in the blob file and refer to it
+				s = blob->Add(ikey.user_key, value, &blob_index);
+				if ( !s.ok() )
+				{
+					break;
+				}
+				ikey.type = kTypeBlobIndex;
+				blob_key.clear();
+				AppendInternalKey(&blob_key, ikey);
+				key = blob_key;
+				value = blob_index;
+			}
+			if ( builder->NumEntries() == 0 )
+			{
+				meta->smallest.DecodeFrom(key);
+			}
 			meta->largest.DecodeFrom(key);
-			builder->Add(key, iter->value());
+			if ( ExtractValueType(key) == kTypeDeletion )
+			{
+				meta->num_deletions++;
+			}
+			builder->Add(key, value);
 		}
+		meta->num_entries = builder->NumEntries();
+
+		// The table must span the ranges it deletes, so that lookups and
+		// compactions of those keys consider it.
+		const InternalKeyComparator* icmp =
+				static_cast<const InternalKeyComparator*> (options.comparator);
+		for (; s.ok() && range_del_iter != NULL && range_del_iter->Valid();
+				range_del_iter->Next())
+		{
+			RangeTombstone t;
+			if ( !ParseRangeTombstone(range_del_iter->key(),
+					range_del_iter->value(), &t) )
+			{
+				s = Status::Corruption("corrupted range deletion entry");
+				break;
+			}
+			builder->AddRangeDeletion(range_del_iter->key(),
+					range_del_iter->value());
+			ExtendBoundsForTombstone(*icmp, t, &has_bounds, &meta->smallest,
+					&meta->largest);
+		}
+		meta->num_range_deletions = builder->NumRangeDeletions();
 
 		// Finish and check for builder errors
 		if ( s.ok() )
@@ -73,7 +130,7 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
 		{
 			// Verify that the table is usable
 			Iterator* it = table_cache->NewIterator(ReadOptions(),
-					meta->number, meta->file_size);
+					meta->number, meta->file_size, 0);
 			s = it->status();
 			delete it;
 		}
@@ -84,6 +141,10 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
 	{
 		s = iter->status();
 	}
+	if ( range_del_iter != NULL && !range_del_iter->status().ok() )
+	{
+		s = range_del_iter->status();
+	}
 
 	if ( s.ok() && meta->file_size > 0 )
 	{
@@ -13,19 +13,23 @@ namespace leveldb
 struct Options;
 struct FileMetaData;
 
+class BlobFileBuilder;
 class Env;
 class Iterator;
 class TableCache;
 class VersionEdit;
 
-// Build a Table file from the contents of *iter.  The generated file
-// will be named according to meta->number.  On success, the rest of
-// *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// Build a Table file from the contents of *iter, plus the range
+// deletions yielded by *range_del_iter (which may be NULL).  The
+// generated file will be named according to meta->number.  On success,
+// the rest of *meta will be filled with metadata about the generated table.
+// If no data is present in either iterator, meta->file_size will be set
+// to zero, and no Table file will be produced.
+// If blob is non-NULL, values of at least options.min_blob_size bytes are
+// added to it and the table refers to them.  The caller finishes *blob.
 extern Status BuildTable(const std::string& dbname, Env* env,
 		const Options& options, TableCache* table_cache, Iterator* iter,
-		FileMetaData* meta);
+		Iterator* range_del_iter, BlobFileBuilder* blob, FileMetaData* meta);
 
 } // namespace leveldb
 
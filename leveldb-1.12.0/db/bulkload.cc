@@ -0,0 +1,682 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// BulkLoad() builds a new database straight from a stream of
+// records, skipping the log, the memtable and compactions:
+//
+// (1) The input is read in buffers of bounded size.  Each buffer is
+//     sorted and written as a temporary table ("run") by a worker thread.
+// (2) The key space is cut into partitions using keys sampled from the
+//     runs.  Worker threads merge the runs over one partition at a time
+//     and write the database tables, which do not overlap.
+// (3) A descriptor listing every table in the last level is written, so
+//     that DB::Open finds a ready database.
+//
+// Input records are lines of the form "key<TAB>value"; a line without a
+// tab holds an empty value.  When a key repeats, its last value wins.
+// The database uses the default comparator.
+
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "db/bulkload.h"
+#include "db/dbformat.h"
+#include "db/filename.h"
+#include "db/log_writer.h"
+#include "db/version_edit.h"
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "leveldb/status.h"
+#include "leveldb/table.h"
+#include "leveldb/table_builder.h"
+#include "port/port.h"
+#include "table/merger.h"
+#include "util/mutexlock.h"
+
+namespace leveldb
+{
+
+namespace
+{
+
+typedef std::vector<std::pair<std::string, std::string> > RecordBuffer;
+
+// Approximate memory taken by one buffered record
+static size_t RecordSize(const Slice& key, const Slice& value)
+{
+	return key.size() + value.size() + 2 * sizeof(std::string);
+}
+
+struct RecordLess
+{
+		const Comparator* ucmp;
+		explicit RecordLess(const Comparator* c) :
+			ucmp(c)
+		{
+		}
+		bool operator()(const std::pair<std::string, std::string>& a,
+				const std::pair<std::string, std::string>& b) const
+		{
+			return ucmp->Compare(a.first, b.first) < 0;
+		}
+};
+
+struct SliceLess
+{
+		const Comparator* ucmp;
+		explicit SliceLess(const Comparator* c) :
+			ucmp(c)
+		{
+		}
+		bool operator()(const std::string& a, const std::string& b) const
+		{
+			return ucmp->Compare(a, b) < 0;
+		}
+};
+
+class BulkLoader
+{
+	public:
+		BulkLoader(Env* env, const std::string& dbname,
+				const BulkLoadOptions& options);
+		~BulkLoader();
+
+		// Build the database from the records of *input
+		Status Load(SequentialFile* input, BulkLoadStats* stats);
+
+	private:
+		// A sorted temporary table of part of the input
+		struct Run
+		{
+				uint64_t number;
+				uint64_t file_size;
+				RandomAccessFile* file;
+				Table* table;
+		};
+
+		struct RunJob
+		{
+				BulkLoader* loader;
+				uint64_t number;
+				RecordBuffer records;
+		};
+
+		// The keys in [begin, end); an empty end stands for "no limit"
+		struct Partition
+		{
+				std::string begin;
+				std::string end;
+				std::vector<FileMetaData> files;
+		};
+
+		static void RunThread(void* arg);
+		static void PartitionThread(void* arg);
+
+		Status ReadInput(SequentialFile* input);
+		void StartRun(RecordBuffer* records);
+		Status WriteRun(RunJob* job);
+		Status OpenRuns();
+		void PickPartitions();
+		void WritePartitions();
+		Status WritePartition(Partition* p);
+		Status FinishTable(TableBuilder* builder, WritableFile* file,
+				FileMetaData* meta);
+		Status WriteDescriptor();
+		void RemoveRuns();
+		void RecordError(const Status& s);
+
+		uint64_t NewFileNumber()
+		{
+			MutexLock l(&mu_);
+			return next_file_number_++;
+		}
+
+		Env* const env_;
+		const std::string dbname_;
+		const BulkLoadOptions options_;
+		const Comparator* const ucmp_;
+		const InternalKeyComparator icmp_;
+		const FilterPolicy* user_policy_;
+		const InternalFilterPolicy ipolicy_;
+		Options run_options_; // Temporary runs hold plain user keys
+		Options table_options_; // Database tables hold internal keys
+		const size_t buffer_bytes_;
+
+		port::Mutex mu_;
+		port::CondVar cv_; // Signalled when a worker finishes
+		uint64_t next_file_number_;
+		int running_; // Workers started but not finished
+		Status bg_status_; // First error of a worker
+		std::vector<Run> runs_;
+		std::vector<std::string> samples_; // Keys sampled from the runs
+		std::vector<Partition> partitions_;
+		size_t next_partition_; // First partition not handed to a worker
+		uint64_t num_records_;
+
+		// No copying allowed
+		BulkLoader(const BulkLoader&);
+		void operator=(const BulkLoader&);
+};
+
+BulkLoader::BulkLoader(Env* env, const std::string& dbname,
+		const BulkLoadOptions& options) :
+	env_(env), dbname_(dbname), options_(options), ucmp_(
+			BytewiseComparator()), icmp_(ucmp_), user_policy_(
+			options.bloom_bits > 0 ? NewBloomFilterPolicy(options.bloom_bits)
+					: NULL), ipolicy_(user_policy_),
+			buffer_bytes_(options.memory / (options.threads + 1)),
+			cv_(&mu_), next_file_number_(2), // 1 is the descriptor
+			running_(0), next_partition_(0), num_records_(0)
+{
+	run_options_.env = env;
+	run_options_.comparator = ucmp_;
+	run_options_.compression = options.compression;
+	table_options_.env = env;
+	table_options_.comparator = &icmp_;
+	table_options_.filter_policy = (user_policy_ != NULL) ? &ipolicy_ : NULL;
+	table_options_.compression = options.compression;
+}
+
+BulkLoader::~BulkLoader()
+{
+	RemoveRuns();
+	delete user_policy_;
+}
+
+void BulkLoader::RecordError(const Status& s)
+{
+	MutexLock l(&mu_);
+	if ( bg_status_.ok() )
+	{
+		bg_status_ = s;
+	}
+}
+
+Status BulkLoader::Load(SequentialFile* input, BulkLoadStats* stats)
+{
+	env_->CreateDir(dbname_);
+	FileLock* lock;
+	Status s = env_->LockFile(LockFileName(dbname_), &lock);
+	if ( !s.ok() )
+	{
+		return s;
+	}
+	if ( env_->FileExists(CurrentFileName(dbname_)) )
+	{
+		env_->UnlockFile(lock);
+		return Status::InvalidArgument(dbname_, "exists");
+	}
+
+	const uint64_t start = env_->NowMicros();
+	s = ReadInput(input);
+	const uint64_t sorted = env_->NowMicros();
+	if ( s.ok() )
+	{
+		s = OpenRuns();
+	}
+	if ( s.ok() )
+	{
+		PickPartitions();
+		WritePartitions();
+		s = bg_status_;
+	}
+	if ( s.ok() )
+	{
+		s = WriteDescriptor();
+	}
+	RemoveRuns();
+	env_->UnlockFile(lock);
+
+	if ( s.ok() && stats != NULL )
+	{
+		stats->records = num_records_;
+		stats->tables = 0;
+		stats->bytes = 0;
+		for (size_t i = 0; i < partitions_.size(); i++)
+		{
+			stats->tables += partitions_[i].files.size();
+			for (size_t j = 0; j < partitions_[i].files.size(); j++)
+			{
+				stats->bytes += partitions_[i].files[j].file_size;
+			}
+		}
+		stats->sort_micros = sorted - start;
+		stats->write_micros = env_->NowMicros() - sorted;
+	}
+	return s;
+}
+
+Status BulkLoader::ReadInput(SequentialFile* input)
+{
+	const size_t kChunkSize = 1 << 20;
+	char* scratch = new char[kChunkSize];
+	std::string line; // Incomplete line at the end of the last chunk
+	RecordBuffer* records = new RecordBuffer;
+	size_t bytes = 0;
+	bool eof = false;
+	Status s;
+	while (s.ok() && !eof)
+	{
+		Slice chunk;
+		s = input->Read(kChunkSize, &chunk, scratch);
+		if ( !s.ok() )
+		{
+			break;
+		}
+		eof = chunk.empty();
+		if ( eof && !line.empty() )
+		{
+			chunk = Slice("\n", 1); // Terminate the last line
+		}
+		while (!chunk.empty())
+		{
+			const char* newline = static_cast<const char*> (memchr(
+					chunk.data(), '\n', chunk.size()));
+			if ( newline == NULL )
+			{
+				line.append(chunk.data(), chunk.size());
+				break;
+			}
+			line.append(chunk.data(), newline - chunk.data());
+			chunk.remove_prefix(newline - chunk.data() + 1);
+
+			const size_t tab = line.find('\t');
+			Slice key(line), value;
+			if ( tab != std::string::npos )
+			{
+				key = Slice(line.data(), tab);
+				value = Slice(line.data() + tab + 1, line.size() - tab - 1);
+			}
+			records->push_back(std::make_pair(key.ToString(),
+					value.ToString()));
+			bytes += RecordSize(key, value);
+			num_records_++;
+			line.clear();
+
+			if ( bytes >= buffer_bytes_ )
+			{
+				StartRun(records);
+				records = new RecordBuffer;
+				bytes = 0;
+			}
+		}
+	}
+	delete[] scratch;
+	if ( s.ok() && !records->empty() )
+	{
+		StartRun(records);
+	}
+	else
+	{
+		delete records;
+	}
+
+	MutexLock l(&mu_);
+	while (running_ > 0)
+	{
+		cv_.Wait();
+	}
+	if ( s.ok() )
+	{
+		s = bg_status_;
+	}
+	return s;
+}
+
+// Hand *records (deleted here) to a worker, after waiting for one to be free
+void BulkLoader::StartRun(RecordBuffer* records)
+{
+	RunJob* job = new RunJob;
+	job->loader = this;
+	job->number = NewFileNumber();
+	job->records.swap(*records);
+	delete records;
+
+	MutexLock l(&mu_);
+	while (running_ >= options_.threads)
+	{
+		cv_.Wait();
+	}
+	running_++;
+	env_->StartThread(&BulkLoader::RunThread, job);
+}
+
+void BulkLoader::RunThread(void* arg)
+{
+	RunJob* job = reinterpret_cast<RunJob*> (arg);
+	BulkLoader* loader = job->loader;
+	Status s = loader->WriteRun(job);
+	delete job;
+	if ( !s.ok() )
+	{
+		loader->RecordError(s);
+	}
+	MutexLock l(&loader->mu_);
+	loader->running_--;
+	loader->cv_.SignalAll();
+}
+
+Status BulkLoader::WriteRun(RunJob* job)
+{
+	RecordBuffer& records = job->records;
+	std::stable_sort(records.begin(), records.end(), RecordLess(ucmp_));
+
+	const std::string fname = TempFileName(dbname_, job->number);
+	WritableFile* file;
+	Status s = env_->NewWritableFile(fname, &file);
+	if ( !s.ok() )
+	{
+		return s;
+	}
+	TableBuilder* builder = new TableBuilder(run_options_, file);
+	std::vector<std::string> samples;
+	const size_t kSamplesPerRun = 256;
+	const size_t step = records.size() / kSamplesPerRun + 1;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		if ( i + 1 < records.size() && ucmp_->Compare(records[i].first,
+				records[i + 1].first) == 0 )
+		{
+			continue; // A later value of the same key follows
+		}
+		builder->Add(records[i].first, records[i].second);
+		if ( i % step == 0 )
+		{
+			samples.push_back(records[i].first);
+		}
+	}
+	s = builder->Finish();
+	Run run;
+	run.number = job->number;
+	run.file_size = builder->FileSize();
+	run.file = NULL;
+	run.table = NULL;
+	delete builder;
+	if ( s.ok() )
+	{
+		s = file->Close();
+	}
+	delete file;
+
+	MutexLock l(&mu_);
+	runs_.push_back(run); // Even if incomplete, so that it gets removed
+	samples_.insert(samples_.end(), samples.begin(), samples.end());
+	return s;
+}
+
+struct RunNewer
+{
+		template<typename T>
+		bool operator()(const T& a, const T& b) const
+		{
+			return a.number > b.number;
+		}
+};
+
+Status BulkLoader::OpenRuns()
+{
+	// Newest first: the merging iterator yields the first of equal keys
+	std::sort(runs_.begin(), runs_.end(), RunNewer());
+	Status s;
+	for (size_t i = 0; s.ok() && i < runs_.size(); i++)
+	{
+		Run& run = runs_[i];
+		s = env_->NewRandomAccessFile(TempFileName(dbname_, run.number),
+				&run.file);
+		if ( s.ok() )
+		{
+			s = Table::Open(run_options_, run.file, run.file_size, &run.table);
+		}
+	}
+	return s;
+}
+
+void BulkLoader::PickPartitions()
+{
+	std::sort(samples_.begin(), samples_.end(), SliceLess(ucmp_));
+	// Several partitions per worker even out their sizes
+	size_t n = options_.threads * 4;
+	if ( n > samples_.size() )
+	{
+		n = samples_.size();
+	}
+	partitions_.push_back(Partition());
+	for (size_t i = 1; i < n; i++)
+	{
+		const std::string& split = samples_[i * samples_.size() / n];
+		if ( ucmp_->Compare(split, partitions_.back().begin) > 0 )
+		{
+			partitions_.back().end = split;
+			partitions_.push_back(Partition());
+			partitions_.back().begin = split;
+		}
+	}
+}
+
+void BulkLoader::WritePartitions()
+{
+	MutexLock l(&mu_);
+	for (int i = 0; i < options_.threads && i < static_cast<int> (
+			partitions_.size()); i++)
+	{
+		running_++;
+		env_->StartThread(&BulkLoader::PartitionThread, this);
+	}
+	while (running_ > 0)
+	{
+		cv_.Wait();
+	}
+}
+
+void BulkLoader::PartitionThread(void* arg)
+{
+	BulkLoader* loader = reinterpret_cast<BulkLoader*> (arg);
+	MutexLock l(&loader->mu_);
+	while (loader->bg_status_.ok() && loader->next_partition_
+			< loader->partitions_.size())
+	{
+		Partition* p = &loader->partitions_[loader->next_partition_++];
+		loader->mu_.Unlock();
+		Status s = loader->WritePartition(p);
+		loader->mu_.Lock();
+		if ( !s.ok() && loader->bg_status_.ok() )
+		{
+			loader->bg_status_ = s;
+		}
+	}
+	loader->running_--;
+	loader->cv_.SignalAll();
+}
+
+Status BulkLoader::WritePartition(Partition* p)
+{
+	std::vector<Iterator*> list;
+	ReadOptions options;
+	options.fill_cache = false;
+	for (size_t i = 0; i < runs_.size(); i++)
+	{
+		list.push_back(runs_[i].table->NewIterator(options));
+	}
+	Iterator* iter = NewMergingIterator(ucmp_, &list[0], list.size());
+	if ( p->begin.empty() )
+	{
+		iter->SeekToFirst();
+	}
+	else
+	{
+		iter->Seek(p->begin);
+	}
+
+	Status s;
+	std::string last_key, ikey;
+	bool has_last_key = false;
+	WritableFile* file = NULL;
+	TableBuilder* builder = NULL;
+	FileMetaData meta;
+	for (; s.ok() && iter->Valid(); iter->Next())
+	{
+		const Slice key = iter->key();
+		if ( !p->end.empty() && ucmp_->Compare(key, p->end) >= 0 )
+		{
+			break;
+		}
+		if ( has_last_key && ucmp_->Compare(key, last_key) == 0 )
+		{
+			continue; // Older value from a later run
+		}
+		last_key.assign(key.data(), key.size());
+		has_last_key = true;
+
+		if ( builder == NULL )
+		{
+			meta = FileMetaData();
+			meta.number = NewFileNumber();
+			s = env_->NewWritableFile(TableFileName(dbname_, meta.number),
+					&file);
+			if ( !s.ok() )
+			{
+				break;
+			}
+			builder = new TableBuilder(table_options_, file);
+		}
+		ikey.clear();
+		AppendInternalKey(&ikey, ParsedInternalKey(key, 0, kTypeValue));
+		if ( builder->NumEntries() == 0 )
+		{
+			meta.smallest.DecodeFrom(ikey);
+		}
+		meta.largest.DecodeFrom(ikey);
+		builder->Add(ikey, iter->value());
+
+		if ( builder->FileSize() >= options_.max_file_size )
+		{
+			s = FinishTable(builder, file, &meta);
+			builder = NULL;
+			file = NULL;
+			if ( s.ok() )
+			{
+				p->files.push_back(meta);
+			}
+		}
+	}
+	if ( s.ok() )
+	{
+		s = iter->status();
+	}
+	delete iter;
+	if ( builder != NULL )
+	{
+		if ( s.ok() )
+		{
+			s = FinishTable(builder, file, &meta);
+			if ( s.ok() )
+			{
+				p->files.push_back(meta);
+			}
+		}
+		else
+		{
+			builder->Abandon();
+			delete builder;
+			delete file;
+		}
+	}
+	return s;
+}
+
+// Finish the table and delete builder and file
+Status BulkLoader::FinishTable(TableBuilder* builder, WritableFile* file,
+		FileMetaData* meta)
+{
+	Status s = builder->Finish();
+	meta->file_size = builder->FileSize();
+	delete builder;
+	if ( s.ok() )
+	{
+		s = file->Sync();
+	}
+	if ( s.ok() )
+	{
+		s = file->Close();
+	}
+	delete file;
+	return s;
+}
+
+Status BulkLoader::WriteDescriptor()
+{
+	// All tables go to the last level: they do not overlap
+	VersionEdit edit;
+	edit.SetComparatorName(ucmp_->Name());
+	edit.SetLogNumber(0);
+	edit.SetNextFile(next_file_number_);
+	edit.SetLastSequence(0);
+	for (size_t i = 0; i < partitions_.size(); i++)
+	{
+		for (size_t j = 0; j < partitions_[i].files.size(); j++)
+		{
+			edit.AddFile(config::kNumLevels - 1, partitions_[i].files[j]);
+		}
+	}
+
+	const std::string manifest = DescriptorFileName(dbname_, 1);
+	WritableFile* file;
+	Status s = env_->NewWritableFile(manifest, &file);
+	if ( !s.ok() )
+	{
+		return s;
+	}
+	{
+		log::Writer log(file);
+		std::string record;
+		edit.EncodeTo(&record);
+		s = log.AddRecord(record);
+		if ( s.ok() )
+		{
+			s = file->Sync();
+		}
+		if ( s.ok() )
+		{
+			s = file->Close();
+		}
+	}
+	delete file;
+	if ( s.ok() )
+	{
+		// Make "CURRENT" file that points to the new manifest file.
+		s = SetCurrentFile(env_, dbname_, 1);
+	}
+	else
+	{
+		env_->DeleteFile(manifest);
+	}
+	return s;
+}
+
+void BulkLoader::RemoveRuns()
+{
+	for (size_t i = 0; i < runs_.size(); i++)
+	{
+		delete runs_[i].table;
+		delete runs_[i].file;
+		env_->DeleteFile(TempFileName(dbname_, runs_[i].number));
+	}
+	runs_.clear();
+}
+
+} // namespace
+
+Status BulkLoad(Env* env, const std::string& dbname,
+		const BulkLoadOptions& options, SequentialFile* input,
+		BulkLoadStats* stats)
+{
+	BulkLoader loader(env, dbname, options);
+	return loader.Load(input, stats);
+}
+
+} // namespace leveldb
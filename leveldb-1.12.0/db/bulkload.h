@@ -0,0 +1,59 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_BULKLOAD_H_
+#define STORAGE_LEVELDB_DB_BULKLOAD_H_
+
+#include <stdint.h>
+#include <string>
+#include "leveldb/options.h"
+#include "leveldb/status.h"
+
+namespace leveldb
+{
+
+class Env;
+class SequentialFile;
+
+struct BulkLoadOptions
+{
+		int threads; // Worker threads
+		size_t memory; // Bytes of input buffered at once, over all buffers
+		uint64_t max_file_size; // Target size of a database table
+		CompressionType compression;
+		int bloom_bits; // Bloom filter bits per key, or 0 for none
+
+		BulkLoadOptions() :
+			threads(4), memory(256 << 20), max_file_size(2 << 20),
+					compression(kSnappyCompression), bloom_bits(0)
+		{
+		}
+};
+
+// What a successful BulkLoad() did
+struct BulkLoadStats
+{
+		uint64_t records; // Input records, repeated keys included
+		uint64_t tables; // Tables written to the database
+		uint64_t bytes; // Bytes of those tables
+		uint64_t sort_micros; // Reading the input into sorted runs
+		uint64_t write_micros; // Merging the runs into the tables
+
+		BulkLoadStats() :
+			records(0), tables(0), bytes(0), sort_micros(0), write_micros(0)
+		{
+		}
+};
+
+// Build the database "dbname", which must not exist yet, from the
+// "key<TAB>value" lines of *input.  Its tables all go to the last level
+// and hold their entries at sequence number 0.  If stats is non-NULL,
+// *stats is filled in on success.
+extern Status BulkLoad(Env* env, const std::string& dbname,
+		const BulkLoadOptions& options, SequentialFile* input,
+		BulkLoadStats* stats);
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BULKLOAD_H_
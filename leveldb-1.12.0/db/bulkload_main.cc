@@ -0,0 +1,103 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// leveldb_bulkload: builds a new database from "key<TAB>value" lines
+// with BulkLoad() (see db/bulkload.cc).
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "db/bulkload.h"
+#include "leveldb/env.h"
+
+static void Usage()
+{
+	fprintf(stderr, "Usage: leveldb_bulkload --db=<path> [options]\n"
+		"   --input=<file>        -- records, one \"key<TAB>value\" per line"
+		" (default: stdin)\n"
+		"   --threads=<n>         -- worker threads (default: 4)\n"
+		"   --memory_mb=<n>       -- memory for buffered input (default: 256)\n"
+		"   --file_size_mb=<n>    -- size of the tables written (default: 2)\n"
+		"   --compression=<0|1>   -- snappy compress the tables (default: 1)\n"
+		"   --bloom_bits=<n>      -- bloom filter bits per key (default: 0)\n");
+}
+
+int main(int argc, char** argv)
+{
+	leveldb::Env* env = leveldb::Env::Default();
+	leveldb::BulkLoadOptions options;
+	std::string dbname;
+	std::string input = "/dev/stdin";
+	bool ok = true;
+	for (int i = 1; ok && i < argc; i++)
+	{
+		int n;
+		char junk;
+		if ( strncmp(argv[i], "--db=", 5) == 0 )
+		{
+			dbname = argv[i] + 5;
+		}
+		else if ( strncmp(argv[i], "--input=", 8) == 0 )
+		{
+			input = argv[i] + 8;
+		}
+		else if ( sscanf(argv[i], "--threads=%d%c", &n, &junk) == 1 && n > 0 )
+		{
+			options.threads = n;
+		}
+		else if ( sscanf(argv[i], "--memory_mb=%d%c", &n, &junk) == 1 && n
+				> 0 )
+		{
+			options.memory = static_cast<size_t> (n) << 20;
+		}
+		else if ( sscanf(argv[i], "--file_size_mb=%d%c", &n, &junk) == 1 && n
+				> 0 )
+		{
+			options.max_file_size = static_cast<uint64_t> (n) << 20;
+		}
+		else if ( sscanf(argv[i], "--compression=%d%c", &n, &junk) == 1 && (n
+				== 0 || n == 1) )
+		{
+			options.compression = n ? leveldb::kSnappyCompression
+					: leveldb::kNoCompression;
+		}
+		else if ( sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1 && n
+				>= 0 )
+		{
+			options.bloom_bits = n;
+		}
+		else
+		{
+			ok = false;
+		}
+	}
+	if ( !ok || dbname.empty() )
+	{
+		Usage();
+		return 1;
+	}
+
+	leveldb::SequentialFile* file;
+	leveldb::Status s = env->NewSequentialFile(input, &file);
+	if ( s.ok() )
+	{
+		leveldb::BulkLoadStats stats;
+		s = leveldb::BulkLoad(env, dbname, options, file, &stats);
+		delete file;
+		if ( s.ok() )
+		{
+			fprintf(stderr, "loaded %llu records: %llu tables, %llu bytes; "
+				"%.1fs sorting, %.1fs writing\n",
+					(unsigned long long) stats.records,
+					(unsigned long long) stats.tables,
+					(unsigned long long) stats.bytes, stats.sort_micros * 1e-6,
+					stats.write_micros * 1e-6);
+		}
+	}
+	if ( !s.ok() )
+	{
+		fprintf(stderr, "%s\n", s.ToString().c_str());
+	}
+	return (s.ok() ? 0 : 1);
+}
@@ -0,0 +1,206 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/bulkload.h"
+
+#include <stdio.h>
+#include <map>
+#include "leveldb/compaction_filter.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/random.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+class BulkLoadTest {
+ public:
+  Env* env_;
+  std::string dbname_;
+  std::string input_;
+  DB* db_;
+  BulkLoadStats stats_;
+
+  BulkLoadTest() : env_(Env::Default()), db_(NULL) {
+    dbname_ = test::TmpDir() + "/bulkload_test";
+    input_ = test::TmpDir() + "/bulkload_test_input";
+    DestroyDB(dbname_, Options());
+  }
+
+  ~BulkLoadTest() {
+    delete db_;
+    DestroyDB(dbname_, Options());
+    env_->DeleteFile(input_);
+  }
+
+  Status Load(const std::string& lines, const BulkLoadOptions& options) {
+    Status s = WriteStringToFile(env_, lines, input_);
+    SequentialFile* file;
+    if (s.ok()) {
+      s = env_->NewSequentialFile(input_, &file);
+    }
+    if (s.ok()) {
+      s = BulkLoad(env_, dbname_, options, file, &stats_);
+      delete file;
+    }
+    return s;
+  }
+
+  Status Open() {
+    return Open(Options());
+  }
+
+  Status Open(const Options& options) {
+    delete db_;
+    db_ = NULL;
+    return DB::Open(options, dbname_, &db_);
+  }
+
+  std::string Get(const std::string& k) {
+    std::string result;
+    Status s = db_->Get(ReadOptions(), k, &result);
+    if (s.IsNotFound()) {
+      result = "NOT_FOUND";
+    } else if (!s.ok()) {
+      result = s.ToString();
+    }
+    return result;
+  }
+
+  std::string Contents() {
+    std::string result;
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      result += "(" + iter->key().ToString() + "->" +
+          iter->value().ToString() + ")";
+    }
+    delete iter;
+    return result;
+  }
+
+  std::string Contents(const std::map<std::string, std::string>& m) {
+    std::string result;
+    for (std::map<std::string, std::string>::const_iterator it = m.begin();
+         it != m.end(); ++it) {
+      result += "(" + it->first + "->" + it->second + ")";
+    }
+    return result;
+  }
+};
+
+TEST(BulkLoadTest, LastValueWins) {
+  // Unsorted input, with keys repeated within and across the runs
+  Random rnd(301);
+  std::map<std::string, std::string> expected;
+  std::string lines;
+  for (int i = 0; i < 3000; i++) {
+    char key[100], value[100];
+    snprintf(key, sizeof(key), "key%06d", static_cast<int>(rnd.Uniform(800)));
+    snprintf(value, sizeof(value), "v%d", i);
+    lines += std::string(key) + "\t" + value + "\n";
+    expected[key] = value;
+  }
+  // A line without a tab holds an empty value, even if unterminated
+  lines += "key000000";
+  expected["key000000"] = "";
+
+  BulkLoadOptions options;
+  options.threads = 3;
+  options.memory = 64 << 10;       // Several runs
+  options.max_file_size = 4 << 10; // Several tables
+  options.compression = kNoCompression;
+  ASSERT_OK(Load(lines, options));
+  ASSERT_EQ(3001, stats_.records);
+  ASSERT_TRUE(stats_.tables > 1);
+  ASSERT_TRUE(!Load(lines, options).ok()); // The database exists now
+
+  ASSERT_OK(Open());
+  ASSERT_EQ(Contents(expected), Contents());
+  for (std::map<std::string, std::string>::const_iterator it =
+           expected.begin(); it != expected.end(); ++it) {
+    ASSERT_EQ(it->second, Get(it->first));
+  }
+}
+
+TEST(BulkLoadTest, LaterWritesShadow) {
+  std::map<std::string, std::string> expected;
+  std::string lines;
+  for (int i = 0; i < 1000; i++) {
+    char key[100];
+    snprintf(key, sizeof(key), "key%06d", (i * 7) % 1000);
+    lines += std::string(key) + "\tloaded\n";
+    expected[key] = "loaded";
+  }
+  BulkLoadOptions options;
+  options.threads = 2;
+  options.memory = 16 << 10;
+  options.max_file_size = 4 << 10;
+  options.compression = kNoCompression;
+  ASSERT_OK(Load(lines, options));
+
+  // The loaded entries are at sequence 0, older than any write
+  ASSERT_OK(Open());
+  for (int i = 0; i < 1000; i += 10) {
+    char key[100];
+    snprintf(key, sizeof(key), "key%06d", i);
+    if (i % 20 == 0) {
+      ASSERT_OK(db_->Put(WriteOptions(), key, "written"));
+      expected[key] = "written";
+    } else {
+      ASSERT_OK(db_->Delete(WriteOptions(), key));
+      expected.erase(key);
+    }
+  }
+  ASSERT_EQ("written", Get("key000000"));
+  ASSERT_EQ("NOT_FOUND", Get("key000010"));
+  ASSERT_EQ(Contents(expected), Contents());
+
+  // Also once the writes are in the tables, compacted with the loaded ones
+  ASSERT_OK(Open());
+  ASSERT_EQ(Contents(expected), Contents());
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ("written", Get("key000000"));
+  ASSERT_EQ("NOT_FOUND", Get("key000010"));
+  ASSERT_EQ("loaded", Get("key000001"));
+  ASSERT_EQ(Contents(expected), Contents());
+  ASSERT_OK(Open());
+  ASSERT_EQ(Contents(expected), Contents());
+}
+
+namespace {
+class ExpiredFilter : public CompactionFilter {
+ public:
+  virtual const char* Name() const { return "ExpiredFilter"; }
+  virtual bool Filter(int level, const Slice& key, const Slice& existing_value,
+                      std::string* new_value, bool* value_changed) const {
+    return existing_value == Slice("expired");
+  }
+};
+}
+
+TEST(BulkLoadTest, CompactionFilter) {
+  BulkLoadOptions options;
+  options.compression = kNoCompression;
+  ASSERT_OK(Load("a\texpired\nb\tkeep\nc\texpired\n", options));
+
+  // The loaded entries, at sequence 0, are filtered too once a compaction
+  // reaches the last level
+  ExpiredFilter filter;
+  Options db_options;
+  db_options.compaction_filter = &filter;
+  ASSERT_OK(Open(db_options));
+  ASSERT_OK(db_->Put(WriteOptions(), "a", "new"));
+  ASSERT_OK(db_->Put(WriteOptions(), "d", "new"));
+  db_->CompactRange(NULL, NULL);
+  ASSERT_EQ("new", Get("a"));
+  ASSERT_EQ("keep", Get("b"));
+  ASSERT_EQ("NOT_FOUND", Get("c"));
+  ASSERT_EQ("(a->new)(b->keep)(d->new)", Contents());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
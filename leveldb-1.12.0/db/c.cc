@@ -30,6 +30,7 @@ using leveldb::Logger;
 using leveldb::NewBloomFilterPolicy;
 using leveldb::NewLRUCache;
 using leveldb::Options;
+using leveldb::PinnableSlice;
 using leveldb::RandomAccessFile;
 using leveldb::Range;
 using leveldb::ReadOptions;
@@ -63,6 +64,10 @@ struct leveldb_snapshot_t
 struct leveldb_readoptions_t
 {
 		ReadOptions rep;
+		std::string lower_bound; // Backing store for the bounds of rep
+		std::string upper_bound;
+		Slice lower_bound_slice;
+		Slice upper_bound_slice;
 };
 struct leveldb_writeoptions_t
 {
@@ -72,6 +77,10 @@ struct leveldb_options_t
 {
 		Options rep;
 };
+struct leveldb_pinnableslice_t
+{
+		PinnableSlice rep;
+};
 struct leveldb_cache_t
 {
 		Cache* rep;
@@ -274,6 +283,36 @@ char* leveldb_get(leveldb_t* db, const leveldb_readoptions_t* options,
 	return result;
 }
 
+leveldb_pinnableslice_t* leveldb_get_pinned(leveldb_t* db,
+		const leveldb_readoptions_t* options, const char* key, size_t keylen,
+		char** errptr)
+{
+	leveldb_pinnableslice_t* result = new leveldb_pinnableslice_t;
+	Status s = db->rep->Get(options->rep, Slice(key, keylen), &result->rep);
+	if ( !s.ok() )
+	{
+		delete result;
+		result = NULL;
+		if ( !s.IsNotFound() )
+		{
+			SaveError(errptr, s);
+		}
+	}
+	return result;
+}
+
+const char* leveldb_pinnableslice_value(const leveldb_pinnableslice_t* slice,
+		size_t* vallen)
+{
+	*vallen = slice->rep.size();
+	return slice->rep.data();
+}
+
+void leveldb_pinnableslice_destroy(leveldb_pinnableslice_t* slice)
+{
+	delete slice;
+}
+
 leveldb_iterator_t* leveldb_create_iterator(leveldb_t* db,
 		const leveldb_readoptions_t* options)
 {
@@ -639,6 +678,36 @@ void leveldb_readoptions_set_snapshot(leveldb_readoptions_t* opt,
 	opt->rep.snapshot = (snap ? snap->rep : NULL);
 }
 
+void leveldb_readoptions_set_iterate_lower_bound(leveldb_readoptions_t* opt,
+		const char* key, size_t keylen)
+{
+	if ( key == NULL )
+	{
+		opt->rep.iterate_lower_bound = NULL;
+	}
+	else
+	{
+		opt->lower_bound.assign(key, keylen);
+		opt->lower_bound_slice = opt->lower_bound;
+		opt->rep.iterate_lower_bound = &opt->lower_bound_slice;
+	}
+}
+
+void leveldb_readoptions_set_iterate_upper_bound(leveldb_readoptions_t* opt,
+		const char* key, size_t keylen)
+{
+	if ( key == NULL )
+	{
+		opt->rep.iterate_upper_bound = NULL;
+	}
+	else
+	{
+		opt->upper_bound.assign(key, keylen);
+		opt->upper_bound_slice = opt->upper_bound;
+		opt->rep.iterate_upper_bound = &opt->upper_bound_slice;
+	}
+}
+
 leveldb_writeoptions_t* leveldb_writeoptions_create()
 {
 	return new leveldb_writeoptions_t;
@@ -69,10 +69,21 @@ static void CheckGet(
   char* err = NULL;
   size_t val_len;
   char* val;
+  leveldb_pinnableslice_t* pinned;
   val = leveldb_get(db, options, key, strlen(key), &val_len, &err);
   CheckNoError(err);
   CheckEqual(expected, val, val_len);
   Free(&val);
+
+  pinned = leveldb_get_pinned(db, options, key, strlen(key), &err);
+  CheckNoError(err);
+  if (pinned == NULL) {
+    CheckEqual(expected, NULL, 0);
+  } else {
+    CheckEqual(expected, leveldb_pinnableslice_value(pinned, &val_len),
+               val_len);
+    leveldb_pinnableslice_destroy(pinned);
+  }
 }
 
 static void CheckIter(leveldb_iterator_t* iter,
@@ -271,6 +282,17 @@ int main(int argc, char** argv) {
     leveldb_iter_get_error(iter, &err);
     CheckNoError(err);
     leveldb_iter_destroy(iter);
+
+    leveldb_readoptions_set_iterate_upper_bound(roptions, "c", 1);
+    iter = leveldb_create_iterator(db, roptions);
+    leveldb_iter_seek_to_first(iter);
+    CheckIter(iter, "box", "c");
+    leveldb_iter_next(iter);
+    CheckCondition(!leveldb_iter_valid(iter));
+    leveldb_iter_seek_to_last(iter);
+    CheckIter(iter, "box", "c");
+    leveldb_iter_destroy(iter);
+    leveldb_readoptions_set_iterate_upper_bound(roptions, NULL, 0);
   }
 
   StartPhase("approximate_sizes");
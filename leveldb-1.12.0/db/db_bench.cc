@@ -10,9 +10,12 @@
 #include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/perf_context.h"
+#include "leveldb/statistics.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
 #include "util/crc32c.h"
+#include "util/hash.h"
 #include "util/histogram.h"
 #include "util/mutexlock.h"
 #include "util/random.h"
@@ -29,16 +32,22 @@
 //      deleterandom  -- delete N keys in random order
 //      readseq       -- read N times sequentially
 //      readreverse   -- read N times in reverse order
+//      seekreverse   -- read N times in reverse order, 100 keys back from
+//                       each of N/100 random seeks
 //      readrandom    -- read N times in random order
 //      readmissing   -- read N missing keys in random order
 //      readhot       -- read N times in random order from 1% section of DB
 //      seekrandom    -- N random seeks
 //      crc32c        -- repeated crc32c of 4K of data
+//      crc32c_portable -- crc32c without the SSE4.2 instructions
+//      crc32c_hw     -- crc32c with the SSE4.2 instructions, if supported
+//      xxhash64      -- repeated xxHash64 of 4K of data
 //      acquireload   -- load N*1000 times
 //   Meta operations:
 //      compact     -- Compact the entire DB
 //      stats       -- Print DB stats
 //      sstables    -- Print sstable info
+//      statistics  -- Print the tickers and histograms (with --statistics=1)
 //      heapprofile -- Dump a heap profile (if supported by this port)
 static const char* FLAGS_benchmarks = "fillseq,"
 	"fillsync,"
@@ -77,6 +86,13 @@ static double FLAGS_compression_ratio = 0.5;
 // Print histogram of operation timings
 static bool FLAGS_histogram = false;
 
+// Collect and print the PerfContext and IOStatsContext of the first thread
+// of each benchmark: 0 for nothing, 1 for counts, 2 for counts and times
+static int FLAGS_perf_level = 0;
+
+// Collect Options::statistics for the "statistics" benchmark to print
+static bool FLAGS_statistics = false;
+
 // Number of bytes to buffer in memtable before compacting
 // (initialized to default value by "main")
 static int FLAGS_write_buffer_size = 0;
@@ -85,13 +101,40 @@ static int FLAGS_write_buffer_size = 0;
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
 
-// Maximum number of files to keep open at the same time (use default if == 0)
+// Number of bytes to use as a cache of rows (zero means no row cache).
+static int FLAGS_row_cache_size = 0;
+
+// Directory, on faster storage, of a secondary tier under the block
+// cache holding up to FLAGS_secondary_cache_size bytes (none if NULL)
+static const char* FLAGS_secondary_cache_path = NULL;
+static long long FLAGS_secondary_cache_size = 1LL << 30;
+
+// Maximum number of files to keep open at the same time (use default if == 0,
+// keep every table open from the start if == -1)
 static int FLAGS_open_files = 0;
 
+// Number of obsolete log files kept for reuse by new logs
+static int FLAGS_recycle_log_file_num = 0;
+
+// Start writing back logs and tables every this many bytes (0 disables)
+static int FLAGS_bytes_per_sync = 0;
+
+// If true, sync writes wait for a dedicated log sync thread
+static bool FLAGS_background_wal_sync = false;
+
+// If true, DB::Open leaves the last recovered memtable to the background
+static bool FLAGS_avoid_flush_during_recovery = false;
+
+// Share of deletion markers that gets a table compacted (0 disables it)
+static double FLAGS_deletion_compaction_ratio = 0;
+
 // Bloom filter bits per key.
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// If true, build data blocks with a hash index for point lookups
+static bool FLAGS_data_block_hash_index = false;
+
 // If true, do not destroy the existing database.  If you set this
 // flag and also specify a benchmark that wants a fresh database, that
 // benchmark will fail.
@@ -333,6 +376,8 @@ struct ThreadState
 		Random rand; // Has different seeds for different threads
 		Stats stats;
 		SharedState* shared;
+		PerfContext perf_context; // As of the end of the benchmark
+		IOStatsContext iostats_context;
 
 		ThreadState(int index) :
 			tid(index), rand(1000 + index)
@@ -340,13 +385,33 @@ struct ThreadState
 		}
 };
 
+SecondaryCache* NewSecondaryCache()
+{
+	if ( FLAGS_secondary_cache_path == NULL )
+	{
+		return NULL;
+	}
+	SecondaryCache* secondary;
+	Status s = NewLogSecondaryCache(Env::Default(),
+			FLAGS_secondary_cache_path, FLAGS_secondary_cache_size, &secondary);
+	if ( !s.ok() )
+	{
+		fprintf(stderr, "secondary cache error: %s\n", s.ToString().c_str());
+		exit(1);
+	}
+	return secondary;
+}
+
 } // namespace
 
 class Benchmark
 {
 	private:
+		SecondaryCache* secondary_cache_;
 		Cache* cache_;
+		Cache* row_cache_;
 		const FilterPolicy* filter_policy_;
+		Statistics* statistics_;
 		DB* db_;
 		int num_;
 		int value_size_;
@@ -449,11 +514,18 @@ class Benchmark
 
 	public:
 		Benchmark() :
+					secondary_cache_(NewSecondaryCache()),
 					cache_(
 							FLAGS_cache_size >= 0 ? NewLRUCache(
-									FLAGS_cache_size) : NULL), filter_policy_(
+									FLAGS_cache_size, secondary_cache_) : NULL),
+					row_cache_(
+							FLAGS_row_cache_size > 0 ? NewLRUCache(
+									FLAGS_row_cache_size) : NULL),
+					filter_policy_(
 							FLAGS_bloom_bits >= 0 ? NewBloomFilterPolicy(
-									FLAGS_bloom_bits) : NULL), db_(NULL), num_(
+									FLAGS_bloom_bits) : NULL),
+					statistics_(FLAGS_statistics ? NewStatistics() : NULL),
+					db_(NULL), num_(
 							FLAGS_num), value_size_(FLAGS_value_size),
 					entries_per_batch_(1), reads_(FLAGS_reads < 0 ? FLAGS_num
 							: FLAGS_reads), heap_counter_(0)
@@ -478,7 +550,10 @@ class Benchmark
 		{
 			delete db_;
 			delete cache_;
+			delete secondary_cache_;
+			delete row_cache_;
 			delete filter_policy_;
+			delete statistics_;
 		}
 
 		void Run()
@@ -556,6 +631,10 @@ class Benchmark
 				{
 					method = &Benchmark::ReadReverse;
 				}
+				else if ( name == Slice("seekreverse") )
+				{
+					method = &Benchmark::SeekReverse;
+				}
 				else if ( name == Slice("readrandom") )
 				{
 					method = &Benchmark::ReadRandom;
@@ -598,6 +677,18 @@ class Benchmark
 				{
 					method = &Benchmark::Crc32c;
 				}
+				else if ( name == Slice("crc32c_portable") )
+				{
+					method = &Benchmark::Crc32cPortable;
+				}
+				else if ( name == Slice("crc32c_hw") )
+				{
+					method = &Benchmark::Crc32cHardware;
+				}
+				else if ( name == Slice("xxhash64") )
+				{
+					method = &Benchmark::XXHash64;
+				}
 				else if ( name == Slice("acquireload") )
 				{
 					method = &Benchmark::AcquireLoad;
@@ -622,6 +713,10 @@ class Benchmark
 				{
 					PrintStats("leveldb.sstables");
 				}
+				else if ( name == Slice("statistics") )
+				{
+					PrintStats("leveldb.statistics");
+				}
 				else
 				{
 					if ( name != Slice() )
@@ -684,9 +779,14 @@ class Benchmark
 				}
 			}
 
+			SetPerfLevel(static_cast<PerfLevel> (FLAGS_perf_level));
+			GetPerfContext()->Reset();
+			GetIOStatsContext()->Reset();
 			thread->stats.Start();
 			(arg->bm->*(arg->method))(thread);
 			thread->stats.Stop();
+			thread->perf_context = *GetPerfContext();
+			thread->iostats_context = *GetIOStatsContext();
 
 			{
 				MutexLock l(&shared->mu);
@@ -737,6 +837,12 @@ class Benchmark
 				arg[0].thread->stats.Merge(arg[i].thread->stats);
 			}
 			arg[0].thread->stats.Report(name);
+			if ( FLAGS_perf_level > kDisable )
+			{
+				fprintf(stdout, "PERF_CONTEXT:\n%s\nIOSTATS_CONTEXT:\n%s\n",
+						arg[0].thread->perf_context.ToString().c_str(),
+						arg[0].thread->iostats_context.ToString().c_str());
+			}
 
 			for (int i = 0; i < n; i++)
 			{
@@ -745,27 +851,74 @@ class Benchmark
 			delete[] arg;
 		}
 
-		void Crc32c(ThreadState* thread)
+		enum ChecksumFunction
+		{
+			kCrc32c, kCrc32cPortable, kCrc32cHardware, kXXHash64
+		};
+
+		void Checksum(ThreadState* thread, ChecksumFunction function)
 		{
+			if ( function == kCrc32cHardware
+					&& !crc32c::IsHardwareAccelerated() )
+			{
+				thread->stats.AddMessage("(SSE4.2 not supported)");
+				return;
+			}
+
 			// Checksum about 500MB of data total
 			const int size = 4096;
 			const char* label = "(4K per op)";
 			std::string data(size, 'x');
 			int64_t bytes = 0;
-			uint32_t crc = 0;
+			uint64_t crc = 0;
 			while (bytes < 500 * 1048576)
 			{
-				crc = crc32c::Value(data.data(), size);
+				switch (function)
+				{
+				case kCrc32c:
+					crc = crc32c::Value(data.data(), size);
+					break;
+				case kCrc32cPortable:
+					crc = crc32c::ExtendPortable(0, data.data(), size);
+					break;
+				case kCrc32cHardware:
+					crc = crc32c::ExtendHardware(0, data.data(), size);
+					break;
+				case kXXHash64:
+					crc = leveldb::XXHash64(data.data(), size, 0);
+					break;
+				}
 				thread->stats.FinishedSingleOp();
 				bytes += size;
 			}
 			// Print so result is not dead
-			fprintf(stderr, "... crc=0x%x\r", static_cast<unsigned int> (crc));
+			fprintf(stderr, "... crc=0x%llx\r",
+					static_cast<unsigned long long> (crc));
 
 			thread->stats.AddBytes(bytes);
 			thread->stats.AddMessage(label);
 		}
 
+		void Crc32c(ThreadState* thread)
+		{
+			Checksum(thread, kCrc32c);
+		}
+
+		void Crc32cPortable(ThreadState* thread)
+		{
+			Checksum(thread, kCrc32cPortable);
+		}
+
+		void Crc32cHardware(ThreadState* thread)
+		{
+			Checksum(thread, kCrc32cHardware);
+		}
+
+		void XXHash64(ThreadState* thread)
+		{
+			Checksum(thread, kXXHash64);
+		}
+
 		void AcquireLoad(ThreadState* thread)
 		{
 			int dummy;
@@ -851,9 +1004,19 @@ class Benchmark
 			Options options;
 			options.create_if_missing = !FLAGS_use_existing_db;
 			options.block_cache = cache_;
+			options.row_cache = row_cache_;
+			options.statistics = statistics_;
 			options.write_buffer_size = FLAGS_write_buffer_size;
 			options.max_open_files = FLAGS_open_files;
+			options.recycle_log_file_num = FLAGS_recycle_log_file_num;
+			options.bytes_per_sync = FLAGS_bytes_per_sync;
+			options.background_wal_sync = FLAGS_background_wal_sync;
+			options.avoid_flush_during_recovery
+					= FLAGS_avoid_flush_during_recovery;
+			options.deletion_compaction_ratio
+					= FLAGS_deletion_compaction_ratio;
 			options.filter_policy = filter_policy_;
+			options.data_block_hash_index = FLAGS_data_block_hash_index;
 			Status s = DB::Open(options, FLAGS_db, &db_);
 			if ( !s.ok() )
 			{
@@ -938,6 +1101,27 @@ class Benchmark
 			thread->stats.AddBytes(bytes);
 		}
 
+		void SeekReverse(ThreadState* thread)
+		{
+			Iterator* iter = db_->NewIterator(ReadOptions());
+			int64_t bytes = 0;
+			for (int i = 0; i < reads_; i += 100)
+			{
+				char key[100];
+				const int k = thread->rand.Next() % FLAGS_num;
+				snprintf(key, sizeof(key), "%016d", k);
+				iter->Seek(key);
+				for (int j = 0; j < 100 && i + j < reads_ && iter->Valid(); j++)
+				{
+					bytes += iter->key().size() + iter->value().size();
+					thread->stats.FinishedSingleOp();
+					iter->Prev();
+				}
+			}
+			delete iter;
+			thread->stats.AddBytes(bytes);
+		}
+
 		void ReadRandom(ThreadState* thread)
 		{
 			ReadOptions options;
@@ -1139,6 +1323,7 @@ int main(int argc, char** argv)
 	{
 		double d;
 		int n;
+		long long ll;
 		char junk;
 		if ( leveldb::Slice(argv[i]).starts_with("--benchmarks=") )
 		{
@@ -1153,6 +1338,16 @@ int main(int argc, char** argv)
 		{
 			FLAGS_histogram = n;
 		}
+		else if ( sscanf(argv[i], "--statistics=%d%c", &n, &junk) == 1
+				&& (n == 0 || n == 1) )
+		{
+			FLAGS_statistics = n;
+		}
+		else if ( sscanf(argv[i], "--perf_level=%d%c", &n, &junk) == 1
+				&& n >= leveldb::kDisable && n <= leveldb::kEnableTime )
+		{
+			FLAGS_perf_level = n;
+		}
 		else if ( sscanf(argv[i], "--use_existing_db=%d%c", &n, &junk) == 1
 				&& (n == 0 || n == 1) )
 		{
@@ -1182,18 +1377,60 @@ int main(int argc, char** argv)
 		{
 			FLAGS_cache_size = n;
 		}
+		else if ( sscanf(argv[i], "--row_cache_size=%d%c", &n, &junk) == 1 )
+		{
+			FLAGS_row_cache_size = n;
+		}
 		else if ( sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1 )
 		{
 			FLAGS_bloom_bits = n;
 		}
+		else if ( sscanf(argv[i], "--data_block_hash_index=%d%c", &n, &junk)
+				== 1 && (n == 0 || n == 1) )
+		{
+			FLAGS_data_block_hash_index = n;
+		}
 		else if ( sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1 )
 		{
 			FLAGS_open_files = n;
 		}
+		else if ( sscanf(argv[i], "--recycle_log_file_num=%d%c", &n, &junk)
+				== 1 )
+		{
+			FLAGS_recycle_log_file_num = n;
+		}
+		else if ( sscanf(argv[i], "--bytes_per_sync=%d%c", &n, &junk) == 1 )
+		{
+			FLAGS_bytes_per_sync = n;
+		}
+		else if ( sscanf(argv[i], "--background_wal_sync=%d%c", &n, &junk)
+				== 1 && (n == 0 || n == 1) )
+		{
+			FLAGS_background_wal_sync = n;
+		}
+		else if ( sscanf(argv[i], "--avoid_flush_during_recovery=%d%c", &n,
+				&junk) == 1 && (n == 0 || n == 1) )
+		{
+			FLAGS_avoid_flush_during_recovery = n;
+		}
+		else if ( sscanf(argv[i], "--deletion_compaction_ratio=%lf%c", &d,
+				&junk) == 1 )
+		{
+			FLAGS_deletion_compaction_ratio = d;
+		}
 		else if ( strncmp(argv[i], "--db=", 5) == 0 )
 		{
 			FLAGS_db = argv[i] + 5;
 		}
+		else if ( strncmp(argv[i], "--secondary_cache_path=", 23) == 0 )
+		{
+			FLAGS_secondary_cache_path = argv[i] + 23;
+		}
+		else if ( sscanf(argv[i], "--secondary_cache_size=%lld%c", &ll,
+				&junk) == 1 )
+		{
+			FLAGS_secondary_cache_size = ll;
+		}
 		else
 		{
 			fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
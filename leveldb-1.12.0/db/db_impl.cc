@@ -5,11 +5,13 @@
 #include "db/db_impl.h"
 
 #include <algorithm>
+#include <map>
 #include <set>
 #include <string>
 #include <stdint.h>
 #include <stdio.h>
 #include <vector>
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
@@ -17,14 +19,19 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/merge_context.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/merge_operator.h"
 #include "leveldb/status.h"
 #include "leveldb/table.h"
 #include "leveldb/table_builder.h"
+#include "leveldb/write_buffer_manager.h"
 #include "port/port.h"
 #include "table/block.h"
 #include "table/merger.h"
@@ -32,12 +39,17 @@
 #include "util/coding.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/perf_context_imp.h"
+#include "util/statistics_imp.h"
 
 namespace leveldb
 {
 
 const int kNumNonTableCacheFiles = 10;
 
+// Capacity of the file caches when max_open_files is -1
+static const int kUnboundedCacheEntries = 1 << 30;
+
 // Information kept for every waiting writer
 struct DBImpl::Writer
 {
@@ -45,10 +57,13 @@ struct DBImpl::Writer
 		WriteBatch* batch;
 		bool sync;
 		bool done;
+		// If non-zero once done, the write must still wait for the log to be
+		// synced past this sequence (see Options::background_wal_sync)
+		SequenceNumber log_sync_sequence;
 		port::CondVar cv;
 
 		explicit Writer(port::Mutex* mu) :
-			cv(mu)
+			log_sync_sequence(0), cv(mu)
 		{
 		}
 };
@@ -63,11 +78,36 @@ struct DBImpl::CompactionState //压缩
 		// we can drop all entries for the same key with sequence numbers < S.
 		SequenceNumber smallest_snapshot;
 
+		// Entries with sequence numbers > newest_snapshot are invisible to
+		// every live snapshot, so the compaction filter may rewrite them.
+		// Without a snapshot, all entries are, down to sequence number 0.
+		bool has_snapshot;
+		SequenceNumber newest_snapshot;
+
+		// Merge operands of the current user key that every snapshot sees,
+		// newest first, held back until the value they apply to is found.
+		std::vector<std::string> merge_keys;
+		std::vector<std::string> merge_values;
+
+		// Range deletions of the inputs.  Entries they hide from every
+		// snapshot are dropped.
+		RangeDelAggregator* range_del;
+
+		// The range deletions that outputs must keep, because they may hide
+		// entries of later snapshots or of deeper levels.  Each output gets
+		// the part of them from range_del_lower up to its successor's first
+		// key, so the outputs stay disjoint.
+		std::vector<RangeTombstone> range_del_outputs;
+		std::string range_del_lower;
+		bool has_range_del_lower;
+
 		// Files produced by compaction
 		struct Output
 		{
 				uint64_t number;
 				uint64_t file_size;
+				uint64_t num_range_deletions;
+				uint64_t num_entries, num_deletions;
 				InternalKey smallest, largest;
 		};
 		std::vector<Output> outputs;
@@ -78,13 +118,36 @@ struct DBImpl::CompactionState //压缩
 
 		uint64_t total_bytes;
 
+		// Blob file receiving the large values written by the compaction,
+		// and backing store for the entries referring to it
+		BlobFileBuilder* blob;
+		std::string blob_key;
+		std::string blob_index;
+
+		// Whether the tables may refer to blob files at all; the blob files
+		// whose values are copied out so that they can go (see
+		// Options::blob_gc_ratio); and backing store for a value read from
+		// a blob file
+		bool has_blob_files;
+		std::set<uint64_t> blob_gc_files;
+		std::string blob_value;
+
+		// Bytes of blob records the compaction stopped referring to, by file
+		std::map<uint64_t, uint64_t> blob_garbage;
+
+		// Number taken up front for the output of an intra-L0 compaction,
+		// until the output file is opened
+		uint64_t reserved_output_number;
+
 		Output* current_output()
 		{
 			return &outputs[outputs.size() - 1];
 		}
 
 		explicit CompactionState(Compaction* c) :
-			compaction(c), outfile(NULL), builder(NULL), total_bytes(0)
+			compaction(c), range_del(NULL), has_range_del_lower(false),
+					outfile(NULL), builder(NULL), total_bytes(0), blob(NULL),
+					has_blob_files(false), reserved_output_number(0)
 		{
 		}
 };
@@ -105,7 +168,11 @@ Options SanitizeOptions(const std::string& dbname,
 	Options result = src;
 	result.comparator = icmp;
 	result.filter_policy = (src.filter_policy != NULL) ? ipolicy : NULL;
-	ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
+	if ( result.max_open_files != -1 )
+	{
+		ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
+	}
+	ClipToRange(&result.max_file_opening_threads, 1, 256);
 	ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
 	ClipToRange(&result.block_size, 1 << 10, 4 << 20);
 	if ( result.info_log == NULL )
@@ -128,42 +195,88 @@ Options SanitizeOptions(const std::string& dbname,
 	return result;
 }
 
-DBImpl::DBImpl(const Options& options, const std::string& dbname) :
+DBImpl::DBImpl(const Options& options, const std::string& dbname,
+		DBImpl* root, uint32_t column_family_id) :
 	env_(options.env), internal_comparator_(options.comparator),
 			internal_filter_policy_(options.filter_policy), options_(
 					SanitizeOptions(dbname, &internal_comparator_,
 							&internal_filter_policy_, options)),
 			owns_info_log_(options_.info_log != options.info_log), owns_cache_(
 					options_.block_cache != options.block_cache), dbname_(
-					dbname), db_lock_(NULL), shutting_down_(NULL), bg_cv_(
-					&mutex_), mem_(new MemTable(internal_comparator_)), imm_(
-					NULL), logfile_(NULL), logfile_number_(0), log_(NULL),
-			tmp_batch_(new WriteBatch), bg_compaction_scheduled_(false),
-			manual_compaction_(NULL), consecutive_compaction_errors_(0)
+					dbname), db_lock_(NULL), root_(root != NULL ? root : this),
+			column_family_id_(column_family_id), mutex_(root_->own_mutex_),
+			shutting_down_(NULL), bg_cv_(&mutex_), mem_(new MemTable(
+					internal_comparator_, options_.write_buffer_manager)),
+			imm_(NULL), logfile_(NULL),
+			logfile_number_(0), log_(NULL), mem_log_number_(0),
+			log_sync_cv_(&log_sync_mu_), log_sync_thread_running_(false),
+			log_sync_requested_(0), log_synced_(0), log_syncing_(false),
+			first_log_number_(0), tmp_batch_(
+					new WriteBatch), snapshots_(root_->own_snapshots_),
+			bg_compaction_scheduled_(false), manual_compaction_(NULL),
+			consecutive_compaction_errors_(0), stall_condition_(kStallNormal)
 {
 	mem_->Ref();
 	has_imm_.Release_Store(NULL);
 
-	// Reserve ten files or so for other uses and give the rest to TableCache.
-	const int table_cache_size = options.max_open_files
-			- kNumNonTableCacheFiles;
+	// Reserve ten files or so for other uses and give the rest to TableCache,
+	// less a tenth for blob files if large values are kept apart.  With
+	// max_open_files == -1 no file is ever closed to make room.
+	int blob_cache_size = (options_.min_blob_size > 0)
+			? (options.max_open_files - kNumNonTableCacheFiles) / 10 : 1;
+	int table_cache_size = options.max_open_files
+			- kNumNonTableCacheFiles - blob_cache_size;
+	if ( options_.max_open_files == -1 )
+	{
+		blob_cache_size = kUnboundedCacheEntries;
+		table_cache_size = kUnboundedCacheEntries;
+	}
 	table_cache_ = new TableCache(dbname_, &options_, table_cache_size);
+	blob_cache_ = new BlobCache(dbname_, &options_, blob_cache_size);
 
-	versions_ = new VersionSet(dbname_, &options_, table_cache_,
+	versions_ = new VersionSet(dbname_, &options_, table_cache_, blob_cache_,
 			&internal_comparator_);
 }
 
 DBImpl::~DBImpl()
 {
-	// Wait for background work to finish
+	// Wait for background work to finish, in the column families too, as
+	// it may delete logs they need
 	mutex_.Lock();
 	shutting_down_.Release_Store(this); // Any non-NULL value is ok
+	std::map<uint32_t, ColumnFamilyHandleImpl*>::iterator it;
+	for (it = column_families_.begin(); it != column_families_.end(); ++it)
+	{
+		it->second->db()->shutting_down_.Release_Store(this);
+	}
 	while (bg_compaction_scheduled_)
 	{
 		bg_cv_.Wait();
 	}
+	log_sync_mu_.Lock();
+	log_sync_cv_.SignalAll();
+	while (log_sync_thread_running_)
+	{
+		log_sync_cv_.Wait();
+	}
+	log_sync_mu_.Unlock();
+	for (it = column_families_.begin(); it != column_families_.end(); ++it)
+	{
+		DBImpl* family = it->second->db();
+		while (family->bg_compaction_scheduled_)
+		{
+			family->bg_cv_.Wait();
+		}
+	}
 	mutex_.Unlock();
 
+	// The column families go first, as they use the log and the mutex
+	for (it = column_families_.begin(); it != column_families_.end(); ++it)
+	{
+		delete it->second->db();
+		delete it->second;
+	}
+
 	if ( db_lock_ != NULL )
 	{
 		env_->UnlockFile(db_lock_);
@@ -178,6 +291,7 @@ DBImpl::~DBImpl()
 	delete log_;
 	delete logfile_;
 	delete table_cache_;
+	delete blob_cache_;
 
 	if ( owns_info_log_ )
 	{
@@ -240,11 +354,34 @@ void DBImpl::MaybeIgnoreError(Status* s) const
 	}
 }
 
+uint64_t DBImpl::OldestLiveLog()
+{
+	mutex_.AssertHeld();
+	uint64_t oldest = (imm_ != NULL) ? versions_->LogNumber() : mem_log_number_;
+	for (std::map<uint32_t, ColumnFamilyHandleImpl*>::iterator it =
+			column_families_.begin(); it != column_families_.end(); ++it)
+	{
+		oldest = std::min(oldest, it->second->db()->OldestLiveLog());
+	}
+	return oldest;
+}
+
 void DBImpl::DeleteObsoleteFiles()
 {
 	// Make a set of all of the live files
 	std::set<uint64_t> live = pending_outputs_;
 	versions_->AddLiveFiles(&live);
+	const uint64_t oldest_log = OldestLiveLog();
+
+	// A log may be recycled once no recovery would replay it, i.e. it is
+	// older than the log numbers recorded in the descriptors
+	uint64_t recyclable_log = versions_->LogNumber();
+	for (std::map<uint32_t, ColumnFamilyHandleImpl*>::iterator it =
+			column_families_.begin(); it != column_families_.end(); ++it)
+	{
+		recyclable_log = std::min(recyclable_log,
+				it->second->db()->versions_->LogNumber());
+	}
 
 	std::vector<std::string> filenames;
 	env_->GetChildren(dbname_, &filenames); // Ignoring errors on purpose
@@ -258,8 +395,24 @@ void DBImpl::DeleteObsoleteFiles()
 			switch (type)
 			{
 			case kLogFile:
-				keep = ((number >= versions_->LogNumber()) || (number
+				keep = ((number >= oldest_log) || (number
 						== versions_->PrevLogNumber()));
+				if ( !keep && std::find(log_recycle_files_.begin(),
+						log_recycle_files_.end(), number)
+						!= log_recycle_files_.end() )
+				{
+					keep = true;
+				}
+				else if ( !keep && number >= first_log_number_ && number
+						< recyclable_log && number
+						!= versions_->PrevLogNumber() && log_recycle_files_.size()
+						< options_.recycle_log_file_num )
+				{
+					Log(options_.info_log, "Recycle log #%lld\n",
+							static_cast<unsigned long long> (number));
+					log_recycle_files_.push_back(number);
+					keep = true;
+				}
 				break;
 			case kDescriptorFile:
 				// Keep my manifest file, and any newer incarnations'
@@ -267,6 +420,7 @@ void DBImpl::DeleteObsoleteFiles()
 				keep = (number >= versions_->ManifestFileNumber());
 				break;
 			case kTableFile:
+			case kBlobFile:
 				keep = (live.find(number) != live.end());
 				break;
 			case kTempFile:
@@ -277,6 +431,7 @@ void DBImpl::DeleteObsoleteFiles()
 			case kCurrentFile:
 			case kDBLockFile:
 			case kInfoLogFile:
+			case kColumnFamilyDir:
 				keep = true;
 				break;
 			}
@@ -287,6 +442,10 @@ void DBImpl::DeleteObsoleteFiles()
 				{
 					table_cache_->Evict(number);
 				}
+				else if ( type == kBlobFile )
+				{
+					blob_cache_->Evict(number);
+				}
 				Log(options_.info_log, "Delete type=%d #%lld\n", int(type),
 						static_cast<unsigned long long> (number));
 				env_->DeleteFile(dbname_ + "/" + filenames[i]);
@@ -295,6 +454,40 @@ void DBImpl::DeleteObsoleteFiles()
 	}
 }
 
+// State of the replay of the logs, carried from one log to the next
+struct DBImpl::RecoveryState
+{
+		DBImpl* const db;
+		VersionEdit* const edit; // Receives the level-0 tables written
+		SequenceNumber max_sequence;
+		MemTable* mem; // Memtable being filled, or NULL
+		uint64_t mem_log; // The log mem holds from its start, or 0
+		MemTable* imm; // Memtable being written by BGRecoveryFlush()
+		bool flushing;
+		Status flush_status;
+		uint64_t bytes; // Size of the logs
+		uint64_t records;
+
+		RecoveryState(DBImpl* d, VersionEdit* e) :
+			db(d), edit(e), max_sequence(0), mem(NULL), mem_log(0), imm(NULL),
+					flushing(false), bytes(0), records(0)
+		{
+		}
+};
+
+// Memtables holding no updates need no log
+static bool MemTableIsEmpty(MemTable* mem)
+{
+	Iterator* iter = mem->NewIterator();
+	Iterator* range_del_iter = mem->NewRangeDelIterator();
+	iter->SeekToFirst();
+	range_del_iter->SeekToFirst();
+	const bool empty = !iter->Valid() && !range_del_iter->Valid();
+	delete iter;
+	delete range_del_iter;
+	return empty;
+}
+
 Status DBImpl::Recover(VersionEdit* edit)
 {
 	mutex_.AssertHeld();
@@ -338,8 +531,6 @@ Status DBImpl::Recover(VersionEdit* edit)
 	s = versions_->Recover();
 	if ( s.ok() )
 	{
-		SequenceNumber max_sequence(0);
-
 		// Recover from all newer log files than the ones named in the
 		// descriptor (new log files may have been added by the previous
 		// incarnation without registering them in the descriptor).
@@ -362,14 +553,27 @@ Status DBImpl::Recover(VersionEdit* edit)
 		std::vector<uint64_t> logs;
 		for (size_t i = 0; i < filenames.size(); i++)
 		{
-			if ( ParseFileName(filenames[i], &number, &type) )
+			if ( ParseFileName(filenames[i], &number, &type)
+					&& type != kColumnFamilyDir )
 			{
 				expected.erase(number);
-				if ( type == kLogFile && ((number >= min_log) || (number
-						== prev_log)) )
-					logs.push_back(number);
 			}
 		}
+		if ( root_ != this )
+		{
+			// A column family replays the log of its root
+			s = env_->GetChildren(root_->dbname_, &filenames);
+			if ( !s.ok() )
+			{
+				return s;
+			}
+		}
+		for (size_t i = 0; i < filenames.size(); i++)
+		{
+			if ( ParseFileName(filenames[i], &number, &type) && type
+					== kLogFile && ((number >= min_log) || (number == prev_log)) )
+				logs.push_back(number);
+		}
 		if ( !expected.empty() )
 		{
 			char buf[50];
@@ -381,30 +585,220 @@ Status DBImpl::Recover(VersionEdit* edit)
 
 		// Recover in the order in which the logs were generated
 		std::sort(logs.begin(), logs.end());
-		for (size_t i = 0; i < logs.size(); i++)
+		const uint64_t start_micros = env_->NowMicros();
+		RecoveryState state(this, edit);
+		for (size_t i = 0; s.ok() && i < logs.size(); i++)
 		{
-			s = RecoverLogFile(logs[i], edit, &max_sequence);
+			s = RecoverLogFile(logs[i], &state);
 
 			// The previous incarnation may not have written any MANIFEST
 			// records after allocating this log number.  So we manually
 			// update the file number allocation counter in VersionSet.
 			versions_->MarkFileNumberUsed(logs[i]);
 		}
+		while (state.flushing)
+		{
+			bg_cv_.Wait();
+		}
+		if ( s.ok() )
+		{
+			s = state.flush_status;
+		}
+
+		if ( s.ok() && state.mem != NULL )
+		{
+			if ( MemTableIsEmpty(state.mem) )
+			{
+				// Nothing of this column family in the logs
+			}
+			else if ( options_.avoid_flush_during_recovery
+					&& state.mem_log != 0 && state.mem_log >= min_log )
+			{
+				// Open the DB at once, and leave the last memtable to the
+				// background compaction.  The logs it holds stay live
+				// until it is written.
+				imm_ = state.mem;
+				has_imm_.Release_Store(imm_);
+				state.mem = NULL;
+				edit->SetLogNumber(state.mem_log);
+			}
+			else
+			{
+				// Reflect errors immediately so that conditions like full
+				// file-systems cause the DB::Open() to fail.
+				s = WriteLevel0Table(state.mem, edit, NULL);
+			}
+		}
+		if ( state.mem != NULL )
+		{
+			state.mem->Unref();
+		}
 
 		if ( s.ok() )
 		{
-			if ( versions_->LastSequence() < max_sequence )
+			if ( versions_->LastSequence() < state.max_sequence )
 			{
-				versions_->SetLastSequence(max_sequence);
+				versions_->SetLastSequence(state.max_sequence);
 			}
 		}
+		if ( s.ok() && !logs.empty() )
+		{
+			const uint64_t micros = env_->NowMicros() - start_micros;
+			Log(options_.info_log, "Recovered %d logs, %llu bytes, %llu "
+				"records in %llu micros (%.1f MB/s)%s",
+					static_cast<int> (logs.size()),
+					static_cast<unsigned long long> (state.bytes),
+					static_cast<unsigned long long> (state.records),
+					static_cast<unsigned long long> (micros),
+					micros > 0 ? double(state.bytes) / micros : 0.0,
+					imm_ != NULL ? "; last memtable left to compaction" : "");
+		}
 	}
 
 	return s;
 }
 
-Status DBImpl::RecoverLogFile(uint64_t log_number, VersionEdit* edit,
-		SequenceNumber* max_sequence)
+// Reads and checksums the records of a log on a thread of its own, up to
+// kReadAheadBytes ahead of their replay.  The records are handed over in
+// chunks of kChunkBytes or so.
+namespace
+{
+class LogReadAhead
+{
+	public:
+		// *status is the one the reporter of "reader" sets
+		LogReadAhead(log::Reader* reader, log::Reader::Reporter* reporter,
+				const Status* status) :
+			reader_(reader), reporter_(reporter), status_(status), cv_(&mu_),
+					bytes_(0), done_(false), stopped_(false)
+		{
+		}
+
+		void Start(Env* env)
+		{
+			env->StartThread(&LogReadAhead::Run, this);
+		}
+
+		// Set *record to the next record of the log, waiting for it if need
+		// be.  It stays valid until the next call.  Returns false once the
+		// log is exhausted.
+		bool Next(Slice* record)
+		{
+			while (input_.empty())
+			{
+				if ( !taken_.empty() )
+				{
+					taken_.pop_front();
+				}
+				if ( taken_.empty() )
+				{
+					MutexLock l(&mu_);
+					while (chunks_.empty() && !done_)
+					{
+						cv_.Wait();
+					}
+					if ( chunks_.empty() )
+					{
+						return false;
+					}
+					taken_.swap(chunks_);
+					bytes_ = 0;
+					cv_.SignalAll();
+				}
+				input_ = taken_.front();
+			}
+			return GetLengthPrefixedSlice(&input_, record);
+		}
+
+		// Stop reading, and wait for the thread to be done
+		void Stop()
+		{
+			MutexLock l(&mu_);
+			stopped_ = true;
+			cv_.SignalAll();
+			while (!done_)
+			{
+				cv_.Wait();
+			}
+		}
+
+	private:
+		enum
+		{
+			kChunkBytes = 64 << 10, kReadAheadBytes = 1 << 20
+		};
+
+		static void Run(void* arg)
+		{
+			reinterpret_cast<LogReadAhead*> (arg)->ReadAll();
+		}
+
+		void ReadAll()
+		{
+			std::string chunk;
+			std::string scratch;
+			Slice record;
+			bool more = true;
+			while (more && reader_->ReadRecord(&record, &scratch)
+					&& status_->ok())
+			{
+				if ( record.size() < 12 )
+				{
+					reporter_->Corruption(record.size(), Status::Corruption(
+							"log record too small"));
+					continue;
+				}
+				PutLengthPrefixedSlice(&chunk, record);
+				if ( chunk.size() >= kChunkBytes )
+				{
+					more = Push(&chunk);
+				}
+			}
+			if ( more && !chunk.empty() )
+			{
+				Push(&chunk);
+			}
+			MutexLock l(&mu_);
+			done_ = true;
+			cv_.SignalAll();
+		}
+
+		// Returns false if the reading is to stop
+		bool Push(std::string* chunk)
+		{
+			MutexLock l(&mu_);
+			while (bytes_ >= kReadAheadBytes && !stopped_)
+			{
+				cv_.Wait();
+			}
+			if ( stopped_ )
+			{
+				return false;
+			}
+			bytes_ += chunk->size();
+			chunks_.push_back(std::string());
+			chunks_.back().swap(*chunk);
+			cv_.SignalAll();
+			return true;
+		}
+
+		log::Reader* const reader_;
+		log::Reader::Reporter* const reporter_;
+		const Status* const status_;
+		port::Mutex mu_;
+		port::CondVar cv_;
+		std::deque<std::string> chunks_; // Read, not yet taken
+		size_t bytes_; // Bytes in chunks_
+		bool done_;
+		bool stopped_;
+
+		// Used by the replay only
+		std::deque<std::string> taken_;
+		Slice input_; // Rest of taken_.front()
+};
+} // namespace
+
+Status DBImpl::RecoverLogFile(uint64_t log_number, RecoveryState* state)
 {
 	struct LogReporter: public log::Reader::Reporter
 	{
@@ -425,7 +819,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, VersionEdit* edit,
 	mutex_.AssertHeld();
 
 	// Open the log file
-	std::string fname = LogFileName(dbname_, log_number);
+	std::string fname = LogFileName(root_->dbname_, log_number);
 	SequentialFile* file;
 	Status status = env_->NewSequentialFile(fname, &file);
 	if ( !status.ok() )
@@ -433,96 +827,163 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, VersionEdit* edit,
 		MaybeIgnoreError(&status);
 		return status;
 	}
+	uint64_t file_size;
+	if ( env_->GetFileSize(fname, &file_size).ok() )
+	{
+		state->bytes += file_size;
+	}
 
-	// Create the log reader.
+	// Create the log reader.  The reporter is called by the read-ahead
+	// thread, hence a status of its own.
+	Status read_status;
 	LogReporter reporter;
 	reporter.env = env_;
 	reporter.info_log = options_.info_log;
 	reporter.fname = fname.c_str();
-	reporter.status = (options_.paranoid_checks ? &status : NULL);
+	reporter.status = (options_.paranoid_checks ? &read_status : NULL);
 	// We intentially make log::Reader do checksumming even if
 	// paranoid_checks==false so that corruptions cause entire commits
 	// to be skipped instead of propagating bad information (like overly
 	// large sequence numbers).
-	log::Reader reader(file, &reporter, true/*checksum*/, 0/*initial_offset*/);
+	log::Reader reader(file, &reporter, true/*checksum*/, 0/*initial_offset*/,
+			log_number);
 	Log(options_.info_log, "Recovering log #%llu",
 			(unsigned long long) log_number);
 
-	// Read all the records and add to a memtable
-	std::string scratch;
+	// Read all the records and add to a memtable.  The memtable is the
+	// replay's own, so the mutex is not needed until it is full.
+	LogReadAhead ahead(&reader, &reporter, &read_status);
+	ahead.Start(env_);
+	mutex_.Unlock();
+
 	Slice record;
 	WriteBatch batch;
-	MemTable* mem = NULL;
-	while (reader.ReadRecord(&record, &scratch) && status.ok())
+	std::map<uint32_t, MemTable*> memtables; // Skips other column families
+	bool first_record = true;
+
+	while (ahead.Next(&record))
 	{
-		if ( record.size() < 12 )
-		{
-			reporter.Corruption(record.size(), Status::Corruption(
-					"log record too small"));
-			continue;
-		}
 		WriteBatchInternal::SetContents(&batch, record);
 
-		if ( mem == NULL )
+		if ( state->mem == NULL )
 		{
-			mem = new MemTable(internal_comparator_);
-			mem->Ref();
+			state->mem = new MemTable(internal_comparator_,
+					options_.write_buffer_manager);
+			state->mem->Ref();
+			state->mem_log = first_record ? log_number : 0;
 		}
-		status = WriteBatchInternal::InsertInto(&batch, mem);
+		first_record = false;
+		memtables[column_family_id_] = state->mem;
+		status = WriteBatchInternal::InsertInto(&batch, memtables);
 		MaybeIgnoreError(&status);
 		if ( !status.ok() )
 		{
 			break;
 		}
+		state->records++;
 		const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch)
 				+ WriteBatchInternal::Count(&batch) - 1;
-		if ( last_seq > *max_sequence )
+		if ( last_seq > state->max_sequence )
 		{
-			*max_sequence = last_seq;
+			state->max_sequence = last_seq;
 		}
 
-		if ( mem->ApproximateMemoryUsage() > options_.write_buffer_size )
+		// A memtable started with a log fills up where the memtable that
+		// wrote the log did, at its end, unless write_buffer_size shrank
+		if ( state->mem->ApproximateMemoryUsage() > options_.write_buffer_size )
 		{
-			status = WriteLevel0Table(mem, edit, NULL);
+			mutex_.Lock();
+			status = FlushRecoveredMemTable(state);
+			mutex_.Unlock();
 			if ( !status.ok() )
 			{
 				// Reflect errors immediately so that conditions like full
 				// file-systems cause the DB::Open() to fail.
 				break;
 			}
-			mem->Unref();
-			mem = NULL;
 		}
 	}
 
-	if ( status.ok() && mem != NULL )
+	ahead.Stop();
+	mutex_.Lock();
+	if ( status.ok() )
 	{
-		status = WriteLevel0Table(mem, edit, NULL);
-		// Reflect errors immediately so that conditions like full
-		// file-systems cause the DB::Open() to fail.
+		status = read_status;
 	}
-
-	if ( mem != NULL )
-		mem->Unref();
 	delete file;
 	return status;
 }
 
-Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
+Status DBImpl::FlushRecoveredMemTable(RecoveryState* state)
+{
+	mutex_.AssertHeld();
+	// One flush at a time keeps the level-0 tables in the order of the logs
+	while (state->flushing)
+	{
+		bg_cv_.Wait();
+	}
+	if ( !state->flush_status.ok() )
+	{
+		return state->flush_status;
+	}
+	state->flushing = true;
+	state->imm = state->mem;
+	state->mem = NULL;
+	env_->StartThread(&DBImpl::BGRecoveryFlush, state);
+	return Status::OK();
+}
+
+void DBImpl::BGRecoveryFlush(void* arg)
+{
+	RecoveryState* state = reinterpret_cast<RecoveryState*> (arg);
+	DBImpl* db = state->db;
+	MutexLock l(&db->mutex_);
+	Status s = db->WriteLevel0Table(state->imm, state->edit, NULL);
+	state->imm->Unref();
+	state->imm = NULL;
+	if ( !s.ok() )
+	{
+		state->flush_status = s;
+	}
+	state->flushing = false;
+	db->bg_cv_.SignalAll();
+}
+
+Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base,
+		FlushJobInfo* info)
 {
 	mutex_.AssertHeld();
 	const uint64_t start_micros = env_->NowMicros();
 	FileMetaData meta;
 	meta.number = versions_->NewFileNumber();
 	pending_outputs_.insert(meta.number);
+	BlobFileBuilder* blob = NULL;
+	if ( options_.min_blob_size > 0 )
+	{
+		blob = new BlobFileBuilder(env_, dbname_, versions_->NewFileNumber());
+		pending_outputs_.insert(blob->number());
+	}
 	Iterator* iter = mem->NewIterator();
+	Iterator* range_del_iter = mem->NewRangeDelIterator();
 	Log(options_.info_log, "Level-0 table #%llu: started",
 			(unsigned long long) meta.number);
 
 	Status s;
 	{
 		mutex_.Unlock();
-		s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+		s = BuildTable(dbname_, env_, options_, table_cache_, iter,
+				range_del_iter, blob, &meta);
+		if ( blob != NULL )
+		{
+			if ( s.ok() )
+			{
+				s = blob->Finish();
+			}
+			else
+			{
+				blob->Abandon();
+			}
+		}
 		mutex_.Lock();
 	}
 
@@ -530,7 +991,23 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
 			(unsigned long long) meta.number,
 			(unsigned long long) meta.file_size, s.ToString().c_str());
 	delete iter;
+	delete range_del_iter;
 	pending_outputs_.erase(meta.number);
+	uint64_t blob_size = 0;
+	if ( blob != NULL )
+	{
+		blob_size = blob->FileSize();
+		if ( s.ok() && blob_size > 0 )
+		{
+			Log(options_.info_log, "Level-0 table #%llu: blob file #%llu, "
+				"%lld bytes", (unsigned long long) meta.number,
+					(unsigned long long) blob->number(),
+					(unsigned long long) blob_size);
+			edit->AddBlobFile(blob->number(), blob_size);
+		}
+		pending_outputs_.erase(blob->number());
+		delete blob;
+	}
 
 	// Note that if file_size is zero, the file has been deleted and
 	// should not be added to the manifest.
@@ -545,17 +1022,89 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
 					= base->PickLevelForMemTableOutput(min_user_key,
 							max_user_key);
 		}
-		edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-				meta.largest);
+		edit->AddFile(level, meta);
 	}
 
 	CompactionStats stats;
 	stats.micros = env_->NowMicros() - start_micros;
-	stats.bytes_written = meta.file_size;
+	stats.bytes_written = meta.file_size + blob_size;
 	stats_[level].Add(stats);
+	RecordTick(options_.statistics, kFlushWriteBytes, stats.bytes_written);
+	if ( info != NULL )
+	{
+		info->db_name = dbname_;
+		info->file_number = meta.number;
+		info->level = level;
+		info->file_size = stats.bytes_written;
+		info->micros = stats.micros;
+	}
 	return s;
 }
 
+void DBImpl::NotifyOnFlushCompleted(const FlushJobInfo& info)
+{
+	mutex_.AssertHeld();
+	if ( options_.listeners.empty() )
+	{
+		return;
+	}
+	mutex_.Unlock();
+	for (size_t i = 0; i < options_.listeners.size(); i++)
+	{
+		options_.listeners[i]->OnFlushCompleted(this, info);
+	}
+	mutex_.Lock();
+}
+
+void DBImpl::NotifyOnCompaction(const CompactionJobInfo& info, bool completed)
+{
+	mutex_.AssertHeld();
+	if ( options_.listeners.empty() )
+	{
+		return;
+	}
+	mutex_.Unlock();
+	for (size_t i = 0; i < options_.listeners.size(); i++)
+	{
+		if ( completed )
+		{
+			options_.listeners[i]->OnCompactionCompleted(this, info);
+		}
+		else
+		{
+			options_.listeners[i]->OnCompactionBegin(this, info);
+		}
+	}
+	mutex_.Lock();
+}
+
+bool DBImpl::SetStallCondition(WriteStallCondition condition,
+		WriteStallCause cause)
+{
+	mutex_.AssertHeld();
+	if ( condition == stall_condition_ )
+	{
+		return false;
+	}
+	WriteStallInfo info;
+	info.db_name = dbname_;
+	info.condition = condition;
+	info.prev_condition = stall_condition_;
+	info.cause = cause;
+	stall_condition_ = condition;
+	if ( options_.listeners.empty() )
+	{
+		return false;
+	}
+	mutex_.Unlock();
+	for (size_t i = 0; i < options_.listeners.size(); i++)
+	{
+		options_.listeners[i]->OnStallConditionsChanged(this, info);
+	}
+	mutex_.Lock();
+	return true;
+}
+
 Status DBImpl::CompactMemTable()
 {
 	mutex_.AssertHeld();
@@ -565,7 +1114,8 @@ Status DBImpl::CompactMemTable()
 	VersionEdit edit;
 	Version* base = versions_->current();
 	base->Ref();
-	Status s = WriteLevel0Table(imm_, &edit, base);
+	FlushJobInfo info;
+	Status s = WriteLevel0Table(imm_, &edit, base, &info);
 	base->Unref();
 
 	if ( s.ok() && shutting_down_.Acquire_Load() )
@@ -577,7 +1127,9 @@ Status DBImpl::CompactMemTable()
 	if ( s.ok() )
 	{
 		edit.SetPrevLogNumber(0);
-		edit.SetLogNumber(logfile_number_); // Earlier logs no longer needed
+		edit.SetLogNumber(mem_log_number_); // Earlier logs no longer needed
+		// The log numbers of a column family are those of its root
+		versions_->MarkFileNumberUsed(mem_log_number_);
 		s = versions_->LogAndApply(&edit, &mutex_);
 	}
 
@@ -588,6 +1140,11 @@ Status DBImpl::CompactMemTable()
 		imm_ = NULL;
 		has_imm_.Release_Store(NULL);
 		DeleteObsoleteFiles();
+		if ( root_ != this )
+		{
+			root_->DeleteObsoleteFiles(); // The log may be done with
+		}
+		NotifyOnFlushCompleted(info);
 	}
 
 	return s;
@@ -788,34 +1345,77 @@ Status DBImpl::BackgroundCompaction()
 		c = versions_->PickCompaction();
 	}
 
+	CompactionJobInfo info;
+	if ( c != NULL )
+	{
+		info.db_name = dbname_;
+		info.reason = c->reason();
+		info.level = c->level();
+		info.output_level = c->output_level();
+		info.trivial_move = !is_manual && c->IsTrivialMove();
+		for (int which = 0; which < 2; which++)
+		{
+			for (int i = 0; i < c->num_input_files(which); i++)
+			{
+				info.input_files.push_back(c->input(which, i)->number);
+			}
+		}
+		info.bytes_read = 0;
+		info.bytes_written = 0;
+		info.micros = 0;
+		// c stays valid while the listeners run unlocked: it holds its
+		// input version, and with bg_compaction_scheduled_ set no other
+		// thread installs a new one (see LogAndApplyInForeground())
+		NotifyOnCompaction(info, false);
+	}
+
+	const uint64_t start_micros = env_->NowMicros();
 	Status status;
 	if ( c == NULL )
 	{
 		// Nothing to do
 	}
-	else if ( !is_manual && c->IsTrivialMove() )
+	else if ( info.trivial_move )
 	{
 		// Move file to next level
 		assert(c->num_input_files(0) == 1);
 		FileMetaData* f = c->input(0, 0);
 		c->edit()->DeleteFile(c->level(), f->number);
-		c->edit()->AddFile(c->level() + 1, f->number, f->file_size,
-				f->smallest, f->largest);
+		c->edit()->AddFile(c->output_level(), *f);
 		status = versions_->LogAndApply(c->edit(), &mutex_);
 		VersionSet::LevelSummaryStorage tmp;
 		Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
-				static_cast<unsigned long long> (f->number), c->level() + 1,
+				static_cast<unsigned long long> (f->number), c->output_level(),
 				static_cast<unsigned long long> (f->file_size),
 				status.ToString().c_str(), versions_->LevelSummary(&tmp));
+		info.output_files.push_back(f->number);
 	}
 	else
 	{
 		CompactionState* compact = new CompactionState(c);
 		status = DoCompactionWork(compact);
+		for (int which = 0; which < 2; which++)
+		{
+			for (int i = 0; i < c->num_input_files(which); i++)
+			{
+				info.bytes_read += c->input(which, i)->file_size;
+			}
+		}
+		for (size_t i = 0; i < compact->outputs.size(); i++)
+		{
+			info.output_files.push_back(compact->outputs[i].number);
+			info.bytes_written += compact->outputs[i].file_size;
+		}
 		CleanupCompaction(compact);
 		c->ReleaseInputs();
 		DeleteObsoleteFiles();
 	}
+	if ( c != NULL )
+	{
+		info.status = status;
+		info.micros = env_->NowMicros() - start_micros;
+		NotifyOnCompaction(info, true);
+	}
 	delete c;
 
 	if ( status.ok() )
@@ -874,41 +1474,256 @@ void DBImpl::CleanupCompaction(CompactionState* compact)
 		const CompactionState::Output& out = compact->outputs[i];
 		pending_outputs_.erase(out.number);
 	}
+	if ( compact->reserved_output_number != 0 )
+	{
+		pending_outputs_.erase(compact->reserved_output_number);
+	}
+	if ( compact->blob != NULL )
+	{
+		compact->blob->Abandon(); // No-op once finished
+		pending_outputs_.erase(compact->blob->number());
+		delete compact->blob;
+	}
+	delete compact->range_del;
 	delete compact;
 }
 
-Status DBImpl::OpenCompactionOutputFile(CompactionState* compact)
+static Status AddFileRangeDels(TableCache* table_cache,
+		const FileMetaData* f, RangeDelAggregator* range_del)
 {
-	assert(compact != NULL);
-	assert(compact->builder == NULL);
-	uint64_t file_number;
-	{
-		mutex_.Lock();
-		file_number = versions_->NewFileNumber();
-		pending_outputs_.insert(file_number);
-		CompactionState::Output out;
-		out.number = file_number;
-		out.smallest.Clear();
-		out.largest.Clear();
-		compact->outputs.push_back(out);
-		mutex_.Unlock();
-	}
-
-	// Make the output file
-	std::string fname = TableFileName(dbname_, file_number);
-	Status s = env_->NewWritableFile(fname, &compact->outfile);
-	if ( s.ok() )
+	if ( f->num_range_deletions == 0 )
 	{
-		compact->builder = new TableBuilder(options_, compact->outfile);
+		return Status::OK();
 	}
+	Iterator* iter = table_cache->NewRangeDelIterator(f->number, f->file_size);
+	Status s = range_del->AddTombstones(iter);
+	delete iter;
 	return s;
 }
 
-Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
-		Iterator* input)
+// Add to *garbage the blob records the entries of table *f refer to
+static Status AddFileBlobGarbage(TableCache* table_cache,
+		const FileMetaData* f, std::map<uint64_t, uint64_t>* garbage)
 {
-	assert(compact != NULL);
-	assert(compact->outfile != NULL);
+	Iterator* iter = table_cache->NewIterator(ReadOptions(), f->number,
+			f->file_size, f->global_seqno);
+	for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+	{
+		ParsedInternalKey ikey;
+		BlobIndex blob;
+		if ( ParseInternalKey(iter->key(), &ikey) && ikey.type
+				== kTypeBlobIndex && blob.DecodeFrom(iter->value()) )
+		{
+			(*garbage)[blob.file_number] += blob.size;
+		}
+	}
+	Status s = iter->status();
+	delete iter;
+	return s;
+}
+
+Status DBImpl::SetupCompactionRangeDels(CompactionState* compact)
+{
+	Compaction* c = compact->compaction;
+	const Comparator* ucmp = user_comparator();
+	compact->range_del = new RangeDelAggregator(ucmp);
+	Status s;
+	for (int i = 0; s.ok() && i < c->num_input_files(0); i++)
+	{
+		s = AddFileRangeDels(table_cache_, c->input(0, i), compact->range_del);
+	}
+	if ( !s.ok() )
+	{
+		return s;
+	}
+
+	// A parent file inside a tombstone that every snapshot sees holds
+	// nothing readable, since its entries are all older than the tombstone.
+	const std::vector<RangeTombstone>& tombstones =
+			compact->range_del->tombstones();
+	for (int i = c->num_input_files(1) - 1; i >= 0; i--)
+	{
+		const FileMetaData* f = c->input(1, i);
+		for (size_t j = 0; j < tombstones.size(); j++)
+		{
+			const RangeTombstone& t = tombstones[j];
+			if ( t.sequence <= compact->smallest_snapshot && ucmp->Compare(
+					t.begin, f->smallest.user_key()) <= 0 && ucmp->Compare(
+					f->largest.user_key(), t.end) < 0 )
+			{
+				Log(options_.info_log,
+						"Dropping #%llu@%d: covered by a range deletion",
+						static_cast<unsigned long long> (f->number),
+						c->level() + 1);
+				if ( compact->has_blob_files )
+				{
+					s = AddFileBlobGarbage(table_cache_, f,
+							&compact->blob_garbage);
+					if ( !s.ok() )
+					{
+						return s;
+					}
+				}
+				c->DropParentInput(i);
+				break;
+			}
+		}
+	}
+
+	for (int i = 0; s.ok() && i < c->num_input_files(1); i++)
+	{
+		s = AddFileRangeDels(table_cache_, c->input(1, i), compact->range_del);
+	}
+	compact->range_del->Finish(compact->smallest_snapshot);
+
+	// Once every snapshot sees a tombstone and no deeper level holds keys
+	// in its range, all it hides is dropped here and it has done its job.
+	for (size_t j = 0; j < tombstones.size(); j++)
+	{
+		const RangeTombstone& t = tombstones[j];
+		if ( t.sequence > compact->smallest_snapshot
+				|| !c->IsBaseLevelForRange(t.begin, t.end) )
+		{
+			compact->range_del_outputs.push_back(t);
+		}
+	}
+	return s;
+}
+
+Status DBImpl::OpenCompactionOutputFile(CompactionState* compact)
+{
+	assert(compact != NULL);
+	assert(compact->builder == NULL);
+	uint64_t file_number;
+	{
+		mutex_.Lock();
+		if ( compact->reserved_output_number != 0 )
+		{
+			file_number = compact->reserved_output_number;
+			compact->reserved_output_number = 0;
+		}
+		else
+		{
+			file_number = versions_->NewFileNumber();
+			pending_outputs_.insert(file_number);
+		}
+		CompactionState::Output out;
+		out.number = file_number;
+		out.num_range_deletions = 0;
+		out.num_entries = 0;
+		out.num_deletions = 0;
+		out.smallest.Clear();
+		out.largest.Clear();
+		compact->outputs.push_back(out);
+		mutex_.Unlock();
+	}
+
+	// Make the output file
+	std::string fname = TableFileName(dbname_, file_number);
+	Status s = env_->NewWritableFile(fname, &compact->outfile);
+	if ( s.ok() )
+	{
+		compact->builder = new TableBuilder(options_, compact->outfile);
+	}
+	return s;
+}
+
+namespace
+{
+struct EncodedTombstoneLess
+{
+		const InternalKeyComparator* icmp;
+		explicit EncodedTombstoneLess(const InternalKeyComparator* c) :
+			icmp(c)
+		{
+		}
+		bool operator()(const std::pair<std::string, std::string>& a,
+				const std::pair<std::string, std::string>& b) const
+		{
+			return icmp->Compare(a.first, b.first) < 0;
+		}
+};
+} // namespace
+
+void DBImpl::AddRangeDelsToOutput(CompactionState* compact,
+		const Slice* next_user_key)
+{
+	const Comparator* ucmp = user_comparator();
+	std::vector<std::pair<std::string, std::string> > entries;
+	for (size_t i = 0; i < compact->range_del_outputs.size(); i++)
+	{
+		const RangeTombstone& t = compact->range_del_outputs[i];
+		Slice begin = t.begin;
+		Slice end = t.end;
+		if ( compact->has_range_del_lower && ucmp->Compare(begin,
+				compact->range_del_lower) < 0 )
+		{
+			begin = compact->range_del_lower;
+		}
+		if ( next_user_key != NULL && ucmp->Compare(*next_user_key, end) < 0 )
+		{
+			end = *next_user_key;
+		}
+		if ( ucmp->Compare(begin, end) < 0 )
+		{
+			std::string key;
+			AppendInternalKey(&key, ParsedInternalKey(begin, t.sequence,
+					kTypeRangeDeletion));
+			entries.push_back(std::make_pair(key, end.ToString()));
+		}
+	}
+	std::sort(entries.begin(), entries.end(), EncodedTombstoneLess(
+			&internal_comparator_));
+
+	CompactionState::Output* out = compact->current_output();
+	bool has_bounds = (compact->builder->NumEntries() > 0);
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		// Clipping may leave two pieces of a tombstone with the same start
+		std::string end = entries[i].second;
+		while ( i + 1 < entries.size() && entries[i + 1].first
+				== entries[i].first )
+		{
+			i++;
+			if ( ucmp->Compare(end, entries[i].second) < 0 )
+			{
+				end = entries[i].second;
+			}
+		}
+		compact->builder->AddRangeDeletion(entries[i].first, end);
+		RangeTombstone t;
+		ParseRangeTombstone(entries[i].first, end, &t);
+		ExtendBoundsForTombstone(internal_comparator_, t, &has_bounds,
+				&out->smallest, &out->largest);
+	}
+	out->num_range_deletions = compact->builder->NumRangeDeletions();
+
+	if ( next_user_key != NULL )
+	{
+		compact->range_del_lower = next_user_key->ToString();
+		compact->has_range_del_lower = true;
+	}
+}
+
+bool DBImpl::HasPendingRangeDels(CompactionState* compact)
+{
+	for (size_t i = 0; i < compact->range_del_outputs.size(); i++)
+	{
+		if ( !compact->has_range_del_lower || user_comparator()->Compare(
+				compact->range_del_lower, compact->range_del_outputs[i].end)
+				< 0 )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
+		Iterator* input, const Slice* next_user_key)
+{
+	assert(compact != NULL);
+	assert(compact->outfile != NULL);
 	assert(compact->builder != NULL);
 
 	const uint64_t output_number = compact->current_output()->number;
@@ -918,6 +1733,11 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 	Status s = input->status();
 	const uint64_t current_entries = compact->builder->NumEntries();
 	if ( s.ok() )
+	{
+		AddRangeDelsToOutput(compact, next_user_key);
+	}
+	const uint64_t current_range_dels = compact->builder->NumRangeDeletions();
+	if ( s.ok() )
 	{
 		s = compact->builder->Finish();
 	}
@@ -927,6 +1747,7 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 	}
 	const uint64_t current_bytes = compact->builder->FileSize();
 	compact->current_output()->file_size = current_bytes;
+	compact->current_output()->num_entries = current_entries;
 	compact->total_bytes += current_bytes;
 	delete compact->builder;
 	compact->builder = NULL;
@@ -943,11 +1764,11 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 	delete compact->outfile;
 	compact->outfile = NULL;
 
-	if ( s.ok() && current_entries > 0 )
+	if ( s.ok() && (current_entries > 0 || current_range_dels > 0) )
 	{
 		// Verify that the table is usable
 		Iterator* iter = table_cache_->NewIterator(ReadOptions(),
-				output_number, current_bytes);
+				output_number, current_bytes, 0);
 		s = iter->status();
 		delete iter;
 		if ( s.ok() )
@@ -968,21 +1789,146 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact)
 	Log(options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes",
 			compact->compaction->num_input_files(0),
 			compact->compaction->level(), compact->compaction->num_input_files(
-					1), compact->compaction->level() + 1,
+					1), compact->compaction->output_level(),
 			static_cast<long long> (compact->total_bytes));
 
 	// Add compaction outputs
 	compact->compaction->AddInputDeletions(compact->compaction->edit());
-	const int level = compact->compaction->level();
+	const int level = compact->compaction->output_level();
 	for (size_t i = 0; i < compact->outputs.size(); i++)
 	{
 		const CompactionState::Output& out = compact->outputs[i];
-		compact->compaction->edit()->AddFile(level + 1, out.number,
-				out.file_size, out.smallest, out.largest);
+		FileMetaData f;
+		f.number = out.number;
+		f.file_size = out.file_size;
+		f.num_range_deletions = out.num_range_deletions;
+		f.num_entries = out.num_entries;
+		f.num_deletions = out.num_deletions;
+		f.smallest = out.smallest;
+		f.largest = out.largest;
+		compact->compaction->edit()->AddFile(level, f);
+	}
+	if ( compact->blob != NULL && compact->blob->FileSize() > 0 )
+	{
+		compact->compaction->edit()->AddBlobFile(compact->blob->number(),
+				compact->blob->FileSize());
+	}
+	for (std::map<uint64_t, uint64_t>::const_iterator it =
+			compact->blob_garbage.begin(); it != compact->blob_garbage.end(); ++it)
+	{
+		compact->compaction->edit()->AddBlobGarbage(it->first, it->second);
 	}
 	return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
 }
 
+Status DBImpl::AddCompactionOutput(CompactionState* compact,
+		const Slice& entry_key, const Slice& entry_value, Iterator* input)
+{
+	Status status;
+	Slice key = entry_key;
+	Slice value = entry_value;
+	ParsedInternalKey ikey;
+	if ( options_.min_blob_size > 0 && value.size() >= options_.min_blob_size
+			&& ParseInternalKey(key, &ikey) && ikey.type == kTypeValue )
+	{
+		if ( compact->blob == NULL )
+		{
+			mutex_.Lock();
+			compact->blob = new BlobFileBuilder(env_, dbname_,
+					versions_->NewFileNumber());
+			pending_outputs_.insert(compact->blob->number());
+			mutex_.Unlock();
+		}
+		status = compact->blob->Add(ikey.user_key, value, &compact->blob_index);
+		if ( !status.ok() )
+		{
+			return status;
+		}
+		ikey.type = kTypeBlobIndex;
+		compact->blob_key.clear();
+		AppendInternalKey(&compact->blob_key, ikey);
+		key = compact->blob_key;
+		value = compact->blob_index;
+	}
+
+	// Close output file if it is big enough.  All entries of a user key go
+	// to one file, so a range deletion clipped at the file boundary cannot
+	// make neighbouring files overlap.
+	if ( compact->builder != NULL && compact->builder->FileSize()
+			>= compact->compaction->MaxOutputFileSize() && key.size() >= 8 )
+	{
+		const Slice user_key = ExtractUserKey(key);
+		if ( user_comparator()->Compare(user_key,
+				compact->current_output()->largest.user_key()) != 0 )
+		{
+			status = FinishCompactionOutputFile(compact, input, &user_key);
+			if ( !status.ok() )
+			{
+				return status;
+			}
+		}
+	}
+
+	// Open output file if necessary
+	if ( compact->builder == NULL )
+	{
+		status = OpenCompactionOutputFile(compact);
+		if ( !status.ok() )
+		{
+			return status;
+		}
+	}
+	if ( compact->builder->NumEntries() == 0 )
+	{
+		compact->current_output()->smallest.DecodeFrom(key);
+	}
+	compact->current_output()->largest.DecodeFrom(key);
+	if ( ExtractValueType(key) == kTypeDeletion )
+	{
+		compact->current_output()->num_deletions++;
+	}
+	compact->builder->Add(key, value);
+	return status;
+}
+
+Status DBImpl::FlushCompactionMerge(CompactionState* compact, bool resolve,
+		const Slice* base, bool* resolved, Iterator* input)
+{
+	Status status;
+	*resolved = false;
+	if ( resolve )
+	{
+		// Fold all operands into one value at the newest operand's sequence
+		ParsedInternalKey newest;
+		ParseInternalKey(compact->merge_keys[0], &newest);
+		MergeContext merge(options_.merge_operator);
+		for (size_t i = 0; i < compact->merge_values.size(); i++)
+		{
+			merge.AddOlder(compact->merge_values[i]);
+		}
+		std::string merged;
+		if ( merge.Finish(newest.user_key, base, &merged).ok() )
+		{
+			std::string key;
+			AppendInternalKey(&key, ParsedInternalKey(newest.user_key,
+					newest.sequence, kTypeValue));
+			status = AddCompactionOutput(compact, key, merged, input);
+			*resolved = true;
+		}
+	}
+	// Otherwise keep the operands as they are; a failed merge is retried
+	// by readers, which report its error.
+	for (size_t i = 0; !*resolved && status.ok() && i
+			< compact->merge_keys.size(); i++)
+	{
+		status = AddCompactionOutput(compact, compact->merge_keys[i],
+				compact->merge_values[i], input);
+	}
+	compact->merge_keys.clear();
+	compact->merge_values.clear();
+	return status;
+}
+
 Status DBImpl::DoCompactionWork(CompactionState* compact)
 {
 	const uint64_t start_micros = env_->NowMicros();
@@ -991,7 +1937,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
 	Log(options_.info_log, "Compacting %d@%d + %d@%d files",
 			compact->compaction->num_input_files(0),
 			compact->compaction->level(), compact->compaction->num_input_files(
-					1), compact->compaction->level() + 1);
+					1), compact->compaction->output_level());
 
 	assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
 	assert(compact->builder == NULL);
@@ -999,23 +1945,51 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
 	if ( snapshots_.empty() )
 	{
 		compact->smallest_snapshot = versions_->LastSequence();
+		compact->has_snapshot = false;
+		compact->newest_snapshot = 0;
 	}
 	else
 	{
 		compact->smallest_snapshot = snapshots_.oldest()->number_;
+		compact->has_snapshot = true;
+		compact->newest_snapshot = snapshots_.newest()->number_;
+	}
+	const CompactionFilter* filter = options_.compaction_filter;
+	const std::vector<BlobFileMetaData>& blob_files =
+			versions_->current()->blob_files();
+	compact->has_blob_files = !blob_files.empty();
+	for (size_t i = 0; i < blob_files.size(); i++)
+	{
+		if ( blob_files[i].garbage_size >= options_.blob_gc_ratio
+				* blob_files[i].file_size )
+		{
+			compact->blob_gc_files.insert(blob_files[i].number);
+		}
+	}
+
+	if ( compact->compaction->output_level() == 0 )
+	{
+		// The level-0 output must rank below any file that imm_ compactions
+		// flush while we run, so take its number before they can
+		compact->reserved_output_number = versions_->NewFileNumber();
+		pending_outputs_.insert(compact->reserved_output_number);
 	}
 
 	// Release mutex while we're actually doing the compaction work
 	mutex_.Unlock();
 
+	Status status = SetupCompactionRangeDels(compact);
 	Iterator* input = versions_->MakeInputIterator(compact->compaction);
 	input->SeekToFirst();
-	Status status;
 	ParsedInternalKey ikey;
 	std::string current_user_key;
 	bool has_current_user_key = false;
 	SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
-	for (; input->Valid() && !shutting_down_.Acquire_Load();)
+	bool newest_for_key = false; // No newer entry of the key, operands included
+	std::string filtered_key; // Backing store for keys rewritten by filter
+	std::string filtered_value; // Backing store for values rewritten by filter
+	std::string resolved_key; // Backing store for keys of values read from blobs
+	for (; status.ok() && input->Valid() && !shutting_down_.Acquire_Load();)
 	{
 		// Prioritize immutable compaction work
 		if ( has_imm_.NoBarrier_Load() != NULL )
@@ -1032,10 +2006,29 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
 		}
 
 		Slice key = input->key();
+		if ( !compact->merge_keys.empty() && (!ParseInternalKey(key, &ikey)
+				|| user_comparator()->Compare(ikey.user_key,
+						Slice(current_user_key)) != 0) )
+		{
+			// Operands ran out without reaching a value.  At the base level
+			// nothing older can exist, so they can be merged on their own.
+			bool resolved;
+			status = FlushCompactionMerge(compact,
+					compact->compaction->IsBaseLevelForKey(current_user_key),
+					NULL, &resolved, input);
+			if ( !status.ok() )
+			{
+				break;
+			}
+		}
+
 		if ( compact->compaction->ShouldStopBefore(key) && compact->builder
-				!= NULL )
+				!= NULL && key.size() >= 8 && user_comparator()->Compare(
+				ExtractUserKey(key),
+				compact->current_output()->largest.user_key()) != 0 )
 		{
-			status = FinishCompactionOutputFile(compact, input);
+			const Slice next_user_key = ExtractUserKey(key);
+			status = FinishCompactionOutputFile(compact, input, &next_user_key);
 			if ( !status.ok() )
 			{
 				break;
@@ -1043,7 +2036,13 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
 		}
 
 		// Handle key/value, add to state, etc.
+		Slice value = input->value();
 		bool drop = false;
+		// A blob reference read here becomes garbage unless it is written
+		// out as it is
+		BlobIndex blob_ref;
+		bool has_blob_ref = false;
+		Slice blob_ref_key, blob_ref_value;
 		if ( !ParseInternalKey(key, &ikey) )
 		{
 			// Do not hide error keys
@@ -1061,6 +2060,34 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
 						ikey.user_key.size());
 				has_current_user_key = true;
 				last_sequence_for_key = kMaxSequenceNumber;
+				newest_for_key = true;
+			}
+
+			if ( ikey.type == kTypeBlobIndex && blob_ref.DecodeFrom(value) )
+			{
+				has_blob_ref = true;
+				blob_ref_key = key;
+				blob_ref_value = value;
+				if ( last_sequence_for_key > compact->smallest_snapshot
+						&& (filter != NULL || !compact->merge_keys.empty()
+								|| compact->blob_gc_files.count(
+										blob_ref.file_number) > 0) )
+				{
+					// The value itself is needed: to be filtered, to have
+					// operands merged into it, or to leave its blob file.
+					status = blob_cache_->Get(ReadOptions(), value,
+							&compact->blob_value);
+					if ( !status.ok() )
+					{
+						break;
+					}
+					ikey.type = kTypeValue;
+					resolved_key.clear();
+					AppendInternalKey(&resolved_key, ikey);
+					key = resolved_key;
+					ParseInternalKey(key, &ikey);
+					value = compact->blob_value;
+				}
 			}
 
 			if ( last_sequence_for_key <= compact->smallest_snapshot )
@@ -1068,6 +2095,86 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
 				// Hidden by an newer entry for same user key
 				drop = true; // (A)
 			}
+			else if ( compact->range_del->ShouldDelete(ikey) )
+			{
+				// Hidden by a range deletion.  Held back operands are newer
+				// than it, so they apply to a deleted key.
+				if ( !compact->merge_keys.empty() )
+				{
+					bool resolved;
+					status = FlushCompactionMerge(compact, true, NULL,
+							&resolved, input);
+					if ( !status.ok() )
+					{
+						break;
+					}
+				}
+				drop = true;
+			}
+			else if ( filter != NULL && ikey.type == kTypeValue
+					&& newest_for_key && (!compact->has_snapshot
+							|| ikey.sequence > compact->newest_snapshot) )
+			{
+				// Newest version of this key and no snapshot can see it, so
+				// let the compaction filter remove or rewrite it.  A value
+				// under merge operands is not: the operands apply to it as
+				// it is, and the filter sees their result once it is the
+				// newest version in a later compaction.  A removed
+				// entry becomes a deletion marker, since older versions of the
+				// key may still live in deeper levels; the marker itself is
+				// then dropped below when that is safe.
+				bool value_changed = false;
+				filtered_value.clear();
+				if ( filter->Filter(compact->compaction->level(), ikey.user_key,
+						value, &filtered_value, &value_changed) )
+				{
+					ikey.type = kTypeDeletion;
+					value = Slice();
+				}
+				else if ( value_changed )
+				{
+					value = filtered_value;
+				}
+				if ( ikey.type == kTypeDeletion )
+				{
+					filtered_key.clear();
+					AppendInternalKey(&filtered_key, ikey);
+					key = filtered_key;
+					ParseInternalKey(key, &ikey);
+				}
+			}
+
+			if ( drop )
+			{
+				// Already hidden
+			}
+			else if ( ikey.type == kTypeMerge )
+			{
+				if ( ikey.sequence <= compact->smallest_snapshot )
+				{
+					// No snapshot lies between this operand and the older
+					// entries, so it may be merged into them.  Hold it back.
+					compact->merge_keys.push_back(key.ToString());
+					compact->merge_values.push_back(value.ToString());
+					drop = true;
+				}
+			}
+			else if ( !compact->merge_keys.empty() )
+			{
+				// The value (or deletion) the held back operands apply to.
+				// If they merge cleanly it is replaced by the result.
+				status = FlushCompactionMerge(compact, true,
+						ikey.type == kTypeValue ? &value : NULL, &drop, input);
+				if ( !status.ok() )
+				{
+					break;
+				}
+			}
+
+			if ( drop )
+			{
+				// Consumed above
+			}
 			else if ( ikey.type == kTypeDeletion && ikey.sequence
 					<= compact->smallest_snapshot
 					&& compact->compaction->IsBaseLevelForKey(ikey.user_key) )
@@ -1082,7 +2189,21 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
 				drop = true;
 			}
 
-			last_sequence_for_key = ikey.sequence;
+			if ( ikey.type != kTypeMerge )
+			{
+				// Merge operands do not hide older entries
+				last_sequence_for_key = ikey.sequence;
+			}
+			newest_for_key = false;
+
+			if ( has_blob_ref && !drop && value.data()
+					== compact->blob_value.data()
+					&& compact->blob_gc_files.count(blob_ref.file_number) == 0 )
+			{
+				// Read back unchanged from a blob file that stays
+				key = blob_ref_key;
+				value = blob_ref_value;
+			}
 		}
 #if 0
 		Log(options_.info_log,
@@ -1096,33 +2217,16 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
 
 		if ( !drop )
 		{
-			// Open output file if necessary
-			if ( compact->builder == NULL )
-			{
-				status = OpenCompactionOutputFile(compact);
-				if ( !status.ok() )
-				{
-					break;
-				}
-			}
-			if ( compact->builder->NumEntries() == 0 )
-			{
-				compact->current_output()->smallest.DecodeFrom(key);
-			}
-			compact->current_output()->largest.DecodeFrom(key);
-			compact->builder->Add(key, input->value());
-
-			// Close output file if it is big enough
-			if ( compact->builder->FileSize()
-					>= compact->compaction->MaxOutputFileSize() )
+			status = AddCompactionOutput(compact, key, value, input);
+			if ( !status.ok() )
 			{
-				status = FinishCompactionOutputFile(compact, input);
-				if ( !status.ok() )
-				{
-					break;
-				}
+				break;
 			}
 		}
+		if ( has_blob_ref && (drop || value.data() != blob_ref_value.data()) )
+		{
+			compact->blob_garbage[blob_ref.file_number] += blob_ref.size;
+		}
 
 		input->Next();
 	}
@@ -1131,9 +2235,25 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
 	{
 		status = Status::IOError("Deleting DB during compaction");
 	}
+	if ( status.ok() && !compact->merge_keys.empty() )
+	{
+		bool resolved;
+		status = FlushCompactionMerge(compact,
+				compact->compaction->IsBaseLevelForKey(current_user_key),
+				NULL, &resolved, input);
+	}
+	if ( status.ok() && compact->builder == NULL
+			&& HasPendingRangeDels(compact) )
+	{
+		status = OpenCompactionOutputFile(compact);
+	}
 	if ( status.ok() && compact->builder != NULL )
 	{
-		status = FinishCompactionOutputFile(compact, input);
+		status = FinishCompactionOutputFile(compact, input, NULL);
+	}
+	if ( status.ok() && compact->blob != NULL )
+	{
+		status = compact->blob->Finish();
 	}
 	if ( status.ok() )
 	{
@@ -1155,9 +2275,21 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
 	{
 		stats.bytes_written += compact->outputs[i].file_size;
 	}
+	if ( compact->blob != NULL )
+	{
+		stats.bytes_written += compact->blob->FileSize();
+	}
+
+	if ( options_.statistics != NULL )
+	{
+		options_.statistics->RecordTick(kCompactReadBytes, stats.bytes_read);
+		options_.statistics->RecordTick(kCompactWriteBytes,
+				stats.bytes_written);
+		options_.statistics->MeasureTime(kCompactionTime, stats.micros);
+	}
 
 	mutex_.Lock();
-	stats_[compact->compaction->level() + 1].Add(stats);
+	stats_[compact->compaction->output_level()].Add(stats);
 
 	if ( status.ok() )
 	{
@@ -1192,7 +2324,7 @@ static void CleanupIteratorState(void* arg1, void* arg2)
 } // namespace
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
-		SequenceNumber* latest_snapshot)
+		SequenceNumber* latest_snapshot, RangeDelAggregator* range_del)
 {
 	IterState* cleanup = new IterState;
 	mutex_.Lock();
@@ -1210,6 +2342,12 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
 	versions_->current()->AddIterators(options, &list);
 	Iterator* internal_iter = NewMergingIterator(&internal_comparator_,
 			&list[0], list.size());
+	if ( !versions_->current()->blob_files().empty() )
+	{
+		// Values kept in blob files are read as they are reached
+		internal_iter = NewBlobResolvingIterator(internal_iter, blob_cache_,
+				options);
+	}
 	versions_->current()->Ref();
 
 	cleanup->mu = &mutex_;
@@ -1219,13 +2357,36 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
 	internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, NULL);
 
 	mutex_.Unlock();
+
+	if ( range_del != NULL )
+	{
+		// The references held by cleanup keep these sources alive
+		Iterator* iter = cleanup->mem->NewRangeDelIterator();
+		Status s = range_del->AddTombstones(iter);
+		delete iter;
+		if ( s.ok() && cleanup->imm != NULL )
+		{
+			iter = cleanup->imm->NewRangeDelIterator();
+			s = range_del->AddTombstones(iter);
+			delete iter;
+		}
+		if ( s.ok() )
+		{
+			s = cleanup->version->AddRangeTombstones(range_del);
+		}
+		if ( !s.ok() )
+		{
+			delete internal_iter;
+			return NewErrorIterator(s);
+		}
+	}
 	return internal_iter;
 }
 
 Iterator* DBImpl::TEST_NewInternalIterator()
 {
 	SequenceNumber ignored;
-	return NewInternalIterator(ReadOptions(), &ignored);
+	return NewInternalIterator(ReadOptions(), &ignored, NULL);
 }
 
 int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes()
@@ -1234,11 +2395,39 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes()
 	return versions_->MaxNextLevelOverlappingBytes();
 }
 
-Status DBImpl::Get(const ReadOptions& options, const Slice& key,
-		std::string* value)
+// Releases the memtable pinned by a PinnableSlice
+static void UnrefPinnedMemTable(void* arg1, void* arg2)
 {
+	MemTable* mem = reinterpret_cast<MemTable*> (arg1);
+	port::Mutex* mu = reinterpret_cast<port::Mutex*> (arg2);
+	MutexLock l(mu);
+	mem->Unref();
+}
+
+Status DBImpl::Get(const ReadOptions& options, const Slice& key,
+		std::string* value)
+{
+	PinnableSlice pinnable(value);
+	return GetImpl(options, key, &pinnable, false);
+}
+
+Status DBImpl::Get(const ReadOptions& options, const Slice& key,
+		PinnableSlice* value)
+{
+	return GetImpl(options, key, value, true);
+}
+
+Status DBImpl::GetImpl(const ReadOptions& options, const Slice& key,
+		PinnableSlice* value, bool pin)
+{
+	// Released before taking the mutex, which a pinned memtable needs
+	value->Reset();
+	StopWatch sw(env_, options_.statistics, kDBGet);
+
 	Status s;
+	PERF_TIMER_GUARD(db_mutex_lock_nanos);
 	MutexLock l(&mutex_);
+	PERF_TIMER_STOP(db_mutex_lock_nanos);
 	SequenceNumber snapshot;
 	if ( options.snapshot != NULL )
 	{
@@ -1260,28 +2449,69 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
 
 	bool have_stat_update = false;
 	Version::GetStats stats;
+	MemTable* pinned_mem = NULL; // Memtable holding mem_value
+	Slice mem_value(NULL, 0);
 
 	// Unlock while reading from files and memtables
 	{
 		mutex_.Unlock();
 		// First look in the memtable, then in the immutable memtable (if any).
 		LookupKey lkey(key, snapshot);
-		if ( mem->Get(lkey, value, &s) )
+		// Merge operands found on the way down are collected here and
+		// folded into the first value or deletion below them.
+		MergeContext merge(options_.merge_operator);
+		// Newest range deletion covering key seen so far; older entries
+		// read as deleted.
+		SequenceNumber range_del_seq = 0;
+		std::string* buf = value->GetSelf();
+		PERF_TIMER_GUARD(get_from_memtable_time);
+		PERF_COUNTER_ADD(get_from_memtable_count, 1);
+		if ( mem->Get(lkey, buf, &s, &merge, &range_del_seq,
+				pin ? &mem_value : NULL) )
 		{
-			// Done
+			pinned_mem = mem;
 		}
-		else if ( imm != NULL && imm->Get(lkey, value, &s) )
+		else if ( imm != NULL )
 		{
-			// Done
+			PERF_COUNTER_ADD(get_from_memtable_count, 1);
+			if ( imm->Get(lkey, buf, &s, &merge, &range_del_seq,
+					pin ? &mem_value : NULL) )
+			{
+				pinned_mem = imm;
+			}
 		}
-		else
+		PERF_TIMER_STOP(get_from_memtable_time);
+		if ( pinned_mem == NULL )
 		{
-			s = current->Get(options, lkey, value, &stats);
+			PERF_TIMER_GUARD(get_from_output_files_time);
+			s = current->Get(options, lkey, value, &stats, &merge,
+					&range_del_seq, pin);
 			have_stat_update = true;
 		}
+		if ( pinned_mem != NULL && (!s.ok() || mem_value.data() == NULL) )
+		{
+			// Not found, or the value was computed into buf
+			pinned_mem = NULL;
+			if ( s.ok() )
+			{
+				value->PinSelf();
+			}
+		}
+		PERF_TIMER_GUARD(db_mutex_lock_nanos);
 		mutex_.Lock();
 	}
 
+	if ( pinned_mem != NULL )
+	{
+		pinned_mem->Ref();
+		value->PinSlice(mem_value, &UnrefPinnedMemTable, pinned_mem, &mutex_);
+	}
+
+	if ( s.ok() )
+	{
+		RecordTick(options_.statistics, kKeysRead);
+		RecordTick(options_.statistics, kBytesRead, value->size());
+	}
 	if ( have_stat_update && current->UpdateStats(stats) )
 	{
 		MaybeScheduleCompaction();
@@ -1296,14 +2526,25 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
 Iterator* DBImpl::NewIterator(const ReadOptions& options)
 {
 	SequenceNumber latest_snapshot;
-	Iterator* internal_iter = NewInternalIterator(options, &latest_snapshot);
-	return NewDBIterator(
-			&dbname_,
-			env_,
-			user_comparator(),
-			internal_iter,
-			(options.snapshot != NULL ? reinterpret_cast<const SnapshotImpl*> (options.snapshot)->number_
-					: latest_snapshot));
+	RangeDelAggregator* range_del = new RangeDelAggregator(user_comparator());
+	Iterator* internal_iter = NewInternalIterator(options, &latest_snapshot,
+			range_del);
+	SequenceNumber sequence = (options.snapshot != NULL
+			? reinterpret_cast<const SnapshotImpl*> (options.snapshot)->number_
+			: latest_snapshot);
+	if ( range_del->empty() )
+	{
+		delete range_del;
+		range_del = NULL;
+	}
+	else
+	{
+		range_del->Finish(sequence);
+	}
+	return NewDBIterator(&dbname_, env_, user_comparator(),
+			options_.merge_operator, range_del, internal_iter, sequence,
+			options.iterate_lower_bound, options.iterate_upper_bound,
+			options_.statistics);
 }
 
 const Snapshot* DBImpl::GetSnapshot()
@@ -1329,14 +2570,320 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key)
 	return DB::Delete(options, key);
 }
 
+Status DBImpl::Merge(const WriteOptions& options, const Slice& key,
+		const Slice& value)
+{
+	if ( options_.merge_operator == NULL )
+	{
+		return Status::InvalidArgument("no merge_operator configured");
+	}
+	return DB::Merge(options, key, value);
+}
+
+Status DBImpl::DeleteRange(const WriteOptions& options,
+		const Slice& begin_key, const Slice& end_key)
+{
+	if ( user_comparator()->Compare(begin_key, end_key) >= 0 )
+	{
+		// Empty range
+		return Status::OK();
+	}
+	return DB::DeleteRange(options, begin_key, end_key);
+}
+
+static Status CopyFile(Env* env, const std::string& src,
+		const std::string& dst)
+{
+	SequentialFile* in;
+	Status s = env->NewSequentialFile(src, &in);
+	if ( !s.ok() )
+	{
+		return s;
+	}
+	WritableFile* out;
+	s = env->NewWritableFile(dst, &out);
+	if ( !s.ok() )
+	{
+		delete in;
+		return s;
+	}
+	const size_t kBufferSize = 1 << 20;
+	char* buf = new char[kBufferSize];
+	while (s.ok())
+	{
+		Slice chunk;
+		s = in->Read(kBufferSize, &chunk, buf);
+		if ( !s.ok() || chunk.empty() )
+		{
+			break;
+		}
+		s = out->Append(chunk);
+	}
+	delete[] buf;
+	if ( s.ok() )
+	{
+		s = out->Sync();
+	}
+	if ( s.ok() )
+	{
+		s = out->Close();
+	}
+	delete out;
+	delete in;
+	if ( !s.ok() )
+	{
+		env->DeleteFile(dst);
+	}
+	return s;
+}
+
+// Does *mem hold an entry or a range deletion for a user key in
+// [smallest, largest]?
+static bool MemTableOverlaps(MemTable* mem, const Comparator* ucmp,
+		const Slice& smallest, const Slice& largest)
+{
+	Iterator* iter = mem->NewIterator();
+	LookupKey lkey(smallest, kMaxSequenceNumber);
+	iter->Seek(lkey.internal_key());
+	bool overlap = iter->Valid() && ucmp->Compare(ExtractUserKey(iter->key()),
+			largest) <= 0;
+	delete iter;
+
+	iter = mem->NewRangeDelIterator();
+	for (iter->SeekToFirst(); !overlap && iter->Valid(); iter->Next())
+	{
+		overlap = ucmp->Compare(ExtractUserKey(iter->key()), largest) <= 0
+				&& ucmp->Compare(smallest, iter->value()) < 0;
+	}
+	delete iter;
+	return overlap;
+}
+
+Status DBImpl::ValidateExternalFile(FileMetaData* meta)
+{
+	Status s = env_->GetFileSize(TableFileName(dbname_, meta->number),
+			&meta->file_size);
+	if ( !s.ok() )
+	{
+		return s;
+	}
+
+	// Any non-zero sequence number opens the file as an external table
+	ReadOptions options;
+	options.verify_checksums = true;
+	options.fill_cache = false;
+	Iterator* iter = table_cache_->NewIterator(options, meta->number,
+			meta->file_size, kMaxSequenceNumber);
+	std::string smallest, largest;
+	bool empty = true;
+	for (iter->SeekToFirst(); s.ok() && iter->Valid(); iter->Next())
+	{
+		const Slice user_key = ExtractUserKey(iter->key());
+		if ( empty )
+		{
+			smallest = user_key.ToString();
+			empty = false;
+		}
+		else if ( user_comparator()->Compare(largest, user_key) >= 0 )
+		{
+			s = Status::InvalidArgument("external file keys are not sorted",
+					EscapeString(user_key));
+		}
+		largest.assign(user_key.data(), user_key.size());
+	}
+	if ( s.ok() )
+	{
+		s = iter->status();
+	}
+	delete iter;
+	if ( s.ok() && empty )
+	{
+		s = Status::InvalidArgument("external file is empty");
+	}
+	if ( s.ok() )
+	{
+		iter = table_cache_->NewRangeDelIterator(meta->number, meta->file_size);
+		iter->SeekToFirst();
+		if ( iter->Valid() )
+		{
+			s = Status::InvalidArgument("external file holds range deletions");
+		}
+		delete iter;
+	}
+	if ( s.ok() )
+	{
+		// The sequence number is filled in by InstallExternalFile()
+		meta->smallest = InternalKey(smallest, 0, kTypeValue);
+		meta->largest = InternalKey(largest, 0, kTypeValue);
+	}
+	return s;
+}
+
+Status DBImpl::InstallExternalFile(FileMetaData* meta)
+{
+	mutex_.AssertHeld();
+	const std::string smallest = meta->smallest.user_key().ToString();
+	const std::string largest = meta->largest.user_key().ToString();
+
+	// The memtables are older than the file, so their entries must not
+	// stay above it: flush them.  Compactions are waited out since only
+	// one thread at a time may write the descriptor.
+	Status s;
+	if ( MemTableOverlaps(mem_, user_comparator(), smallest, largest) )
+	{
+		s = MakeRoomForWrite(true /* force compaction */);
+	}
+	while (s.ok() && (bg_compaction_scheduled_ || imm_ != NULL))
+	{
+		if ( !bg_error_.ok() )
+		{
+			s = bg_error_;
+		}
+		else
+		{
+			bg_cv_.Wait();
+		}
+	}
+	if ( !s.ok() )
+	{
+		return s;
+	}
+	bg_compaction_scheduled_ = true; // Keep compactions out meanwhile
+
+	// Place the file right above the first level holding any of its keys
+	const Slice smallest_user_key(smallest), largest_user_key(largest);
+	Version* current = versions_->current();
+	int level = 0;
+	while (level < config::kNumLevels && !current->OverlapInLevel(level,
+			&smallest_user_key, &largest_user_key))
+	{
+		level++;
+	}
+	level = (level > 0) ? level - 1 : 0;
+
+	// Level-0 files are read newest first by number, and the file's number
+	// was taken before the memtables above were flushed: give it one newer
+	// than theirs
+	if ( level == 0 )
+	{
+		const uint64_t number = versions_->NewFileNumber();
+		s = env_->RenameFile(TableFileName(dbname_, meta->number),
+				TableFileName(dbname_, number));
+		if ( s.ok() )
+		{
+			table_cache_->Evict(meta->number);
+			pending_outputs_.erase(meta->number);
+			pending_outputs_.insert(number);
+			meta->number = number;
+		}
+	}
+
+	const SequenceNumber sequence = versions_->LastSequence() + 1;
+	meta->global_seqno = sequence;
+	meta->smallest = InternalKey(smallest, sequence, kTypeValue);
+	meta->largest = InternalKey(largest, sequence, kTypeValue);
+	if ( s.ok() )
+	{
+		VersionEdit edit;
+		edit.AddFile(level, *meta);
+		versions_->SetLastSequence(sequence);
+		s = versions_->LogAndApply(&edit, &mutex_);
+	}
+	Log(options_.info_log, "Ingested #%llu to level-%d: %lld bytes at seq %llu %s",
+			(unsigned long long) meta->number, level,
+			(unsigned long long) meta->file_size,
+			(unsigned long long) sequence, s.ToString().c_str());
+
+	bg_compaction_scheduled_ = false;
+	bg_cv_.SignalAll();
+	MaybeScheduleCompaction();
+	return s;
+}
+
+Status DBImpl::IngestExternalFile(const IngestOptions& options,
+		const std::string& fname)
+{
+	FileMetaData meta;
+	{
+		MutexLock l(&mutex_);
+		meta.number = versions_->NewFileNumber();
+		pending_outputs_.insert(meta.number);
+	}
+
+	// Check the file once it is in place, before queueing with the writers
+	const std::string dst = TableFileName(dbname_, meta.number);
+	bool moved = false;
+	Status s;
+	if ( options.move_file )
+	{
+		moved = env_->RenameFile(fname, dst).ok();
+	}
+	if ( !moved )
+	{
+		s = CopyFile(env_, fname, dst);
+	}
+	if ( s.ok() )
+	{
+		s = ValidateExternalFile(&meta);
+	}
+
+	if ( s.ok() )
+	{
+		Writer w(&mutex_);
+		w.batch = NULL;
+		w.sync = false;
+		w.done = false;
+
+		MutexLock l(&mutex_);
+		writers_.push_back(&w);
+		while (&w != writers_.front())
+		{
+			w.cv.Wait();
+		}
+		s = InstallExternalFile(&meta);
+		writers_.pop_front();
+		if ( !writers_.empty() )
+		{
+			writers_.front()->cv.Signal();
+		}
+	}
+
+	MutexLock l(&mutex_);
+	pending_outputs_.erase(meta.number);
+	if ( !s.ok() )
+	{
+		// InstallExternalFile() may have renumbered the file
+		const std::string placed = TableFileName(dbname_, meta.number);
+		table_cache_->Evict(meta.number);
+		if ( moved )
+		{
+			env_->RenameFile(placed, fname);
+		}
+		else
+		{
+			env_->DeleteFile(placed);
+		}
+	}
+	return s;
+}
+
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
+{
+	return root_->WriteImpl(options, my_batch, this);
+}
+
+Status DBImpl::WriteImpl(const WriteOptions& options, WriteBatch* my_batch,
+		DBImpl* family)
 {
 	Writer w(&mutex_);
 	w.batch = my_batch;
 	w.sync = options.sync;
 	w.done = false;
+	StopWatch sw(env_, options_.statistics, kDBWrite);
 
-	MutexLock l(&mutex_);
+	PERF_TIMER_GUARD(db_mutex_lock_nanos);
+	mutex_.Lock();
+	PERF_TIMER_STOP(db_mutex_lock_nanos);
 	writers_.push_back(&w);
 	while (!w.done && &w != writers_.front())
 	{
@@ -1344,42 +2891,92 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
 	}
 	if ( w.done )
 	{
+		mutex_.Unlock();
+		if ( w.status.ok() && w.log_sync_sequence != 0 )
+		{
+			return WaitForLogSync(w.log_sync_sequence);
+		}
 		return w.status;
 	}
 
 	// May temporarily unlock and wait.
-	Status status = MakeRoomForWrite(my_batch == NULL);
+	Status status = MakeRoomForWrites(my_batch == NULL ? family : NULL);
 	uint64_t last_sequence = versions_->LastSequence();
 	Writer* last_writer = &w;
+	const bool background_sync = options.sync && options_.background_wal_sync
+			&& logfile_->IsSyncThreadSafe();
 	if ( status.ok() && my_batch != NULL )
 	{ // NULL batch is for compactions
 		WriteBatch* updates = BuildBatchGroup(&last_writer);
 		WriteBatchInternal::SetSequence(updates, last_sequence + 1);
 		last_sequence += WriteBatchInternal::Count(updates);
 
+		// The memtables of the column families the batch may span
+		std::map<uint32_t, MemTable*> memtables;
+		std::map<uint32_t, ColumnFamilyHandleImpl*>::iterator it;
+		if ( !column_families_.empty() )
+		{
+			memtables[0] = mem_;
+			for (it = column_families_.begin(); it != column_families_.end(); ++it)
+			{
+				memtables[it->first] = it->second->db()->mem_;
+			}
+		}
+
 		// Add to log and apply to memtable.  We can release the lock
 		// during this phase since &w is currently responsible for logging
 		// and protects against concurrent loggers and concurrent writes
 		// into mem_.
 		{
 			mutex_.Unlock();
+			RecordTick(options_.statistics, kBytesWritten,
+					WriteBatchInternal::ByteSize(updates));
+			RecordTick(options_.statistics, kKeysWritten,
+					WriteBatchInternal::Count(updates));
+			RecordTick(options_.statistics, kWALFileBytes,
+					WriteBatchInternal::ByteSize(updates));
+			PERF_TIMER_GUARD(write_wal_time);
 			status = log_->AddRecord(WriteBatchInternal::Contents(updates));
-			if ( status.ok() && options.sync )
+			if ( status.ok() && options.sync && !background_sync )
 			{
+				StopWatch sync_sw(env_, options_.statistics, kWALFileSyncMicros);
+				RecordTick(options_.statistics, kWALFileSynced);
 				status = logfile_->Sync();
 			}
+			PERF_TIMER_STOP(write_wal_time);
 			if ( status.ok() )
 			{
-				status = WriteBatchInternal::InsertInto(updates, mem_);
+				PERF_TIMER_GUARD(write_memtable_time);
+				if ( memtables.empty() )
+				{
+					status = WriteBatchInternal::InsertInto(updates, mem_);
+				}
+				else
+				{
+					status = WriteBatchInternal::InsertInto(updates, memtables);
+				}
 			}
 			mutex_.Lock();
 		}
 		if ( updates == tmp_batch_ )
 			tmp_batch_->Clear();
 
+		// Sequence numbers are shared by all the column families
 		versions_->SetLastSequence(last_sequence);
+		for (it = column_families_.begin(); it != column_families_.end(); ++it)
+		{
+			it->second->db()->versions_->SetLastSequence(last_sequence);
+		}
 	}
 
+	// With a background sync, the group waits for it out of the queue, so
+	// that the next group may append to the log meanwhile
+	const SequenceNumber log_sync_sequence = (status.ok() && background_sync
+			&& my_batch != NULL) ? last_sequence : 0;
+	if ( log_sync_sequence != 0 )
+	{
+		RequestLogSync(log_sync_sequence);
+	}
 	while (true)
 	{
 		Writer* ready = writers_.front();
@@ -1387,6 +2984,7 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
 		if ( ready != &w )
 		{
 			ready->status = status;
+			ready->log_sync_sequence = log_sync_sequence;
 			ready->done = true;
 			ready->cv.Signal();
 		}
@@ -1400,60 +2998,172 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
 		writers_.front()->cv.Signal();
 	}
 
+	mutex_.Unlock();
+
+	if ( log_sync_sequence != 0 )
+	{
+		status = WaitForLogSync(log_sync_sequence);
+	}
 	return status;
 }
 
-// REQUIRES: Writer list must be non-empty
-// REQUIRES: First writer must have a non-NULL batch
-WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer)
+void DBImpl::RequestLogSync(SequenceNumber sequence)
 {
-	assert(!writers_.empty());
-	Writer* first = writers_.front();
-	WriteBatch* result = first->batch;
-	assert(result != NULL);
-
-	size_t size = WriteBatchInternal::ByteSize(first->batch);
+	mutex_.AssertHeld();
+	MutexLock l(&log_sync_mu_);
+	if ( log_sync_requested_ < sequence )
+	{
+		log_sync_requested_ = sequence;
+		log_sync_cv_.SignalAll();
+	}
+}
 
-	// Allow the group to grow up to a maximum size, but if the
-	// original write is small, limit the growth so we do not slow
-	// down the small write too much.
-	size_t max_size = 1 << 20;
-	if ( size <= (128 << 10) )
+Status DBImpl::WaitForLogSync(SequenceNumber sequence)
+{
+	MutexLock l(&log_sync_mu_);
+	while (log_synced_ < sequence && log_sync_status_.ok())
 	{
-		max_size = size + (128 << 10);
+		log_sync_cv_.Wait();
 	}
+	return (log_synced_ >= sequence) ? Status::OK() : log_sync_status_;
+}
 
-	*last_writer = first;
-	std::deque<Writer*>::iterator iter = writers_.begin();
-	++iter; // Advance past "first"
-	for (; iter != writers_.end(); ++iter)
+void DBImpl::BGLogSync(void* db)
+{
+	reinterpret_cast<DBImpl*> (db)->LogSyncLoop();
+}
+
+void DBImpl::LogSyncLoop()
+{
+	MutexLock l(&log_sync_mu_);
+	while (!shutting_down_.Acquire_Load())
 	{
-		Writer* w = *iter;
-		if ( w->sync && !first->sync )
+		if ( log_synced_ >= log_sync_requested_ || !log_sync_status_.ok() )
 		{
-			// Do not include a sync write into a batch handled by a non-sync write.
-			break;
+			log_sync_cv_.Wait();
+			continue;
 		}
 
-		if ( w->batch != NULL )
+		// Every record up to "target" has been appended to logfile_, which
+		// SwitchLogFile() does not close during the sync
+		const SequenceNumber target = log_sync_requested_;
+		WritableFile* file = logfile_;
+		log_syncing_ = true;
+		log_sync_mu_.Unlock();
+		Status s;
 		{
-			size += WriteBatchInternal::ByteSize(w->batch);
-			if ( size > max_size )
-			{
-				// Do not make batch too big
-				break;
-			}
-
-			// Append to *reuslt
-			if ( result == first->batch )
-			{
-				// Switch to temporary batch instead of disturbing caller's batch
-				result = tmp_batch_;
-				assert(WriteBatchInternal::Count(result) == 0);
-				WriteBatchInternal::Append(result, first->batch);
-			}
-			WriteBatchInternal::Append(result, w->batch);
+			StopWatch sync_sw(env_, options_.statistics, kWALFileSyncMicros);
+			RecordTick(options_.statistics, kWALFileSynced);
+			s = file->Sync();
 		}
+		log_sync_mu_.Lock();
+		log_syncing_ = false;
+		if ( s.ok() )
+		{
+			log_synced_ = target;
+		}
+		else
+		{
+			log_sync_status_ = s;
+		}
+		log_sync_cv_.SignalAll();
+	}
+	log_sync_thread_running_ = false;
+	log_sync_cv_.SignalAll();
+}
+
+Status DBImpl::FlushWAL(bool sync)
+{
+	if ( root_ != this )
+	{
+		return root_->FlushWAL(sync);
+	}
+
+	// At the front of the writer queue no one appends to the log or
+	// switches to a new one
+	Writer w(&mutex_);
+	w.batch = NULL;
+	w.sync = false;
+	w.done = false;
+	MutexLock l(&mutex_);
+	writers_.push_back(&w);
+	while (&w != writers_.front())
+	{
+		w.cv.Wait();
+	}
+	WritableFile* file = logfile_;
+	mutex_.Unlock();
+	Status s = file->Flush();
+	if ( s.ok() && sync )
+	{
+		StopWatch sync_sw(env_, options_.statistics, kWALFileSyncMicros);
+		RecordTick(options_.statistics, kWALFileSynced);
+		s = file->Sync();
+	}
+	mutex_.Lock();
+	writers_.pop_front();
+	if ( !writers_.empty() )
+	{
+		writers_.front()->cv.Signal();
+	}
+	return s;
+}
+
+// REQUIRES: Writer list must be non-empty
+// REQUIRES: First writer must have a non-NULL batch
+WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer)
+{
+	assert(!writers_.empty());
+	Writer* first = writers_.front();
+	WriteBatch* result = first->batch;
+	assert(result != NULL);
+
+	size_t size = WriteBatchInternal::ByteSize(first->batch);
+
+	// Allow the group to grow up to a maximum size, but if the
+	// original write is small, limit the growth so we do not slow
+	// down the small write too much.
+	size_t max_size = 1 << 20;
+	if ( size <= (128 << 10) )
+	{
+		max_size = size + (128 << 10);
+	}
+
+	*last_writer = first;
+	std::deque<Writer*>::iterator iter = writers_.begin();
+	++iter; // Advance past "first"
+	for (; iter != writers_.end(); ++iter)
+	{
+		Writer* w = *iter;
+		if ( w->sync && !first->sync )
+		{
+			// Do not include a sync write into a batch handled by a non-sync write.
+			break;
+		}
+
+		if ( w->batch == NULL )
+		{
+			// Compaction requests and file ingestion must reach the front
+			// of the queue themselves.
+			break;
+		}
+
+		size += WriteBatchInternal::ByteSize(w->batch);
+		if ( size > max_size )
+		{
+			// Do not make batch too big
+			break;
+		}
+
+		// Append to *reuslt
+		if ( result == first->batch )
+		{
+			// Switch to temporary batch instead of disturbing caller's batch
+			result = tmp_batch_;
+			assert(WriteBatchInternal::Count(result) == 0);
+			WriteBatchInternal::Append(result, first->batch);
+		}
+		WriteBatchInternal::Append(result, w->batch);
 		*last_writer = w;
 	}
 	return result;
@@ -1464,7 +3174,7 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer)
 Status DBImpl::MakeRoomForWrite(bool force)
 {
 	mutex_.AssertHeld();
-	assert(!writers_.empty());
+	assert(!root_->writers_.empty());
 	bool allow_delay = !force;
 	Status s;
 	while (true)
@@ -1484,8 +3194,10 @@ Status DBImpl::MakeRoomForWrite(bool force)
 			// individual write by 1ms to reduce latency variance.  Also,
 			// this delay hands over some CPU to the compaction thread in
 			// case it is sharing the same core as the writer.
+			SetStallCondition(kStallDelayed, kStallCauseL0FileCountLimit);
 			mutex_.Unlock();
 			env_->SleepForMicroseconds(1000);
+			RecordTick(options_.statistics, kStallMicros, 1000);
 			allow_delay = false; // Do not delay a single write more than once
 			mutex_.Lock();
 		}
@@ -1493,6 +3205,10 @@ Status DBImpl::MakeRoomForWrite(bool force)
 				<= options_.write_buffer_size) )
 		{
 			// There is room in current memtable
+			if ( allow_delay )
+			{
+				SetStallCondition(kStallNormal, kStallCauseNone);
+			}
 			break;
 		}
 		else if ( imm_ != NULL )
@@ -1500,36 +3216,37 @@ Status DBImpl::MakeRoomForWrite(bool force)
 			// We have filled up the current memtable, but the previous
 			// one is still being compacted, so we wait.
 			Log(options_.info_log, "Current memtable full; waiting...\n");
-			bg_cv_.Wait();
+			if ( SetStallCondition(kStallStopped, kStallCauseMemtableLimit) )
+			{
+				// The compaction may be done by now, its signal missed
+				continue;
+			}
+			WaitForRoom();
 		}
 		else if ( versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger )
 		{
 			// There are too many level-0 files.
 			Log(options_.info_log, "Too many L0 files; waiting...\n");
-			bg_cv_.Wait();
+			if ( SetStallCondition(kStallStopped, kStallCauseL0FileCountLimit) )
+			{
+				continue; // As above
+			}
+			WaitForRoom();
 		}
 		else
 		{
 			// Attempt to switch to a new memtable and trigger compaction of old
 			assert(versions_->PrevLogNumber() == 0);
-			uint64_t new_log_number = versions_->NewFileNumber();
-			WritableFile* lfile = NULL;
-			s = env_->NewWritableFile(LogFileName(dbname_, new_log_number),
-					&lfile);
+			s = root_->SwitchLogFile();
 			if ( !s.ok() )
 			{
-				// Avoid chewing through file number space in a tight loop.
-				versions_->ReuseFileNumber(new_log_number);
 				break;
 			}
-			delete log_;
-			delete logfile_;
-			logfile_ = lfile;
-			logfile_number_ = new_log_number;
-			log_ = new log::Writer(lfile);
+			mem_log_number_ = root_->logfile_number_;
 			imm_ = mem_;
 			has_imm_.Release_Store(imm_);
-			mem_ = new MemTable(internal_comparator_);
+			mem_ = new MemTable(internal_comparator_,
+					options_.write_buffer_manager);
 			mem_->Ref();
 			force = false; // Do not force another compaction if have room
 			MaybeScheduleCompaction();
@@ -1538,6 +3255,135 @@ Status DBImpl::MakeRoomForWrite(bool force)
 	return s;
 }
 
+void DBImpl::WaitForRoom()
+{
+	const uint64_t start_micros =
+			(options_.statistics != NULL ? env_->NowMicros() : 0);
+	bg_cv_.Wait();
+	if ( options_.statistics != NULL )
+	{
+		options_.statistics->RecordTick(kStallMicros, env_->NowMicros()
+				- start_micros);
+	}
+}
+
+Status DBImpl::MakeRoomForWrites(DBImpl* force)
+{
+	mutex_.AssertHeld();
+	if ( force == NULL )
+	{
+		force = MemTableToFlush();
+	}
+	Status s = MakeRoomForWrite(force == this);
+	for (std::map<uint32_t, ColumnFamilyHandleImpl*>::iterator it =
+			column_families_.begin(); s.ok() && it != column_families_.end(); ++it)
+	{
+		DBImpl* family = it->second->db();
+		s = family->MakeRoomForWrite(force == family);
+	}
+	return s;
+}
+
+// Has the write buffer manager of a DB reached its budget, with the
+// memtable "mem" of the DB worth flushing and no flush of "imm" underway?
+static bool OverWriteBufferBudget(const Options& options, MemTable* mem,
+		MemTable* imm)
+{
+	return options.write_buffer_manager != NULL
+			&& options.write_buffer_manager->ShouldFlush() && imm == NULL
+			&& !MemTableIsEmpty(mem);
+}
+
+DBImpl* DBImpl::MemTableToFlush()
+{
+	mutex_.AssertHeld();
+	DBImpl* largest = NULL;
+	if ( OverWriteBufferBudget(options_, mem_, imm_) )
+	{
+		largest = this;
+	}
+	for (std::map<uint32_t, ColumnFamilyHandleImpl*>::iterator it =
+			column_families_.begin(); it != column_families_.end(); ++it)
+	{
+		DBImpl* family = it->second->db();
+		if ( OverWriteBufferBudget(family->options_, family->mem_,
+				family->imm_) && (largest == NULL
+				|| family->mem_->ApproximateMemoryUsage()
+						> largest->mem_->ApproximateMemoryUsage()) )
+		{
+			largest = family;
+		}
+	}
+	return largest;
+}
+
+Status DBImpl::SwitchLogFile()
+{
+	mutex_.AssertHeld();
+	assert(root_ == this);
+	uint64_t new_log_number = versions_->NewFileNumber();
+	WritableFile* lfile = NULL;
+	Status s;
+	if ( !log_recycle_files_.empty() )
+	{
+		const uint64_t old_log_number = log_recycle_files_.front();
+		log_recycle_files_.pop_front();
+		s = env_->ReuseWritableFile(LogFileName(dbname_, new_log_number),
+				LogFileName(dbname_, old_log_number), &lfile);
+	}
+	else
+	{
+		s = env_->NewWritableFile(LogFileName(dbname_, new_log_number),
+				&lfile);
+	}
+	if ( !s.ok() )
+	{
+		// Avoid chewing through file number space in a tight loop.
+		versions_->ReuseFileNumber(new_log_number);
+		return s;
+	}
+	{
+		// Writers may wait for the old log to be synced: by the sync
+		// thread, which must be done with it, or here
+		MutexLock l(&log_sync_mu_);
+		while (log_syncing_)
+		{
+			log_sync_cv_.Wait();
+		}
+		if ( log_synced_ < log_sync_requested_ && log_sync_status_.ok() )
+		{
+			log_sync_status_ = logfile_->Sync();
+			if ( log_sync_status_.ok() )
+			{
+				log_synced_ = log_sync_requested_;
+			}
+			log_sync_cv_.SignalAll();
+		}
+		delete log_;
+		delete logfile_;
+		logfile_ = lfile;
+	}
+	logfile_number_ = new_log_number;
+	log_ = new log::Writer(lfile, new_log_number,
+			options_.recycle_log_file_num > 0, options_.bytes_per_sync);
+
+	// Idle memtables would otherwise keep the older logs alive
+	if ( imm_ == NULL && MemTableIsEmpty(mem_) )
+	{
+		mem_log_number_ = new_log_number;
+	}
+	for (std::map<uint32_t, ColumnFamilyHandleImpl*>::iterator it =
+			column_families_.begin(); it != column_families_.end(); ++it)
+	{
+		DBImpl* family = it->second->db();
+		if ( family->imm_ == NULL && MemTableIsEmpty(family->mem_) )
+		{
+			family->mem_log_number_ = new_log_number;
+		}
+	}
+	return s;
+}
+
 bool DBImpl::GetProperty(const Slice& property, std::string* value)
 {
 	value->clear();
@@ -1595,6 +3441,11 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value)
 		*value = versions_->current()->DebugString();
 		return true;
 	}
+	else if ( in == "statistics" && options_.statistics != NULL )
+	{
+		*value = options_.statistics->ToString();
+		return true;
+	}
 
 	return false;
 }
@@ -1641,19 +3492,151 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key)
 	return Write(opt, &batch);
 }
 
+Status DB::Merge(const WriteOptions& opt, const Slice& key, const Slice& value)
+{
+	WriteBatch batch;
+	batch.Merge(key, value);
+	return Write(opt, &batch);
+}
+
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin_key,
+		const Slice& end_key)
+{
+	WriteBatch batch;
+	batch.DeleteRange(begin_key, end_key);
+	return Write(opt, &batch);
+}
+
+Status DB::IngestExternalFile(const IngestOptions& options,
+		const std::string& fname)
+{
+	return Status::NotSupported("IngestExternalFile", fname);
+}
+
+Status DB::FlushWAL(bool sync)
+{
+	return Status::NotSupported("FlushWAL");
+}
+
+Status DB::CreateColumnFamily(const Options& options, const std::string& name,
+		ColumnFamilyHandle** handle)
+{
+	*handle = NULL;
+	return Status::NotSupported("CreateColumnFamily", name);
+}
+
+Status DB::DropColumnFamily(ColumnFamilyHandle* column_family)
+{
+	return Status::NotSupported("DropColumnFamily");
+}
+
+Status DB::Put(const WriteOptions& opt, ColumnFamilyHandle* column_family,
+		const Slice& key, const Slice& value)
+{
+	WriteBatch batch;
+	batch.Put(column_family, key, value);
+	return Write(opt, &batch);
+}
+
+Status DB::Delete(const WriteOptions& opt, ColumnFamilyHandle* column_family,
+		const Slice& key)
+{
+	WriteBatch batch;
+	batch.Delete(column_family, key);
+	return Write(opt, &batch);
+}
+
+Status DB::Get(const ReadOptions& options, ColumnFamilyHandle* column_family,
+		const Slice& key, std::string* value)
+{
+	if ( column_family != NULL )
+	{
+		return Status::NotSupported("column families");
+	}
+	return Get(options, key, value);
+}
+
+Status DB::Get(const ReadOptions& options, const Slice& key,
+		PinnableSlice* value)
+{
+	value->Reset();
+	Status s = Get(options, key, value->GetSelf());
+	if ( s.ok() )
+	{
+		value->PinSelf();
+	}
+	return s;
+}
+
+Status DB::Get(const ReadOptions& options, ColumnFamilyHandle* column_family,
+		const Slice& key, PinnableSlice* value)
+{
+	if ( column_family != NULL )
+	{
+		return Status::NotSupported("column families");
+	}
+	return Get(options, key, value);
+}
+
+Iterator* DB::NewIterator(const ReadOptions& options,
+		ColumnFamilyHandle* column_family)
+{
+	if ( column_family != NULL )
+	{
+		return NewErrorIterator(Status::NotSupported("column families"));
+	}
+	return NewIterator(options);
+}
+
+bool DB::GetProperty(ColumnFamilyHandle* column_family, const Slice& property,
+		std::string* value)
+{
+	return column_family == NULL && GetProperty(property, value);
+}
+
+void DB::CompactRange(ColumnFamilyHandle* column_family, const Slice* begin,
+		const Slice* end)
+{
+	if ( column_family == NULL )
+	{
+		CompactRange(begin, end);
+	}
+}
+
 DB::~DB()
 {
 }
+
+ColumnFamilyHandle::~ColumnFamilyHandle()
+{
+}
+
 //打开数据库
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr)
+{
+	std::vector<ColumnFamilyHandle*> handles;
+	return Open(options, dbname, std::vector<ColumnFamilyDescriptor>(),
+			&handles, dbptr);
+}
+
+Status DB::Open(const Options& options, const std::string& dbname,
+		const std::vector<ColumnFamilyDescriptor>& column_families,
+		std::vector<ColumnFamilyHandle*>* handles, DB** dbptr)
 {
 	*dbptr = NULL;
+	handles->clear();
 
 	DBImpl* impl = new DBImpl(options, dbname);
 	impl->mutex_.Lock();
 	VersionEdit edit;
+	std::vector<VersionEdit*> family_edits;
 	Status s = impl->Recover(&edit); // Handles create_if_missing, error_if_exists
 	if ( s.ok() )
+	{
+		s = impl->RecoverColumnFamilies(column_families, handles,
+				&family_edits);
+	}
+	if ( s.ok() )
 	{
 		uint64_t new_log_number = impl->versions_->NewFileNumber();
 		WritableFile* lfile;
@@ -1661,17 +3644,75 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr)
 				&lfile);
 		if ( s.ok() )
 		{
-			edit.SetLogNumber(new_log_number);
+			if ( impl->imm_ == NULL )
+			{
+				// Else the logs of imm_ stay live until it is written
+				edit.SetLogNumber(new_log_number);
+			}
 			impl->logfile_ = lfile;
 			impl->logfile_number_ = new_log_number;
-			impl->log_ = new log::Writer(lfile);
+			impl->first_log_number_ = new_log_number;
+			impl->log_ = new log::Writer(lfile, new_log_number,
+					impl->options_.recycle_log_file_num > 0,
+					impl->options_.bytes_per_sync);
+			impl->mem_log_number_ = new_log_number;
 			s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
 		}
+		std::map<uint32_t, ColumnFamilyHandleImpl*>::iterator it;
+		size_t i = 0;
+		for (it = impl->column_families_.begin(); s.ok() && it
+				!= impl->column_families_.end(); ++it, ++i)
+		{
+			DBImpl* family = it->second->db();
+			family->versions_->MarkFileNumberUsed(new_log_number);
+			if ( family->imm_ == NULL )
+			{
+				family_edits[i]->SetLogNumber(new_log_number);
+			}
+			family->mem_log_number_ = new_log_number;
+			s = family->versions_->LogAndApply(family_edits[i], &impl->mutex_);
+		}
+		if ( s.ok() )
+		{
+			s = impl->LoadTables();
+		}
+		for (it = impl->column_families_.begin(); s.ok() && it
+				!= impl->column_families_.end(); ++it)
+		{
+			s = it->second->db()->LoadTables();
+		}
+		for (it = impl->column_families_.begin(); s.ok() && it
+				!= impl->column_families_.end(); ++it)
+		{
+			it->second->db()->DeleteObsoleteFiles();
+			it->second->db()->MaybeScheduleCompaction();
+		}
 		if ( s.ok() )
 		{
 			impl->DeleteObsoleteFiles();
 			impl->MaybeScheduleCompaction();
 		}
+		if ( s.ok() && options.background_wal_sync )
+		{
+			impl->log_sync_thread_running_ = true;
+			options.env->StartThread(&DBImpl::BGLogSync, impl);
+		}
+	}
+	for (size_t i = 0; i < family_edits.size(); i++)
+	{
+		delete family_edits[i];
+	}
+
+	// Families missing from the DB are created on top of the new log
+	for (size_t i = 0; s.ok() && i < column_families.size(); i++)
+	{
+		if ( (*handles)[i] == NULL )
+		{
+			ColumnFamilyHandleImpl* handle;
+			s = impl->AddColumnFamily(column_families[i].options,
+					column_families[i].name, &handle);
+			(*handles)[i] = handle;
+		}
 	}
 	impl->mutex_.Unlock();
 	if ( s.ok() )
@@ -1680,11 +3721,320 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr)
 	}
 	else
 	{
+		handles->clear();
 		delete impl;
 	}
 	return s;
 }
 
+Status DBImpl::LoadTables()
+{
+	mutex_.AssertHeld();
+	if ( options_.max_open_files != -1 )
+	{
+		return Status::OK();
+	}
+	return versions_->LoadTableHandlers(options_.max_file_opening_threads);
+}
+
+Status DBImpl::RecoverColumnFamilies(
+		const std::vector<ColumnFamilyDescriptor>& column_families,
+		std::vector<ColumnFamilyHandle*>* handles,
+		std::vector<VersionEdit*>* edits)
+{
+	mutex_.AssertHeld();
+	std::map<std::string, size_t> listed;
+	for (size_t i = 0; i < column_families.size(); i++)
+	{
+		if ( column_families[i].name.empty()
+				|| !listed.insert(std::make_pair(column_families[i].name, i)).second )
+		{
+			return Status::InvalidArgument("bad column family name",
+					column_families[i].name);
+		}
+	}
+	handles->assign(column_families.size(), NULL);
+
+	const std::map<uint32_t, std::string>& existing =
+			versions_->column_families();
+	for (std::map<uint32_t, std::string>::const_iterator it = existing.begin(); it
+			!= existing.end(); ++it)
+	{
+		std::map<std::string, size_t>::iterator l = listed.find(it->second);
+		if ( l == listed.end() )
+		{
+			return Status::InvalidArgument("column family not opened",
+					it->second);
+		}
+		// The directory of an existing family must be there
+		Options options = column_families[l->second].options;
+		options.create_if_missing = false;
+		options.error_if_exists = false;
+		DBImpl* family = new DBImpl(options, ColumnFamilyDirName(dbname_,
+				it->first), this, it->first);
+		ColumnFamilyHandleImpl* handle = new ColumnFamilyHandleImpl(it->first,
+				it->second, family);
+		column_families_[it->first] = handle;
+		(*handles)[l->second] = handle;
+		edits->push_back(new VersionEdit);
+		Status s = family->Recover(edits->back());
+		if ( !s.ok() )
+		{
+			return s;
+		}
+	}
+
+	// Sequence numbers are shared by all the column families
+	SequenceNumber last_sequence = versions_->LastSequence();
+	std::map<uint32_t, ColumnFamilyHandleImpl*>::iterator it;
+	for (it = column_families_.begin(); it != column_families_.end(); ++it)
+	{
+		last_sequence = std::max(last_sequence,
+				it->second->db()->versions_->LastSequence());
+	}
+	versions_->SetLastSequence(last_sequence);
+	for (it = column_families_.begin(); it != column_families_.end(); ++it)
+	{
+		it->second->db()->versions_->SetLastSequence(last_sequence);
+	}
+
+	for (size_t i = 0; i < column_families.size(); i++)
+	{
+		if ( (*handles)[i] == NULL && !options_.create_if_missing )
+		{
+			return Status::InvalidArgument(column_families[i].name,
+					"column family does not exist (create_if_missing is false)");
+		}
+	}
+	return Status::OK();
+}
+
+Status DBImpl::AddColumnFamily(const Options& options, const std::string& name,
+		ColumnFamilyHandleImpl** handle)
+{
+	mutex_.AssertHeld();
+	*handle = NULL;
+	if ( name.empty() )
+	{
+		return Status::InvalidArgument("bad column family name", name);
+	}
+	const std::map<uint32_t, std::string>& existing =
+			versions_->column_families();
+	for (std::map<uint32_t, std::string>::const_iterator it = existing.begin(); it
+			!= existing.end(); ++it)
+	{
+		if ( it->second == name )
+		{
+			return Status::InvalidArgument(name, "column family exists");
+		}
+	}
+
+	// The family is complete before the descriptor of the DB names it
+	const uint32_t id = versions_->MaxColumnFamily() + 1;
+	const std::string dirname = ColumnFamilyDirName(dbname_, id);
+	Options family_options = options;
+	family_options.create_if_missing = true;
+	family_options.error_if_exists = true;
+	DBImpl* family = new DBImpl(family_options, dirname, this, id);
+	VersionEdit family_edit;
+	Status s = family->Recover(&family_edit);
+	if ( s.ok() )
+	{
+		family->versions_->MarkFileNumberUsed(logfile_number_);
+		family->versions_->SetLastSequence(versions_->LastSequence());
+		if ( family->imm_ == NULL )
+		{
+			family_edit.SetLogNumber(logfile_number_);
+		}
+		family->mem_log_number_ = logfile_number_;
+		s = family->versions_->LogAndApply(&family_edit, &mutex_);
+	}
+	if ( s.ok() )
+	{
+		VersionEdit edit;
+		edit.SetMaxColumnFamily(id);
+		edit.AddColumnFamily(id, name);
+		s = LogAndApplyInForeground(&edit);
+	}
+	if ( !s.ok() )
+	{
+		mutex_.Unlock(); // The family takes the mutex on deletion
+		delete family;
+		DestroyDB(dirname, family_options);
+		mutex_.Lock();
+		return s;
+	}
+
+	Log(options_.info_log, "Created column family %u \"%s\"", id,
+			name.c_str());
+	*handle = new ColumnFamilyHandleImpl(id, name, family);
+	column_families_[id] = *handle;
+	family->MaybeScheduleCompaction();
+	return s;
+}
+
+Status DBImpl::LogAndApplyInForeground(VersionEdit* edit)
+{
+	mutex_.AssertHeld();
+	while (bg_compaction_scheduled_)
+	{
+		bg_cv_.Wait();
+	}
+	bg_compaction_scheduled_ = true; // Keep compactions out meanwhile
+	Status s = versions_->LogAndApply(edit, &mutex_);
+	bg_compaction_scheduled_ = false;
+	bg_cv_.SignalAll();
+	MaybeScheduleCompaction();
+	return s;
+}
+
+Status DBImpl::CreateColumnFamily(const Options& options,
+		const std::string& name, ColumnFamilyHandle** handle)
+{
+	*handle = NULL;
+	if ( root_ != this )
+	{
+		return root_->CreateColumnFamily(options, name, handle);
+	}
+
+	Writer w(&mutex_);
+	w.batch = NULL;
+	w.sync = false;
+	w.done = false;
+
+	MutexLock l(&mutex_);
+	writers_.push_back(&w);
+	while (&w != writers_.front())
+	{
+		w.cv.Wait();
+	}
+	ColumnFamilyHandleImpl* impl;
+	Status s = AddColumnFamily(options, name, &impl);
+	*handle = impl;
+	writers_.pop_front();
+	if ( !writers_.empty() )
+	{
+		writers_.front()->cv.Signal();
+	}
+	return s;
+}
+
+Status DBImpl::DropColumnFamily(ColumnFamilyHandle* column_family)
+{
+	if ( column_family == NULL || column_family->GetID() == 0 )
+	{
+		return Status::InvalidArgument("cannot drop the default column family");
+	}
+	if ( root_ != this )
+	{
+		return root_->DropColumnFamily(column_family);
+	}
+
+	Writer w(&mutex_);
+	w.batch = NULL;
+	w.sync = false;
+	w.done = false;
+
+	MutexLock l(&mutex_);
+	writers_.push_back(&w);
+	while (&w != writers_.front())
+	{
+		w.cv.Wait();
+	}
+	const uint32_t id = column_family->GetID();
+	Status s;
+	if ( column_families_.count(id) == 0 )
+	{
+		s = Status::InvalidArgument("unknown column family",
+				column_family->GetName());
+	}
+	else
+	{
+		// Updates of the family left in the log are skipped from now on
+		VersionEdit edit;
+		edit.DropColumnFamily(id);
+		s = LogAndApplyInForeground(&edit);
+	}
+	ColumnFamilyHandleImpl* handle = NULL;
+	if ( s.ok() )
+	{
+		handle = column_families_[id];
+		column_families_.erase(id);
+		Log(options_.info_log, "Dropped column family %u \"%s\"", id,
+				handle->GetName().c_str());
+	}
+	writers_.pop_front();
+	if ( !writers_.empty() )
+	{
+		writers_.front()->cv.Signal();
+	}
+
+	if ( handle != NULL )
+	{
+		mutex_.Unlock(); // The family takes the mutex on deletion
+		Options options;
+		options.env = env_;
+		delete handle->db();
+		delete handle;
+		DestroyDB(ColumnFamilyDirName(dbname_, id), options);
+		mutex_.Lock();
+		DeleteObsoleteFiles();
+	}
+	return s;
+}
+
+DBImpl* DBImpl::ColumnFamily(ColumnFamilyHandle* column_family)
+{
+	if ( column_family == NULL )
+	{
+		return this;
+	}
+	return reinterpret_cast<ColumnFamilyHandleImpl*> (column_family)->db();
+}
+
+Status DBImpl::Put(const WriteOptions& options,
+		ColumnFamilyHandle* column_family, const Slice& key, const Slice& value)
+{
+	return DB::Put(options, column_family, key, value);
+}
+
+Status DBImpl::Delete(const WriteOptions& options,
+		ColumnFamilyHandle* column_family, const Slice& key)
+{
+	return DB::Delete(options, column_family, key);
+}
+
+Status DBImpl::Get(const ReadOptions& options,
+		ColumnFamilyHandle* column_family, const Slice& key, std::string* value)
+{
+	return ColumnFamily(column_family)->Get(options, key, value);
+}
+
+Status DBImpl::Get(const ReadOptions& options,
+		ColumnFamilyHandle* column_family, const Slice& key,
+		PinnableSlice* value)
+{
+	return ColumnFamily(column_family)->Get(options, key, value);
+}
+
+Iterator* DBImpl::NewIterator(const ReadOptions& options,
+		ColumnFamilyHandle* column_family)
+{
+	return ColumnFamily(column_family)->NewIterator(options);
+}
+
+bool DBImpl::GetProperty(ColumnFamilyHandle* column_family,
+		const Slice& property, std::string* value)
+{
+	return ColumnFamily(column_family)->GetProperty(property, value);
+}
+
+void DBImpl::CompactRange(ColumnFamilyHandle* column_family,
+		const Slice* begin, const Slice* end)
+{
+	ColumnFamily(column_family)->CompactRange(begin, end);
+}
+
 Snapshot::~Snapshot()
 {
 }
@@ -1712,7 +4062,9 @@ Status DestroyDB(const std::string& dbname, const Options& options)
 			if ( ParseFileName(filenames[i], &number, &type) && type
 					!= kDBLockFile )
 			{ // Lock file will be deleted at end
-				Status del = env->DeleteFile(dbname + "/" + filenames[i]);
+				Status del = (type == kColumnFamilyDir)
+						? DestroyDB(dbname + "/" + filenames[i], options)
+						: env->DeleteFile(dbname + "/" + filenames[i]);
 				if ( result.ok() && !del.ok() )
 				{
 					result = del;
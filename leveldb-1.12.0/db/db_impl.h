@@ -6,37 +6,56 @@
 #define STORAGE_LEVELDB_DB_DB_IMPL_H_
 
 #include <deque>
+#include <map>
 #include <set>
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/listener.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
 
 namespace leveldb
 {
 
+class BlobCache;
+class ColumnFamilyHandleImpl;
 class MemTable;
+class RangeDelAggregator;
 class TableCache;
 class Version;
 class VersionEdit;
 class VersionSet;
+struct FileMetaData;
 
 class DBImpl: public DB
 {
 	public:
-		DBImpl(const Options& options, const std::string& dbname);
+		// A DBImpl with a non-NULL "root" is the column family with id
+		// "column_family_id" of the DB "root": it keeps its tables under
+		// "dbname", and shares the mutex, the snapshots and the log of root.
+		DBImpl(const Options& options, const std::string& dbname,
+				DBImpl* root = NULL, uint32_t column_family_id = 0);
 		virtual ~DBImpl();
 
 		// Implementations of the DB interface
 		virtual Status Put(const WriteOptions&, const Slice& key,
 				const Slice& value);
 		virtual Status Delete(const WriteOptions&, const Slice& key);
+		virtual Status Merge(const WriteOptions&, const Slice& key,
+				const Slice& value);
+		virtual Status DeleteRange(const WriteOptions&, const Slice& begin_key,
+				const Slice& end_key);
+		virtual Status IngestExternalFile(const IngestOptions& options,
+				const std::string& fname);
 		virtual Status Write(const WriteOptions& options, WriteBatch* updates);
+		virtual Status FlushWAL(bool sync);
 		virtual Status Get(const ReadOptions& options, const Slice& key,
 				std::string* value);
+		virtual Status Get(const ReadOptions& options, const Slice& key,
+				PinnableSlice* value);
 		virtual Iterator* NewIterator(const ReadOptions&);
 		virtual const Snapshot* GetSnapshot();
 		virtual void ReleaseSnapshot(const Snapshot* snapshot);
@@ -44,6 +63,26 @@ class DBImpl: public DB
 		virtual void GetApproximateSizes(const Range* range, int n,
 				uint64_t* sizes);
 		virtual void CompactRange(const Slice* begin, const Slice* end);
+		virtual Status CreateColumnFamily(const Options& options,
+				const std::string& name, ColumnFamilyHandle** handle);
+		virtual Status DropColumnFamily(ColumnFamilyHandle* column_family);
+		virtual Status Put(const WriteOptions&,
+				ColumnFamilyHandle* column_family, const Slice& key,
+				const Slice& value);
+		virtual Status Delete(const WriteOptions&,
+				ColumnFamilyHandle* column_family, const Slice& key);
+		virtual Status Get(const ReadOptions& options,
+				ColumnFamilyHandle* column_family, const Slice& key,
+				std::string* value);
+		virtual Status Get(const ReadOptions& options,
+				ColumnFamilyHandle* column_family, const Slice& key,
+				PinnableSlice* value);
+		virtual Iterator* NewIterator(const ReadOptions& options,
+				ColumnFamilyHandle* column_family);
+		virtual bool GetProperty(ColumnFamilyHandle* column_family,
+				const Slice& property, std::string* value);
+		virtual void CompactRange(ColumnFamilyHandle* column_family,
+				const Slice* begin, const Slice* end);
 
 		// Extra methods (for testing) that are not in the public DB interface
 
@@ -53,6 +92,12 @@ class DBImpl: public DB
 		// Force current memtable contents to be compacted.
 		Status TEST_CompactMemTable();
 
+		// Return the DBImpl holding the column family (this for NULL).
+		DBImpl* TEST_ColumnFamily(ColumnFamilyHandle* column_family)
+		{
+			return ColumnFamily(column_family);
+		}
+
 		// Return an internal iterator over the current state of the database.
 		// The keys of this iterator are internal keys (see format.h).
 		// The returned iterator should be deleted when no longer needed.
@@ -67,8 +112,17 @@ class DBImpl: public DB
 		struct CompactionState;
 		struct Writer;
 
+		// Look "key" up.  If "pin" is true, a value read as is stays in the
+		// memtable or block holding it, pinned by *value; otherwise it is
+		// copied to value->GetSelf().
+		Status GetImpl(const ReadOptions& options, const Slice& key,
+				PinnableSlice* value, bool pin);
+
+		// If range_del is non-NULL, the range deletions of every source are
+		// added to it.
 		Iterator* NewInternalIterator(const ReadOptions&,
-				SequenceNumber* latest_snapshot);
+				SequenceNumber* latest_snapshot,
+				RangeDelAggregator* range_del);
 
 		Status NewDB();
 
@@ -79,6 +133,40 @@ class DBImpl: public DB
 
 		void MaybeIgnoreError(Status* s) const;
 
+		// With max_open_files == -1, open every live table now so that no
+		// read has to.
+		Status LoadTables();
+
+		// Open the column families of the DB just recovered, and create those
+		// of "column_families" it lacks.  Any changes to be made to the
+		// descriptors are added to *edits, one per family opened, which the
+		// caller deletes.
+		Status RecoverColumnFamilies(
+				const std::vector<ColumnFamilyDescriptor>& column_families,
+				std::vector<ColumnFamilyHandle*>* handles,
+				std::vector<VersionEdit*>* edits)
+		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// Create the column family "name" on top of the current log.
+		// REQUIRES: this thread is at the front of the writer queue, or
+		// the DB is being opened
+		Status AddColumnFamily(const Options& options, const std::string& name,
+				ColumnFamilyHandleImpl** handle)
+		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// Return the DBImpl holding the column family: this for NULL.
+		DBImpl* ColumnFamily(ColumnFamilyHandle* column_family);
+
+		// Apply *edit to the descriptor from a foreground thread.
+		// Background compactions are waited out and kept from starting
+		// meanwhile, since only one thread at a time may write it.
+		Status LogAndApplyInForeground(VersionEdit* edit)
+		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// Return the number of the oldest log that may hold updates of this
+		// DB, or of its column families, that are not in tables yet.
+		uint64_t OldestLiveLog() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
 		// Delete any unneeded files and stale in-memory entries.
 		void DeleteObsoleteFiles();
 
@@ -87,20 +175,67 @@ class DBImpl: public DB
 		Status CompactMemTable()
 		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-		Status RecoverLogFile(uint64_t log_number, VersionEdit* edit,
-				SequenceNumber* max_sequence)
+		// Replay a log into the memtable of *state.  The mutex is released
+		// meanwhile, for the memtables filled up are written to level-0 by
+		// a thread of their own while the replay goes on.
+		struct RecoveryState;
+		Status RecoverLogFile(uint64_t log_number, RecoveryState* state)
+		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		Status FlushRecoveredMemTable(RecoveryState* state)
 		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		static void BGRecoveryFlush(void* state);
 
+		// Describes the table written in *info, if info is non-NULL
 		Status
 				WriteLevel0Table(MemTable* mem, VersionEdit* edit,
-						Version* base)
+						Version* base, FlushJobInfo* info = NULL)
 		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+		// Call the Options::listeners.  The mutex is released meanwhile.
+		void NotifyOnFlushCompleted(const FlushJobInfo& info)
+		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		void NotifyOnCompaction(const CompactionJobInfo& info, bool completed)
+		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		// Record the write stall condition, telling the listeners if it
+		// changed.  Returns true if mutex_ was released to do so.
+		bool SetStallCondition(WriteStallCondition condition,
+				WriteStallCause cause) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+		// Write *my_batch, which may span the column families of this DB.
+		// A NULL batch compacts the memtable of "family" instead.
+		// REQUIRES: this is the root of "family"
+		Status WriteImpl(const WriteOptions& options, WriteBatch* my_batch,
+				DBImpl* family);
+
 		Status
 				MakeRoomForWrite(bool force /* compact even if there is room? */)
 		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		// Wait on bg_cv_ for a write stopped by compactions
+		void WaitForRoom() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		// MakeRoomForWrite() for this DB and all of its column families;
+		// the memtable of "force" (if non-NULL) is compacted in any case.
+		Status MakeRoomForWrites(DBImpl* force) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		// Once the memtables sharing a WriteBufferManager reach its budget,
+		// return this DB or the column family with the largest memtable to
+		// flush; else NULL.
+		DBImpl* MemTableToFlush() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		// Start a new log, which the memtables of the column families
+		// holding no updates start from at once.
+		Status SwitchLogFile() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 		WriteBatch* BuildBatchGroup(Writer** last_writer);
 
+		// With Options::background_wal_sync: have the sync thread sync the
+		// log past the record of "sequence".  Requested before the writer
+		// queue moves on, so that a SwitchLogFile() by the next group syncs
+		// the old log rather than close it with the record unsynced.
+		void RequestLogSync(SequenceNumber sequence)
+				EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+		// Wait for the sync requested past "sequence".
+		// REQUIRES: mutex_ is not held
+		Status WaitForLogSync(SequenceNumber sequence);
+		static void BGLogSync(void* db);
+		void LogSyncLoop();
+
 		void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 		static void BGWork(void* db);
 		void BackgroundCall();
@@ -110,12 +245,38 @@ class DBImpl: public DB
 		Status DoCompactionWork(CompactionState* compact)
 		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+		// Collect the range deletions of the compaction inputs, skip the
+		// parent files they hide entirely, and pick the tombstones the
+		// outputs must keep.
+		Status SetupCompactionRangeDels(CompactionState* compact);
 		Status OpenCompactionOutputFile(CompactionState* compact);
+		// Values of at least options_.min_blob_size bytes go to the
+		// compaction's blob file.
+		Status AddCompactionOutput(CompactionState* compact, const Slice& key,
+				const Slice& value, Iterator* input);
+		// Write out the merge operands held back in *compact.  If "resolve"
+		// is set they are first combined with *base (NULL if the key has no
+		// value), and *resolved tells whether that succeeded.
+		Status FlushCompactionMerge(CompactionState* compact, bool resolve,
+				const Slice* base, bool* resolved, Iterator* input);
+		// next_user_key is the first user key of the following output file,
+		// or NULL if this is the last one.
 		Status FinishCompactionOutputFile(CompactionState* compact,
-				Iterator* input);
+				Iterator* input, const Slice* next_user_key);
+		void AddRangeDelsToOutput(CompactionState* compact,
+				const Slice* next_user_key);
+		bool HasPendingRangeDels(CompactionState* compact);
 		Status InstallCompactionResults(CompactionState* compact)
 		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+		// Check the external table file #meta->number and fill in the rest
+		// of *meta, except for its sequence number.
+		Status ValidateExternalFile(FileMetaData* meta);
+		// Add the checked external file at the next sequence number.
+		// REQUIRES: this thread is at the front of the writer queue
+		Status InstallExternalFile(FileMetaData* meta)
+		EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
 		// Constant after construction
 		Env* const env_;
 		const InternalKeyComparator internal_comparator_;
@@ -128,11 +289,21 @@ class DBImpl: public DB
 		// table_cache_ provides its own synchronization
 		TableCache* table_cache_;
 
+		// blob_cache_ provides its own synchronization
+		BlobCache* blob_cache_;
+
 		// Lock over the persistent DB state.  Non-NULL iff successfully acquired.
 		FileLock* db_lock_;
 
+		// The DB this is a column family of, or this.  Column families take
+		// the mutex and the snapshots of their root, and write to its log.
+		DBImpl* const root_;
+		const uint32_t column_family_id_;
+		port::Mutex own_mutex_;
+		SnapshotList own_snapshots_;
+
 		// State below is protected by mutex_
-		port::Mutex mutex_;
+		port::Mutex& mutex_;
 		port::AtomicPointer shutting_down_;
 		port::CondVar bg_cv_; // Signalled when background work finishes
 		MemTable* mem_;
@@ -141,12 +312,35 @@ class DBImpl: public DB
 		WritableFile* logfile_;
 		uint64_t logfile_number_;
 		log::Writer* log_;
+		uint64_t mem_log_number_; // Oldest log holding updates of mem_
+
+		// Log sync thread (see Options::background_wal_sync).  Its state
+		// has a mutex of its own so that neither the thread nor the writers
+		// waiting for it contend for mutex_ with the other writers;
+		// logfile_ is changed holding both.  log_sync_cv_ is signalled when
+		// a sync is requested, and when one is done.
+		port::Mutex log_sync_mu_;
+		port::CondVar log_sync_cv_;
+		bool log_sync_thread_running_;
+		SequenceNumber log_sync_requested_; // Sync the log past this
+		SequenceNumber log_synced_; // The log is synced past this
+		bool log_syncing_; // The thread syncs logfile_ unlocked
+		Status log_sync_status_; // Once a sync fails, the later ones do
+
+		// Obsolete logs kept for reuse (see Options::recycle_log_file_num)
+		std::deque<uint64_t> log_recycle_files_;
+		// First log of this incarnation.  Older logs may have been written
+		// without log numbers in their records, so are never recycled.
+		uint64_t first_log_number_;
+
+		// Column families of this DB, by id (the root only)
+		std::map<uint32_t, ColumnFamilyHandleImpl*> column_families_;
 
 		// Queue of writers.
 		std::deque<Writer*> writers_;
 		WriteBatch* tmp_batch_;
 
-		SnapshotList snapshots_;
+		SnapshotList& snapshots_;
 
 		// Set of table files to protect from deletion because they are
 		// part of ongoing compactions.
@@ -171,6 +365,7 @@ class DBImpl: public DB
 		// Have we encountered a background error in paranoid mode?
 		Status bg_error_;
 		int consecutive_compaction_errors_;
+		WriteStallCondition stall_condition_;
 
 		// Per level compaction stats.  stats_[level] stores the stats for
 		// compactions that produced data for the specified "level".
@@ -204,6 +399,37 @@ class DBImpl: public DB
 		}
 };
 
+class ColumnFamilyHandleImpl: public ColumnFamilyHandle
+{
+	public:
+		ColumnFamilyHandleImpl(uint32_t id, const std::string& name,
+				DBImpl* db) :
+			id_(id), name_(name), db_(db)
+		{
+		}
+		virtual ~ColumnFamilyHandleImpl()
+		{
+		}
+
+		virtual const std::string& GetName() const
+		{
+			return name_;
+		}
+		virtual uint32_t GetID() const
+		{
+			return id_;
+		}
+		DBImpl* db() const
+		{
+			return db_;
+		}
+
+	private:
+		const uint32_t id_;
+		const std::string name_;
+		DBImpl* const db_;
+};
+
 // Sanitize db options.  The caller should delete result.info_log if
 // it is not equal to src.info_log.
 extern Options SanitizeOptions(const std::string& db,
@@ -6,11 +6,15 @@
 
 #include "db/filename.h"
 #include "db/dbformat.h"
+#include "db/merge_context.h"
+#include "db/range_del.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "port/port.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/perf_context_imp.h"
+#include "util/statistics_imp.h"
 
 namespace leveldb
 {
@@ -49,20 +53,40 @@ class DBIter: public Iterator
 		//     the exact entry that yields this->key(), this->value()
 		// (2) When moving backwards, the internal iterator is positioned
 		//     just before all entries whose user key == this->key().
+		// A key whose newest entry is a merge operand is the exception
+		// in the forward direction: its value has to be computed, so the
+		// internal iterator is left after the entries that were merged and
+		// this->key(), this->value() are held in saved_key_, saved_value_.
 		enum Direction
 		{
 			kForward, kReverse
 		};
 
 		DBIter(const std::string* dbname, Env* env, const Comparator* cmp,
-				Iterator* iter, SequenceNumber s) :
-			dbname_(dbname), env_(env), user_comparator_(cmp), iter_(iter),
-					sequence_(s), direction_(kForward), valid_(false)
+				const MergeOperator* merge_operator,
+				RangeDelAggregator* range_del, Iterator* iter, SequenceNumber s,
+				const Slice* lower_bound, const Slice* upper_bound,
+				Statistics* statistics) :
+			dbname_(dbname), env_(env), statistics_(statistics),
+					user_comparator_(cmp),
+					merge_operator_(merge_operator), range_del_(range_del),
+					iter_(iter), sequence_(s), has_lower_bound_(lower_bound
+							!= NULL), has_upper_bound_(upper_bound != NULL),
+					direction_(kForward), valid_(false), merged_(false)
 		{
+			if ( has_lower_bound_ )
+			{
+				lower_bound_ = lower_bound->ToString();
+			}
+			if ( has_upper_bound_ )
+			{
+				upper_bound_ = upper_bound->ToString();
+			}
 		}
 		virtual ~DBIter()
 		{
 			delete iter_;
+			delete range_del_;
 		}
 		virtual bool Valid() const
 		{
@@ -71,13 +95,14 @@ class DBIter: public Iterator
 		virtual Slice key() const
 		{
 			assert(valid_);
-			return (direction_ == kForward) ? ExtractUserKey(iter_->key())
-					: saved_key_;
+			return (direction_ == kForward && !merged_) ? ExtractUserKey(
+					iter_->key()) : saved_key_;
 		}
 		virtual Slice value() const
 		{
 			assert(valid_);
-			return (direction_ == kForward) ? iter_->value() : saved_value_;
+			return (direction_ == kForward && !merged_) ? iter_->value()
+					: saved_value_;
 		}
 		virtual Status status() const
 		{
@@ -100,8 +125,23 @@ class DBIter: public Iterator
 	private:
 		void FindNextUserEntry(bool skipping, std::string* skip);
 		void FindPrevUserEntry();
+		void MergeForward(const Slice& user_key);
 		bool ParseKey(ParsedInternalKey* key);
 
+		// Is iter_ at an entry whose user key is outside the bounds?
+		inline bool PastUpperBound() const
+		{
+			return has_upper_bound_ && iter_->key().size() >= 8
+					&& user_comparator_->Compare(ExtractUserKey(iter_->key()),
+							upper_bound_) >= 0;
+		}
+		inline bool BeforeLowerBound() const
+		{
+			return has_lower_bound_ && iter_->key().size() >= 8
+					&& user_comparator_->Compare(ExtractUserKey(iter_->key()),
+							lower_bound_) < 0;
+		}
+
 		inline void SaveKey(const Slice& k, std::string* dst)
 		{
 			dst->assign(k.data(), k.size());
@@ -122,15 +162,23 @@ class DBIter: public Iterator
 
 		const std::string* const dbname_;
 		Env* const env_;
+		Statistics* const statistics_;
 		const Comparator* const user_comparator_;
+		const MergeOperator* const merge_operator_;
+		RangeDelAggregator* const range_del_;
 		Iterator* const iter_;
 		SequenceNumber const sequence_;
+		const bool has_lower_bound_;
+		const bool has_upper_bound_;
+		std::string lower_bound_; // User keys; see ReadOptions
+		std::string upper_bound_;
 
 		Status status_;
 		std::string saved_key_; // == current key when direction_==kReverse
 		std::string saved_value_; // == current raw value when direction_==kReverse
 		Direction direction_;
 		bool valid_;
+		bool merged_; // Current entry is a merge result held in saved_*
 
 		// No copying allowed
 		DBIter(const DBIter&);
@@ -146,6 +194,11 @@ inline bool DBIter::ParseKey(ParsedInternalKey* ikey)
 	}
 	else
 	{
+		if ( range_del_ != NULL && range_del_->ShouldDelete(*ikey) )
+		{
+			// Hidden by a range deletion: behaves as a deletion marker
+			ikey->type = kTypeDeletion;
+		}
 		return true;
 	}
 }
@@ -160,7 +213,17 @@ void DBIter::Next()
 		// iter_ is pointing just before the entries for this->key(),
 		// so advance into the range of entries for this->key() and then
 		// use the normal skipping code below.
-		if ( !iter_->Valid() )
+		if ( has_lower_bound_ )
+		{
+			// Sources of iter_ may have stopped short of their entries
+			// below the bound, leaving iter_ before some of them: find
+			// the entries for this->key() again
+			std::string target;
+			AppendInternalKey(&target, ParsedInternalKey(saved_key_,
+					kMaxSequenceNumber, kValueTypeForSeek));
+			iter_->Seek(target);
+		}
+		else if ( !iter_->Valid() )
 		{
 			iter_->SeekToFirst();
 		}
@@ -175,10 +238,33 @@ void DBIter::Next()
 			return;
 		}
 	}
+	else if ( merged_ )
+	{
+		// iter_ is already past the merged entries and saved_key_ holds
+		// this->key(), which is exactly the key to skip.
+		merged_ = false;
+		ClearSavedValue();
+		if ( !iter_->Valid() )
+		{
+			valid_ = false;
+			saved_key_.clear();
+			return;
+		}
+		FindNextUserEntry(true, &saved_key_);
+		return;
+	}
 
-	// Temporarily use saved_key_ as storage for key to skip.
+	// Temporarily use saved_key_ as storage for key to skip.  Step off the
+	// current entry first so that it is not counted as skipped.
 	std::string* skip = &saved_key_;
 	SaveKey(ExtractUserKey(iter_->key()), skip);
+	iter_->Next();
+	if ( !iter_->Valid() )
+	{
+		valid_ = false;
+		saved_key_.clear();
+		return;
+	}
 	FindNextUserEntry(true, skip);
 }
 
@@ -189,6 +275,11 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip)
 	assert(direction_ == kForward);
 	do
 	{
+		if ( PastUpperBound() )
+		{
+			// Stop here rather than skip whatever lies beyond the bound
+			break;
+		}
 		ParsedInternalKey ikey;
 		if ( ParseKey(&ikey) && ikey.sequence <= sequence_ )
 		{
@@ -199,12 +290,14 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip)
 				// they are hidden by this deletion.
 				SaveKey(ikey.user_key, skip);
 				skipping = true;
+				PERF_COUNTER_ADD(internal_delete_skipped_count, 1);
 				break;
 			case kTypeValue:
 				if ( skipping
 						&& user_comparator_->Compare(ikey.user_key, *skip) <= 0 )
 				{
 					// Entry hidden
+					PERF_COUNTER_ADD(internal_key_skipped_count, 1);
 				}
 				else
 				{
@@ -213,6 +306,26 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip)
 					return;
 				}
 				break;
+			case kTypeMerge:
+				if ( skipping
+						&& user_comparator_->Compare(ikey.user_key, *skip) <= 0 )
+				{
+					// Entry hidden
+					PERF_COUNTER_ADD(internal_key_skipped_count, 1);
+				}
+				else
+				{
+					MergeForward(ikey.user_key);
+					return;
+				}
+				break;
+			case kTypeRangeDeletion:
+			case kTypeBlobIndex:
+				// Not met here: range deletions are kept apart from the
+				// entries of iter_ and applied through range_del_, and
+				// blob indexes are handed out as kTypeValue by
+				// NewBlobResolvingIterator()
+				break;
 			}
 		}
 		iter_->Next();
@@ -229,8 +342,20 @@ void DBIter::Prev()
 	{ // Switch directions?
 		// iter_ is pointing at the current entry.  Scan backwards until
 		// the key changes so we can use the normal reverse scanning code.
-		assert(iter_->Valid()); // Otherwise valid_ would have been false
-		SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+		if ( merged_ )
+		{
+			// iter_ is past the current entry and saved_key_ holds its key
+			merged_ = false;
+			if ( !iter_->Valid() )
+			{
+				iter_->SeekToLast();
+			}
+		}
+		else
+		{
+			assert(iter_->Valid()); // Otherwise valid_ would have been false
+			SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+		}
 		while (true)
 		{
 			iter_->Prev();
@@ -258,10 +383,16 @@ void DBIter::FindPrevUserEntry()
 	assert(direction_ == kReverse);
 
 	ValueType value_type = kTypeDeletion;
+	MergeContext merge(merge_operator_);
+	bool has_base = false; // saved_value_ holds a value the operands apply to
 	if ( iter_->Valid() )
 	{
 		do
 		{
+			if ( BeforeLowerBound() )
+			{
+				break;
+			}
 			ParsedInternalKey ikey;
 			if ( ParseKey(&ikey) && ikey.sequence <= sequence_ )
 			{
@@ -277,6 +408,13 @@ void DBIter::FindPrevUserEntry()
 				{
 					saved_key_.clear();
 					ClearSavedValue();
+					merge.Clear();
+					has_base = false;
+				}
+				else if ( value_type == kTypeMerge )
+				{
+					SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+					merge.AddNewer(iter_->value());
 				}
 				else
 				{
@@ -288,32 +426,111 @@ void DBIter::FindPrevUserEntry()
 					}
 					SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
 					saved_value_.assign(raw_value.data(), raw_value.size());
+					merge.Clear();
+					has_base = true;
 				}
 			}
 			iter_->Prev();
 		} while (iter_->Valid());
 	}
 
-	if ( value_type == kTypeDeletion )
+	if ( value_type == kTypeDeletion || !iter_->status().ok() )
 	{
-		// End
+		// End, or the value could not be read (a blob, see
+		// NewBlobResolvingIterator()) and status() says why
 		valid_ = false;
 		saved_key_.clear();
 		ClearSavedValue();
 		direction_ = kForward;
 	}
+	else if ( !merge.empty() )
+	{
+		Slice base(saved_value_);
+		Status s = merge.Finish(saved_key_, has_base ? &base : NULL,
+				&saved_value_);
+		if ( !s.ok() )
+		{
+			status_ = s;
+		}
+		valid_ = s.ok();
+	}
 	else
 	{
 		valid_ = true;
 	}
 }
 
+// iter_ is at a visible merge operand for user_key, the newest entry for
+// it.  Collect the operands below it up to the first value or deletion,
+// leave iter_ just after the entries consumed and make the merge result
+// the current entry.
+void DBIter::MergeForward(const Slice& user_key)
+{
+	SaveKey(user_key, &saved_key_);
+	MergeContext merge(merge_operator_);
+	merge.AddOlder(iter_->value());
+	Status s;
+	bool done = false;
+	for (iter_->Next(); iter_->Valid() && !done; iter_->Next())
+	{
+		ParsedInternalKey ikey;
+		if ( !ParseKey(&ikey) )
+		{
+			continue;
+		}
+		if ( user_comparator_->Compare(ikey.user_key, saved_key_) != 0 )
+		{
+			break;
+		}
+		switch (ikey.type)
+		{
+		case kTypeMerge:
+			merge.AddOlder(iter_->value());
+			break;
+		case kTypeValue:
+		{
+			// Merge before moving on: the value is only valid until Next()
+			Slice base = iter_->value();
+			s = iter_->status(); // The value may be a blob not read
+			if ( s.ok() )
+			{
+				s = merge.Finish(saved_key_, &base, &saved_value_);
+			}
+			done = true;
+			break;
+		}
+		case kTypeDeletion:
+			s = merge.Finish(saved_key_, NULL, &saved_value_);
+			done = true;
+			break;
+		case kTypeRangeDeletion:
+		case kTypeBlobIndex:
+			// Not met here, see FindNextUserEntry()
+			break;
+		}
+	}
+	if ( !done )
+	{
+		s = merge.Finish(saved_key_, NULL, &saved_value_);
+	}
+	if ( !s.ok() )
+	{
+		status_ = s;
+	}
+	merged_ = s.ok();
+	valid_ = merged_;
+}
+
 void DBIter::Seek(const Slice& target)
 {
+	StopWatch sw(env_, statistics_, kDBSeek);
 	direction_ = kForward;
+	merged_ = false;
 	ClearSavedValue();
 	saved_key_.clear();
-	AppendInternalKey(&saved_key_, ParsedInternalKey(target, sequence_,
+	AppendInternalKey(&saved_key_, ParsedInternalKey(
+			(has_lower_bound_ && user_comparator_->Compare(target, lower_bound_)
+					< 0) ? Slice(lower_bound_) : target, sequence_,
 			kValueTypeForSeek));
 	iter_->Seek(saved_key_);
 	if ( iter_->Valid() )
@@ -329,8 +546,19 @@ void DBIter::Seek(const Slice& target)
 void DBIter::SeekToFirst()
 {
 	direction_ = kForward;
+	merged_ = false;
 	ClearSavedValue();
-	iter_->SeekToFirst();
+	if ( has_lower_bound_ )
+	{
+		std::string first;
+		AppendInternalKey(&first, ParsedInternalKey(lower_bound_,
+				kMaxSequenceNumber, kValueTypeForSeek));
+		iter_->Seek(first);
+	}
+	else
+	{
+		iter_->SeekToFirst();
+	}
 	if ( iter_->Valid() )
 	{
 		FindNextUserEntry(false, &saved_key_ /* temporary storage */);
@@ -344,18 +572,43 @@ void DBIter::SeekToFirst()
 void DBIter::SeekToLast()
 {
 	direction_ = kReverse;
+	merged_ = false;
 	ClearSavedValue();
-	iter_->SeekToLast();
+	if ( has_upper_bound_ )
+	{
+		// Step back from the first entry at or past the bound
+		std::string last;
+		AppendInternalKey(&last, ParsedInternalKey(upper_bound_,
+				kMaxSequenceNumber, kValueTypeForSeek));
+		iter_->Seek(last);
+		if ( iter_->Valid() )
+		{
+			iter_->Prev();
+		}
+		else
+		{
+			iter_->SeekToLast();
+		}
+	}
+	else
+	{
+		iter_->SeekToLast();
+	}
 	FindPrevUserEntry();
 }
 
 } // anonymous namespace
 
 Iterator* NewDBIterator(const std::string* dbname, Env* env,
-		const Comparator* user_key_comparator, Iterator* internal_iter,
-		const SequenceNumber& sequence)
+		const Comparator* user_key_comparator,
+		const MergeOperator* merge_operator, RangeDelAggregator* range_del,
+		Iterator* internal_iter, const SequenceNumber& sequence,
+		const Slice* lower_bound, const Slice* upper_bound,
+		Statistics* statistics)
 {
-	return new DBIter(dbname, env, user_key_comparator, internal_iter, sequence);
+	return new DBIter(dbname, env, user_key_comparator, merge_operator,
+			range_del, internal_iter, sequence, lower_bound, upper_bound,
+			statistics);
 }
 
 } // namespace leveldb
@@ -12,12 +12,25 @@
 namespace leveldb
 {
 
+class MergeOperator;
+class RangeDelAggregator;
+class Statistics;
+
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys.  Merge operands are combined with
+// "merge_operator" (which may be NULL if the DB holds none).  Entries
+// hidden by a tombstone in "*range_del" (finished at "sequence") are
+// skipped like deleted ones; range_del may be NULL, and is owned by the
+// returned iterator otherwise.  The iterator stays within the user keys
+// "*lower_bound" (inclusive) and "*upper_bound" (exclusive) if they are
+// non-NULL.  Seeks are timed into "*statistics" if it is non-NULL.
 extern Iterator* NewDBIterator(const std::string* dbname, Env* env,
-		const Comparator* user_key_comparator, Iterator* internal_iter,
-		const SequenceNumber& sequence);
+		const Comparator* user_key_comparator,
+		const MergeOperator* merge_operator, RangeDelAggregator* range_del,
+		Iterator* internal_iter, const SequenceNumber& sequence,
+		const Slice* lower_bound = NULL, const Slice* upper_bound = NULL,
+		Statistics* statistics = NULL);
 
 } // namespace leveldb
 
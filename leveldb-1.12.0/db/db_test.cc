@@ -3,14 +3,21 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "leveldb/db.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/merge_operator.h"
 #include "db/db_impl.h"
 #include "db/filename.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
+#include "leveldb/listener.h"
+#include "leveldb/perf_context.h"
+#include "leveldb/statistics.h"
 #include "leveldb/table.h"
+#include "leveldb/table_builder.h"
+#include "leveldb/write_buffer_manager.h"
 #include "util/hash.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -75,6 +82,10 @@ class SpecialEnv : public EnvWrapper {
   bool count_random_reads_;
   AtomicCounter random_read_counter_;
 
+  // Return random reads in the caller's buffer, as from a file that is
+  // not mmapped, so that the blocks read are cachable
+  bool copy_random_reads_;
+
   AtomicCounter sleep_counter_;
   AtomicCounter sleep_time_counter_;
 
@@ -83,6 +94,7 @@ class SpecialEnv : public EnvWrapper {
     no_space_.Release_Store(NULL);
     non_writable_.Release_Store(NULL);
     count_random_reads_ = false;
+    copy_random_reads_ = false;
     manifest_sync_error_.Release_Store(NULL);
     manifest_write_error_.Release_Store(NULL);
   }
@@ -161,21 +173,28 @@ class SpecialEnv : public EnvWrapper {
      private:
       RandomAccessFile* target_;
       AtomicCounter* counter_;
+      bool copy_;
      public:
-      CountingFile(RandomAccessFile* target, AtomicCounter* counter)
-          : target_(target), counter_(counter) {
+      CountingFile(RandomAccessFile* target, AtomicCounter* counter,
+                   bool copy)
+          : target_(target), counter_(counter), copy_(copy) {
       }
       virtual ~CountingFile() { delete target_; }
       virtual Status Read(uint64_t offset, size_t n, Slice* result,
                           char* scratch) const {
         counter_->Increment();
-        return target_->Read(offset, n, result, scratch);
+        Status s = target_->Read(offset, n, result, scratch);
+        if (s.ok() && copy_ && result->data() != scratch) {
+          memcpy(scratch, result->data(), result->size());
+          *result = Slice(scratch, result->size());
+        }
+        return s;
       }
     };
 
     Status s = target()->NewRandomAccessFile(f, r);
-    if (s.ok() && count_random_reads_) {
-      *r = new CountingFile(*r, &random_read_counter_);
+    if (s.ok() && (count_random_reads_ || copy_random_reads_)) {
+      *r = new CountingFile(*r, &random_read_counter_, copy_random_reads_);
     }
     return s;
   }
@@ -190,12 +209,16 @@ class SpecialEnv : public EnvWrapper {
 class DBTest {
  private:
   const FilterPolicy* filter_policy_;
+  Cache* row_cache_;
 
   // Sequence of option configurations to try
   enum OptionConfig {
     kDefault,
     kFilter,
     kUncompressed,
+    kBlobs,
+    kHashIndex,
+    kRowCache,
     kEnd
   };
   int option_config_;
@@ -210,6 +233,7 @@ class DBTest {
   DBTest() : option_config_(kDefault),
              env_(new SpecialEnv(Env::Default())) {
     filter_policy_ = NewBloomFilterPolicy(10);
+    row_cache_ = NewLRUCache(1 << 20);
     dbname_ = test::TmpDir() + "/db_test";
     DestroyDB(dbname_, Options());
     db_ = NULL;
@@ -221,6 +245,7 @@ class DBTest {
     DestroyDB(dbname_, Options());
     delete env_;
     delete filter_policy_;
+    delete row_cache_;
   }
 
   // Switch to a fresh database with the next option configuration to
@@ -245,12 +270,26 @@ class DBTest {
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kBlobs:
+        options.min_blob_size = 1;
+        break;
+      case kHashIndex:
+        options.data_block_hash_index = true;
+        break;
+      case kRowCache:
+        options.row_cache = row_cache_;
+        break;
       default:
         break;
     }
     return options;
   }
 
+  // Whether the current configuration keeps values out of the tables
+  bool ValuesInBlobs() {
+    return CurrentOptions().min_blob_size > 0;
+  }
+
   DBImpl* dbfull() {
     return reinterpret_cast<DBImpl*>(db_);
   }
@@ -294,6 +333,27 @@ class DBTest {
     return db_->Delete(WriteOptions(), k);
   }
 
+  // Build a table of the user keys in data at fname, as a bulk loader would
+  Status BuildExternalFile(const std::string& fname,
+                           const std::map<std::string, std::string>& data) {
+    WritableFile* file;
+    Status s = env_->NewWritableFile(fname, &file);
+    if (!s.ok()) {
+      return s;
+    }
+    TableBuilder builder(CurrentOptions(), file);
+    for (std::map<std::string, std::string>::const_iterator it = data.begin();
+         it != data.end(); ++it) {
+      builder.Add(it->first, it->second);
+    }
+    s = builder.Finish();
+    if (s.ok()) {
+      s = file->Close();
+    }
+    delete file;
+    return s;
+  }
+
   std::string Get(const std::string& k, const Snapshot* snapshot = NULL) {
     ReadOptions options;
     options.snapshot = snapshot;
@@ -363,6 +423,14 @@ class DBTest {
             case kTypeDeletion:
               result += "DEL";
               break;
+            case kTypeMerge:
+              result += "MERGE(" + iter->value().ToString() + ")";
+              break;
+            case kTypeRangeDeletion:
+            case kTypeBlobIndex:
+              // Kept apart, and resolved, by the internal iterator
+              result += "UNEXPECTED";
+              break;
           }
         }
         iter->Next();
@@ -415,6 +483,65 @@ class DBTest {
     return static_cast<int>(files.size());
   }
 
+  int CountBlobFiles(uint64_t* bytes = NULL) {
+    std::vector<std::string> files;
+    env_->GetChildren(dbname_, &files);
+    int count = 0;
+    uint64_t number, size;
+    FileType type;
+    if (bytes != NULL) *bytes = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+      if (ParseFileName(files[i], &number, &type) && type == kBlobFile) {
+        count++;
+        if (bytes != NULL &&
+            env_->GetFileSize(dbname_ + "/" + files[i], &size).ok()) {
+          *bytes += size;
+        }
+      }
+    }
+    return count;
+  }
+
+  int CountLogFiles() {
+    std::vector<std::string> files;
+    env_->GetChildren(dbname_, &files);
+    int count = 0;
+    uint64_t number;
+    FileType type;
+    for (size_t i = 0; i < files.size(); i++) {
+      if (ParseFileName(files[i], &number, &type) && type == kLogFile) {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  // Reopen along with the column families "names"
+  Status TryReopenWithColumnFamilies(const std::vector<std::string>& names,
+                                     std::vector<ColumnFamilyHandle*>* handles) {
+    delete db_;
+    db_ = NULL;
+    Options opts = CurrentOptions();
+    opts.create_if_missing = true;
+    last_options_ = opts;
+    std::vector<ColumnFamilyDescriptor> column_families;
+    for (size_t i = 0; i < names.size(); i++) {
+      column_families.push_back(ColumnFamilyDescriptor(names[i], opts));
+    }
+    return DB::Open(opts, dbname_, column_families, handles, &db_);
+  }
+
+  std::string Get(ColumnFamilyHandle* column_family, const std::string& k) {
+    std::string result;
+    Status s = db_->Get(ReadOptions(), column_family, k, &result);
+    if (s.IsNotFound()) {
+      result = "NOT_FOUND";
+    } else if (!s.ok()) {
+      result = s.ToString();
+    }
+    return result;
+  }
+
   uint64_t Size(const Slice& start, const Slice& limit) {
     Range r(start, limit);
     uint64_t size;
@@ -541,6 +668,31 @@ TEST(DBTest, GetFromVersions) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, GetPinnable) {
+  do {
+    ASSERT_OK(Put("foo", "v1"));
+    PinnableSlice value;
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &value));
+    ASSERT_TRUE(value.IsPinned());
+    ASSERT_EQ("v1", value.ToString());
+
+    // The pinned memtable outlives its compaction
+    ASSERT_OK(Put("foo", "v2"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("v1", value.ToString());
+
+    // Values in blob files are copied
+    ASSERT_OK(db_->Get(ReadOptions(), "foo", &value));
+    ASSERT_EQ(!ValuesInBlobs(), value.IsPinned());
+    ASSERT_EQ("v2", value.ToString());
+    dbfull()->TEST_CompactRange(0, NULL, NULL);
+    ASSERT_EQ("v2", value.ToString());
+
+    ASSERT_TRUE(db_->Get(ReadOptions(), "bar", &value).IsNotFound());
+    ASSERT_TRUE(!value.IsPinned());
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, GetSnapshot) {
   do {
     // Try with both a short key and a long key
@@ -831,6 +983,54 @@ TEST(DBTest, IterMultiWithDelete) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, IterBounds) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("b", "vb"));
+    ASSERT_OK(Put("c", "vc"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(Put("d", "vd"));
+    ASSERT_OK(Put("e", "ve"));
+    ASSERT_OK(Delete("c"));
+
+    Slice lower("b");
+    Slice upper("d");
+    ReadOptions options;
+    options.iterate_lower_bound = &lower;
+    options.iterate_upper_bound = &upper;
+    Iterator* iter = db_->NewIterator(options);
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    iter->Seek("a");
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Seek("d");
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    delete iter;
+
+    // The bounds are copied
+    options.iterate_lower_bound = NULL;
+    std::string bound = "e";
+    upper = bound;
+    iter = db_->NewIterator(options);
+    bound = "a";
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "a->va");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    delete iter;
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, Recover) {
   do {
     ASSERT_OK(Put("foo", "v1"));
@@ -943,6 +1143,41 @@ TEST(DBTest, RecoverWithLargeLog) {
   ASSERT_GT(NumTableFilesAtLevel(0), 1);
 }
 
+TEST(DBTest, RecoverManyMemTables) {
+  // One large log, replayed into many memtables written in the background
+  Options options = CurrentOptions();
+  options.write_buffer_size = 10000000;
+  Reopen(&options);
+  for (int i = 0; i < 3000; i++) {
+    ASSERT_OK(Put(Key(i % 100), Key(i) + std::string(100, 'v')));
+  }
+  ASSERT_EQ(TotalTableFiles(), 0);
+
+  options.write_buffer_size = 10000;
+  Reopen(&options);
+  ASSERT_GT(TotalTableFiles(), 2);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(Key(2900 + i) + std::string(100, 'v'), Get(Key(i)));
+  }
+
+  // A memtable starting with a log is written once the DB is open, and
+  // its log is kept until then
+  ASSERT_OK(Put("foo", "v1"));
+  options.avoid_flush_during_recovery = true;
+  env_->delay_sstable_sync_.Release_Store(env_);
+  Reopen(&options);
+  ASSERT_EQ("v1", Get("foo"));
+  ASSERT_EQ(2, CountLogFiles());
+  env_->delay_sstable_sync_.Release_Store(NULL);
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(1, CountLogFiles());
+  Reopen(&options);
+  ASSERT_EQ("v1", Get("foo"));
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(Key(2900 + i) + std::string(100, 'v'), Get(Key(i)));
+  }
+}
+
 TEST(DBTest, CompactionsGenerateMultipleFiles) {
   Options options = CurrentOptions();
   options.write_buffer_size = 100000000;        // Large write buffer
@@ -1041,6 +1276,9 @@ static bool Between(uint64_t val, uint64_t low, uint64_t high) {
 
 TEST(DBTest, ApproximateSizes) {
   do {
+    if (ValuesInBlobs()) {
+      continue;  // Sizes do not count the values kept in blob files
+    }
     Options options = CurrentOptions();
     options.write_buffer_size = 100000000;        // Large write buffer
     options.compression = kNoCompression;
@@ -1091,6 +1329,9 @@ TEST(DBTest, ApproximateSizes) {
 
 TEST(DBTest, ApproximateSizes_MixOfSmallAndLarge) {
   do {
+    if (ValuesInBlobs()) {
+      continue;  // Sizes do not count the values kept in blob files
+    }
     Options options = CurrentOptions();
     options.compression = kNoCompression;
     Reopen();
@@ -1182,6 +1423,10 @@ TEST(DBTest, HiddenValuesAreRemoved) {
   do {
     Random rnd(301);
     FillLevels("a", "z");
+    // Compact the level-0 files FillLevels left behind now, so that a
+    // background compaction cannot pick up the table flushed below while
+    // the snapshot still protects "big".
+    dbfull()->TEST_CompactRange(0, NULL, NULL);
 
     std::string big = RandomString(&rnd, 50000);
     Put("foo", big);
@@ -1194,7 +1439,9 @@ TEST(DBTest, HiddenValuesAreRemoved) {
     ASSERT_GT(NumTableFilesAtLevel(0), 0);
 
     ASSERT_EQ(big, Get("foo", snapshot));
-    ASSERT_TRUE(Between(Size("", "pastfoo"), 50000, 60000));
+    if (!ValuesInBlobs()) {
+      ASSERT_TRUE(Between(Size("", "pastfoo"), 50000, 60000));
+    }
     db_->ReleaseSnapshot(snapshot);
     ASSERT_EQ(AllEntriesFor("foo"), "[ tiny, " + big + " ]");
     Slice x("x");
@@ -1264,126 +1511,961 @@ TEST(DBTest, DeletionMarkers2) {
   ASSERT_EQ(AllEntriesFor("foo"), "[ ]");
 }
 
-TEST(DBTest, OverlapInLevel0) {
-  do {
-    ASSERT_EQ(config::kMaxMemCompactLevel, 2) << "Fix test to match config";
+TEST(DBTest, DeletionCompaction) {
+  Options options = CurrentOptions();
+  options.deletion_compaction_ratio = 0.5;
+  Reopen(&options);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), "v"));
+  }
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  const int last = config::kMaxMemCompactLevel;
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);
 
-    // Fill levels 1 and 2 to disable the pushing of new memtables to levels > 0.
-    ASSERT_OK(Put("100", "v100"));
-    ASSERT_OK(Put("999", "v999"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_OK(Delete("100"));
-    ASSERT_OK(Delete("999"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_EQ("0,1,1", FilesPerLevel());
+  // A table of deletion markers, landing right above the values, is
+  // compacted without any level being too large
+  for (int i = 0; i < 60; i++) {
+    ASSERT_OK(Delete(Key(i)));
+  }
+  ASSERT_OK(Put(Key(60), "v2"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  for (int i = 0; i < 1000 && NumTableFilesAtLevel(last - 1) != 0; i++) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ(AllEntriesFor(Key(0)), "[ ]");
+  ASSERT_EQ(AllEntriesFor(Key(60)), "[ v2 ]");
+  ASSERT_EQ("v", Get(Key(99)));
+}
 
-    // Make files spanning the following ranges in level-0:
-    //  files[0]  200 .. 900
-    //  files[1]  300 .. 500
-    // Note that files are sorted by smallest key.
-    ASSERT_OK(Put("300", "v300"));
-    ASSERT_OK(Put("500", "v500"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_OK(Put("200", "v200"));
-    ASSERT_OK(Put("600", "v600"));
-    ASSERT_OK(Put("900", "v900"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_EQ("2,1,1", FilesPerLevel());
+namespace {
+// Drops entries whose value is "expired" and rewrites "stale" to "fresh".
+class TestCompactionFilter : public CompactionFilter {
+ public:
+  virtual const char* Name() const { return "TestCompactionFilter"; }
+  virtual bool Filter(int level, const Slice& key, const Slice& existing_value,
+                      std::string* new_value, bool* value_changed) const {
+    if (existing_value == Slice("expired")) {
+      return true;
+    }
+    if (existing_value == Slice("stale")) {
+      new_value->assign("fresh");
+      *value_changed = true;
+    }
+    return false;
+  }
+};
+}
 
-    // Compact away the placeholder files we created initially
-    dbfull()->TEST_CompactRange(1, NULL, NULL);
-    dbfull()->TEST_CompactRange(2, NULL, NULL);
-    ASSERT_EQ("2", FilesPerLevel());
+TEST(DBTest, CompactionFilter) {
+  TestCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.compaction_filter = &filter;
+  Reopen(&options);
 
-    // Do a memtable compaction.  Before bug-fix, the compaction would
-    // not detect the overlap with level-0 files and would incorrectly place
-    // the deletion in a deeper level.
-    ASSERT_OK(Delete("600"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_EQ("3", FilesPerLevel());
-    ASSERT_EQ("NOT_FOUND", Get("600"));
-  } while (ChangeOptions());
-}
+  Put("a", "expired");
+  Put("b", "stale");
+  Put("c", "keep");
+  Put("d", "expired");
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  // Entries visible to a live snapshot are left alone
+  ASSERT_EQ("expired", Get("a"));
+  ASSERT_EQ("expired", Get("d", snapshot));
+  db_->ReleaseSnapshot(snapshot);
 
-TEST(DBTest, L0_CompactionBug_Issue44_a) {
-  Reopen();
-  ASSERT_OK(Put("b", "v"));
-  Reopen();
-  ASSERT_OK(Delete("b"));
-  ASSERT_OK(Delete("a"));
-  Reopen();
-  ASSERT_OK(Delete("a"));
-  Reopen();
-  ASSERT_OK(Put("a", "v"));
-  Reopen();
-  Reopen();
-  ASSERT_EQ("(a->v)", Contents());
-  DelayMilliseconds(1000);  // Wait for compaction to finish
-  ASSERT_EQ("(a->v)", Contents());
+  Put("d", "expired");
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ("NOT_FOUND", Get("a"));
+  ASSERT_EQ(AllEntriesFor("a"), "[ ]");
+  ASSERT_EQ("fresh", Get("b"));
+  ASSERT_EQ("keep", Get("c"));
+  ASSERT_EQ("NOT_FOUND", Get("d"));
+  ASSERT_EQ(AllEntriesFor("d"), "[ ]");
 }
 
-TEST(DBTest, L0_CompactionBug_Issue44_b) {
-  Reopen();
-  Put("","");
-  Reopen();
-  Delete("e");
-  Put("","");
-  Reopen();
-  Put("c", "cv");
-  Reopen();
-  Put("","");
-  Reopen();
-  Put("","");
-  DelayMilliseconds(1000);  // Wait for compaction to finish
-  Reopen();
-  Put("d","dv");
-  Reopen();
-  Put("","");
-  Reopen();
-  Delete("d");
-  Delete("b");
-  Reopen();
-  ASSERT_EQ("(->)(c->cv)", Contents());
-  DelayMilliseconds(1000);  // Wait for compaction to finish
-  ASSERT_EQ("(->)(c->cv)", Contents());
+TEST(DBTest, CompactionFilterHidesOlderVersions) {
+  TestCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.compaction_filter = &filter;
+  Reopen(&options);
+
+  Put("foo", "v1");
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  const int last = config::kMaxMemCompactLevel;
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);   // foo => v1 is now in last level
+
+  // Place a table at level last-1 to prevent merging with preceding mutation
+  Put("a", "begin");
+  Put("z", "end");
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);
+  ASSERT_EQ(NumTableFilesAtLevel(last-1), 1);
+
+  Put("foo", "expired");
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());  // Moves to level last-2
+  ASSERT_EQ(AllEntriesFor("foo"), "[ expired, v1 ]");
+  dbfull()->TEST_CompactRange(last-2, NULL, NULL);
+  // Filtered entry turns into a DEL since "last" file overlaps
+  ASSERT_EQ(AllEntriesFor("foo"), "[ DEL, v1 ]");
+  ASSERT_EQ("NOT_FOUND", Get("foo"));
+  dbfull()->TEST_CompactRange(last-1, NULL, NULL);
+  ASSERT_EQ(AllEntriesFor("foo"), "[ ]");
 }
 
-TEST(DBTest, ComparatorCheck) {
-  class NewComparator : public Comparator {
-   public:
-    virtual const char* Name() const { return "leveldb.NewComparator"; }
-    virtual int Compare(const Slice& a, const Slice& b) const {
-      return BytewiseComparator()->Compare(a, b);
-    }
-    virtual void FindShortestSeparator(std::string* s, const Slice& l) const {
-      BytewiseComparator()->FindShortestSeparator(s, l);
+namespace {
+// Appends operands to the existing value, separated by commas.
+class AppendOperator : public MergeOperator {
+ public:
+  virtual const char* Name() const { return "AppendOperator"; }
+  virtual bool Merge(const Slice& key, const Slice* existing_value,
+                     const Slice* operands, int n,
+                     std::string* new_value) const {
+    new_value->clear();
+    if (existing_value != NULL) {
+      new_value->assign(existing_value->data(), existing_value->size());
     }
-    virtual void FindShortSuccessor(std::string* key) const {
-      BytewiseComparator()->FindShortSuccessor(key);
+    for (int i = 0; i < n; i++) {
+      if (!new_value->empty()) new_value->push_back(',');
+      new_value->append(operands[i].data(), operands[i].size());
     }
-  };
-  NewComparator cmp;
-  Options new_options = CurrentOptions();
-  new_options.comparator = &cmp;
-  Status s = TryReopen(&new_options);
-  ASSERT_TRUE(!s.ok());
-  ASSERT_TRUE(s.ToString().find("comparator") != std::string::npos)
-      << s.ToString();
+    return true;
+  }
+};
 }
 
-TEST(DBTest, CustomComparator) {
-  class NumberComparator : public Comparator {
-   public:
-    virtual const char* Name() const { return "test.NumberComparator"; }
-    virtual int Compare(const Slice& a, const Slice& b) const {
-      return ToNumber(a) - ToNumber(b);
-    }
-    virtual void FindShortestSeparator(std::string* s, const Slice& l) const {
-      ToNumber(*s);     // Check format
-      ToNumber(l);      // Check format
-    }
-    virtual void FindShortSuccessor(std::string* key) const {
-      ToNumber(*key);   // Check format
+TEST(DBTest, Merge) {
+  ASSERT_TRUE(!db_->Merge(WriteOptions(), "a", "1").ok());
+
+  AppendOperator merge_operator;
+  Options options = CurrentOptions();
+  options.merge_operator = &merge_operator;
+  Reopen(&options);
+
+  ASSERT_OK(Put("a", "1"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "2"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "b", "x"));
+  ASSERT_OK(Put("c", "old"));
+  ASSERT_OK(Delete("c"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "c", "y"));
+  ASSERT_EQ("1,2", Get("a"));
+  ASSERT_EQ("x", Get("b"));
+  ASSERT_EQ("y", Get("c"));
+
+  // Operands in the memtable on top of values in tables
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "3"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "b", "z"));
+  ASSERT_EQ("1,2,3", Get("a"));
+  ASSERT_EQ("x,z", Get("b"));
+  ASSERT_EQ("y", Get("c"));
+
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  ASSERT_EQ(IterStatus(iter), "a->1,2,3");
+  iter->Next();
+  ASSERT_EQ(IterStatus(iter), "b->x,z");
+  iter->Prev();
+  ASSERT_EQ(IterStatus(iter), "a->1,2,3");
+  iter->Next();
+  iter->Next();
+  ASSERT_EQ(IterStatus(iter), "c->y");
+  iter->Next();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  iter->SeekToLast();
+  ASSERT_EQ(IterStatus(iter), "c->y");
+  iter->Prev();
+  ASSERT_EQ(IterStatus(iter), "b->x,z");
+  iter->Prev();
+  ASSERT_EQ(IterStatus(iter), "a->1,2,3");
+  iter->Prev();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  delete iter;
+
+  // Compaction folds the operands into plain values
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ(AllEntriesFor("a"), "[ 1,2,3 ]");
+  ASSERT_EQ(AllEntriesFor("b"), "[ x,z ]");
+  ASSERT_EQ(AllEntriesFor("c"), "[ y ]");
+
+  Reopen(&options);
+  ASSERT_EQ("1,2,3", Get("a"));
+}
+
+TEST(DBTest, MergeWithCompactionFilter) {
+  AppendOperator merge_operator;
+  TestCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.merge_operator = &merge_operator;
+  options.compaction_filter = &filter;
+  Reopen(&options);
+
+  // Values under operands are not the newest versions: the filter leaves
+  // them to the operands
+  ASSERT_OK(Put("a", "expired"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "a", "x"));
+  ASSERT_OK(Put("b", "stale"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "b", "y"));
+  ASSERT_OK(Put("c", "expired"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ("expired,x", Get("a"));
+  ASSERT_EQ("stale,y", Get("b"));
+  ASSERT_EQ("NOT_FOUND", Get("c"));
+}
+
+TEST(DBTest, MergeWithSnapshot) {
+  AppendOperator merge_operator;
+  Options options = CurrentOptions();
+  options.merge_operator = &merge_operator;
+  Reopen(&options);
+
+  ASSERT_OK(Put("foo", "1"));
+  ASSERT_OK(db_->Merge(WriteOptions(), "foo", "2"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(db_->Merge(WriteOptions(), "foo", "3"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  // The operand above the snapshot stays separate
+  ASSERT_EQ(AllEntriesFor("foo"), "[ MERGE(3), 1,2 ]");
+  ASSERT_EQ("1,2", Get("foo", snapshot));
+  ASSERT_EQ("1,2,3", Get("foo"));
+
+  db_->ReleaseSnapshot(snapshot);
+  ASSERT_EQ("1,2,3", Get("foo"));
+}
+
+TEST(DBTest, MergeAboveBaseLevel) {
+  AppendOperator merge_operator;
+  Options options = CurrentOptions();
+  options.merge_operator = &merge_operator;
+  Reopen(&options);
+
+  Put("foo", "v1");
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  const int last = config::kMaxMemCompactLevel;
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);   // foo => v1 is now in last level
+
+  // Place a table at level last-1 to prevent merging with preceding mutation
+  Put("a", "begin");
+  Put("z", "end");
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);
+  ASSERT_EQ(NumTableFilesAtLevel(last-1), 1);
+
+  db_->Merge(WriteOptions(), "foo", "x");
+  db_->Merge(WriteOptions(), "foo", "y");
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());  // Moves to level last-2
+  dbfull()->TEST_CompactRange(last-2, NULL, NULL);
+  // The value lives further down, so the operands are kept as they are
+  ASSERT_EQ(AllEntriesFor("foo"), "[ MERGE(y), MERGE(x), v1 ]");
+  ASSERT_EQ("v1,x,y", Get("foo"));
+  dbfull()->TEST_CompactRange(last-1, NULL, NULL);
+  ASSERT_EQ(AllEntriesFor("foo"), "[ v1,x,y ]");
+  ASSERT_EQ("v1,x,y", Get("foo"));
+}
+
+TEST(DBTest, DeleteRange) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("b", "vb"));
+    ASSERT_OK(Put("c", "vc"));
+    ASSERT_OK(Put("d", "vd"));
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), "b", "d"));
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), "d", "a"));  // Empty range
+    ASSERT_EQ("va", Get("a"));
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("NOT_FOUND", Get("c"));
+    ASSERT_EQ("vd", Get("d"));
+    ASSERT_OK(Put("c", "vc2"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+
+    Reopen();
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("vc2", Get("c"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+
+    // The table's range deletions must survive being copied into the
+    // new descriptor written by each open
+    Reopen();
+    Reopen();
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+
+    for (int level = 0; level < config::kNumLevels - 1; level++) {
+      dbfull()->TEST_CompactRange(level, NULL, NULL);
+    }
+    ASSERT_EQ("NOT_FOUND", Get("b"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+    ASSERT_EQ(AllEntriesFor("b"), "[ ]");
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, DeleteRangeWithSnapshot) {
+  Put("foo1", "v1");
+  Put("foo2", "v2");
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "foo", "fop"));
+  ASSERT_EQ("NOT_FOUND", Get("foo1"));
+  ASSERT_EQ("v1", Get("foo1", snapshot));
+
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  dbfull()->TEST_CompactRange(1, NULL, NULL);
+  ASSERT_EQ("NOT_FOUND", Get("foo2"));
+  ASSERT_EQ("v2", Get("foo2", snapshot));
+
+  ReadOptions options;
+  options.snapshot = snapshot;
+  Iterator* iter = db_->NewIterator(options);
+  iter->SeekToFirst();
+  ASSERT_EQ(IterStatus(iter), "foo1->v1");
+  iter->Next();
+  ASSERT_EQ(IterStatus(iter), "foo2->v2");
+  iter->Next();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  delete iter;
+
+  iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  delete iter;
+  db_->ReleaseSnapshot(snapshot);
+}
+
+TEST(DBTest, DeleteRangeOverlapping) {
+  // Overlapping tombstones, each lookup answered for its own snapshot, first
+  // from the memtable and then from a table
+  for (int i = 1; i <= 7; i++) {
+    Put(Key(i), "v1");
+  }
+  const Snapshot* s1 = db_->GetSnapshot();
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(2), Key(6)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(3)));
+  Put(Key(4), "v2");  // Added after the memtable's tombstones were indexed
+  const Snapshot* s2 = db_->GetSnapshot();
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(1), Key(5)));
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(3), Key(4)));
+  Put(Key(3), "v3");
+
+  for (int pass = 0; pass < 2; pass++) {
+    std::string latest, at_s1, at_s2;
+    for (int i = 1; i <= 7; i++) {
+      latest += Get(Key(i)) + " ";
+      at_s1 += Get(Key(i), s1) + " ";
+      at_s2 += Get(Key(i), s2) + " ";
+    }
+    ASSERT_EQ("NOT_FOUND NOT_FOUND v3 NOT_FOUND NOT_FOUND v1 v1 ", latest);
+    ASSERT_EQ("v1 v1 v1 v1 v1 v1 v1 ", at_s1);
+    ASSERT_EQ("v1 NOT_FOUND NOT_FOUND v2 NOT_FOUND v1 v1 ", at_s2);
+    dbfull()->TEST_CompactMemTable();
+  }
+  db_->ReleaseSnapshot(s1);
+  db_->ReleaseSnapshot(s2);
+}
+
+TEST(DBTest, DeleteRangeAboveBaseLevel) {
+  Put("foo", "v1");
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  const int last = config::kMaxMemCompactLevel;
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);   // foo => v1 is now in last level
+
+  // Place a table at level last-1 to prevent merging with preceding mutation
+  Put("a", "begin");
+  Put("z", "end");
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);
+  ASSERT_EQ(NumTableFilesAtLevel(last-1), 1);
+
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "e", "g"));
+  Put("x", "x");
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());  // Moves to level last-2
+  ASSERT_EQ(NumTableFilesAtLevel(last-2), 1);
+  ASSERT_EQ("NOT_FOUND", Get("foo"));
+
+  // The tombstone must survive while foo => v1 lives further down
+  dbfull()->TEST_CompactRange(last-2, NULL, NULL);
+  ASSERT_EQ("NOT_FOUND", Get("foo"));
+  ASSERT_EQ("(a->begin)(x->x)(z->end)", Contents());
+  dbfull()->TEST_CompactRange(last-1, NULL, NULL);
+  ASSERT_EQ("NOT_FOUND", Get("foo"));
+  ASSERT_EQ(AllEntriesFor("foo"), "[ ]");
+  ASSERT_EQ("(a->begin)(x->x)(z->end)", Contents());
+}
+
+TEST(DBTest, DeleteRangeDropsCoveredFiles) {
+  Put("b1", "v1");
+  Put("b2", "v2");
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  const int last = config::kMaxMemCompactLevel;
+  ASSERT_EQ(NumTableFilesAtLevel(last), 1);
+
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "b", "c"));
+  ASSERT_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(NumTableFilesAtLevel(last-1), 1);
+  ASSERT_EQ("NOT_FOUND", Get("b2"));
+
+  // The parent file is deleted unread, and the tombstone with it
+  dbfull()->TEST_CompactRange(last-1, NULL, NULL);
+  ASSERT_EQ("", FilesPerLevel());
+  ASSERT_EQ("NOT_FOUND", Get("b1"));
+  ASSERT_EQ("", Contents());
+}
+
+TEST(DBTest, IngestExternalFile) {
+  do {
+    const std::string fname = test::TmpDir() + "/db_test_ingest.sst";
+    std::map<std::string, std::string> data;
+    data["a1"] = "x1";
+    data["a2"] = "x2";
+    data["a3"] = "x3";
+    ASSERT_OK(BuildExternalFile(fname, data));
+
+    ASSERT_OK(Put("a2", "old"));
+    ASSERT_OK(Put("b", "vb"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_OK(db_->IngestExternalFile(IngestOptions(), fname));
+    ASSERT_TRUE(env_->FileExists(fname));   // Copied, not moved
+    ASSERT_EQ("x1", Get("a1"));
+    ASSERT_EQ("x2", Get("a2"));
+    ASSERT_EQ("old", Get("a2", snapshot));
+    ASSERT_EQ("NOT_FOUND", Get("a1", snapshot));
+    ASSERT_EQ("(a1->x1)(a2->x2)(a3->x3)(b->vb)", Contents());
+    db_->ReleaseSnapshot(snapshot);
+
+    // Later writes win over the file
+    ASSERT_OK(Put("a3", "newer"));
+    ASSERT_EQ("newer", Get("a3"));
+
+    Reopen();
+    ASSERT_EQ("x2", Get("a2"));
+    ASSERT_EQ("newer", Get("a3"));
+    for (int level = 0; level < config::kNumLevels - 1; level++) {
+      dbfull()->TEST_CompactRange(level, NULL, NULL);
+    }
+    ASSERT_EQ("(a1->x1)(a2->x2)(a3->newer)(b->vb)", Contents());
+    env_->DeleteFile(fname);
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, IngestExternalFileLevels) {
+  const std::string fname = test::TmpDir() + "/db_test_ingest.sst";
+  std::map<std::string, std::string> data;
+  data["k1"] = "v1";
+  data["k2"] = "v2";
+  ASSERT_OK(BuildExternalFile(fname, data));
+
+  // Nothing overlaps: the file goes to the last level
+  IngestOptions options;
+  options.move_file = true;
+  ASSERT_OK(db_->IngestExternalFile(options, fname));
+  ASSERT_TRUE(!env_->FileExists(fname));
+  ASSERT_EQ(NumTableFilesAtLevel(config::kNumLevels - 1), 1);
+
+  // A second file over the same keys lands right above the first
+  data["k1"] = "w1";
+  ASSERT_OK(BuildExternalFile(fname, data));
+  ASSERT_OK(db_->IngestExternalFile(options, fname));
+  ASSERT_EQ(NumTableFilesAtLevel(config::kNumLevels - 2), 1);
+  ASSERT_EQ("w1", Get("k1"));
+
+  // An overlapping memtable is flushed first
+  ASSERT_OK(Put("k2", "mem"));
+  data["k2"] = "w2";
+  ASSERT_OK(BuildExternalFile(fname, data));
+  ASSERT_OK(db_->IngestExternalFile(options, fname));
+  ASSERT_EQ("w2", Get("k2"));
+  ASSERT_EQ("(k1->w1)(k2->w2)", Contents());
+
+  // With level-0 overlapping as well the file goes there, and still reads
+  // as newer than the memtable flushed to make room for it
+  ASSERT_OK(Put("k2", "m3"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(NumTableFilesAtLevel(0), 1);
+  ASSERT_OK(Put("k2", "m4"));
+  data["k2"] = "w4";
+  ASSERT_OK(BuildExternalFile(fname, data));
+  ASSERT_OK(db_->IngestExternalFile(options, fname));
+  ASSERT_EQ(NumTableFilesAtLevel(0), 3);
+  ASSERT_EQ("w4", Get("k2"));
+  ASSERT_EQ("(k1->w1)(k2->w4)", Contents());
+  Reopen();
+  ASSERT_EQ("w4", Get("k2"));
+
+  // An empty table is rejected and left where it was
+  data.clear();
+  ASSERT_OK(BuildExternalFile(fname, data));
+  ASSERT_TRUE(!db_->IngestExternalFile(options, fname).ok());
+  ASSERT_TRUE(env_->FileExists(fname));
+  env_->DeleteFile(fname);
+  ASSERT_TRUE(!db_->IngestExternalFile(options, fname).ok());
+}
+
+TEST(DBTest, BlobFiles) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.min_blob_size = 100;
+  DestroyAndReopen(&options);
+
+  Random rnd(301);
+  std::string big1 = RandomString(&rnd, 1000);
+  std::string big2 = RandomString(&rnd, 1000);
+  ASSERT_OK(Put("a", "small"));
+  ASSERT_OK(Put("b", big1));
+  ASSERT_OK(Put("c", big2));
+  ASSERT_EQ(0, CountBlobFiles());
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(1, CountBlobFiles());
+
+  // Reads and iterators see the values, not the references
+  ASSERT_EQ("small", Get("a"));
+  ASSERT_EQ(big1, Get("b"));
+  ASSERT_EQ(big2, Get("c"));
+  ASSERT_EQ("(a->small)(b->" + big1 + ")(c->" + big2 + ")", Contents());
+  ASSERT_EQ(AllEntriesFor("b"), "[ " + big1 + " ]");
+  ASSERT_TRUE(Between(Size("", "z"), 0, 1000));
+
+  Reopen(&options);
+  ASSERT_EQ(big1, Get("b"));
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ(big1, Get("b"));
+  ASSERT_EQ(big2, Get("c"));
+  ASSERT_EQ(1, CountBlobFiles());
+
+  // A scan stops at a value whose blob cannot be read, with an error
+  Close();
+  std::vector<std::string> files;
+  env_->GetChildren(dbname_, &files);
+  uint64_t number;
+  FileType type;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (ParseFileName(files[i], &number, &type) && type == kBlobFile) {
+      // Cut the records short
+      std::string contents;
+      const std::string fname = dbname_ + "/" + files[i];
+      ASSERT_OK(ReadFileToString(env_, fname, &contents));
+      contents.resize(100);
+      ASSERT_OK(WriteStringToFile(env_, contents, fname));
+    }
+  }
+  Reopen(&options);
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  std::string seen;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    seen += "(" + iter->key().ToString() + "->" + iter->value().ToString() + ")";
+  }
+  ASSERT_EQ("(a->small)(b->)", seen);
+  ASSERT_TRUE(!iter->status().ok());
+  delete iter;
+  iter = db_->NewIterator(ReadOptions());
+  iter->SeekToLast();
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_TRUE(!iter->status().ok());
+  delete iter;
+}
+
+TEST(DBTest, BlobGarbageCollection) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.min_blob_size = 100;
+  options.blob_gc_ratio = 0.5;
+  DestroyAndReopen(&options);
+
+  Random rnd(301);
+  std::string keep = RandomString(&rnd, 1000);
+  ASSERT_OK(Put("a", keep));
+  for (int i = 0; i < 4; i++) {
+    ASSERT_OK(Put("b" + NumberToString(i), RandomString(&rnd, 1000)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  uint64_t bytes;
+  ASSERT_EQ(1, CountBlobFiles(&bytes));
+  ASSERT_GT(bytes, 5000);
+
+  // Overwriting most of the values makes the first blob file mostly
+  // garbage, so a compaction moves "a" out of it and deletes it.
+  for (int i = 0; i < 4; i++) {
+    ASSERT_OK(Put("b" + NumberToString(i), "v" + NumberToString(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ(1, CountBlobFiles(&bytes));
+  ASSERT_TRUE(Between(bytes, 1000, 1100));
+  ASSERT_EQ(keep, Get("a"));
+  ASSERT_EQ("v2", Get("b2"));
+
+  // Once every value is overwritten no blob file is left
+  ASSERT_OK(Put("a", "small"));
+  dbfull()->TEST_CompactMemTable();
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, NULL, NULL);
+  }
+  ASSERT_EQ(0, CountBlobFiles());
+  Reopen(&options);
+  ASSERT_EQ("small", Get("a"));
+  ASSERT_EQ(0, CountBlobFiles());
+}
+
+TEST(DBTest, ColumnFamilies) {
+  ColumnFamilyHandle* cf;
+  Options cf_options = CurrentOptions();
+  cf_options.merge_operator = NULL;
+  cf_options.write_buffer_size = 100000;
+  ASSERT_OK(db_->CreateColumnFamily(cf_options, "cf", &cf));
+  ASSERT_EQ("cf", cf->GetName());
+  ColumnFamilyHandle* dup;
+  ASSERT_TRUE(!db_->CreateColumnFamily(cf_options, "cf", &dup).ok());
+
+  // The families are separate keyspaces
+  ASSERT_OK(Put("a", "v0"));
+  ASSERT_OK(db_->Put(WriteOptions(), cf, "a", "v1"));
+  ASSERT_OK(db_->Put(WriteOptions(), cf, "b", "v2"));
+  ASSERT_EQ("v0", Get("a"));
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  ASSERT_EQ("v1", Get(cf, "a"));
+  ASSERT_EQ("v0", Get(NULL, "a"));
+  Iterator* iter = db_->NewIterator(ReadOptions(), cf);
+  iter->SeekToFirst();
+  ASSERT_EQ("a->v1", IterStatus(iter));
+  iter->Next();
+  ASSERT_EQ("b->v2", IterStatus(iter));
+  iter->Next();
+  ASSERT_EQ("(invalid)", IterStatus(iter));
+  delete iter;
+
+  // A batch spans families
+  WriteBatch batch;
+  batch.Delete(cf, "a");
+  batch.Put("c", "v3");
+  batch.Put(cf, "c", "v4");
+  ASSERT_OK(db_->Write(WriteOptions(), &batch));
+  ASSERT_EQ("NOT_FOUND", Get(cf, "a"));
+  ASSERT_EQ("v3", Get("c"));
+  ASSERT_EQ("v4", Get(cf, "c"));
+
+  // Every family must be opened
+  Close();
+  ASSERT_TRUE(!TryReopen(NULL).ok());
+  std::vector<std::string> names;
+  names.push_back("cf");
+  std::vector<ColumnFamilyHandle*> handles;
+  ASSERT_OK(TryReopenWithColumnFamilies(names, &handles));
+  ASSERT_EQ(1, handles.size());
+  cf = handles[0];
+  ASSERT_EQ("v0", Get("a"));
+  ASSERT_EQ("NOT_FOUND", Get(cf, "a"));
+  ASSERT_EQ("v2", Get(cf, "b"));
+  ASSERT_EQ("v4", Get(cf, "c"));
+
+  // Missing families are created on open
+  names.push_back("other");
+  ASSERT_OK(TryReopenWithColumnFamilies(names, &handles));
+  ASSERT_EQ(2, handles.size());
+  ASSERT_EQ("v2", Get(handles[0], "b"));
+  ASSERT_EQ("NOT_FOUND", Get(handles[1], "b"));
+  ASSERT_OK(db_->Put(WriteOptions(), handles[1], "b", "v5"));
+
+  // Dropping a family deletes its data for good
+  ASSERT_OK(db_->DropColumnFamily(handles[0]));
+  ASSERT_TRUE(!db_->DropColumnFamily(NULL).ok());
+  names.erase(names.begin());
+  ASSERT_OK(TryReopenWithColumnFamilies(names, &handles));
+  ASSERT_EQ("v5", Get(handles[0], "b"));
+  ASSERT_EQ("v3", Get("c"));
+  ASSERT_OK(db_->CreateColumnFamily(cf_options, "cf", &cf));
+  ASSERT_EQ("NOT_FOUND", Get(cf, "b"));
+  ASSERT_NE(handles[0]->GetID(), cf->GetID());
+}
+
+TEST(DBTest, ColumnFamilyLogs) {
+  ColumnFamilyHandle* cf;
+  ASSERT_OK(db_->CreateColumnFamily(CurrentOptions(), "cf", &cf));
+  ASSERT_OK(Put("a", "v0"));
+  ASSERT_OK(db_->Put(WriteOptions(), cf, "a", "v1"));
+
+  // The log stays while a family has updates only it holds
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("b", "v2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(3, CountLogFiles());
+  std::vector<std::string> names;
+  names.push_back("cf");
+  std::vector<ColumnFamilyHandle*> handles;
+  ASSERT_OK(TryReopenWithColumnFamilies(names, &handles));
+  cf = handles[0];
+  ASSERT_EQ("v0", Get("a"));
+  ASSERT_EQ("v2", Get("b"));
+  ASSERT_EQ("v1", Get(cf, "a"));
+
+  // Once every family has its updates in tables the old logs go
+  ASSERT_EQ(1, CountLogFiles());
+  ASSERT_OK(Put("c", "v3"));
+  ASSERT_OK(db_->Put(WriteOptions(), cf, "b", "v4"));
+  dbfull()->TEST_ColumnFamily(cf)->TEST_CompactMemTable();
+  ASSERT_EQ(2, CountLogFiles());
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(1, CountLogFiles());
+  ASSERT_OK(TryReopenWithColumnFamilies(names, &handles));
+  cf = handles[0];
+  ASSERT_EQ("v1", Get(cf, "a"));
+  ASSERT_EQ("v4", Get(cf, "b"));
+  ASSERT_EQ("v3", Get("c"));
+  ASSERT_EQ("NOT_FOUND", Get(cf, "c"));
+}
+
+static int CountTableFiles(Env* env, const std::string& dbname) {
+  std::vector<std::string> files;
+  env->GetChildren(dbname, &files);
+  int count = 0;
+  uint64_t number;
+  FileType type;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (ParseFileName(files[i], &number, &type) && type == kTableFile) {
+      count++;
+    }
+  }
+  return count;
+}
+
+static void DeleteNothing(const Slice& key, void* value) { }
+
+TEST(DBTest, WriteBufferManager) {
+  const size_t kBudget = 200 << 10;
+  WriteBufferManager manager(kBudget);
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.write_buffer_manager = &manager;
+  DestroyAndReopen(&options);
+  std::string dbname2 = test::TmpDir() + "/db_write_buffer_manager";
+  DestroyDB(dbname2, Options());
+  DB* db2;
+  ASSERT_OK(DB::Open(options, dbname2, &db2));
+
+  // Neither DB reaches its write_buffer_size, but the first write past
+  // the shared budget flushes the memtable of the DB it goes to.
+  Random rnd(301);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 1000)));
+  }
+  ASSERT_GT(manager.memory_usage(), 100000);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_OK(db2->Put(WriteOptions(), Key(i), RandomString(&rnd, 1000)));
+  }
+  // Writes made while a flush is underway do not flush again
+  for (int i = 0; i < 1000 && manager.memory_usage() >= kBudget; i++) {
+    DelayMilliseconds(10);
+    ASSERT_OK(db2->Put(WriteOptions(), "x", "x"));
+  }
+  ASSERT_LT(manager.memory_usage(), kBudget);
+  ASSERT_GE(CountTableFiles(env_, dbname2), 1);
+  ASSERT_EQ(0, CountTableFiles(env_, dbname_));
+  ASSERT_EQ(1000, Get(Key(99)).size());
+  std::string value;
+  ASSERT_OK(db2->Get(ReadOptions(), Key(0), &value));
+  ASSERT_EQ(1000, value.size());
+
+  // The memory goes with the memtables
+  delete db2;
+  DestroyDB(dbname2, Options());
+  Close();
+  ASSERT_EQ(0, manager.memory_usage());
+
+  // Memtable memory may be charged against a block cache
+  Cache* cache = NewLRUCache(1 << 20);
+  {
+    WriteBufferManager charged(1 << 20, cache);
+    cache->Release(cache->Insert("k", NULL, 1, &DeleteNothing));
+    Cache::Handle* h = cache->Lookup("k");
+    ASSERT_TRUE(h != NULL);
+    cache->Release(h);
+    charged.ReserveMem(4 << 20);
+    ASSERT_TRUE(charged.ShouldFlush());
+    ASSERT_TRUE(cache->Lookup("k") == NULL);
+    charged.FreeMem(4 << 20);
+  }
+  delete cache;
+}
+
+TEST(DBTest, OverlapInLevel0) {
+  do {
+    ASSERT_EQ(config::kMaxMemCompactLevel, 2) << "Fix test to match config";
+
+    // Fill levels 1 and 2 to disable the pushing of new memtables to levels > 0.
+    ASSERT_OK(Put("100", "v100"));
+    ASSERT_OK(Put("999", "v999"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(Delete("100"));
+    ASSERT_OK(Delete("999"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("0,1,1", FilesPerLevel());
+
+    // Make files spanning the following ranges in level-0:
+    //  files[0]  200 .. 900
+    //  files[1]  300 .. 500
+    // Note that files are sorted by smallest key.
+    ASSERT_OK(Put("300", "v300"));
+    ASSERT_OK(Put("500", "v500"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(Put("200", "v200"));
+    ASSERT_OK(Put("600", "v600"));
+    ASSERT_OK(Put("900", "v900"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("2,1,1", FilesPerLevel());
+
+    // Compact away the placeholder files we created initially
+    dbfull()->TEST_CompactRange(1, NULL, NULL);
+    dbfull()->TEST_CompactRange(2, NULL, NULL);
+    ASSERT_EQ("2", FilesPerLevel());
+
+    // Do a memtable compaction.  Before bug-fix, the compaction would
+    // not detect the overlap with level-0 files and would incorrectly place
+    // the deletion in a deeper level.
+    ASSERT_OK(Delete("600"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("3", FilesPerLevel());
+    ASSERT_EQ("NOT_FOUND", Get("600"));
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, IntraL0Compaction) {
+  // A level-1 file much larger than the level-0 files over its range
+  Options options = CurrentOptions();
+  options.write_buffer_size = 10000000;
+  Reopen(&options);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'x')));
+  }
+  Reopen(&options);  // Recovery writes to level-0
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  const int level1_files = NumTableFilesAtLevel(1);
+  ASSERT_GT(level1_files, 0);
+
+  // Replaying one log into small memtables gives many level-0 files at
+  // once, which are merged among themselves rather than into level-1
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_OK(Put(Key((i * 7) % 1000), Key(i) + std::string(300, 'v')));
+  }
+  options.write_buffer_size = 10000;
+  Reopen(&options);
+  for (int i = 0; i < 1000 && NumTableFilesAtLevel(0) != 1; i++) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ(1, NumTableFilesAtLevel(0));
+  ASSERT_EQ(level1_files, NumTableFilesAtLevel(1));
+  for (int i = 1000; i < 2000; i++) {
+    ASSERT_EQ(Key(i) + std::string(300, 'v'), Get(Key((i * 7) % 1000)));
+  }
+
+  // Still ordered correctly against level-1 and later level-0 files
+  ASSERT_OK(Put(Key(3), "new"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("new", Get(Key(3)));
+  Reopen(&options);
+  ASSERT_EQ("new", Get(Key(3)));
+  ASSERT_EQ(Key(1859) + std::string(300, 'v'), Get(Key(13)));
+}
+
+TEST(DBTest, L0_CompactionBug_Issue44_a) {
+  Reopen();
+  ASSERT_OK(Put("b", "v"));
+  Reopen();
+  ASSERT_OK(Delete("b"));
+  ASSERT_OK(Delete("a"));
+  Reopen();
+  ASSERT_OK(Delete("a"));
+  Reopen();
+  ASSERT_OK(Put("a", "v"));
+  Reopen();
+  Reopen();
+  ASSERT_EQ("(a->v)", Contents());
+  DelayMilliseconds(1000);  // Wait for compaction to finish
+  ASSERT_EQ("(a->v)", Contents());
+}
+
+TEST(DBTest, L0_CompactionBug_Issue44_b) {
+  Reopen();
+  Put("","");
+  Reopen();
+  Delete("e");
+  Put("","");
+  Reopen();
+  Put("c", "cv");
+  Reopen();
+  Put("","");
+  Reopen();
+  Put("","");
+  DelayMilliseconds(1000);  // Wait for compaction to finish
+  Reopen();
+  Put("d","dv");
+  Reopen();
+  Put("","");
+  Reopen();
+  Delete("d");
+  Delete("b");
+  Reopen();
+  ASSERT_EQ("(->)(c->cv)", Contents());
+  DelayMilliseconds(1000);  // Wait for compaction to finish
+  ASSERT_EQ("(->)(c->cv)", Contents());
+}
+
+TEST(DBTest, ComparatorCheck) {
+  class NewComparator : public Comparator {
+   public:
+    virtual const char* Name() const { return "leveldb.NewComparator"; }
+    virtual int Compare(const Slice& a, const Slice& b) const {
+      return BytewiseComparator()->Compare(a, b);
+    }
+    virtual void FindShortestSeparator(std::string* s, const Slice& l) const {
+      BytewiseComparator()->FindShortestSeparator(s, l);
+    }
+    virtual void FindShortSuccessor(std::string* key) const {
+      BytewiseComparator()->FindShortSuccessor(key);
+    }
+  };
+  NewComparator cmp;
+  Options new_options = CurrentOptions();
+  new_options.comparator = &cmp;
+  Status s = TryReopen(&new_options);
+  ASSERT_TRUE(!s.ok());
+  ASSERT_TRUE(s.ToString().find("comparator") != std::string::npos)
+      << s.ToString();
+}
+
+TEST(DBTest, CustomComparator) {
+  class NumberComparator : public Comparator {
+   public:
+    virtual const char* Name() const { return "test.NumberComparator"; }
+    virtual int Compare(const Slice& a, const Slice& b) const {
+      return ToNumber(a) - ToNumber(b);
+    }
+    virtual void FindShortestSeparator(std::string* s, const Slice& l) const {
+      ToNumber(*s);     // Check format
+      ToNumber(l);      // Check format
+    }
+    virtual void FindShortSuccessor(std::string* key) const {
+      ToNumber(*key);   // Check format
     }
    private:
     static int ToNumber(const Slice& x) {
@@ -1690,6 +2772,431 @@ TEST(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST(DBTest, RowCache) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.row_cache = NewLRUCache(1 << 20);
+  Reopen(&options);
+
+  ASSERT_OK(Put("foo", "v1"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(Put("foo", "v2"));
+  ASSERT_OK(Put("goo", "v3"));
+  dbfull()->TEST_CompactMemTable();
+
+  // The first lookup reads the table and fills the row
+  env_->random_read_counter_.Reset();
+  ASSERT_EQ("v2", Get("foo"));
+  ASSERT_GT(env_->random_read_counter_.Read(), 0);
+
+  // Later ones, including older versions of the key, do not
+  env_->random_read_counter_.Reset();
+  ASSERT_EQ("v2", Get("foo"));
+  ASSERT_EQ("v1", Get("foo", snapshot));
+  PinnableSlice value;
+  ASSERT_OK(db_->Get(ReadOptions(), "foo", &value));
+  ASSERT_TRUE(value.IsPinned());
+  ASSERT_EQ("v2", value.ToString());
+  value.Reset();
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  // Rows belong to one file, so newer files are still seen
+  ASSERT_OK(Delete("foo"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("NOT_FOUND", Get("foo"));
+  ASSERT_EQ("v1", Get("foo", snapshot));
+  ASSERT_EQ("v3", Get("goo"));
+
+  db_->ReleaseSnapshot(snapshot);
+  Close();
+  delete options.block_cache;
+  delete options.row_cache;
+}
+
+TEST(DBTest, IterBoundsSkipTables) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.block_size = 256;
+  Reopen(&options);
+
+  // Three files over disjoint ranges, many blocks each
+  Random rnd(301);
+  const int N = 300;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 100)));
+    if (i % 100 == 99) {
+      dbfull()->TEST_CompactMemTable();
+    }
+  }
+  ASSERT_EQ("0,0,3", FilesPerLevel());
+  const std::string lower = Key(190);
+  const std::string upper = Key(200);
+
+  // Without bounds, the iterator reads on past the range into the next
+  // file
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->Seek(lower); iter->Valid() && iter->key().compare(upper) < 0;
+       iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(10, count);
+  delete iter;
+  const int unbounded_reads = env_->random_read_counter_.Read();
+
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  ReadOptions ro;
+  Slice lower_bound(lower);
+  Slice upper_bound(upper);
+  ro.iterate_lower_bound = &lower_bound;
+  ro.iterate_upper_bound = &upper_bound;
+  iter = db_->NewIterator(ro);
+  count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(10, count);
+  delete iter;
+  const int bounded_reads = env_->random_read_counter_.Read();
+  ASSERT_LT(bounded_reads, unbounded_reads);
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST(DBTest, RecycleLogFiles) {
+  Options options = CurrentOptions();
+  options.recycle_log_file_num = 2;
+  options.bytes_per_sync = 4096;
+  Reopen(&options);
+
+  // Each flush moves to a new log, reusing the file kept from the previous
+  // flush, and keeps the log it leaves for the next one
+  for (int round = 0; round < 6; round++) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_OK(Put(Key(i), "round" + NumberToString(round)));
+    }
+    dbfull()->TEST_CompactMemTable();
+  }
+  ASSERT_EQ(2, CountLogFiles());
+
+  // The current log is a reused file that held round 4.  Records of the
+  // same size end where the old ones do, so only the log number tells the
+  // rest of round 4 apart: recovery must not replay it.
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(Put(Key(i), "round6"));
+  }
+  std::vector<std::string> files;
+  ASSERT_OK(env_->GetChildren(dbname_, &files));
+  uint64_t number, log_number = 0;
+  FileType type;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (ParseFileName(files[i], &number, &type) && type == kLogFile) {
+      log_number = std::max(log_number, number);
+    }
+  }
+  // Closing trims the old records off the file; a crash would not
+  const std::string log_name = LogFileName(dbname_, log_number);
+  std::string contents;
+  ASSERT_OK(ReadFileToString(env_, log_name, &contents));
+  Close();
+  ASSERT_OK(WriteStringToFile(env_, contents, log_name));
+  Reopen(&options);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(i < 10 ? "round6" : "round5", Get(Key(i)));
+  }
+}
+
+TEST(DBTest, PreloadTables) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  Reopen(&options);
+
+  Random rnd(301);
+  for (int i = 0; i < 300; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 100)));
+    if (i % 100 == 99) {
+      dbfull()->TEST_CompactMemTable();
+    }
+  }
+  ASSERT_EQ("0,0,3", FilesPerLevel());
+
+  // Normally the first read of each table opens it
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  for (int i = 50; i < 300; i += 100) {
+    Get(Key(i));
+  }
+  const int lazy_reads = env_->random_read_counter_.Read();
+
+  // With max_open_files == -1 DB::Open does that instead
+  options.max_open_files = -1;
+  options.max_file_opening_threads = 2;
+  env_->random_read_counter_.Reset();
+  Reopen(&options);
+  ASSERT_GT(env_->random_read_counter_.Read(), 0);
+  env_->random_read_counter_.Reset();
+  for (int i = 50; i < 300; i += 100) {
+    Get(Key(i));
+  }
+  ASSERT_LT(env_->random_read_counter_.Read(), lazy_reads);
+
+  // Tables written later are read as usual
+  ASSERT_OK(Put(Key(0), "v"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("v", Get(Key(0)));
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST(DBTest, PerfContext) {
+  Options options = CurrentOptions();
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  Reopen(&options);
+  ASSERT_OK(Put("a", "va"));
+  ASSERT_OK(Put("c", "vc"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Delete("a"));
+
+  // Nothing is collected by default
+  PerfContext* perf = GetPerfContext();
+  perf->Reset();
+  ASSERT_EQ("vc", Get("c"));
+  ASSERT_EQ(0, perf->get_from_memtable_count);
+  ASSERT_EQ(0, perf->block_read_count);
+
+  SetPerfLevel(kEnableTime);
+  perf->Reset();
+  GetIOStatsContext()->Reset();
+  ASSERT_EQ("vc", Get("c"));
+  ASSERT_EQ(1, perf->get_from_memtable_count);
+  ASSERT_EQ(1, perf->bloom_sst_hit_count);
+  ASSERT_EQ(1, perf->block_cache_miss_count);
+  ASSERT_EQ(1, perf->block_read_count);
+  ASSERT_GT(perf->block_read_byte, 0);
+  ASSERT_GT(perf->get_from_output_files_time, 0);
+  ASSERT_GT(GetIOStatsContext()->bytes_read, 0);
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  ASSERT_EQ(1, perf->bloom_sst_miss_count);
+  ASSERT_EQ(1, perf->block_read_count);
+
+  // The deletion in the memtable hides the value in the table
+  perf->Reset();
+  ASSERT_EQ("(c->vc)", Contents());
+  ASSERT_EQ(1, perf->internal_delete_skipped_count);
+  ASSERT_EQ(1, perf->internal_key_skipped_count);
+  ASSERT_TRUE(perf->ToString().find("internal_key_skipped_count = 1")
+              != std::string::npos);
+
+  SetPerfLevel(kDisable);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST(DBTest, Statistics) {
+  Options options = CurrentOptions();
+  options.statistics = NewStatistics();
+  Reopen(&options);
+  Statistics* stats = options.statistics;
+
+  WriteOptions sync;
+  sync.sync = true;
+  ASSERT_OK(db_->Put(sync, "foo", "v1"));
+  ASSERT_OK(Put("bar", "v2"));
+  ASSERT_EQ(2, stats->GetTickerCount(kKeysWritten));
+  ASSERT_EQ(1, stats->GetTickerCount(kWALFileSynced));
+  ASSERT_GT(stats->GetTickerCount(kBytesWritten), 0);
+
+  ASSERT_EQ("v1", Get("foo"));
+  ASSERT_EQ("NOT_FOUND", Get("missing"));
+  ASSERT_EQ(1, stats->GetTickerCount(kKeysRead));
+  ASSERT_EQ(2, stats->GetTickerCount(kBytesRead));
+
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_GT(stats->GetTickerCount(kFlushWriteBytes), 0);
+  ASSERT_EQ("v2", Get("bar"));
+  ASSERT_GT(stats->GetTickerCount(kBlockCacheMiss), 0);
+
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->Seek("foo");
+  ASSERT_EQ("foo->v1", IterStatus(iter));
+  delete iter;
+
+  // The dump lists every ticker and histogram
+  std::string dump;
+  ASSERT_TRUE(db_->GetProperty("leveldb.statistics", &dump));
+  ASSERT_TRUE(dump.find("leveldb.number.keys.written COUNT : 2\n")
+              != std::string::npos);
+  ASSERT_TRUE(dump.find("leveldb.db.get.micros") != std::string::npos);
+  ASSERT_TRUE(dump.find("leveldb.db.seek.micros") != std::string::npos);
+
+  stats->Reset();
+  ASSERT_EQ(0, stats->GetTickerCount(kKeysWritten));
+
+  Close();
+  delete stats;
+}
+
+TEST(DBTest, SecondaryBlockCache) {
+  const std::string dir = dbname_ + "_secondary";
+  SecondaryCache* secondary;
+  ASSERT_OK(NewLogSecondaryCache(env_, dir, 4 << 20, &secondary));
+  Options options = CurrentOptions();
+  options.block_cache = NewLRUCache(64 << 10, secondary);
+  options.statistics = NewStatistics();
+  options.env = env_;
+  env_->copy_random_reads_ = true;
+  Reopen(&options);
+  Statistics* stats = options.statistics;
+
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'a' + i % 26)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Blocks evicted from the block cache are read back from the second tier
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_EQ(std::string(1000, 'a' + i % 26), Get(Key(i)));
+    }
+  }
+  ASSERT_GT(stats->GetTickerCount(kBlockCacheMiss), 0);
+  ASSERT_GT(stats->GetTickerCount(kSecondaryCacheMiss), 0);
+  ASSERT_GT(stats->GetTickerCount(kSecondaryCacheHit), 0);
+  ASSERT_EQ(stats->GetTickerCount(kBlockCacheMiss),
+            stats->GetTickerCount(kSecondaryCacheHit) +
+            stats->GetTickerCount(kSecondaryCacheMiss));
+
+  Close();
+  env_->copy_random_reads_ = false;
+  delete options.block_cache;
+  delete secondary;
+  delete stats;
+  env_->DeleteDir(dir);
+}
+
+namespace {
+class RecordingListener : public EventListener {
+ public:
+  std::vector<FlushJobInfo> flushes;
+  std::vector<CompactionJobInfo> begun;
+  std::vector<CompactionJobInfo> completed;
+  std::string stats;  // Read from the DB by a callback
+
+  virtual void OnFlushCompleted(DB* db, const FlushJobInfo& info) {
+    flushes.push_back(info);
+    db->GetProperty("leveldb.num-files-at-level0", &stats);
+  }
+  virtual void OnCompactionBegin(DB* db, const CompactionJobInfo& info) {
+    begun.push_back(info);
+  }
+  virtual void OnCompactionCompleted(DB* db, const CompactionJobInfo& info) {
+    completed.push_back(info);
+  }
+};
+}
+
+TEST(DBTest, EventListener) {
+  RecordingListener listener;
+  Options options = CurrentOptions();
+  options.listeners.push_back(&listener);
+  Reopen(&options);
+
+  ASSERT_OK(Put("a", "va"));
+  ASSERT_OK(Put("z", "vz"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(1, listener.flushes.size());
+  ASSERT_EQ(dbname_, listener.flushes[0].db_name);
+  ASSERT_GT(listener.flushes[0].file_size, 0);
+  ASSERT_EQ(NumTableFilesAtLevel(listener.flushes[0].level), 1);
+  ASSERT_EQ(listener.flushes[0].level == 0 ? "1" : "0", listener.stats);
+
+  // Overlap the first table so that the compaction merges both
+  ASSERT_OK(Put("b", "vb"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(2, listener.flushes.size());
+  listener.begun.clear();
+  listener.completed.clear();
+  const int level = listener.flushes[0].level;
+  dbfull()->TEST_CompactRange(level, NULL, NULL);
+  ASSERT_EQ(1, listener.begun.size());
+  ASSERT_EQ(1, listener.completed.size());
+  const CompactionJobInfo& info = listener.completed[0];
+  ASSERT_EQ(kManualCompaction, info.reason);
+  ASSERT_EQ(level, info.level);
+  ASSERT_EQ(level + 1, info.output_level);
+  ASSERT_OK(info.status);
+  ASSERT_EQ(listener.begun[0].input_files.size(), info.input_files.size());
+  ASSERT_GE(info.input_files.size(), 1);
+  ASSERT_EQ(1, info.output_files.size());
+  ASSERT_GT(info.bytes_read, 0);
+  ASSERT_GT(info.bytes_written, 0);
+  ASSERT_EQ("va", Get("a"));
+
+  Close();
+}
+
+namespace {
+// Once writes stop, lets the flush held up by delay_sstable_sync_ finish
+// while the stopped writer is still in the callback
+class StallListener : public EventListener {
+ public:
+  SpecialEnv* env;
+  port::AtomicPointer flushed;
+  int stops;
+
+  explicit StallListener(SpecialEnv* e) : env(e), flushed(NULL), stops(0) { }
+
+  virtual void OnFlushCompleted(DB* db, const FlushJobInfo& info) {
+    flushed.Release_Store(this);
+  }
+  virtual void OnStallConditionsChanged(DB* db, const WriteStallInfo& info) {
+    if (info.condition == kStallStopped) {
+      stops++;
+      env->delay_sstable_sync_.Release_Store(NULL);
+      while (flushed.Acquire_Load() == NULL) {
+        DelayMilliseconds(10);
+      }
+      DelayMilliseconds(100);  // Until the background thread is done too
+    }
+  }
+};
+}
+
+TEST(DBTest, StallListenerBlocksDuringFlush) {
+  StallListener listener(env_);
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.write_buffer_size = 100000;
+  options.listeners.push_back(&listener);
+  Reopen(&options);
+
+  // The second memtable fills up while the first cannot be flushed.  The
+  // stopped write must not then wait for the flush it was told about.
+  env_->delay_sstable_sync_.Release_Store(env_);
+  for (int i = 0; listener.stops == 0 && i < 1000; i++) {
+    ASSERT_OK(Put(Key(i), std::string(1000, 'v')));
+  }
+  env_->delay_sstable_sync_.Release_Store(NULL);
+  ASSERT_EQ(1, listener.stops);
+  ASSERT_OK(Put("last", "v"));
+  ASSERT_EQ("v", Get("last"));
+
+  Close();
+}
+
 // Multi-threaded test:
 namespace {
 
@@ -1788,6 +3295,70 @@ TEST(DBTest, MultiThreaded) {
   } while (ChangeOptions());
 }
 
+namespace {
+
+struct SyncWriter {
+  DB* db;
+  int id;
+  port::AtomicPointer done;
+};
+
+static void SyncWriterBody(void* arg) {
+  SyncWriter* w = reinterpret_cast<SyncWriter*>(arg);
+  WriteOptions options;
+  options.sync = true;
+  for (int i = 0; i < 100; i++) {
+    char key[20];
+    snprintf(key, sizeof(key), "%d.%03d", w->id, i);
+    ASSERT_OK(w->db->Put(options, key, std::string(100, 'v')));
+  }
+  w->done.Release_Store(w);
+}
+
+}  // namespace
+
+TEST(DBTest, BackgroundWALSync) {
+  Options options = CurrentOptions();
+  options.background_wal_sync = true;
+  options.write_buffer_size = 10000;  // Switch logs under the sync thread
+  options.statistics = NewStatistics();
+  Reopen(&options);
+
+  SyncWriter writers[kNumThreads];
+  for (int id = 0; id < kNumThreads; id++) {
+    writers[id].db = db_;
+    writers[id].id = id;
+    writers[id].done.Release_Store(NULL);
+    env_->StartThread(SyncWriterBody, &writers[id]);
+  }
+  for (int id = 0; id < kNumThreads; id++) {
+    while (writers[id].done.Acquire_Load() == NULL) {
+      DelayMilliseconds(10);
+    }
+  }
+  const uint64_t syncs =
+      options.statistics->GetTickerCount(kWALFileSynced);
+  ASSERT_GT(syncs, 0);
+  ASSERT_LE(syncs, kNumThreads * 100);
+
+  // Non-sync writes are made durable at once by FlushWAL()
+  ASSERT_OK(Put("foo", "v1"));
+  ASSERT_OK(db_->FlushWAL(true));
+  ASSERT_EQ(syncs + 1, options.statistics->GetTickerCount(kWALFileSynced));
+
+  Reopen(&options);
+  ASSERT_EQ("v1", Get("foo"));
+  for (int id = 0; id < kNumThreads; id++) {
+    for (int i = 0; i < 100; i++) {
+      char key[20];
+      snprintf(key, sizeof(key), "%d.%03d", id, i);
+      ASSERT_EQ(std::string(100, 'v'), Get(key));
+    }
+  }
+  Close();
+  delete options.statistics;
+}
+
 namespace {
 typedef std::map<std::string, std::string> KVMap;
 }
@@ -2047,7 +3618,7 @@ void BM_LogAndApply(int iters, int num_base_files) {
 
   InternalKeyComparator cmp(BytewiseComparator());
   Options options;
-  VersionSet vset(dbname, &options, NULL, &cmp);
+  VersionSet vset(dbname, &options, NULL, NULL, &cmp);
   ASSERT_OK(vset.Recover());
   VersionEdit vbase;
   uint64_t fnum = 1;
@@ -119,6 +119,12 @@ void InternalKeyComparator::FindShortSuccessor(std::string* key) const
 	}
 }
 
+Slice InternalKeyComparator::PointKey(const Slice& key) const
+{
+	// All the versions of a user key
+	return user_comparator_->PointKey(ExtractUserKey(key));
+}
+
 const char* InternalFilterPolicy::Name() const
 {
 	return user_policy_->Name();
@@ -49,7 +49,15 @@ class InternalKey;
 // data structures.
 enum ValueType
 {
-	kTypeDeletion = 0x0, kTypeValue = 0x1
+	kTypeDeletion = 0x0,
+	kTypeValue = 0x1,
+	kTypeMerge = 0x2,
+	// Deletes user keys in [key, value).  Range deletions live apart from
+	// the other entries: in their own memtable list and table meta block.
+	kTypeRangeDeletion = 0x3,
+	// A value kept in a blob file; the entry's value is its BlobIndex
+	// (see db/blob_file.h).  Only found in tables.
+	kTypeBlobIndex = 0x4
 };
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
@@ -57,7 +65,7 @@ enum ValueType
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeBlobIndex;
 
 // SequenceNumber 是leveldb很重要的东西，每次对数据库进行更新操作，
 // 都会生成一个新的SequenceNumber,64bits，其中高8位为0，可以跟key的类型(8bits)进行合并成64bits。
@@ -138,6 +146,7 @@ class InternalKeyComparator: public Comparator
 		virtual void FindShortestSeparator(std::string* start,
 				const Slice& limit) const;
 		virtual void FindShortSuccessor(std::string* key) const;
+		virtual Slice PointKey(const Slice& key) const;
 
 		const Comparator* user_comparator() const
 		{
@@ -161,6 +170,11 @@ class InternalFilterPolicy: public FilterPolicy
 		virtual void
 		CreateFilter(const Slice* keys, int n, std::string* dst) const;
 		virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const;
+
+		const FilterPolicy* user_policy() const
+		{
+			return user_policy_;
+		}
 };
 
 // Modules in this directory should keep internal keys wrapped inside
@@ -227,7 +241,7 @@ inline bool ParseInternalKey(const Slice& internal_key,
 	result->sequence = num >> 8;
 	result->type = static_cast<ValueType> (c);
 	result->user_key = Slice(internal_key.data(), n - 8);
-	return (c <= static_cast<unsigned char> (kTypeValue));
+	return (c <= static_cast<unsigned char> (kTypeBlobIndex));
 }
 
 // A helper class useful for DBImpl::Get()
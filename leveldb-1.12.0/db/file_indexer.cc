@@ -0,0 +1,129 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/file_indexer.h"
+
+#include "db/version_edit.h"
+#include "leveldb/comparator.h"
+
+namespace leveldb
+{
+
+FileIndexer::FileIndexer()
+{
+	for (int level = 0; level < config::kNumLevels; level++)
+	{
+		next_level_files_[level] = 0;
+	}
+}
+
+void FileIndexer::UpdateIndex(const Comparator* ucmp,
+		const std::vector<FileMetaData*>* files)
+{
+	for (int level = 0; level < config::kNumLevels; level++)
+	{
+		index_[level].clear();
+		next_level_files_[level] = 0;
+	}
+
+	// Level-0 files overlap each other, so the search of level-1 that
+	// follows them is not narrowed
+	for (int level = 1; level + 1 < config::kNumLevels; level++)
+	{
+		const std::vector<FileMetaData*>& upper = files[level];
+		const std::vector<FileMetaData*>& lower = files[level + 1];
+		const uint32_t n = lower.size();
+		next_level_files_[level] = n;
+		if ( upper.empty() || lower.empty() )
+		{
+			continue;
+		}
+
+		// The keys of both levels increase, so each bound only moves
+		// forward from one file to the next
+		index_[level].resize(upper.size());
+		uint32_t smallest_lb = 0, largest_lb = 0;
+		uint32_t smallest_end = 0, largest_end = 0;
+		for (size_t i = 0; i < upper.size(); i++)
+		{
+			const Slice smallest = upper[i]->smallest.user_key();
+			const Slice largest = upper[i]->largest.user_key();
+			while (smallest_lb < n && ucmp->Compare(
+					lower[smallest_lb]->largest.user_key(), smallest) < 0)
+			{
+				smallest_lb++;
+			}
+			while (largest_lb < n && ucmp->Compare(
+					lower[largest_lb]->largest.user_key(), largest) < 0)
+			{
+				largest_lb++;
+			}
+			while (smallest_end < n && ucmp->Compare(
+					lower[smallest_end]->smallest.user_key(), smallest) <= 0)
+			{
+				smallest_end++;
+			}
+			while (largest_end < n && ucmp->Compare(
+					lower[largest_end]->smallest.user_key(), largest) <= 0)
+			{
+				largest_end++;
+			}
+			IndexUnit* unit = &index_[level][i];
+			unit->smallest_lb = smallest_lb;
+			unit->largest_lb = largest_lb;
+			unit->smallest_end = smallest_end;
+			unit->largest_end = largest_end;
+		}
+	}
+}
+
+void FileIndexer::GetNextLevelIndex(int level, size_t file_index,
+		int cmp_smallest, int cmp_largest, uint32_t* left, uint32_t* right) const
+{
+	const std::vector<IndexUnit>& units = index_[level];
+	*left = 0;
+	*right = next_level_files_[level];
+	if ( units.empty() )
+	{
+		// Level-0, an empty level, or a version never indexed
+		return;
+	}
+	assert(file_index <= units.size());
+
+	if ( file_index == units.size() )
+	{
+		// Past the last file of the level
+		*left = units[file_index - 1].largest_lb;
+		return;
+	}
+	const IndexUnit& unit = units[file_index];
+	if ( cmp_smallest < 0 )
+	{
+		// Between the previous file and this one
+		*left = (file_index > 0 ? units[file_index - 1].largest_lb : 0);
+		*right = unit.smallest_end;
+	}
+	else if ( cmp_smallest == 0 )
+	{
+		*left = unit.smallest_lb;
+		*right = unit.smallest_end;
+	}
+	else if ( cmp_largest < 0 )
+	{
+		*left = unit.smallest_lb;
+		*right = unit.largest_end;
+	}
+	else if ( cmp_largest == 0 )
+	{
+		*left = unit.largest_lb;
+		*right = unit.largest_end;
+	}
+	else
+	{
+		*left = unit.largest_lb;
+	}
+	assert(*left <= *right);
+}
+
+} // namespace leveldb
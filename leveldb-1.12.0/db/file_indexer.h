@@ -0,0 +1,69 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_FILE_INDEXER_H_
+#define STORAGE_LEVELDB_DB_FILE_INDEXER_H_
+
+#include <stdint.h>
+#include <vector>
+#include "db/dbformat.h"
+
+namespace leveldb
+{
+
+class Comparator;
+struct FileMetaData;
+
+// Records, for every file of a sorted level (level-1 and up), where its
+// smallest and largest keys fall among the files of the next level.  A
+// lookup that went through a level then searches only the files of the
+// next level that may hold the key, instead of the whole level
+// (fractional cascading).
+//
+// 记录每个文件的边界在下一级文件中的位置，缩小下一级的二分查找范围
+class FileIndexer
+{
+	public:
+		FileIndexer();
+
+		// Index the files of a version, one list per level, whose user keys
+		// "ucmp" orders.
+		// REQUIRES: files[1..] are sorted and disjoint
+		void UpdateIndex(const Comparator* ucmp,
+				const std::vector<FileMetaData*>* files);
+
+		// A lookup of "key" at "level" stopped at files[level][file_index],
+		// the first file of the level whose largest key is >= key (or at
+		// the end of the level), and compared key with the smallest and
+		// largest user keys of that file as cmp_smallest and cmp_largest
+		// (cmp_largest is only needed if cmp_smallest > 0).  Set
+		// [*left, *right) to the range of files of level+1 that the first
+		// file whose largest key is >= key falls in: it is *right if no
+		// file of the range qualifies, in which case the level holds no
+		// entry for key.
+		void GetNextLevelIndex(int level, size_t file_index, int cmp_smallest,
+				int cmp_largest, uint32_t* left, uint32_t* right) const;
+
+	private:
+		// Bounds in the next level of a file, each the index of the first
+		// file of the next level that ...
+		struct IndexUnit
+		{
+				uint32_t smallest_lb; // ... ends at or after our smallest key
+				uint32_t largest_lb; // ... ends at or after our largest key
+				uint32_t smallest_end; // ... starts after our smallest key
+				uint32_t largest_end; // ... starts after our largest key
+		};
+
+		std::vector<IndexUnit> index_[config::kNumLevels];
+		uint32_t next_level_files_[config::kNumLevels];
+
+		// No copying allowed
+		FileIndexer(const FileIndexer&);
+		void operator=(const FileIndexer&);
+};
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_FILE_INDEXER_H_
@@ -37,6 +37,18 @@ std::string TableFileName(const std::string& name, uint64_t number)
 	return MakeFileName(name, number, "sst");
 }
 
+std::string BlobFileName(const std::string& name, uint64_t number)
+{
+	assert(number > 0);
+	return MakeFileName(name, number, "blob");
+}
+
+std::string ColumnFamilyDirName(const std::string& name, uint32_t id)
+{
+	assert(id > 0);
+	return MakeFileName(name, id, "cf");
+}
+
 std::string DescriptorFileName(const std::string& dbname, uint64_t number)
 {
 	assert(number > 0);
@@ -79,7 +91,7 @@ std::string OldInfoLogFileName(const std::string& dbname)
 //    dbname/LOG
 //    dbname/LOG.old
 //    dbname/MANIFEST-[0-9]+
-//    dbname/[0-9]+.(log|sst)
+//    dbname/[0-9]+.(log|sst|blob|cf)
 bool ParseFileName(const std::string& fname, uint64_t* number, FileType* type)
 {
 	Slice rest(fname);
@@ -135,6 +147,14 @@ bool ParseFileName(const std::string& fname, uint64_t* number, FileType* type)
 		{
 			*type = kTempFile;
 		}
+		else if ( suffix == Slice(".blob") )
+		{
+			*type = kBlobFile;
+		}
+		else if ( suffix == Slice(".cf") )
+		{
+			*type = kColumnFamilyDir;
+		}
 		else
 		{
 			return false;
@@ -26,7 +26,9 @@ enum FileType
 	kDescriptorFile,
 	kCurrentFile,
 	kTempFile,
-	kInfoLogFile
+	kInfoLogFile,
+	kBlobFile,
+	kColumnFamilyDir
 // Either the current one, or an old one
 };
 
@@ -40,6 +42,17 @@ extern std::string LogFileName(const std::string& dbname, uint64_t number);
 // "dbname".
 extern std::string TableFileName(const std::string& dbname, uint64_t number);
 
+// Return the name of the blob file with the specified number
+// in the db named by "dbname".  The result will be prefixed with
+// "dbname".
+extern std::string BlobFileName(const std::string& dbname, uint64_t number);
+
+// Return the name of the directory holding the column family with the
+// specified id in the db named by "dbname".  The result will be prefixed
+// with "dbname".
+extern std::string ColumnFamilyDirName(const std::string& dbname,
+		uint32_t id);
+
 // Return the name of the descriptor file for the db named by
 // "dbname" and the specified incarnation number.  The result will be
 // prefixed with "dbname".
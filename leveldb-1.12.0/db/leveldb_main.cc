@@ -89,6 +89,16 @@ class WriteBatchItemPrinter: public WriteBatch::Handler
 		{
 			printf("  del '%s'\n", EscapeString(key).c_str());
 		}
+		virtual void Merge(const Slice& key, const Slice& value)
+		{
+			printf("  merge '%s' '%s'\n", EscapeString(key).c_str(),
+					EscapeString(value).c_str());
+		}
+		virtual void DeleteRange(const Slice& begin_key, const Slice& end_key)
+		{
+			printf("  delete-range '%s' '%s'\n", EscapeString(begin_key).c_str(),
+					EscapeString(end_key).c_str());
+		}
 };
 
 // Called on every log record (each one of which is a WriteBatch)
@@ -166,45 +176,62 @@ bool DumpTable(Env* env, const std::string& fname)
 
 	ReadOptions ro;
 	ro.fill_cache = false;
-	Iterator* iter = table->NewIterator(ro);
-	for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+	// Point entries, then range deletions (kept in a block of their own)
+	Iterator* iters[2] = { table->NewIterator(ro), table->NewRangeDelIterator() };
+	for (int i = 0; i < 2; i++)
 	{
-		ParsedInternalKey key;
-		if ( !ParseInternalKey(iter->key(), &key) )
-		{
-			printf("badkey '%s' => '%s'\n", EscapeString(iter->key()).c_str(),
-					EscapeString(iter->value()).c_str());
-		}
-		else
+		Iterator* iter = iters[i];
+		for (iter->SeekToFirst(); iter->Valid(); iter->Next())
 		{
-			char kbuf[20];
-			const char* type;
-			if ( key.type == kTypeDeletion )
+			ParsedInternalKey key;
+			if ( !ParseInternalKey(iter->key(), &key) )
 			{
-				type = "del";
-			}
-			else if ( key.type == kTypeValue )
-			{
-				type = "val";
+				printf("badkey '%s' => '%s'\n", EscapeString(iter->key()).c_str(),
+						EscapeString(iter->value()).c_str());
 			}
 			else
 			{
-				snprintf(kbuf, sizeof(kbuf), "%d", static_cast<int> (key.type));
-				type = kbuf;
+				char kbuf[20];
+				const char* type;
+				if ( key.type == kTypeDeletion )
+				{
+					type = "del";
+				}
+				else if ( key.type == kTypeValue )
+				{
+					type = "val";
+				}
+				else if ( key.type == kTypeMerge )
+				{
+					type = "merge";
+				}
+				else if ( key.type == kTypeRangeDeletion )
+				{
+					type = "range-del";
+				}
+				else if ( key.type == kTypeBlobIndex )
+				{
+					type = "blob";
+				}
+				else
+				{
+					snprintf(kbuf, sizeof(kbuf), "%d", static_cast<int> (key.type));
+					type = kbuf;
+				}
+				printf("'%s' @ %8llu : %s => '%s'\n",
+						EscapeString(key.user_key).c_str(),
+						static_cast<unsigned long long> (key.sequence), type,
+						EscapeString(iter->value()).c_str());
 			}
-			printf("'%s' @ %8llu : %s => '%s'\n",
-					EscapeString(key.user_key).c_str(),
-					static_cast<unsigned long long> (key.sequence), type,
-					EscapeString(iter->value()).c_str());
 		}
-	}
-	s = iter->status();
-	if ( !s.ok() )
-	{
-		printf("iterator error: %s\n", s.ToString().c_str());
+		s = iter->status();
+		if ( !s.ok() )
+		{
+			printf("iterator error: %s\n", s.ToString().c_str());
+		}
+		delete iter;
 	}
 
-	delete iter;
 	delete table;
 	delete file;
 	return true;
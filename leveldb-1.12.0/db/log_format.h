@@ -23,15 +23,28 @@ enum RecordType
 	// For fragments
 	kFirstType = 2,
 	kMiddleType = 3,
-	kLastType = 4
+	kLastType = 4,
+
+	// The same, in a log whose file may be reused for a later log (see
+	// Options::recycle_log_file_num).  The header also holds the log
+	// number, which tells the records of this log from those left behind
+	// by the previous use of the file.
+	kRecyclableFullType = 5,
+	kRecyclableFirstType = 6,
+	kRecyclableMiddleType = 7,
+	kRecyclableLastType = 8
 };
-static const int kMaxRecordType = kLastType;
+static const int kMaxRecordType = kRecyclableLastType;
 
 static const int kBlockSize = 32768; //32K，每个block的大小
 
 // Header is checksum (4 bytes), type (1 byte), length (2 bytes).
 static const int kHeaderSize = 4 + 1 + 2;
 
+// Recyclable header is checksum (4 bytes), length (2 bytes), type (1 byte),
+// log number (4 bytes).
+static const int kRecyclableHeaderSize = kHeaderSize + 4;
+
 } // namespace log
 } // namespace leveldb
 
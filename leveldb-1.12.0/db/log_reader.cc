@@ -19,10 +19,11 @@ Reader::Reporter::~Reporter()
 }
 
 Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
-		uint64_t initial_offset) :
+		uint64_t initial_offset, uint64_t log_number) :
 	file_(file), reporter_(reporter), checksum_(checksum), backing_store_(
 			new char[kBlockSize]), buffer_(), eof_(false), last_record_offset_(
-			0), end_of_buffer_offset_(0), initial_offset_(initial_offset)
+			0), end_of_buffer_offset_(0), initial_offset_(initial_offset),
+			log_number_(log_number), recycled_(false)
 {
 }
 
@@ -167,6 +168,15 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch)
 			}
 			return false;
 
+		case kOldRecord:
+			if ( in_fragmented_record )
+			{
+				ReportCorruption(scratch->size(),
+						"partial record without end(4)");
+				scratch->clear();
+			}
+			return false;
+
 		case kBadRecord: //坏记录
 			if ( in_fragmented_record )
 			{
@@ -257,10 +267,19 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result)
 		const uint32_t b = static_cast<uint32_t> (header[5]) & 0xff;
 		const unsigned int type = header[6];
 		const uint32_t length = a | (b << 8);
-		if ( kHeaderSize + length > buffer_.size() )
+		const bool recyclable = (type >= kRecyclableFullType && type
+				<= kRecyclableLastType);
+		const size_t header_size = recyclable ? kRecyclableHeaderSize
+				: kHeaderSize;
+		if ( header_size + length > buffer_.size() )
 		{
 			size_t drop_size = buffer_.size();
 			buffer_.clear();
+			if ( recycled_ )
+			{
+				// A torn write or a record of the previous log
+				return kOldRecord;
+			}
 			ReportCorruption(drop_size, "bad record length");
 			return kBadRecord;
 		}
@@ -274,11 +293,25 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result)
 			return kBadRecord;
 		}
 
+		if ( recycled_ && !recyclable )
+		{
+			// Left over from a use of the file before log recycling
+			buffer_.clear();
+			return kOldRecord;
+		}
+		if ( recyclable && log_number_ != 0 && DecodeFixed32(header
+				+ kHeaderSize) != static_cast<uint32_t> (log_number_) )
+		{
+			buffer_.clear();
+			return kOldRecord;
+		}
+
 		// Check crc
 		if ( checksum_ )
 		{
 			uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
-			uint32_t actual_crc = crc32c::Value(header + 6, 1 + length);
+			uint32_t actual_crc = crc32c::Value(header + 6, header_size - 6
+					+ length);
 			if ( actual_crc != expected_crc )
 			{
 				// Drop the rest of the buffer since "length" itself may have
@@ -287,23 +320,31 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result)
 				// like a valid log record.
 				size_t drop_size = buffer_.size();
 				buffer_.clear();
+				if ( recycled_ )
+				{
+					return kOldRecord;
+				}
 				ReportCorruption(drop_size, "checksum mismatch");
 				return kBadRecord;
 			}
 		}
 
-		buffer_.remove_prefix(kHeaderSize + length);
+		buffer_.remove_prefix(header_size + length);
+		if ( recyclable )
+		{
+			recycled_ = true;
+		}
 
 		// Skip physical record that started before initial_offset_
-		if ( end_of_buffer_offset_ - buffer_.size() - kHeaderSize - length
+		if ( end_of_buffer_offset_ - buffer_.size() - header_size - length
 				< initial_offset_ )
 		{
 			result->clear();
 			return kBadRecord;
 		}
 
-		*result = Slice(header + kHeaderSize, length);
-		return type;
+		*result = Slice(header + header_size, length);
+		return recyclable ? type - (kRecyclableFullType - kFullType) : type;
 	} // endof while(true)
 }
 
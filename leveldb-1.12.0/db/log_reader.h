@@ -45,8 +45,11 @@ class Reader
 		//
 		// The Reader will start reading at the first record located at physical
 		// position >= initial_offset within the file.
+		//
+		// If "log_number" is non-zero, the log ends at the first recyclable
+		// record of another log (see log::Writer).
 		Reader(SequentialFile* file, Reporter* reporter, bool checksum,
-				uint64_t initial_offset);
+				uint64_t initial_offset, uint64_t log_number = 0);
 
 		~Reader();
 
@@ -78,6 +81,12 @@ class Reader
 		// Offset at which to start looking for the first record to return
 		uint64_t const initial_offset_; //偏移（在文件中的），通过该偏移，计算属于哪个block.
 
+		uint64_t const log_number_;
+
+		// A recyclable record was read: the file may be a reused one, whose
+		// tail is left over from its previous log
+		bool recycled_;
+
 		// Extend record types with the following special values
 		enum
 		{
@@ -87,7 +96,10 @@ class Reader
 			// * The record has an invalid CRC (ReadPhysicalRecord reports a drop)
 			// * The record is a 0-length record (No drop is reported)
 			// * The record is below constructor's initial_offset (No drop is reported)
-			kBadRecord = kMaxRecordType + 2
+			kBadRecord = kMaxRecordType + 2,
+			// Returned for what follows the records of a reused log file.
+			// Ends the log without reporting a drop.
+			kOldRecord = kMaxRecordType + 3
 		};
 
 		// Skips all blocks that are completely before "initial_offset_".
@@ -276,6 +276,39 @@ class LogTest
 			delete offset_reader;
 		}
 
+		// Write the records of log #2 over the start of a file holding
+		// those of log #1, as when the file of #1 is reused, and return
+		// what reading it back as log #2 yields.
+		std::string ReadRecycled(bool old_recyclable)
+		{
+			StringDest old_dest;
+			Writer old_writer(&old_dest, 1, old_recyclable, 0);
+			for (int i = 0; i < 8; i++)
+			{
+				old_writer.AddRecord(BigString("old", 20000));
+			}
+			StringDest new_dest;
+			Writer new_writer(&new_dest, 2, true, 0);
+			new_writer.AddRecord(Slice("small"));
+			new_writer.AddRecord(BigString("new", 50000));
+			std::string contents = old_dest.contents_;
+			contents.replace(0, new_dest.contents_.size(), new_dest.contents_);
+
+			StringSource source;
+			source.contents_ = Slice(contents);
+			Reader reader(&source, &report_, true/*checksum*/,
+					0/*initial_offset*/, 2);
+			std::string result;
+			std::string scratch;
+			Slice record;
+			while (reader.ReadRecord(&record, &scratch))
+			{
+				result.append(record.size() > 10 ? record.ToString().substr(0,
+						3) : record.ToString());
+				result.append(",");
+			}
+			return result;
+		}
 };
 
 size_t LogTest::initial_offset_record_sizes_[] =
@@ -580,6 +613,18 @@ TEST(LogTest, ReadPastEnd)
 	CheckOffsetPastEndReturnsNoRecords(5);
 }
 
+TEST(LogTest, RecycledLog)
+{
+	ASSERT_EQ("small,new,", ReadRecycled(true));
+	ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, RecycledLogOverPlainLog)
+{
+	ASSERT_EQ("small,new,", ReadRecycled(false));
+	ASSERT_EQ(0, DroppedBytes());
+}
+
 } // namespace log
 } // namespace leveldb
 
@@ -15,12 +15,31 @@ namespace log
 {
 
 Writer::Writer(WritableFile* dest) :
-	dest_(dest), block_offset_(0)
+	dest_(dest), block_offset_(0), log_number_(0), recyclable_(false),
+			bytes_per_sync_(0), file_offset_(0), synced_offset_(0)
+{
+	Init();
+}
+
+Writer::Writer(WritableFile* dest, uint64_t log_number, bool recyclable,
+		uint64_t bytes_per_sync) :
+	dest_(dest), block_offset_(0), log_number_(log_number), recyclable_(
+			recyclable), bytes_per_sync_(bytes_per_sync), file_offset_(0),
+			synced_offset_(0)
+{
+	Init();
+}
+
+void Writer::Init()
 {
 	for (int i = 0; i <= kMaxRecordType; i++)
 	{
-		char t = static_cast<char> (i);
-		type_crc_[i] = crc32c::Value(&t, 1);
+		// The crc of a recyclable record also covers the log number that
+		// follows the type
+		char buf[5];
+		buf[0] = static_cast<char> (i);
+		EncodeFixed32(buf + 1, static_cast<uint32_t> (log_number_));
+		type_crc_[i] = crc32c::Value(buf, i >= kRecyclableFullType ? 5 : 1);
 	}
 }
 
@@ -40,28 +59,32 @@ Status Writer::AddRecord(const Slice& slice)
 	// zero-length record
 	Status s;
 	bool begin = true;
+	const int header_size = recyclable_ ? kRecyclableHeaderSize : kHeaderSize;
 	do
 	{
 		// 该block剩下的大小
 		const int leftover = kBlockSize - block_offset_;
 		assert(leftover >= 0);
 		//剩下的长度小于头部长度，用0来填充.
-		if ( leftover < kHeaderSize )
+		if ( leftover < header_size )
 		{
 			// Switch to a new block
 			if ( leftover > 0 )
 			{
-				// Fill the trailer (literal below relies on kHeaderSize being 7)
-				assert(kHeaderSize == 7);
-				dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
+				// Fill the trailer (literal below relies on
+				// kRecyclableHeaderSize being 11)
+				assert(kRecyclableHeaderSize == 11);
+				dest_->Append(Slice("\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00",
+						leftover));
+				file_offset_ += leftover;
 			}
 			block_offset_ = 0;
 		}
 
-		// Invariant: we never leave < kHeaderSize bytes in a block.
-		assert(kBlockSize - block_offset_ - kHeaderSize >= 0);
+		// Invariant: we never leave < header_size bytes in a block.
+		assert(kBlockSize - block_offset_ - header_size >= 0);
 
-		const size_t avail = kBlockSize - block_offset_ - kHeaderSize; //该block剩下可用长度
+		const size_t avail = kBlockSize - block_offset_ - header_size; //该block剩下可用长度
 		const size_t fragment_length = (left < avail) ? left : avail; //可以填充的长度.
 
 		RecordType type;
@@ -82,26 +105,44 @@ Status Writer::AddRecord(const Slice& slice)
 		{
 			type = kMiddleType;
 		}
+		if ( recyclable_ )
+		{
+			type = static_cast<RecordType> (type + kRecyclableFullType
+					- kFullType);
+		}
 
 		s = EmitPhysicalRecord(type, ptr, fragment_length);
 		ptr += fragment_length;
 		left -= fragment_length;
 		begin = false;
 	} while (s.ok() && left > 0);
+
+	if ( s.ok() && bytes_per_sync_ > 0 && file_offset_ - synced_offset_
+			>= bytes_per_sync_ )
+	{
+		s = dest_->RangeSync(synced_offset_, file_offset_ - synced_offset_);
+		synced_offset_ = file_offset_;
+	}
 	return s;
 }
 
 Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t n)
 {
+	const size_t header_size = recyclable_ ? kRecyclableHeaderSize
+			: kHeaderSize;
 	assert(n <= 0xffff); // Must fit in two bytes
-	assert(block_offset_ + kHeaderSize + n <= kBlockSize);
+	assert(block_offset_ + header_size + n <= kBlockSize);
 
 	// Format the header
-	char buf[kHeaderSize]; //32bit, CRC; 16bit, len; 8bit, type.
+	char buf[kRecyclableHeaderSize]; //32bit, CRC; 16bit, len; 8bit, type.
 	// little-endian
 	buf[4] = static_cast<char> (n & 0xff); //先存小的
 	buf[5] = static_cast<char> (n >> 8); //后存大的
 	buf[6] = static_cast<char> (t);
+	if ( recyclable_ )
+	{
+		EncodeFixed32(buf + kHeaderSize, static_cast<uint32_t> (log_number_));
+	}
 
 	// Compute the crc of the record type and the payload.
 	uint32_t crc = crc32c::Extend(type_crc_[t], ptr, n);
@@ -109,7 +150,7 @@ Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t n)
 	EncodeFixed32(buf, crc);
 
 	// Write the header and the payload
-	Status s = dest_->Append(Slice(buf, kHeaderSize)); //写头部信息
+	Status s = dest_->Append(Slice(buf, header_size)); //写头部信息
 	if ( s.ok() )
 	{
 		s = dest_->Append(Slice(ptr, n));
@@ -118,7 +159,8 @@ Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t n)
 			s = dest_->Flush();
 		}
 	}
-	block_offset_ += kHeaderSize + n;
+	block_offset_ += header_size + n;
+	file_offset_ += header_size + n;
 	return s;
 }
 
@@ -26,6 +26,15 @@ class Writer
 		// "*dest" must be initially empty.
 		// "*dest" must remain live while this Writer is in use.
 		explicit Writer(WritableFile* dest);
+
+		// Create a writer for the log numbered "log_number".  If
+		// "recyclable", the records carry the log number so that "*dest"
+		// may be a reused file that still holds an older log (see
+		// Env::ReuseWritableFile).  If "bytes_per_sync" is non-zero, the
+		// writeback of the appended data is started every time that many
+		// bytes have been added (see WritableFile::RangeSync).
+		Writer(WritableFile* dest, uint64_t log_number, bool recyclable,
+				uint64_t bytes_per_sync);
 		~Writer();
 
 		Status AddRecord(const Slice& slice);
@@ -33,12 +42,19 @@ class Writer
 	private:
 		WritableFile* dest_;
 		int block_offset_; // Current offset in block，当前指针在block中的偏移
+		const uint64_t log_number_;
+		const bool recyclable_;
+		const uint64_t bytes_per_sync_;
+		uint64_t file_offset_; // Bytes appended to dest_
+		uint64_t synced_offset_; // Writeback started up to here
 
 		// crc32c values for all supported record types.  These are
 		// pre-computed to reduce the overhead of computing the crc of the
 		// record type stored in the header.
 		uint32_t type_crc_[kMaxRecordType + 1];
 
+		void Init();
+
 		// 写物理磁盘
 		Status EmitPhysicalRecord(RecordType type, const char* ptr,
 				size_t length);
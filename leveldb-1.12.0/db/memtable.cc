@@ -3,11 +3,17 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "db/memtable.h"
+
+#include <algorithm>
 #include "db/dbformat.h"
+#include "db/merge_context.h"
+#include "db/range_del.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "leveldb/write_buffer_manager.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
 
 namespace leveldb
 {
@@ -20,14 +26,38 @@ static Slice GetLengthPrefixedSlice(const char* data)
 	return Slice(p, len);
 }
 
-MemTable::MemTable(const InternalKeyComparator& cmp) :
-	comparator_(cmp), refs_(0), table_(comparator_, &arena_)
+MemTable::MemTable(const InternalKeyComparator& cmp,
+		WriteBufferManager* write_buffer_manager) :
+	comparator_(cmp), refs_(0), table_(comparator_, &arena_),
+			range_del_table_(comparator_, &arena_), num_range_dels_(0),
+			range_dels_(NULL), range_dels_built_(0), write_buffer_manager_(
+					write_buffer_manager), charged_(0)
 {
+	ChargeWriteBuffer();
 }
 
 MemTable::~MemTable()
 {
 	assert(refs_ == 0);
+	if ( range_dels_ != NULL )
+	{
+		range_dels_->Unref();
+	}
+	if ( write_buffer_manager_ != NULL )
+	{
+		write_buffer_manager_->FreeMem(charged_);
+	}
+}
+
+// The arena grows a block at a time, so the manager hears of few changes
+void MemTable::ChargeWriteBuffer()
+{
+	const size_t usage = arena_.MemoryUsage();
+	if ( write_buffer_manager_ != NULL && usage > charged_ )
+	{
+		write_buffer_manager_->ReserveMem(usage - charged_);
+		charged_ = usage;
+	}
 }
 
 size_t MemTable::ApproximateMemoryUsage()
@@ -115,6 +145,11 @@ Iterator* MemTable::NewIterator()
 	return new MemTableIterator(&table_);
 }
 
+Iterator* MemTable::NewRangeDelIterator()
+{
+	return new MemTableIterator(&range_del_table_);
+}
+
 // 将k, v编码后，存入到arena_分配的内存中，同时将该内存加入到 table_(即SkipList中)
 void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
 		const Slice& value)
@@ -138,17 +173,79 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
 	p = EncodeVarint32(p, val_size);
 	memcpy(p, value.data(), val_size);
 	assert((p + val_size) - buf == encoded_len);
-	table_.Insert(buf); // k-v 都放到里面
+	if ( type == kTypeRangeDeletion )
+	{
+		range_del_table_.Insert(buf);
+		MutexLock l(&range_del_mutex_);
+		num_range_dels_++;
+	}
+	else
+	{
+		table_.Insert(buf); // k-v 都放到里面
+	}
+	ChargeWriteBuffer();
+}
+
+
+FragmentedRangeTombstones* MemTable::RefRangeDels()
+{
+	// Most memtables hold no range deletion; spare them the mutex
+	Table::Iterator iter(&range_del_table_);
+	iter.SeekToFirst();
+	if ( !iter.Valid() )
+	{
+		return NULL;
+	}
+
+	MutexLock l(&range_del_mutex_);
+	// An entry is counted before its sequence number is published, so a
+	// build from at least num_range_dels_ entries holds all a reader sees
+	if ( range_dels_ == NULL || range_dels_built_ != num_range_dels_ )
+	{
+		const int count = num_range_dels_;
+		MemTableIterator entries(&range_del_table_);
+		FragmentedRangeTombstones* range_dels = new FragmentedRangeTombstones(
+				comparator_.comparator.user_comparator());
+		range_dels->Ref();
+		range_dels->Build(&entries); // Cannot fail on a memtable
+		if ( range_dels_ != NULL )
+		{
+			range_dels_->Unref();
+		}
+		range_dels_ = range_dels;
+		range_dels_built_ = count;
+	}
+	range_dels_->Ref();
+	return range_dels_;
 }
 
+void MemTable::ReleaseRangeDels(FragmentedRangeTombstones* range_dels)
+{
+	MutexLock l(&range_del_mutex_);
+	range_dels->Unref();
+}
 
 // 通过SkipList中的iter找到该key，并获取数据
-bool MemTable::Get(const LookupKey& key, std::string* value, Status* s)
+bool MemTable::Get(const LookupKey& key, std::string* value, Status* s,
+		MergeContext* merge, SequenceNumber* range_del_seq, Slice* pinned)
 {
 	Slice memkey = key.memtable_key();
+	FragmentedRangeTombstones* range_dels = RefRangeDels();
+	if ( range_dels != NULL )
+	{
+		Slice ikey = key.internal_key();
+		SequenceNumber snapshot = DecodeFixed64(ikey.data() + ikey.size() - 8)
+				>> 8;
+		*range_del_seq = std::max(*range_del_seq,
+				range_dels->MaxCoveringSequence(key.user_key(), snapshot));
+		ReleaseRangeDels(range_dels);
+	}
+
 	Table::Iterator iter(&table_);
 	iter.Seek(memkey.data());
-	if ( iter.Valid() )
+	// Merge operands do not hide older entries, so keep walking the
+	// entries for this user key until one that does.
+	for (; iter.Valid(); iter.Next())
 	{
 		// entry format is:
 		//    klength  varint32
@@ -163,22 +260,52 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s)
 		uint32_t key_length;
 		const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
 		if ( comparator_.comparator.user_comparator()->Compare(Slice(key_ptr,
-				key_length - 8), key.user_key()) == 0 )
+				key_length - 8), key.user_key()) != 0 )
 		{
-			// Correct user key
-			const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
-			switch (static_cast<ValueType> (tag & 0xff))
+			break;
+		}
+
+		// Correct user key
+		const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+		ValueType type = static_cast<ValueType> (tag & 0xff);
+		if ( (tag >> 8) < *range_del_seq )
+		{
+			type = kTypeDeletion; // Covered by a range deletion
+		}
+		switch (type)
+		{
+		case kTypeValue:
+		{
+			Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+			if ( merge->empty() && pinned != NULL )
 			{
-			case kTypeValue:
+				*pinned = v;
+			}
+			else if ( merge->empty() )
 			{
-				Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
 				value->assign(v.data(), v.size());
-				return true;
 			}
-			case kTypeDeletion:
+			else
+			{
+				*s = merge->Finish(key.user_key(), &v, value);
+			}
+			return true;
+		}
+		case kTypeDeletion:
+			if ( merge->empty() )
+			{
 				*s = Status::NotFound(Slice());
-				return true;
 			}
+			else
+			{
+				*s = merge->Finish(key.user_key(), NULL, value);
+			}
+			return true;
+		case kTypeMerge:
+			merge->AddOlder(GetLengthPrefixedSlice(key_ptr + key_length));
+			break;
+		default:
+			break;
 		}
 	}
 	return false;
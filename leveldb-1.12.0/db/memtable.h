@@ -9,14 +9,18 @@
 #include "leveldb/db.h"
 #include "db/dbformat.h"
 #include "db/skiplist.h"
+#include "port/port.h"
 #include "util/arena.h"
 
 namespace leveldb
 {
 
+class FragmentedRangeTombstones;
 class InternalKeyComparator;
+class MergeContext;
 class Mutex;
 class MemTableIterator;
+class WriteBufferManager;
 
 // Memtable类只是一个接口类，真正的操作是通过背后的SkipList来做的，包括插入操作和读取操作等，
 // 所以Memtable的核心数据结构是一个SkipList。
@@ -26,7 +30,9 @@ class MemTable
 	public:
 		// MemTables are reference counted.  The initial reference count
 		// is zero and the caller must call Ref() at least once.
-		explicit MemTable(const InternalKeyComparator& comparator);
+		// Its memory is accounted to "write_buffer_manager" if non-NULL.
+		explicit MemTable(const InternalKeyComparator& comparator,
+				WriteBufferManager* write_buffer_manager = NULL);
 
 		// Increase reference count.
 		void Ref()
@@ -60,21 +66,45 @@ class MemTable
 		// db/format.{h,cc} module.
 		Iterator* NewIterator();
 
+		// Return an iterator over the range deletions in the memtable, which
+		// NewIterator() does not yield.  Same lifetime rules as NewIterator().
+		Iterator* NewRangeDelIterator();
+
 		// Add an entry into memtable that maps key to value at the
 		// specified sequence number and with the specified type.
 		// Typically value will be empty if type==kTypeDeletion.
+		// For kTypeRangeDeletion, key..value is the deleted range.
 		void Add(SequenceNumber seq, ValueType type, const Slice& key,
 				const Slice& value);
 
 		// If memtable contains a value for key, store it in *value and return true.
 		// If memtable contains a deletion for key, store a NotFound() error
 		// in *status and return true.
+		// Merge operands met on the way are added to *merge and applied to
+		// the value (or deletion) they sit on; if they sit on nothing in this
+		// memtable, they stay in *merge for the caller to resolve.
+		// Entries older than *range_del_seq are taken as deleted; it is
+		// raised by the range deletions of this memtable covering key.
+		// If "pinned" is non-NULL, a value needing no merge is stored there,
+		// pointing into the memtable, instead of being copied to *value.
 		// Else, return false.
-		bool Get(const LookupKey& key, std::string* value, Status* s);
+		bool Get(const LookupKey& key, std::string* value, Status* s,
+				MergeContext* merge, SequenceNumber* range_del_seq,
+				Slice* pinned = NULL);
 
 	private:
 		~MemTable(); // Private since only Unref() should be used to delete it
 
+		// Report the growth of arena_ to write_buffer_manager_
+		void ChargeWriteBuffer();
+
+		// Return the range deletions of the memtable, fragmented, or NULL if
+		// there are none.  They are fragmented again when range deletions
+		// were added since the last call.  The caller must release the
+		// result with ReleaseRangeDels().
+		FragmentedRangeTombstones* RefRangeDels();
+		void ReleaseRangeDels(FragmentedRangeTombstones* range_dels);
+
 		struct KeyComparator
 		{
 				const InternalKeyComparator comparator;
@@ -93,6 +123,14 @@ class MemTable
 		int refs_;
 		Arena arena_; // k-v都经过编码，放到arena_里面.
 		Table table_; // SkipList
+		Table range_del_table_; // Range deletions, kept apart from table_
+
+		port::Mutex range_del_mutex_;
+		int num_range_dels_; // Entries added to range_del_table_
+		FragmentedRangeTombstones* range_dels_; // Built from range_del_table_
+		int range_dels_built_; // ... when it held this many entries
+		WriteBufferManager* write_buffer_manager_;
+		size_t charged_; // Bytes reported to write_buffer_manager_
 
 		// No copying allowed
 		MemTable(const MemTable&);
@@ -0,0 +1,40 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/merge_context.h"
+
+#include <vector>
+#include "leveldb/merge_operator.h"
+
+namespace leveldb
+{
+
+Status MergeContext::Finish(const Slice& user_key, const Slice* base,
+		std::string* value) const
+{
+	assert(!operands_.empty());
+	if ( op_ == NULL )
+	{
+		return Status::InvalidArgument("merge operand found but no "
+			"merge_operator is set for ", user_key);
+	}
+
+	std::vector<Slice> operands;
+	operands.reserve(operands_.size());
+	for (size_t i = 0; i < operands_.size(); i++)
+	{
+		operands.push_back(operands_[i]);
+	}
+
+	// *base may point into *value, so merge into a temporary first
+	std::string result;
+	if ( !op_->Merge(user_key, base, &operands[0], operands.size(), &result) )
+	{
+		return Status::Corruption("merge operator failed for ", user_key);
+	}
+	value->swap(result);
+	return Status::OK();
+}
+
+} // namespace leveldb
@@ -0,0 +1,71 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
+#define STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
+
+#include <deque>
+#include <string>
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb
+{
+
+class MergeOperator;
+
+// Collects the merge operands (kTypeMerge entries) met while looking up a
+// single user key, until the value they apply to is found.
+//
+// 收集同一个user key的merge操作数，找到base value后再合并
+class MergeContext
+{
+	public:
+		explicit MergeContext(const MergeOperator* op) :
+			op_(op)
+		{
+		}
+
+		// Add an operand older than all operands collected so far.
+		// Used when scanning entries from newest to oldest.
+		void AddOlder(const Slice& operand)
+		{
+			operands_.push_front(operand.ToString());
+		}
+
+		// Add an operand newer than all operands collected so far.
+		// Used when scanning entries from oldest to newest.
+		void AddNewer(const Slice& operand)
+		{
+			operands_.push_back(operand.ToString());
+		}
+
+		bool empty() const
+		{
+			return operands_.empty();
+		}
+
+		void Clear()
+		{
+			operands_.clear();
+		}
+
+		// Apply the collected operands to *base (NULL if the key has no
+		// value) and store the result in *value.
+		// REQUIRES: !empty()
+		Status Finish(const Slice& user_key, const Slice* base,
+				std::string* value) const;
+
+	private:
+		const MergeOperator* const op_;
+		std::deque<std::string> operands_; // Oldest first
+
+		// No copying allowed
+		MergeContext(const MergeContext&);
+		void operator=(const MergeContext&);
+};
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
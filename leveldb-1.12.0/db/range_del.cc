@@ -0,0 +1,272 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_del.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include "leveldb/comparator.h"
+
+namespace leveldb
+{
+
+bool ParseRangeTombstone(const Slice& key, const Slice& value,
+		RangeTombstone* t)
+{
+	ParsedInternalKey ikey;
+	if ( !ParseInternalKey(key, &ikey) || ikey.type != kTypeRangeDeletion )
+	{
+		return false;
+	}
+	t->begin.assign(ikey.user_key.data(), ikey.user_key.size());
+	t->end.assign(value.data(), value.size());
+	t->sequence = ikey.sequence;
+	return true;
+}
+
+void ExtendBoundsForTombstone(const InternalKeyComparator& icmp,
+		const RangeTombstone& t, bool* has_bounds, InternalKey* smallest,
+		InternalKey* largest)
+{
+	InternalKey lower(t.begin, t.sequence, kTypeRangeDeletion);
+	InternalKey upper(t.end, kMaxSequenceNumber, kTypeRangeDeletion);
+	if ( !*has_bounds || icmp.Compare(lower, *smallest) < 0 )
+	{
+		*smallest = lower;
+	}
+	if ( !*has_bounds || icmp.Compare(upper, *largest) > 0 )
+	{
+		*largest = upper;
+	}
+	*has_bounds = true;
+}
+
+namespace
+{
+struct UserKeyLess
+{
+		const Comparator* ucmp;
+		explicit UserKeyLess(const Comparator* c) :
+			ucmp(c)
+		{
+		}
+		bool operator()(const std::string& a, const std::string& b) const
+		{
+			return ucmp->Compare(a, b) < 0;
+		}
+		bool operator()(const Slice& a, const std::string& b) const
+		{
+			return ucmp->Compare(a, b) < 0;
+		}
+		bool operator()(const std::string& a, const Slice& b) const
+		{
+			return ucmp->Compare(a, b) < 0;
+		}
+};
+struct UserKeyEqual
+{
+		const Comparator* ucmp;
+		explicit UserKeyEqual(const Comparator* c) :
+			ucmp(c)
+		{
+		}
+		bool operator()(const std::string& a, const std::string& b) const
+		{
+			return ucmp->Compare(a, b) == 0;
+		}
+};
+
+// Sort *bounds and drop duplicates, leaving the starts of the fragments
+static void SortBounds(const Comparator* ucmp, std::vector<std::string>* bounds)
+{
+	std::sort(bounds->begin(), bounds->end(), UserKeyLess(ucmp));
+	bounds->erase(std::unique(bounds->begin(), bounds->end(),
+			UserKeyEqual(ucmp)), bounds->end());
+}
+
+// Set [*first, *last) to the fragments of "bounds" that t covers
+static void CoveredFragments(const Comparator* ucmp,
+		const std::vector<std::string>& bounds, const RangeTombstone& t,
+		size_t* first, size_t* last)
+{
+	*first = std::lower_bound(bounds.begin(), bounds.end(), t.begin,
+			UserKeyLess(ucmp)) - bounds.begin();
+	*last = std::lower_bound(bounds.begin(), bounds.end(), t.end,
+			UserKeyLess(ucmp)) - bounds.begin();
+}
+
+// Index of the fragment of "bounds" holding user_key, or bounds.size() if
+// there is none
+static size_t FragmentOf(const Comparator* ucmp,
+		const std::vector<std::string>& bounds, const Slice& user_key)
+{
+	// The fragment starts at the last bound <= user_key
+	std::vector<std::string>::const_iterator it = std::upper_bound(
+			bounds.begin(), bounds.end(), user_key, UserKeyLess(ucmp));
+	if ( it == bounds.begin() || it == bounds.end() )
+	{
+		return bounds.size();
+	}
+	return (it - bounds.begin()) - 1;
+}
+
+// Orders (fragment, sequence) pairs by fragment, then newest first
+struct FragmentSeqLess
+{
+		bool operator()(const std::pair<size_t, SequenceNumber>& a,
+				const std::pair<size_t, SequenceNumber>& b) const
+		{
+			if ( a.first != b.first )
+			{
+				return a.first < b.first;
+			}
+			return a.second > b.second;
+		}
+};
+}
+
+RangeDelAggregator::RangeDelAggregator(const Comparator* user_comparator) :
+	ucmp_(user_comparator)
+{
+}
+
+Status RangeDelAggregator::AddTombstones(Iterator* iter)
+{
+	for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+	{
+		RangeTombstone t;
+		if ( !ParseRangeTombstone(iter->key(), iter->value(), &t) )
+		{
+			return Status::Corruption("corrupted range deletion entry");
+		}
+		tombstones_.push_back(t);
+	}
+	return iter->status();
+}
+
+void RangeDelAggregator::AddTombstone(const RangeTombstone& t)
+{
+	tombstones_.push_back(t);
+}
+
+void RangeDelAggregator::Finish(SequenceNumber snapshot)
+{
+	bounds_.clear();
+	seqs_.clear();
+	for (size_t i = 0; i < tombstones_.size(); i++)
+	{
+		const RangeTombstone& t = tombstones_[i];
+		if ( t.sequence <= snapshot && ucmp_->Compare(t.begin, t.end) < 0 )
+		{
+			bounds_.push_back(t.begin);
+			bounds_.push_back(t.end);
+		}
+	}
+	if ( bounds_.empty() )
+	{
+		return;
+	}
+	SortBounds(ucmp_, &bounds_);
+
+	seqs_.resize(bounds_.size() - 1, 0);
+	for (size_t i = 0; i < tombstones_.size(); i++)
+	{
+		const RangeTombstone& t = tombstones_[i];
+		if ( t.sequence > snapshot || ucmp_->Compare(t.begin, t.end) >= 0 )
+		{
+			continue;
+		}
+		size_t first, last;
+		CoveredFragments(ucmp_, bounds_, t, &first, &last);
+		for (size_t f = first; f < last; f++)
+		{
+			seqs_[f] = std::max(seqs_[f], t.sequence);
+		}
+	}
+}
+
+SequenceNumber RangeDelAggregator::MaxCoveringSequence(const Slice& user_key) const
+{
+	size_t f = FragmentOf(ucmp_, bounds_, user_key);
+	return (f < seqs_.size()) ? seqs_[f] : 0;
+}
+
+FragmentedRangeTombstones::FragmentedRangeTombstones(
+		const Comparator* user_comparator) :
+	ucmp_(user_comparator), refs_(0)
+{
+}
+
+Status FragmentedRangeTombstones::Build(Iterator* iter)
+{
+	std::vector<RangeTombstone> tombstones;
+	for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+	{
+		RangeTombstone t;
+		if ( !ParseRangeTombstone(iter->key(), iter->value(), &t) )
+		{
+			return Status::Corruption("corrupted range deletion entry");
+		}
+		if ( ucmp_->Compare(t.begin, t.end) < 0 )
+		{
+			bounds_.push_back(t.begin);
+			bounds_.push_back(t.end);
+			tombstones.push_back(t);
+		}
+	}
+	if ( !iter->status().ok() )
+	{
+		return iter->status();
+	}
+	SortBounds(ucmp_, &bounds_);
+
+	std::vector<std::pair<size_t, SequenceNumber> > covers;
+	for (size_t i = 0; i < tombstones.size(); i++)
+	{
+		size_t first, last;
+		CoveredFragments(ucmp_, bounds_, tombstones[i], &first, &last);
+		for (size_t f = first; f < last; f++)
+		{
+			covers.push_back(std::make_pair(f, tombstones[i].sequence));
+		}
+	}
+	std::sort(covers.begin(), covers.end(), FragmentSeqLess());
+
+	const size_t num_fragments = bounds_.empty() ? 0 : bounds_.size() - 1;
+	starts_.resize(num_fragments + 1);
+	seqs_.resize(covers.size());
+	size_t c = 0;
+	for (size_t f = 0; f < num_fragments; f++)
+	{
+		starts_[f] = c;
+		while (c < covers.size() && covers[c].first == f)
+		{
+			seqs_[c] = covers[c].second;
+			c++;
+		}
+	}
+	starts_[num_fragments] = c;
+	return Status::OK();
+}
+
+SequenceNumber FragmentedRangeTombstones::MaxCoveringSequence(
+		const Slice& user_key, SequenceNumber snapshot) const
+{
+	size_t f = FragmentOf(ucmp_, bounds_, user_key);
+	if ( f + 1 >= starts_.size() )
+	{
+		return 0;
+	}
+	// The newest sequence number not above snapshot
+	std::vector<SequenceNumber>::const_iterator first = seqs_.begin()
+			+ starts_[f];
+	std::vector<SequenceNumber>::const_iterator last = seqs_.begin()
+			+ starts_[f + 1];
+	std::vector<SequenceNumber>::const_iterator it = std::lower_bound(first,
+			last, snapshot, std::greater<SequenceNumber>());
+	return (it != last) ? *it : 0;
+}
+
+} // namespace leveldb
@@ -0,0 +1,165 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Range deletions (see WriteBatch::DeleteRange) are stored as entries
+// whose internal key is (begin_key, sequence, kTypeRangeDeletion) and whose
+// value is the exclusive end_key.  Such a tombstone hides every entry with
+// a user key in [begin_key, end_key) and a smaller sequence number.
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_DEL_H_
+#define STORAGE_LEVELDB_DB_RANGE_DEL_H_
+
+#include <assert.h>
+#include <string>
+#include <vector>
+#include "db/dbformat.h"
+#include "leveldb/iterator.h"
+
+namespace leveldb
+{
+
+class Comparator;
+
+struct RangeTombstone
+{
+		std::string begin; // Inclusive
+		std::string end; // Exclusive
+		SequenceNumber sequence;
+
+		RangeTombstone() :
+			sequence(0)
+		{
+		}
+		RangeTombstone(const Slice& b, const Slice& e, SequenceNumber s) :
+			begin(b.data(), b.size()), end(e.data(), e.size()), sequence(s)
+		{
+		}
+};
+
+// Decode the range deletion entry "key" => "value".
+extern bool ParseRangeTombstone(const Slice& key, const Slice& value,
+		RangeTombstone* t);
+
+// Widen [*smallest, *largest] to span the keys deleted by t.  If
+// *has_bounds is false the bounds are set from t alone, and it becomes
+// true.  The upper bound is the end key at kMaxSequenceNumber, which
+// sorts before every entry for that (not deleted) key.
+extern void ExtendBoundsForTombstone(const InternalKeyComparator& icmp,
+		const RangeTombstone& t, bool* has_bounds, InternalKey* smallest,
+		InternalKey* largest);
+
+// Collects the range deletions of many sources (memtables, tables) and
+// answers whether an entry is covered by any of them.  Answering is
+// O(log n): the tombstones are cut into disjoint fragments, each carrying
+// the newest sequence number that covers it.
+//
+// 汇总多个来源的范围删除，判断某个entry是否被删除
+class RangeDelAggregator
+{
+	public:
+		explicit RangeDelAggregator(const Comparator* user_comparator);
+
+		// Add the range deletion entries yielded by *iter.  Does not take
+		// ownership of *iter.  Returns the status of *iter.
+		Status AddTombstones(Iterator* iter);
+
+		void AddTombstone(const RangeTombstone& t);
+
+		// Index the tombstones visible at "snapshot".  Must be called after
+		// the last Add and before MaxCoveringSequence()/ShouldDelete().
+		void Finish(SequenceNumber snapshot);
+
+		// All tombstones added, in no particular order.
+		const std::vector<RangeTombstone>& tombstones() const
+		{
+			return tombstones_;
+		}
+
+		bool empty() const
+		{
+			return tombstones_.empty();
+		}
+
+		// Newest sequence number of a visible tombstone covering user_key,
+		// or zero if there is none.
+		SequenceNumber MaxCoveringSequence(const Slice& user_key) const;
+
+		// Is the entry hidden by a visible tombstone?
+		bool ShouldDelete(const ParsedInternalKey& ikey) const
+		{
+			return !bounds_.empty() && ikey.sequence < MaxCoveringSequence(
+					ikey.user_key);
+		}
+
+	private:
+		const Comparator* const ucmp_;
+		std::vector<RangeTombstone> tombstones_;
+
+		// Fragment i is [bounds_[i], bounds_[i+1]), covered up to seqs_[i]
+		std::vector<std::string> bounds_;
+		std::vector<SequenceNumber> seqs_;
+
+		// No copying allowed
+		RangeDelAggregator(const RangeDelAggregator&);
+		void operator=(const RangeDelAggregator&);
+};
+
+// The range deletions of one memtable or table, cut into disjoint
+// fragments once and then shared by the point lookups that consult them.
+// Unlike RangeDelAggregator it answers for any snapshot: each fragment
+// keeps the sequence numbers of all the tombstones covering it.
+//
+// Reference counted like MemTable; Ref() and Unref() need external
+// synchronization.  The initial reference count is zero.
+class FragmentedRangeTombstones
+{
+	public:
+		explicit FragmentedRangeTombstones(const Comparator* user_comparator);
+
+		// Fragment the range deletion entries yielded by *iter.  Does not take
+		// ownership of *iter.  Call once, before any lookup.
+		Status Build(Iterator* iter);
+
+		// Newest sequence number, at most "snapshot", of a tombstone covering
+		// user_key, or zero if there is none.  O(log n).
+		SequenceNumber MaxCoveringSequence(const Slice& user_key,
+				SequenceNumber snapshot) const;
+
+		void Ref()
+		{
+			++refs_;
+		}
+
+		void Unref()
+		{
+			--refs_;
+			assert(refs_ >= 0);
+			if ( refs_ <= 0 )
+			{
+				delete this;
+			}
+		}
+
+	private:
+		~FragmentedRangeTombstones()
+		{
+		}
+
+		const Comparator* const ucmp_;
+		int refs_;
+
+		// Fragment i is [bounds_[i], bounds_[i+1]), covered by the tombstones
+		// with sequence numbers seqs_[starts_[i]..starts_[i+1]), newest first
+		std::vector<std::string> bounds_;
+		std::vector<size_t> starts_;
+		std::vector<SequenceNumber> seqs_;
+
+		// No copying allowed
+		FragmentedRangeTombstones(const FragmentedRangeTombstones&);
+		void operator=(const FragmentedRangeTombstones&);
+};
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_DEL_H_
@@ -14,6 +14,7 @@
 //        all tables (see 2c)
 //      - compaction pointers are cleared
 //      - every table file is added at level 0
+//      - every blob file is kept, as if all its records were referenced
 //
 // Possible optimization 1:
 //   (a) Compute total size and use to pick appropriate max-level M
@@ -31,6 +32,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "db/write_batch_internal.h"
@@ -116,6 +118,7 @@ class Repairer
 
 		std::vector<std::string> manifests_;
 		std::vector<uint64_t> table_numbers_;
+		std::vector<uint64_t> blob_numbers_;
 		std::vector<uint64_t> logs_;
 		std::vector<TableInfo> tables_;
 		uint64_t next_file_number_;
@@ -157,6 +160,10 @@ class Repairer
 						{
 							table_numbers_.push_back(number);
 						}
+						else if ( type == kBlobFile )
+						{
+							blob_numbers_.push_back(number);
+						}
 						else
 						{
 							// Ignore other files
@@ -219,7 +226,7 @@ class Repairer
 			// propagating bad information (like overly large sequence
 			// numbers).
 			log::Reader
-					reader(lfile, &reporter, false/*do not checksum*/, 0/*initial_offset*/);
+					reader(lfile, &reporter, false/*do not checksum*/, 0/*initial_offset*/, log);
 
 			// Read all the records and add to a memtable
 			std::string scratch;
@@ -256,9 +263,11 @@ class Repairer
 			FileMetaData meta;
 			meta.number = next_file_number_++;
 			Iterator* iter = mem->NewIterator();
+			Iterator* range_del_iter = mem->NewRangeDelIterator();
 			status = BuildTable(dbname_, env_, options_, table_cache_, iter,
-					&meta);
+					range_del_iter, NULL, &meta);
 			delete iter;
+			delete range_del_iter;
 			mem->Unref();
 			mem = NULL;
 			if ( status.ok() )
@@ -306,7 +315,7 @@ class Repairer
 			if ( status.ok() )
 			{
 				Iterator* iter = table_cache_->NewIterator(ReadOptions(),
-						t->meta.number, t->meta.file_size);
+						t->meta.number, t->meta.file_size, 0);
 				bool empty = true;
 				ParsedInternalKey parsed;
 				t->max_sequence = 0;
@@ -329,6 +338,11 @@ class Repairer
 						t->meta.smallest.DecodeFrom(key);
 					}
 					t->meta.largest.DecodeFrom(key);
+					t->meta.num_entries++;
+					if ( parsed.type == kTypeDeletion )
+					{
+						t->meta.num_deletions++;
+					}
 					if ( parsed.sequence > t->max_sequence )
 					{
 						t->max_sequence = parsed.sequence;
@@ -339,6 +353,38 @@ class Repairer
 					status = iter->status();
 				}
 				delete iter;
+
+				// Range deletions widen the key range of the table
+				iter = table_cache_->NewRangeDelIterator(t->meta.number,
+						t->meta.file_size);
+				bool has_bounds = !empty;
+				for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+				{
+					RangeTombstone tombstone;
+					if ( !ParseRangeTombstone(iter->key(), iter->value(),
+							&tombstone) )
+					{
+						Log(options_.info_log,
+								"Table #%llu: unparsable range deletion %s",
+								(unsigned long long) t->meta.number,
+								EscapeString(iter->key()).c_str());
+						continue;
+					}
+
+					counter++;
+					t->meta.num_range_deletions++;
+					ExtendBoundsForTombstone(icmp_, tombstone, &has_bounds,
+							&t->meta.smallest, &t->meta.largest);
+					if ( tombstone.sequence > t->max_sequence )
+					{
+						t->max_sequence = tombstone.sequence;
+					}
+				}
+				if ( status.ok() && !iter->status().ok() )
+				{
+					status = iter->status();
+				}
+				delete iter;
 			}
 			Log(options_.info_log, "Table #%llu: %d entries %s",
 					(unsigned long long) t->meta.number, counter,
@@ -374,8 +420,19 @@ class Repairer
 			{
 				// TODO(opt): separate out into multiple levels
 				const TableInfo& t = tables_[i];
-				edit_.AddFile(0, t.meta.number, t.meta.file_size,
-						t.meta.smallest, t.meta.largest);
+				edit_.AddFile(0, t.meta);
+			}
+
+			// Which blob records are still referenced is not known; the
+			// garbage left in the files is not reclaimed.
+			for (size_t i = 0; i < blob_numbers_.size(); i++)
+			{
+				uint64_t file_size;
+				if ( env_->GetFileSize(BlobFileName(dbname_, blob_numbers_[i]),
+						&file_size).ok() && file_size > 0 )
+				{
+					edit_.AddBlobFile(blob_numbers_[i], file_size);
+				}
 			}
 
 			//fprintf(stderr, "NewDescriptor:\n%s\n", edit_.DebugString().c_str());
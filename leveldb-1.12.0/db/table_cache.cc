@@ -4,10 +4,13 @@
 
 #include "db/table_cache.h"
 
+#include <algorithm>
 #include "db/filename.h"
+#include "db/range_del.h"
 #include "leveldb/env.h"
 #include "leveldb/table.h"
 #include "util/coding.h"
+#include "util/perf_context_imp.h"
 
 namespace leveldb
 {
@@ -16,11 +19,16 @@ struct TableAndFile
 {
 		RandomAccessFile* file;
 		Table* table;
+		FragmentedRangeTombstones* range_dels; // NULL if the table has none
 };
 
 static void DeleteEntry(const Slice& key, void* value)
 {
 	TableAndFile* tf = reinterpret_cast<TableAndFile*> (value);
+	if ( tf->range_dels != NULL )
+	{
+		tf->range_dels->Unref();
+	}
 	delete tf->table;
 	delete tf->file;
 	delete tf;
@@ -33,11 +41,154 @@ static void UnrefEntry(void* arg1, void* arg2)
 	cache->Release(h);
 }
 
+namespace
+{
+// Presents the user keys of an external table as internal keys of values
+// written at one sequence number.
+class GlobalSeqnoIterator: public Iterator
+{
+	public:
+		GlobalSeqnoIterator(Iterator* iter, const Comparator* ucmp,
+				SequenceNumber seq) :
+			iter_(iter), ucmp_(ucmp), seq_(seq)
+		{
+		}
+		virtual ~GlobalSeqnoIterator()
+		{
+			delete iter_;
+		}
+		virtual bool Valid() const
+		{
+			return iter_->Valid();
+		}
+		virtual void Seek(const Slice& target)
+		{
+			const Slice user_key = ExtractUserKey(target);
+			iter_->Seek(user_key);
+			// Our entry for user_key sorts before target if it is newer
+			if ( iter_->Valid() && ucmp_->Compare(iter_->key(), user_key) == 0
+					&& ((seq_ << 8) | kTypeValue) > DecodeFixed64(target.data()
+							+ target.size() - 8) )
+			{
+				iter_->Next();
+			}
+			SaveKey();
+		}
+		virtual void SeekToFirst()
+		{
+			iter_->SeekToFirst();
+			SaveKey();
+		}
+		virtual void SeekToLast()
+		{
+			iter_->SeekToLast();
+			SaveKey();
+		}
+		virtual void Next()
+		{
+			iter_->Next();
+			SaveKey();
+		}
+		virtual void Prev()
+		{
+			iter_->Prev();
+			SaveKey();
+		}
+		virtual Slice key() const
+		{
+			assert(Valid());
+			return key_;
+		}
+		virtual Slice value() const
+		{
+			return iter_->value();
+		}
+		virtual Status status() const
+		{
+			return iter_->status();
+		}
+
+	private:
+		void SaveKey()
+		{
+			key_.clear();
+			if ( iter_->Valid() )
+			{
+				AppendInternalKey(&key_, ParsedInternalKey(iter_->key(), seq_,
+						kTypeValue));
+			}
+		}
+
+		Iterator* const iter_;
+		const Comparator* const ucmp_;
+		const SequenceNumber seq_;
+		std::string key_;
+};
+
+struct GlobalSeqnoSaver
+{
+		SequenceNumber seq;
+		void* arg;
+		void (*saver)(void*, const Slice&, const Slice&);
+};
+
+static void SaveWithGlobalSeqno(void* arg, const Slice& k, const Slice& v)
+{
+	GlobalSeqnoSaver* s = reinterpret_cast<GlobalSeqnoSaver*> (arg);
+	std::string ikey;
+	AppendInternalKey(&ikey, ParsedInternalKey(k, s->seq, kTypeValue));
+	(*s->saver)(s->arg, ikey, v);
+}
+
+// Notes whether a lookup that misses the row cache found its user key
+struct RowCacheSaver
+{
+		const Comparator* ucmp;
+		Slice user_key;
+		bool found;
+		void* arg;
+		void (*saver)(void*, const Slice&, const Slice&);
+};
+
+static void SaveAndNoteRow(void* arg, const Slice& k, const Slice& v)
+{
+	RowCacheSaver* s = reinterpret_cast<RowCacheSaver*> (arg);
+	if ( k.size() >= 8 && s->ucmp->Compare(ExtractUserKey(k), s->user_key)
+			== 0 )
+	{
+		s->found = true;
+	}
+	(*s->saver)(s->arg, k, v);
+}
+} // namespace
+
+// A row cache entry holds every entry of one user key in one table, newest
+// first, each encoded as
+//    tag: fixed64 (sequence << 8 | type)
+//    value_length: varint32
+//    value: char[value_length]
+static void DeleteRow(const Slice& key, void* value)
+{
+	delete reinterpret_cast<std::string*> (value);
+}
+
 TableCache::TableCache(const std::string& dbname, const Options* options,
 		int entries) :
-	env_(options->env), dbname_(dbname), options_(options), cache_(NewLRUCache(
-			entries))
+	env_(options->env), dbname_(dbname), options_(options),
+			external_options_(*options), cache_(NewLRUCache(entries)),
+			row_cache_id_(options->row_cache != NULL ? options->row_cache->NewId()
+					: 0)
 {
+	// options is sanitized by the DB: it holds the internal key versions of
+	// the user's comparator and filter policy
+	external_options_.comparator = static_cast<const InternalKeyComparator*> (
+			options->comparator)->user_comparator();
+	if ( options->filter_policy != NULL )
+	{
+		external_options_.filter_policy
+				= static_cast<const InternalFilterPolicy*> (
+						options->filter_policy)->user_policy();
+	}
 }
 
 TableCache::~TableCache()
@@ -46,7 +197,7 @@ TableCache::~TableCache()
 }
 
 Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
-		Cache::Handle** handle)
+		bool external, Cache::Handle** handle)
 {
 	Status s;
 	char buf[sizeof(file_number)];
@@ -57,13 +208,38 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
 	//没找到table.
 	if ( *handle == NULL )
 	{
+		PERF_TIMER_GUARD(find_table_nanos);
 		std::string fname = TableFileName(dbname_, file_number);
 		RandomAccessFile* file = NULL; //文件指针
 		Table* table = NULL;
 		s = env_->NewRandomAccessFile(fname, &file); //new 一个随机访问文件，返回文件指针
 		if ( s.ok() )
 		{
-			s = Table::Open(*options_, file, file_size, &table);
+			s = Table::Open(external ? external_options_ : *options_, file,
+					file_size, &table);
+		}
+		// Fragment the range deletions once, for all the point lookups
+		// through this entry.  External tables have none.
+		FragmentedRangeTombstones* range_dels = NULL;
+		if ( s.ok() && !external )
+		{
+			Iterator* iter = table->NewRangeDelIterator();
+			iter->SeekToFirst();
+			if ( iter->Valid() )
+			{
+				range_dels = new FragmentedRangeTombstones(
+						external_options_.comparator);
+				range_dels->Ref();
+				s = range_dels->Build(iter);
+				if ( !s.ok() )
+				{
+					range_dels->Unref();
+					range_dels = NULL;
+					delete table;
+					table = NULL;
+				}
+			}
+			delete iter;
 		}
 
 		if ( !s.ok() )
@@ -78,6 +254,7 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
 			TableAndFile* tf = new TableAndFile;
 			tf->file = file;
 			tf->table = table;
+			tf->range_dels = range_dels;
 			//将该table，插入到cache中。
 			*handle = cache_->Insert(key, tf, 1, &DeleteEntry);
 		}
@@ -85,8 +262,21 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
 	return s;
 }
 
+Status TableCache::Preload(uint64_t file_number, uint64_t file_size,
+		SequenceNumber global_seqno)
+{
+	Cache::Handle* handle = NULL;
+	Status s = FindTable(file_number, file_size, global_seqno != 0, &handle);
+	if ( s.ok() )
+	{
+		cache_->Release(handle);
+	}
+	return s;
+}
+
 Iterator* TableCache::NewIterator(const ReadOptions& options,
-		uint64_t file_number, uint64_t file_size, Table** tableptr)
+		uint64_t file_number, uint64_t file_size, SequenceNumber global_seqno,
+		Table** tableptr)
 {
 	if ( tableptr != NULL )
 	{
@@ -94,7 +284,7 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
 	}
 
 	Cache::Handle* handle = NULL;
-	Status s = FindTable(file_number, file_size, &handle);
+	Status s = FindTable(file_number, file_size, global_seqno != 0, &handle);
 	if ( !s.ok() )
 	{
 		return NewErrorIterator(s);
@@ -102,8 +292,34 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
 
 	Table* table =
 			reinterpret_cast<TableAndFile*> (cache_->Value(handle))->table;
-	Iterator* result = table->NewIterator(options);
+	Iterator* result;
+	if ( global_seqno != 0 )
+	{
+		// The table is keyed by the user keys of our bounds
+		ReadOptions external = options;
+		Slice lower, upper;
+		if ( options.iterate_lower_bound != NULL )
+		{
+			lower = ExtractUserKey(*options.iterate_lower_bound);
+			external.iterate_lower_bound = &lower;
+		}
+		if ( options.iterate_upper_bound != NULL )
+		{
+			upper = ExtractUserKey(*options.iterate_upper_bound);
+			external.iterate_upper_bound = &upper;
+		}
+		result = table->NewIterator(external);
+	}
+	else
+	{
+		result = table->NewIterator(options);
+	}
 	result->RegisterCleanup(&UnrefEntry, cache_, handle);
+	if ( global_seqno != 0 )
+	{
+		result = new GlobalSeqnoIterator(result, external_options_.comparator,
+				global_seqno);
+	}
 	if ( tableptr != NULL )
 	{
 		*tableptr = table;
@@ -111,23 +327,199 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
 	return result;
 }
 
+Iterator* TableCache::NewRangeDelIterator(uint64_t file_number,
+		uint64_t file_size)
+{
+	Cache::Handle* handle = NULL;
+	Status s = FindTable(file_number, file_size, false, &handle);
+	if ( !s.ok() )
+	{
+		return NewErrorIterator(s);
+	}
+
+	Table* table =
+			reinterpret_cast<TableAndFile*> (cache_->Value(handle))->table;
+	Iterator* result = table->NewRangeDelIterator();
+	result->RegisterCleanup(&UnrefEntry, cache_, handle);
+	return result;
+}
+
+Status TableCache::MaxCoveringTombstone(uint64_t file_number,
+		uint64_t file_size, const Slice& user_key, SequenceNumber snapshot,
+		SequenceNumber* max_sequence)
+{
+	Cache::Handle* handle = NULL;
+	Status s = FindTable(file_number, file_size, false, &handle);
+	if ( !s.ok() )
+	{
+		return s;
+	}
+
+	const FragmentedRangeTombstones* range_dels =
+			reinterpret_cast<TableAndFile*> (cache_->Value(handle))->range_dels;
+	if ( range_dels != NULL )
+	{
+		*max_sequence = std::max(*max_sequence,
+				range_dels->MaxCoveringSequence(user_key, snapshot));
+	}
+	cache_->Release(handle);
+	return s;
+}
+
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
-		uint64_t file_size, const Slice& k, void* arg, void(*saver)(void*,
-				const Slice&, const Slice&))
+		uint64_t file_size, SequenceNumber global_seqno, const Slice& k,
+		void* arg, void(*saver)(void*, const Slice&, const Slice&),
+		Iterator** pin)
 {
+	if ( pin != NULL )
+	{
+		*pin = NULL;
+	}
+	if ( global_seqno != 0 && ((global_seqno << 8) | kTypeValue)
+			> DecodeFixed64(k.data() + k.size() - 8) )
+	{
+		// Every entry of the external table is newer than k
+		return Status::OK();
+	}
+
+	// External tables are rare and keyed differently: leave them out of the
+	// row cache
+	Cache* row_cache = (global_seqno == 0 ? options_->row_cache : NULL);
+	std::string row_key;
+	if ( row_cache != NULL )
+	{
+		const Slice user_key = ExtractUserKey(k);
+		PutFixed64(&row_key, row_cache_id_);
+		PutFixed64(&row_key, file_number);
+		row_key.append(user_key.data(), user_key.size());
+		Cache::Handle* row = row_cache->Lookup(row_key);
+		if ( row != NULL )
+		{
+			// Replay the entry a seek to k would have found: the newest one
+			// not newer than k.  If there is none, the seek would have
+			// moved on to another user key, which callers ignore anyway.
+			const std::string* entries =
+					reinterpret_cast<std::string*> (row_cache->Value(row));
+			const uint64_t tag = DecodeFixed64(k.data() + k.size() - 8);
+			Slice input(*entries);
+			bool called = false;
+			while ( input.size() >= 8 )
+			{
+				const uint64_t entry_tag = DecodeFixed64(input.data());
+				input.remove_prefix(8);
+				Slice value;
+				if ( !GetLengthPrefixedSlice(&input, &value) )
+				{
+					break;
+				}
+				if ( entry_tag <= tag )
+				{
+					std::string ikey(user_key.data(), user_key.size());
+					PutFixed64(&ikey, entry_tag);
+					(*saver)(arg, ikey, value);
+					called = true;
+					break;
+				}
+			}
+			if ( pin != NULL && called )
+			{
+				*pin = NewEmptyIterator();
+				(*pin)->RegisterCleanup(&UnrefEntry, row_cache, row);
+			}
+			else
+			{
+				row_cache->Release(row);
+			}
+			return Status::OK();
+		}
+	}
+
 	Cache::Handle* handle = NULL;
 	// 根据file_number找到Table的cache对象
-	Status s = FindTable(file_number, file_size, &handle);
+	Status s = FindTable(file_number, file_size, global_seqno != 0, &handle);
 	if ( s.ok() )
 	{
 		Table* t =
 				reinterpret_cast<TableAndFile*> (cache_->Value(handle))->table;
-		s = t->InternalGet(options, k, arg, saver);
-		cache_->Release(handle);
+		if ( global_seqno != 0 )
+		{
+			GlobalSeqnoSaver external;
+			external.seq = global_seqno;
+			external.arg = arg;
+			external.saver = saver;
+			s = t->InternalGet(options, ExtractUserKey(k), &external,
+					SaveWithGlobalSeqno, pin);
+		}
+		else if ( row_cache != NULL )
+		{
+			RowCacheSaver noted;
+			noted.ucmp = external_options_.comparator;
+			noted.user_key = ExtractUserKey(k);
+			noted.found = false;
+			noted.arg = arg;
+			noted.saver = saver;
+			// The filter keeps lookups of absent keys cheap, so only keys
+			// present in the table are worth a row
+			s = t->InternalGet(options, k, &noted, SaveAndNoteRow, pin);
+			if ( s.ok() && noted.found && options.fill_cache )
+			{
+				FillRow(t, options, noted.user_key, row_key);
+			}
+		}
+		else
+		{
+			s = t->InternalGet(options, k, arg, saver, pin);
+		}
+		if ( pin != NULL && *pin != NULL )
+		{
+			// Blocks read through the file (e.g. mmap-ed ones) need the
+			// table to stay open
+			(*pin)->RegisterCleanup(&UnrefEntry, cache_, handle);
+		}
+		else
+		{
+			cache_->Release(handle);
+		}
 	}
 	return s;
 }
 
+// Collect every entry of "user_key" in "t" into a new row cache entry
+void TableCache::FillRow(Table* t, const ReadOptions& options,
+		const Slice& user_key, const std::string& row_key)
+{
+	std::string* entries = new std::string;
+	ReadOptions scan = options;
+	scan.iterate_lower_bound = NULL; // Meant for iterators of the caller
+	scan.iterate_upper_bound = NULL;
+	std::string target;
+	AppendInternalKey(&target, ParsedInternalKey(user_key, kMaxSequenceNumber,
+			kValueTypeForSeek));
+	Iterator* iter = t->NewIterator(scan);
+	for ( iter->Seek(target); iter->Valid(); iter->Next() )
+	{
+		const Slice ikey = iter->key();
+		if ( ikey.size() < 8 || external_options_.comparator->Compare(
+				ExtractUserKey(ikey), user_key) != 0 )
+		{
+			break;
+		}
+		entries->append(ikey.data() + ikey.size() - 8, 8);
+		PutLengthPrefixedSlice(entries, iter->value());
+	}
+	if ( iter->status().ok() )
+	{
+		Cache* row_cache = options_->row_cache;
+		row_cache->Release(row_cache->Insert(row_key, entries,
+				row_key.size() + entries->size(), &DeleteRow));
+	}
+	else
+	{
+		delete entries;
+	}
+	delete iter;
+}
+
 // @file_number: 文件
 // 依法收回
 void TableCache::Evict(uint64_t file_number)
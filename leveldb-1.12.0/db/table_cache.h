@@ -34,14 +34,49 @@ class TableCache
 		// the returned iterator.  The returned "*tableptr" object is owned by
 		// the cache and should not be deleted, and is valid for as long as the
 		// returned iterator is live.
+		//
+		// A non-zero "global_seqno" marks an external table (see
+		// FileMetaData::global_seqno); its user keys are returned as internal
+		// keys of values written at that sequence number.
+		//
+		// Any iterate bounds of "options" are internal keys.
 		Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
-				uint64_t file_size, Table** tableptr = NULL);
+				uint64_t file_size, SequenceNumber global_seqno,
+				Table** tableptr = NULL);
+
+		// Return an iterator over the range deletions of the specified file.
+		// Keys are internal keys of kTypeRangeDeletion, values the exclusive
+		// end of each deleted range.
+		Iterator* NewRangeDelIterator(uint64_t file_number, uint64_t file_size);
+
+		// Raise *max_sequence to the sequence number of the newest range
+		// deletion of the specified file that covers user_key and is visible
+		// at "snapshot".  The deletions are fragmented when the file is
+		// opened, so this is a binary search.
+		Status MaxCoveringTombstone(uint64_t file_number, uint64_t file_size,
+				const Slice& user_key, SequenceNumber snapshot,
+				SequenceNumber* max_sequence);
 
 		// If a seek to internal key "k" in specified file finds an entry,
-		// call (*handle_result)(arg, found_key, found_value).
+		// call (*handle_result)(arg, found_key, found_value).  For an
+		// external table, entries newer than "k" are not reported.
+		//
+		// If "pin" is non-NULL and such a call is made, *pin is set to an
+		// iterator that keeps the slices passed to handle_result valid (and
+		// the table open) until the caller deletes it; otherwise to NULL.
+		//
+		// With options_->row_cache set, the entries of the user key of "k"
+		// are looked up in (and added to) the row cache first.
 		Status Get(const ReadOptions& options, uint64_t file_number,
-				uint64_t file_size, const Slice& k, void* arg,
-				void(*handle_result)(void*, const Slice&, const Slice&));
+				uint64_t file_size, SequenceNumber global_seqno, const Slice& k,
+				void* arg,
+				void(*handle_result)(void*, const Slice&, const Slice&),
+				Iterator** pin = NULL);
+
+		// Open the specified file, unless it is open already, and leave it
+		// in the cache.
+		Status Preload(uint64_t file_number, uint64_t file_size,
+				SequenceNumber global_seqno);
 
 		// Evict any entry for the specified file number
 		void Evict(uint64_t file_number); //回收
@@ -50,10 +85,14 @@ class TableCache
 		Env* const env_; // 用来操作文件
 		const std::string dbname_;
 		const Options* options_;
+		Options external_options_; // Opens tables keyed by user keys
 		Cache* cache_;
+		uint64_t row_cache_id_; // Prefix of our keys in options_->row_cache
 
 		Status FindTable(uint64_t file_number, uint64_t file_size,
-				Cache::Handle**);
+				bool external, Cache::Handle**);
+		void FillRow(Table* t, const ReadOptions& options,
+				const Slice& user_key, const std::string& row_key);
 };
 
 } // namespace leveldb
@@ -22,7 +22,26 @@ enum Tag
 	kDeletedFile = 6,
 	kNewFile = 7,
 	// 8 was used for large value refs
-	kPrevLogNumber = 9
+	kPrevLogNumber = 9,
+	// Like kNewFile, followed by (field tag, varint64 value) pairs ended by
+	// kEndOfFields.  Only written when a field has a non-default value, so
+	// that older releases can still read the descriptor otherwise.
+	kNewFile2 = 10,
+	kNewBlobFile = 11,
+	kBlobGarbage = 12,
+	kColumnFamily = 13,
+	kDropColumnFamily = 14,
+	kMaxColumnFamily = 15
+};
+
+// Field tags of a kNewFile2 entry.  Also written to disk.
+enum NewFileField
+{
+	kEndOfFields = 0,
+	kNumRangeDeletions = 1,
+	kGlobalSeqno = 2,
+	kNumEntries = 3,
+	kNumDeletions = 4
 };
 
 void VersionEdit::Clear()
@@ -32,13 +51,19 @@ void VersionEdit::Clear()
 	prev_log_number_ = 0;
 	last_sequence_ = 0;
 	next_file_number_ = 0;
+	max_column_family_ = 0;
 	has_comparator_ = false;
 	has_log_number_ = false;
 	has_prev_log_number_ = false;
 	has_next_file_number_ = false;
 	has_last_sequence_ = false;
+	has_max_column_family_ = false;
 	deleted_files_.clear();
 	new_files_.clear();
+	new_blob_files_.clear();
+	blob_garbage_.clear();
+	new_column_families_.clear();
+	dropped_column_families_.clear();
 }
 
 // 将所有成员变量进行编码，放入到 @dst 中
@@ -88,12 +113,66 @@ void VersionEdit::EncodeTo(std::string* dst) const
 	for (size_t i = 0; i < new_files_.size(); i++)
 	{
 		const FileMetaData& f = new_files_[i].second;
-		PutVarint32(dst, kNewFile);
+		const bool has_fields = (f.num_range_deletions > 0 || f.global_seqno
+				> 0 || f.num_deletions > 0);
+		PutVarint32(dst, has_fields ? kNewFile2 : kNewFile);
 		PutVarint32(dst, new_files_[i].first); // level
 		PutVarint64(dst, f.number);
 		PutVarint64(dst, f.file_size);
 		PutLengthPrefixedSlice(dst, f.smallest.Encode());
 		PutLengthPrefixedSlice(dst, f.largest.Encode());
+		if ( has_fields )
+		{
+			if ( f.num_range_deletions > 0 )
+			{
+				PutVarint32(dst, kNumRangeDeletions);
+				PutVarint64(dst, f.num_range_deletions);
+			}
+			if ( f.global_seqno > 0 )
+			{
+				PutVarint32(dst, kGlobalSeqno);
+				PutVarint64(dst, f.global_seqno);
+			}
+			if ( f.num_deletions > 0 )
+			{
+				PutVarint32(dst, kNumEntries);
+				PutVarint64(dst, f.num_entries);
+				PutVarint32(dst, kNumDeletions);
+				PutVarint64(dst, f.num_deletions);
+			}
+			PutVarint32(dst, kEndOfFields);
+		}
+	}
+
+	for (size_t i = 0; i < new_blob_files_.size(); i++)
+	{
+		PutVarint32(dst, kNewBlobFile);
+		PutVarint64(dst, new_blob_files_[i].first); // file number
+		PutVarint64(dst, new_blob_files_[i].second); // file size
+	}
+
+	for (size_t i = 0; i < blob_garbage_.size(); i++)
+	{
+		PutVarint32(dst, kBlobGarbage);
+		PutVarint64(dst, blob_garbage_[i].first); // file number
+		PutVarint64(dst, blob_garbage_[i].second); // bytes
+	}
+
+	if ( has_max_column_family_ )
+	{
+		PutVarint32(dst, kMaxColumnFamily);
+		PutVarint32(dst, max_column_family_);
+	}
+	for (size_t i = 0; i < new_column_families_.size(); i++)
+	{
+		PutVarint32(dst, kColumnFamily);
+		PutVarint32(dst, new_column_families_[i].first); // id
+		PutLengthPrefixedSlice(dst, new_column_families_[i].second); // name
+	}
+	for (size_t i = 0; i < dropped_column_families_.size(); i++)
+	{
+		PutVarint32(dst, kDropColumnFamily);
+		PutVarint32(dst, dropped_column_families_[i]);
 	}
 }
 
@@ -111,6 +190,47 @@ static bool GetInternalKey(Slice* input, InternalKey* dst)
 	}
 }
 
+// Parse the fields that follow the common part of a kNewFile2 entry
+static bool GetNewFileFields(Slice* input, FileMetaData* f)
+{
+	uint32_t field;
+	while (GetVarint32(input, &field))
+	{
+		switch (field)
+		{
+		case kEndOfFields:
+			return true;
+		case kNumRangeDeletions:
+			if ( !GetVarint64(input, &f->num_range_deletions) )
+			{
+				return false;
+			}
+			break;
+		case kGlobalSeqno:
+			if ( !GetVarint64(input, &f->global_seqno) )
+			{
+				return false;
+			}
+			break;
+		case kNumEntries:
+			if ( !GetVarint64(input, &f->num_entries) )
+			{
+				return false;
+			}
+			break;
+		case kNumDeletions:
+			if ( !GetVarint64(input, &f->num_deletions) )
+			{
+				return false;
+			}
+			break;
+		default:
+			return false;
+		}
+	}
+	return false;
+}
+
 static bool GetLevel(Slice* input, int* level)
 {
 	uint32_t v;
@@ -135,6 +255,8 @@ Status VersionEdit::DecodeFrom(const Slice& src)
 	// Temporary storage for parsing
 	int level;
 	uint64_t number;
+	uint64_t bytes;
+	uint32_t id;
 	FileMetaData f;
 	Slice str;
 	InternalKey key;
@@ -222,9 +344,12 @@ Status VersionEdit::DecodeFrom(const Slice& src)
 			break;
 
 		case kNewFile:
+		case kNewFile2:
+			f = FileMetaData();
 			if ( GetLevel(&input, &level) && GetVarint64(&input, &f.number)
 					&& GetVarint64(&input, &f.file_size) && GetInternalKey(
-					&input, &f.smallest) && GetInternalKey(&input, &f.largest) )
+					&input, &f.smallest) && GetInternalKey(&input, &f.largest)
+					&& (tag == kNewFile || GetNewFileFields(&input, &f)) )
 			{
 				new_files_.push_back(std::make_pair(level, f));
 			}
@@ -234,6 +359,63 @@ Status VersionEdit::DecodeFrom(const Slice& src)
 			}
 			break;
 
+		case kNewBlobFile:
+			if ( GetVarint64(&input, &number) && GetVarint64(&input, &bytes) )
+			{
+				new_blob_files_.push_back(std::make_pair(number, bytes));
+			}
+			else
+			{
+				msg = "new-blob-file entry";
+			}
+			break;
+
+		case kBlobGarbage:
+			if ( GetVarint64(&input, &number) && GetVarint64(&input, &bytes) )
+			{
+				blob_garbage_.push_back(std::make_pair(number, bytes));
+			}
+			else
+			{
+				msg = "blob garbage";
+			}
+			break;
+
+		case kMaxColumnFamily:
+			if ( GetVarint32(&input, &max_column_family_) )
+			{
+				has_max_column_family_ = true;
+			}
+			else
+			{
+				msg = "max column family";
+			}
+			break;
+
+		case kColumnFamily:
+			if ( GetVarint32(&input, &id) && GetLengthPrefixedSlice(&input,
+					&str) )
+			{
+				new_column_families_.push_back(std::make_pair(id,
+						str.ToString()));
+			}
+			else
+			{
+				msg = "column family";
+			}
+			break;
+
+		case kDropColumnFamily:
+			if ( GetVarint32(&input, &id) )
+			{
+				dropped_column_families_.push_back(id);
+			}
+			else
+			{
+				msg = "dropped column family";
+			}
+			break;
+
 		default:
 			msg = "unknown tag";
 			break;
@@ -310,6 +492,54 @@ std::string VersionEdit::DebugString() const
 		r.append(f.smallest.DebugString());
 		r.append(" .. ");
 		r.append(f.largest.DebugString());
+		if ( f.num_range_deletions > 0 )
+		{
+			r.append(" range-dels: ");
+			AppendNumberTo(&r, f.num_range_deletions);
+		}
+		if ( f.global_seqno > 0 )
+		{
+			r.append(" global-seqno: ");
+			AppendNumberTo(&r, f.global_seqno);
+		}
+		if ( f.num_deletions > 0 )
+		{
+			r.append(" deletions: ");
+			AppendNumberTo(&r, f.num_deletions);
+			r.append("/");
+			AppendNumberTo(&r, f.num_entries);
+		}
+	}
+	for (size_t i = 0; i < new_blob_files_.size(); i++)
+	{
+		r.append("\n  AddBlobFile: ");
+		AppendNumberTo(&r, new_blob_files_[i].first);
+		r.append(" ");
+		AppendNumberTo(&r, new_blob_files_[i].second);
+	}
+	for (size_t i = 0; i < blob_garbage_.size(); i++)
+	{
+		r.append("\n  BlobGarbage: ");
+		AppendNumberTo(&r, blob_garbage_[i].first);
+		r.append(" ");
+		AppendNumberTo(&r, blob_garbage_[i].second);
+	}
+	if ( has_max_column_family_ )
+	{
+		r.append("\n  MaxColumnFamily: ");
+		AppendNumberTo(&r, max_column_family_);
+	}
+	for (size_t i = 0; i < new_column_families_.size(); i++)
+	{
+		r.append("\n  AddColumnFamily: ");
+		AppendNumberTo(&r, new_column_families_[i].first);
+		r.append(" ");
+		r.append(new_column_families_[i].second);
+	}
+	for (size_t i = 0; i < dropped_column_families_.size(); i++)
+	{
+		r.append("\n  DropColumnFamily: ");
+		AppendNumberTo(&r, dropped_column_families_[i]);
 	}
 	r.append("\n}\n");
 	return r;
@@ -25,8 +25,37 @@ struct FileMetaData
 		InternalKey smallest; // Smallest internal key served by table // 最小key
 		InternalKey largest; // Largest internal key served by table // 最大key
 
+		// Range deletions stored in the table.  smallest..largest also span
+		// the ranges they delete.
+		uint64_t num_range_deletions;
+
+		// Entries of the data blocks, and how many of them are deletion
+		// markers.  Only known for tables holding deletion markers.
+		uint64_t num_entries;
+		uint64_t num_deletions;
+
+		// Non-zero for a table built outside the DB (see IngestExternalFile):
+		// its keys are plain user keys, all read as values written at this
+		// sequence number.
+		SequenceNumber global_seqno;
+
 		FileMetaData() :
-			refs(0), allowed_seeks(1 << 30), file_size(0)
+			refs(0), allowed_seeks(1 << 30), number(0), file_size(0),
+					num_range_deletions(0), num_entries(0), num_deletions(0),
+					global_seqno(0)
+		{
+		}
+};
+
+// A blob file referred to by the tables (see db/blob_file.h)
+struct BlobFileMetaData
+{
+		uint64_t number;
+		uint64_t file_size; // Bytes of all its records
+		uint64_t garbage_size; // Bytes of its records nothing refers to
+
+		BlobFileMetaData() :
+			number(0), file_size(0), garbage_size(0)
 		{
 		}
 };
@@ -90,12 +119,54 @@ class VersionEdit
 			new_files_.push_back(std::make_pair(level, f));
 		}
 
+		// Add the file described by "f", keeping its extra properties.
+		void AddFile(int level, const FileMetaData& f)
+		{
+			new_files_.push_back(std::make_pair(level, f));
+		}
+
 		// Delete the specified "file" from the specified "level".
 		void DeleteFile(int level, uint64_t file)
 		{
 			deleted_files_.insert(std::make_pair(level, file));
 		}
 
+		// Add a blob file of "file_size" bytes.
+		void AddBlobFile(uint64_t file, uint64_t file_size)
+		{
+			new_blob_files_.push_back(std::make_pair(file, file_size));
+		}
+
+		// Record that "bytes" more bytes of records of the specified blob
+		// file are no longer referred to.  A blob file made entirely of
+		// garbage leaves the version.
+		void AddBlobGarbage(uint64_t file, uint64_t bytes)
+		{
+			blob_garbage_.push_back(std::make_pair(file, bytes));
+		}
+
+		// Register the column family "name" under "id".  Its data lives in
+		// a directory of its own (see ColumnFamilyDirName).
+		void AddColumnFamily(uint32_t id, const Slice& name)
+		{
+			new_column_families_.push_back(
+					std::make_pair(id, name.ToString()));
+		}
+
+		// Forget the column family with the specified id.
+		void DropColumnFamily(uint32_t id)
+		{
+			dropped_column_families_.push_back(id);
+		}
+
+		// Ids up to "id" have been handed out, so that they are not reused
+		// while the log may still hold records of a dropped family.
+		void SetMaxColumnFamily(uint32_t id)
+		{
+			has_max_column_family_ = true;
+			max_column_family_ = id;
+		}
+
 		void EncodeTo(std::string* dst) const;
 		Status DecodeFrom(const Slice& src);
 
@@ -111,15 +182,21 @@ class VersionEdit
 		uint64_t prev_log_number_;
 		uint64_t next_file_number_;
 		SequenceNumber last_sequence_;
+		uint32_t max_column_family_;
 		bool has_comparator_;
 		bool has_log_number_;
 		bool has_prev_log_number_;
 		bool has_next_file_number_;
 		bool has_last_sequence_;
+		bool has_max_column_family_;
 
 		std::vector<std::pair<int, InternalKey> > compact_pointers_;
 		DeletedFileSet deleted_files_; //要删除的文件
 		std::vector<std::pair<int, FileMetaData> > new_files_; //新加入的文件
+		std::vector<std::pair<uint64_t, uint64_t> > new_blob_files_;
+		std::vector<std::pair<uint64_t, uint64_t> > blob_garbage_;
+		std::vector<std::pair<uint32_t, std::string> > new_column_families_;
+		std::vector<uint32_t> dropped_column_families_;
 };
 
 } // namespace leveldb
@@ -39,6 +39,67 @@ TEST(VersionEditTest, EncodeDecode) {
   TestEncodeDecode(edit);
 }
 
+TEST(VersionEditTest, EncodeDecodeFileFields) {
+  VersionEdit edit;
+  FileMetaData f;
+  f.number = 7;
+  f.file_size = 1000;
+  f.smallest = InternalKey("a", 10, kTypeRangeDeletion);
+  f.largest = InternalKey("m", kMaxSequenceNumber, kTypeRangeDeletion);
+  f.num_range_deletions = 3;
+  edit.AddFile(2, f);
+  edit.AddFile(3, 8, 2000, InternalKey("n", 5, kTypeValue),
+               InternalKey("z", 6, kTypeValue));
+  f.number = 9;
+  f.num_range_deletions = 0;
+  f.global_seqno = 42;
+  edit.AddFile(4, f);
+  f.number = 10;
+  f.global_seqno = 0;
+  f.num_entries = 100;
+  f.num_deletions = 60;
+  edit.AddFile(5, f);
+  TestEncodeDecode(edit);
+
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_OK(parsed.DecodeFrom(encoded));
+  ASSERT_TRUE(parsed.DebugString().find("range-dels: 3") != std::string::npos);
+  ASSERT_TRUE(parsed.DebugString().find("global-seqno: 42") != std::string::npos);
+  ASSERT_TRUE(parsed.DebugString().find("deletions: 60/100") != std::string::npos);
+}
+
+TEST(VersionEditTest, EncodeDecodeBlobFiles) {
+  VersionEdit edit;
+  edit.AddBlobFile(11, 1 << 20);
+  edit.AddBlobFile(12, 300);
+  edit.AddBlobGarbage(11, 4096);
+  TestEncodeDecode(edit);
+
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_OK(parsed.DecodeFrom(encoded));
+  ASSERT_TRUE(parsed.DebugString().find("AddBlobFile: 12 300") != std::string::npos);
+  ASSERT_TRUE(parsed.DebugString().find("BlobGarbage: 11 4096") != std::string::npos);
+}
+
+TEST(VersionEditTest, EncodeDecodeColumnFamilies) {
+  VersionEdit edit;
+  edit.SetMaxColumnFamily(3);
+  edit.AddColumnFamily(3, "users");
+  edit.DropColumnFamily(2);
+  TestEncodeDecode(edit);
+
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_OK(parsed.DecodeFrom(encoded));
+  ASSERT_TRUE(parsed.DebugString().find("AddColumnFamily: 3 users") != std::string::npos);
+  ASSERT_TRUE(parsed.DebugString().find("DropColumnFamily: 2") != std::string::npos);
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
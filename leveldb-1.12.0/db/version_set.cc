@@ -5,11 +5,15 @@
 #include "db/version_set.h"
 
 #include <algorithm>
+#include <map>
 #include <stdio.h>
+#include "db/blob_file.h"
 #include "db/filename.h"
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/merge_context.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
 #include "leveldb/table_builder.h"
@@ -101,12 +105,12 @@ Version::~Version()
 	}
 }
 
-// 二分查找，找到该 @key在哪个 files中
-int FindFile(const InternalKeyComparator& icmp,
-		const std::vector<FileMetaData*>& files, const Slice& key)
+// Like FindFile(), among files[left, right): returns right if none of
+// them qualifies.
+static uint32_t FindFileInRange(const InternalKeyComparator& icmp,
+		const std::vector<FileMetaData*>& files, const Slice& key,
+		uint32_t left, uint32_t right)
 {
-	uint32_t left = 0;
-	uint32_t right = files.size();
 	while (left < right)
 	{
 		uint32_t mid = (left + right) / 2;
@@ -127,6 +131,13 @@ int FindFile(const InternalKeyComparator& icmp,
 	return right;
 }
 
+// 二分查找，找到该 @key在哪个 files中
+int FindFile(const InternalKeyComparator& icmp,
+		const std::vector<FileMetaData*>& files, const Slice& key)
+{
+	return FindFileInRange(icmp, files, key, 0, files.size());
+}
+
 // 判断 @user_key 是否大于 @f 中的最大key
 static bool AfterFile(const Comparator* ucmp, const Slice* user_key,
 		const FileMetaData* f)
@@ -194,15 +205,31 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
 // An internal iterator.  For a given version/level pair, yields
 // information about the files in the level.  For a given entry, key()
 // is the largest key that occurs in the file, and value() is an
-// 16-byte value containing the file number and file size, both
-// encoded using EncodeFixed64.
+// 24-byte value containing the file number, file size and global
+// sequence number, all encoded using EncodeFixed64.
+//
+// Given the iterate bounds of a read (as internal keys), Next() stops at
+// a file that starts at or past the upper bound, and Prev() at one that
+// ends before the lower bound, so that the files beyond them are not
+// opened.  Seeks are not bounded (see NewTwoLevelIterator).
 class Version::LevelFileNumIterator: public Iterator
 {
 	public:
 		LevelFileNumIterator(const InternalKeyComparator& icmp,
-				const std::vector<FileMetaData*>* flist) :
-			icmp_(icmp), flist_(flist), index_(flist->size())
+				const std::vector<FileMetaData*>* flist,
+				const ReadOptions& options = ReadOptions()) :
+			icmp_(icmp), flist_(flist), index_(flist->size()),
+					has_lower_bound_(options.iterate_lower_bound != NULL),
+					has_upper_bound_(options.iterate_upper_bound != NULL)
 		{ // Marks as invalid
+			if ( has_lower_bound_ )
+			{
+				lower_bound_ = options.iterate_lower_bound->ToString();
+			}
+			if ( has_upper_bound_ )
+			{
+				upper_bound_ = options.iterate_upper_bound->ToString();
+			}
 		}
 		virtual bool Valid() const
 		{
@@ -224,6 +251,7 @@ class Version::LevelFileNumIterator: public Iterator
 		{
 			assert(Valid());
 			index_++;
+			StopPastUpperBound();
 		}
 		virtual void Prev()
 		{
@@ -235,6 +263,7 @@ class Version::LevelFileNumIterator: public Iterator
 			else
 			{
 				index_--;
+				StopBeforeLowerBound();
 			}
 		}
 		Slice key() const
@@ -247,6 +276,7 @@ class Version::LevelFileNumIterator: public Iterator
 			assert(Valid());
 			EncodeFixed64(value_buf_, (*flist_)[index_]->number);
 			EncodeFixed64(value_buf_ + 8, (*flist_)[index_]->file_size);
+			EncodeFixed64(value_buf_ + 16, (*flist_)[index_]->global_seqno);
 			return Slice(value_buf_, sizeof(value_buf_));
 		}
 		virtual Status status() const
@@ -254,19 +284,41 @@ class Version::LevelFileNumIterator: public Iterator
 			return Status::OK();
 		}
 	private:
+		void StopPastUpperBound()
+		{
+			if ( has_upper_bound_ && Valid() && icmp_.Compare(
+					(*flist_)[index_]->smallest.Encode(), upper_bound_) >= 0 )
+			{
+				index_ = flist_->size();
+			}
+		}
+		void StopBeforeLowerBound()
+		{
+			if ( has_lower_bound_ && Valid() && icmp_.Compare(
+					(*flist_)[index_]->largest.Encode(), lower_bound_) < 0 )
+			{
+				index_ = flist_->size();
+			}
+		}
+
 		const InternalKeyComparator icmp_;
 		const std::vector<FileMetaData*>* const flist_;
 		uint32_t index_;
-
-		// Backing store for value().  Holds the file number and size.
-		mutable char value_buf_[16];
+		const bool has_lower_bound_;
+		const bool has_upper_bound_;
+		std::string lower_bound_;
+		std::string upper_bound_;
+
+		// Backing store for value().  Holds the file number, size and global
+		// sequence number.
+		mutable char value_buf_[24];
 };
 
 static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
 		const Slice& file_value)
 {
 	TableCache* cache = reinterpret_cast<TableCache*> (arg);
-	if ( file_value.size() != 16 )
+	if ( file_value.size() != 24 )
 	{
 		return NewErrorIterator(Status::Corruption(
 				"FileReader invoked with unexpected value"));
@@ -274,7 +326,8 @@ static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
 	else
 	{
 		return cache->NewIterator(options, DecodeFixed64(file_value.data()),
-				DecodeFixed64(file_value.data() + 8));
+				DecodeFixed64(file_value.data() + 8), DecodeFixed64(
+						file_value.data() + 16));
 	}
 }
 
@@ -283,17 +336,48 @@ Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
 		int level) const
 {
 	return NewTwoLevelIterator(new LevelFileNumIterator(vset_->icmp_,
-			&files_[level]), &GetFileIterator, vset_->table_cache_, options);
+			&files_[level], options), &GetFileIterator, vset_->table_cache_,
+			options, &vset_->icmp_);
 }
 
-void Version::AddIterators(const ReadOptions& options,
+void Version::AddIterators(const ReadOptions& user_options,
 		std::vector<Iterator*>* iters)
 {
+	// Tables compare the bounds with internal keys: every entry of a user
+	// key sorts at or after the one with the largest sequence number.  The
+	// iterators copy them, so they may live on our stack.
+	const Comparator* ucmp = vset_->icmp_.user_comparator();
+	const Slice* lower = user_options.iterate_lower_bound;
+	const Slice* upper = user_options.iterate_upper_bound;
+	ReadOptions options = user_options;
+	InternalKey lower_key, upper_key;
+	Slice lower_slice, upper_slice;
+	if ( lower != NULL )
+	{
+		lower_key = InternalKey(*lower, kMaxSequenceNumber, kValueTypeForSeek);
+		lower_slice = lower_key.Encode();
+		options.iterate_lower_bound = &lower_slice;
+	}
+	if ( upper != NULL )
+	{
+		upper_key = InternalKey(*upper, kMaxSequenceNumber, kValueTypeForSeek);
+		upper_slice = upper_key.Encode();
+		options.iterate_upper_bound = &upper_slice;
+	}
+
 	// Merge all level zero files together since they may overlap
 	for (size_t i = 0; i < files_[0].size(); i++)
 	{
-		iters->push_back(vset_->table_cache_->NewIterator(options,
-				files_[0][i]->number, files_[0][i]->file_size));
+		const FileMetaData* f = files_[0][i];
+		if ( (lower != NULL && ucmp->Compare(f->largest.user_key(), *lower) < 0)
+				|| (upper != NULL && ucmp->Compare(f->smallest.user_key(),
+						*upper) >= 0) )
+		{
+			// Entirely outside the bounds: do not even open it
+			continue;
+		}
+		iters->push_back(vset_->table_cache_->NewIterator(options, f->number,
+				f->file_size, f->global_seqno));
 	}
 
 	// For levels > 0, we can use a concatenating iterator that sequentially
@@ -308,12 +392,32 @@ void Version::AddIterators(const ReadOptions& options,
 	}
 }
 
+Status Version::AddRangeTombstones(RangeDelAggregator* range_del)
+{
+	Status s;
+	for (int level = 0; level < config::kNumLevels && s.ok(); level++)
+	{
+		for (size_t i = 0; i < files_[level].size() && s.ok(); i++)
+		{
+			const FileMetaData* f = files_[level][i];
+			if ( f->num_range_deletions > 0 )
+			{
+				Iterator* iter = vset_->table_cache_->NewRangeDelIterator(
+						f->number, f->file_size);
+				s = range_del->AddTombstones(iter);
+				delete iter;
+			}
+		}
+	}
+	return s;
+}
+
 // Callback from TableCache::Get()
 namespace
 {
 enum SaverState
 {
-	kNotFound, kFound, kDeleted, kCorrupt,
+	kNotFound, kFound, kDeleted, kCorrupt, kMerge,
 };
 struct Saver
 {
@@ -321,6 +425,12 @@ struct Saver
 		const Comparator* ucmp;
 		Slice user_key;
 		std::string* value;
+		bool pin; // Point pinned_value at the value found instead of copying it
+		Slice pinned_value;
+		MergeContext* merge;
+		SequenceNumber sequence; // Sequence of the entry found
+		SequenceNumber range_del_seq; // Older entries are range deleted
+		bool is_blob; // *value is the BlobIndex of the value found
 };
 }
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v)
@@ -335,15 +445,46 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v)
 	{
 		if ( s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0 )
 		{
-			s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
-			if ( s->state == kFound )
+			s->sequence = parsed_key.sequence;
+			if ( parsed_key.sequence < s->range_del_seq )
+			{
+				parsed_key.type = kTypeDeletion;
+			}
+			switch (parsed_key.type)
 			{
-				s->value->assign(v.data(), v.size());
+			case kTypeValue:
+			case kTypeBlobIndex:
+				s->state = kFound;
+				if ( s->pin )
+				{
+					s->pinned_value = v;
+				}
+				else
+				{
+					s->value->assign(v.data(), v.size());
+				}
+				s->is_blob = (parsed_key.type == kTypeBlobIndex);
+				break;
+			case kTypeDeletion:
+				s->state = kDeleted;
+				break;
+			case kTypeMerge:
+				s->state = kMerge;
+				s->merge->AddOlder(v);
+				break;
+			default:
+				s->state = kCorrupt;
+				break;
 			}
 		}
 	}
 }
 
+static void DeleteIterator(void* arg1, void* arg2)
+{
+	delete reinterpret_cast<Iterator*> (arg1);
+}
+
 static bool NewestFirst(FileMetaData* a, FileMetaData* b)
 {
 	return a->number > b->number;
@@ -351,10 +492,14 @@ static bool NewestFirst(FileMetaData* a, FileMetaData* b)
 
 // 在所有文件中，查找 @k
 Status Version::Get(const ReadOptions& options, const LookupKey& k,
-		std::string* value, GetStats* stats)
+		PinnableSlice* pinnable, GetStats* stats, MergeContext* merge,
+		SequenceNumber* range_del_seq, bool pin)
 {
+	std::string* value = pinnable->GetSelf();
 	Slice ikey = k.internal_key(); // key+sequence+type
 	Slice user_key = k.user_key(); // key
+	const SequenceNumber snapshot = DecodeFixed64(ikey.data() + ikey.size()
+			- 8) >> 8;
 	const Comparator* ucmp = vset_->icmp_.user_comparator();
 	Status s;
 
@@ -368,6 +513,10 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 	// in an smaller level, later levels are irrelevant.
 	std::vector<FileMetaData*> tmp; // 满足条件的文件
 	FileMetaData* tmp2;
+	// Range of files of level "search_level" that file_indexer_ narrowed
+	// the search to
+	int search_level = -1;
+	uint32_t search_left = 0, search_right = 0;
 	for (int level = 0; level < config::kNumLevels; level++)
 	{
 		size_t num_files = files_[level].size(); //每一级，有多少文件
@@ -400,7 +549,14 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 		else
 		{
 			// Binary search to find earliest index whose largest key >= ikey.
-			uint32_t index = FindFile(vset_->icmp_, files_[level], ikey);
+			if ( search_level != level )
+			{
+				search_left = 0;
+				search_right = num_files;
+			}
+			uint32_t index = FindFileInRange(vset_->icmp_, files_[level], ikey,
+					search_left, search_right);
+			int cmp_smallest = 0, cmp_largest = 0;
 			if ( index >= num_files )
 			{
 				files = NULL;
@@ -409,7 +565,8 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 			else
 			{
 				tmp2 = files[index];
-				if ( ucmp->Compare(user_key, tmp2->smallest.user_key()) < 0 )
+				cmp_smallest = ucmp->Compare(user_key, tmp2->smallest.user_key());
+				if ( cmp_smallest < 0 )
 				{
 					// All of "tmp2" is past any data for user_key
 					files = NULL;
@@ -417,10 +574,20 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 				}
 				else
 				{
+					cmp_largest = ucmp->Compare(user_key,
+							tmp2->largest.user_key());
 					files = &tmp2;
 					num_files = 1;
 				}
 			}
+
+			// Where the next level may hold user_key
+			if ( level + 1 < config::kNumLevels )
+			{
+				file_indexer_.GetNextLevelIndex(level, index, cmp_smallest,
+						cmp_largest, &search_left, &search_right);
+				search_level = level + 1;
+			}
 		}
 
 		for (uint32_t i = 0; i < num_files; ++i)
@@ -437,24 +604,88 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 			last_file_read_level = level;
 
 			Saver saver;
-			saver.state = kNotFound;
 			saver.ucmp = ucmp;
 			saver.user_key = user_key;
 			saver.value = value;
+			saver.pin = pin;
+			saver.merge = merge;
+			saver.is_blob = false;
+			if ( f->num_range_deletions > 0 )
+			{
+				s = vset_->table_cache_->MaxCoveringTombstone(f->number,
+						f->file_size, user_key, snapshot, range_del_seq);
+				if ( !s.ok() )
+				{
+					return s;
+				}
+			}
+			saver.range_del_seq = *range_del_seq;
 			//在缓存中找
-			s = vset_->table_cache_->Get(options, f->number, f->file_size,
-					ikey, &saver, SaveValue);
-			if ( !s.ok() )
+			// A merge operand does not hide older entries, so look again
+			// just past it until something else turns up for user_key.
+			Slice target = ikey;
+			InternalKey next;
+			Iterator* block = NULL; // Keeps saver.pinned_value valid
+			while (true)
 			{
-				return s;
+				saver.state = kNotFound;
+				delete block;
+				s = vset_->table_cache_->Get(options, f->number, f->file_size,
+						f->global_seqno, target, &saver, SaveValue,
+						pin ? &block : NULL);
+				if ( !s.ok() )
+				{
+					return s;
+				}
+				if ( saver.state != kMerge || saver.sequence == 0 )
+				{
+					break;
+				}
+				next = InternalKey(user_key, saver.sequence - 1,
+						kValueTypeForSeek);
+				target = next.Encode();
 			}
+			if ( saver.state == kFound && block != NULL )
+			{
+				if ( !saver.is_blob && merge->empty() )
+				{
+					pinnable->PinSlice(saver.pinned_value, &DeleteIterator,
+							block, NULL);
+					return s;
+				}
+				value->assign(saver.pinned_value.data(),
+						saver.pinned_value.size());
+			}
+			delete block;
 			switch (saver.state)
 			{
 			case kNotFound:
+			case kMerge:
 				break; // Keep searching in other files
-			case kFound:
-				return s; //找到了.
+			case kFound: //找到了.
+				if ( saver.is_blob )
+				{
+					const std::string index = *value;
+					s = vset_->blob_cache_->Get(options, index, value);
+					if ( !s.ok() )
+					{
+						return s;
+					}
+				}
+				if ( !merge->empty() )
+				{
+					Slice base(*value);
+					s = merge->Finish(user_key, &base, value);
+				}
+				pinnable->PinSelf();
+				return s;
 			case kDeleted:
+				if ( !merge->empty() )
+				{
+					s = merge->Finish(user_key, NULL, value);
+					pinnable->PinSelf();
+					return s;
+				}
 				s = Status::NotFound(Slice()); // Use empty error message for speed
 				return s;
 			case kCorrupt:
@@ -464,6 +695,13 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 		}
 	} // end for
 
+	if ( !merge->empty() )
+	{
+		// Operands all the way down: they apply to a missing value
+		s = merge->Finish(user_key, NULL, value);
+		pinnable->PinSelf();
+		return s;
+	}
 	return Status::NotFound(Slice()); // Use an empty error message for speed
 }
 
@@ -622,6 +860,23 @@ std::string Version::DebugString() const
 			r.append("]\n");
 		}
 	}
+	if ( !blob_files_.empty() )
+	{
+		// E.g.,
+		//   --- blob files ---
+		//   21:4096(garbage 1024)
+		r.append("--- blob files ---\n");
+		for (size_t i = 0; i < blob_files_.size(); i++)
+		{
+			r.push_back(' ');
+			AppendNumberTo(&r, blob_files_[i].number);
+			r.push_back(':');
+			AppendNumberTo(&r, blob_files_[i].file_size);
+			r.append("(garbage ");
+			AppendNumberTo(&r, blob_files_[i].garbage_size);
+			r.append(")\n");
+		}
+	}
 	return r;
 }
 
@@ -662,6 +917,7 @@ class VersionSet::Builder
 		VersionSet* vset_;
 		Version* base_;
 		LevelState levels_[config::kNumLevels];
+		std::map<uint64_t, BlobFileMetaData> blob_files_;
 
 	public:
 		// Initialize a builder with the files from *base and other info from *vset
@@ -669,6 +925,11 @@ class VersionSet::Builder
 			vset_(vset), base_(base)
 		{
 			base_->Ref();
+			for (size_t i = 0; i < base_->blob_files_.size(); i++)
+			{
+				blob_files_[base_->blob_files_[i].number]
+						= base_->blob_files_[i];
+			}
 			BySmallestKey cmp;
 			cmp.internal_comparator = &vset_->icmp_;
 			for (int level = 0; level < config::kNumLevels; level++)
@@ -751,6 +1012,25 @@ class VersionSet::Builder
 				levels_[level].deleted_files.erase(f->number);
 				levels_[level].added_files->insert(f);
 			}
+
+			// Add new blob files and account for their garbage
+			for (size_t i = 0; i < edit->new_blob_files_.size(); i++)
+			{
+				BlobFileMetaData* b =
+						&blob_files_[edit->new_blob_files_[i].first];
+				b->number = edit->new_blob_files_[i].first;
+				b->file_size = edit->new_blob_files_[i].second;
+				b->garbage_size = 0;
+			}
+			for (size_t i = 0; i < edit->blob_garbage_.size(); i++)
+			{
+				std::map<uint64_t, BlobFileMetaData>::iterator it =
+						blob_files_.find(edit->blob_garbage_[i].first);
+				if ( it != blob_files_.end() )
+				{
+					it->second.garbage_size += edit->blob_garbage_[i].second;
+				}
+			}
 		}
 
 		// Save the current state in *v.
@@ -809,6 +1089,16 @@ class VersionSet::Builder
 				}
 #endif
 			}
+
+			// Blob files no table refers to any more are dropped
+			for (std::map<uint64_t, BlobFileMetaData>::const_iterator it =
+					blob_files_.begin(); it != blob_files_.end(); ++it)
+			{
+				if ( it->second.garbage_size < it->second.file_size )
+				{
+					v->blob_files_.push_back(it->second);
+				}
+			}
 		}
 
 		void MaybeAddFile(Version* v, int level, FileMetaData* f)
@@ -833,14 +1123,15 @@ class VersionSet::Builder
 };
 
 VersionSet::VersionSet(const std::string& dbname, const Options* options,
-		TableCache* table_cache, const InternalKeyComparator* cmp) :
+		TableCache* table_cache, BlobCache* blob_cache,
+		const InternalKeyComparator* cmp) :
 	env_(options->env), dbname_(dbname), options_(options), table_cache_(
-			table_cache),
+			table_cache), blob_cache_(blob_cache),
 			icmp_(*cmp),
 			next_file_number_(2),
 			manifest_file_number_(0), // Filled by Recover()
 			last_sequence_(0), log_number_(0), prev_log_number_(0),
-			descriptor_file_(NULL), descriptor_log_(NULL),
+			max_column_family_(0), descriptor_file_(NULL), descriptor_log_(NULL),
 			dummy_versions_(this), current_(NULL)
 {
 	AppendVersion(new Version(this));
@@ -876,6 +1167,24 @@ void VersionSet::AppendVersion(Version* v)
 	v->next_->prev_ = v;
 }
 
+void VersionSet::ApplyColumnFamilies(const VersionEdit& edit,
+		std::map<uint32_t, std::string>* families, uint32_t* max_id)
+{
+	if ( edit.has_max_column_family_ && edit.max_column_family_ > *max_id )
+	{
+		*max_id = edit.max_column_family_;
+	}
+	for (size_t i = 0; i < edit.new_column_families_.size(); i++)
+	{
+		(*families)[edit.new_column_families_[i].first]
+				= edit.new_column_families_[i].second;
+	}
+	for (size_t i = 0; i < edit.dropped_column_families_.size(); i++)
+	{
+		families->erase(edit.dropped_column_families_[i]);
+	}
+}
+
 Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu)
 {
 	if ( edit->has_log_number_ )
@@ -969,6 +1278,7 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu)
 		AppendVersion(v);
 		log_number_ = edit->log_number_;
 		prev_log_number_ = edit->prev_log_number_;
+		ApplyColumnFamilies(*edit, &column_families_, &max_column_family_);
 	}
 	else
 	{
@@ -1027,6 +1337,8 @@ Status VersionSet::Recover()
 	uint64_t last_sequence = 0;
 	uint64_t log_number = 0;
 	uint64_t prev_log_number = 0;
+	std::map<uint32_t, std::string> column_families;
+	uint32_t max_column_family = 0;
 	Builder builder(this, current_);
 
 	{
@@ -1054,6 +1366,7 @@ Status VersionSet::Recover()
 			if ( s.ok() )
 			{
 				builder.Apply(&edit);
+				ApplyColumnFamilies(edit, &column_families, &max_column_family);
 			}
 
 			if ( edit.has_log_number_ )
@@ -1121,6 +1434,8 @@ Status VersionSet::Recover()
 		last_sequence_ = last_sequence;
 		log_number_ = log_number;
 		prev_log_number_ = prev_log_number;
+		column_families_.swap(column_families);
+		max_column_family_ = max_column_family;
 	}
 
 	return s;
@@ -1136,6 +1451,8 @@ void VersionSet::MarkFileNumberUsed(uint64_t number)
 
 void VersionSet::Finalize(Version* v)
 {
+	v->file_indexer_.UpdateIndex(icmp_.user_comparator(), v->files_);
+
 	// Precomputed best level for next compaction
 	int best_level = -1;
 	double best_score = -1;
@@ -1175,6 +1492,34 @@ void VersionSet::Finalize(Version* v)
 
 	v->compaction_level_ = best_level;
 	v->compaction_score_ = best_score;
+
+	// Tables made mostly of deletion markers, such as the ones left behind
+	// by a queue, slow down every iterator over them.  Push them down until
+	// the markers reach the bottom and are dropped.  The last level has
+	// nowhere to go, and keeps markers only for snapshots anyway.
+	// 删除标记过多的文件，也需要压缩
+	const double ratio = options_->deletion_compaction_ratio;
+	double best_ratio = 0;
+	for (int level = 0; ratio > 0 && level < config::kNumLevels - 1; level++)
+	{
+		const std::vector<FileMetaData*>& files = v->files_[level];
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			const FileMetaData* f = files[i];
+			if ( f->num_deletions == 0 )
+			{
+				continue;
+			}
+			const double r = static_cast<double> (f->num_deletions)
+					/ f->num_entries;
+			if ( r >= ratio && r > best_ratio )
+			{
+				v->deletion_file_to_compact_ = files[i];
+				v->deletion_file_to_compact_level_ = level;
+				best_ratio = r;
+			}
+		}
+	}
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log)
@@ -1202,12 +1547,32 @@ Status VersionSet::WriteSnapshot(log::Writer* log)
 		const std::vector<FileMetaData*>& files = current_->files_[level];
 		for (size_t i = 0; i < files.size(); i++)
 		{
-			const FileMetaData* f = files[i];
-			edit.AddFile(level, f->number, f->file_size, f->smallest,
-					f->largest);
+			edit.AddFile(level, *files[i]);
 		}
 	}
 
+	// Save blob files
+	for (size_t i = 0; i < current_->blob_files_.size(); i++)
+	{
+		const BlobFileMetaData& b = current_->blob_files_[i];
+		edit.AddBlobFile(b.number, b.file_size);
+		if ( b.garbage_size > 0 )
+		{
+			edit.AddBlobGarbage(b.number, b.garbage_size);
+		}
+	}
+
+	// Save column families
+	if ( max_column_family_ > 0 )
+	{
+		edit.SetMaxColumnFamily(max_column_family_);
+	}
+	for (std::map<uint32_t, std::string>::const_iterator iter =
+			column_families_.begin(); iter != column_families_.end(); ++iter)
+	{
+		edit.AddColumnFamily(iter->first, iter->second);
+	}
+
 	std::string record;
 	edit.EncodeTo(&record);
 	return log->AddRecord(record);
@@ -1293,10 +1658,14 @@ uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey)
 				// approximate offset of "ikey" within the table.
 				Table* tableptr;
 				Iterator* iter = table_cache_->NewIterator(ReadOptions(),
-						files[i]->number, files[i]->file_size, &tableptr);
+						files[i]->number, files[i]->file_size,
+						files[i]->global_seqno, &tableptr);
 				if ( tableptr != NULL )
 				{
-					result += tableptr->ApproximateOffsetOf(ikey.Encode());
+					// External tables are keyed by user keys
+					result += tableptr->ApproximateOffsetOf(
+							files[i]->global_seqno != 0 ? ikey.user_key()
+									: ikey.Encode());
 				}
 				delete iter;
 			}
@@ -1319,9 +1688,90 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live)
 				live->insert(files[i]->number);
 			}
 		}
+		for (size_t i = 0; i < v->blob_files_.size(); i++)
+		{
+			live->insert(v->blob_files_[i].number);
+		}
 	}
 }
 
+// Shared by the threads of LoadTableHandlers
+struct VersionSet::TableLoader
+{
+		TableCache* table_cache;
+		std::vector<FileMetaData*> files;
+		port::Mutex mu;
+		port::CondVar done_cv;
+		size_t next_file; // Index of the next file to open
+		int running; // Number of workers still running
+		Status status; // First error
+
+		TableLoader() :
+			done_cv(&mu), next_file(0), running(0)
+		{
+		}
+};
+
+void VersionSet::LoadTables(void* arg)
+{
+	TableLoader* loader = reinterpret_cast<TableLoader*> (arg);
+	loader->mu.Lock();
+	while ( loader->status.ok() && loader->next_file < loader->files.size() )
+	{
+		const FileMetaData* f = loader->files[loader->next_file++];
+		loader->mu.Unlock();
+		Status s = loader->table_cache->Preload(f->number, f->file_size,
+				f->global_seqno);
+		loader->mu.Lock();
+		if ( !s.ok() && loader->status.ok() )
+		{
+			loader->status = s;
+		}
+	}
+	loader->running--;
+	loader->done_cv.SignalAll();
+	loader->mu.Unlock();
+}
+
+Status VersionSet::LoadTableHandlers(int threads)
+{
+	const uint64_t start_micros = env_->NowMicros();
+	TableLoader loader;
+	loader.table_cache = table_cache_;
+	for (int level = 0; level < config::kNumLevels; level++)
+	{
+		loader.files.insert(loader.files.end(), current_->files_[level].begin(),
+				current_->files_[level].end());
+	}
+	if ( loader.files.empty() )
+	{
+		return Status::OK();
+	}
+
+	// The caller holds the mutex, so current_ cannot change under us
+	const int workers = std::min<int>(threads, loader.files.size());
+	loader.mu.Lock();
+	loader.running = workers;
+	loader.mu.Unlock();
+	for (int i = 1; i < workers; i++)
+	{
+		env_->StartThread(&VersionSet::LoadTables, &loader);
+	}
+	LoadTables(&loader);
+	loader.mu.Lock();
+	while ( loader.running > 0 )
+	{
+		loader.done_cv.Wait();
+	}
+	loader.mu.Unlock();
+
+	Log(options_->info_log, "Opened %d tables with %d threads in %llu micros: %s",
+			static_cast<int> (loader.files.size()), workers,
+			static_cast<unsigned long long> (env_->NowMicros() - start_micros),
+			loader.status.ToString().c_str());
+	return loader.status;
+}
+
 int64_t VersionSet::NumLevelBytes(int level) const
 {
 	assert(level >= 0);
@@ -1416,7 +1866,8 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c)
 				for (size_t i = 0; i < files.size(); i++)
 				{
 					list[num++] = table_cache_->NewIterator(options,
-							files[i]->number, files[i]->file_size);
+							files[i]->number, files[i]->file_size,
+							files[i]->global_seqno);
 				}
 			}
 			else
@@ -1444,12 +1895,14 @@ Compaction* VersionSet::PickCompaction()
 	// the compactions triggered by seeks.
 	const bool size_compaction = (current_->compaction_score_ >= 1);
 	const bool seek_compaction = (current_->file_to_compact_ != NULL);
+	const bool deletion_compaction = (current_->deletion_file_to_compact_
+			!= NULL);
 	if ( size_compaction )
 	{
 		level = current_->compaction_level_;
 		assert(level >= 0);
 		assert(level+1 < config::kNumLevels);
-		c = new Compaction(level);
+		c = new Compaction(level, kLevelSize);
 
 		// Pick the first file that comes after compact_pointer_[level]
 		for (size_t i = 0; i < current_->files_[level].size(); i++)
@@ -1471,9 +1924,15 @@ Compaction* VersionSet::PickCompaction()
 	else if ( seek_compaction )
 	{
 		level = current_->file_to_compact_level_;
-		c = new Compaction(level);
+		c = new Compaction(level, kSeekCompaction);
 		c->inputs_[0].push_back(current_->file_to_compact_);
 	}
+	else if ( deletion_compaction )
+	{
+		level = current_->deletion_file_to_compact_level_;
+		c = new Compaction(level, kDeletionCompaction);
+		c->inputs_[0].push_back(current_->deletion_file_to_compact_);
+	}
 	else
 	{
 		return NULL;
@@ -1492,6 +1951,28 @@ Compaction* VersionSet::PickCompaction()
 		// which will include the picked file.
 		current_->GetOverlappingInputs(0, &smallest, &largest, &c->inputs_[0]);
 		assert(!c->inputs_[0].empty());
+
+		// When level-0 nears the write slowdown and the level-1 files this
+		// compaction would rewrite outweigh its level-0 inputs, merging the
+		// newest level-0 files among themselves brings the file count down
+		// (and with it read amplification and the stall) far more cheaply.
+		// 第1层过大时，先在第0层内部合并，减少第0层的文件数
+		if ( size_compaction && current_->files_[0].size()
+				>= static_cast<size_t> (config::kL0_SlowdownWritesTrigger) )
+		{
+			GetRange(c->inputs_[0], &smallest, &largest);
+			std::vector<FileMetaData*> parents;
+			current_->GetOverlappingInputs(1, &smallest, &largest, &parents);
+			if ( TotalFileSize(parents) > TotalFileSize(c->inputs_[0]) )
+			{
+				Compaction* intra = PickIntraL0Compaction();
+				if ( intra != NULL )
+				{
+					delete c;
+					return intra;
+				}
+			}
+		}
 	}
 
 	SetupOtherInputs(c);
@@ -1499,6 +1980,44 @@ Compaction* VersionSet::PickCompaction()
 	return c;
 }
 
+Compaction* VersionSet::PickIntraL0Compaction()
+{
+	// Only the newest files may be merged: an older level-0 file left out
+	// of the merge must stay older than its output, which takes the place
+	// of the newest input in the level-0 order
+	std::vector<FileMetaData*> files(current_->files_[0]);
+	std::sort(files.begin(), files.end(), NewestFirst);
+
+	// A file larger than a memtable flush (an earlier merge, an ingested
+	// file) ends the run: rewriting it again would cost more than it saves
+	std::vector<FileMetaData*> inputs;
+	int64_t total = 0;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		const int64_t size = files[i]->file_size;
+		if ( size > static_cast<int64_t> (options_->write_buffer_size) || total
+				+ size > kExpandedCompactionByteSizeLimit )
+		{
+			break;
+		}
+		inputs.push_back(files[i]);
+		total += size;
+	}
+	if ( inputs.size() < static_cast<size_t> (config::kL0_CompactionTrigger) )
+	{
+		return NULL;
+	}
+
+	Compaction* c = new Compaction(0, kIntraL0Compaction);
+	c->output_level_ = 0;
+	// A single output, so that level-0 shrinks to one file
+	c->max_output_file_size_ = ~static_cast<uint64_t> (0);
+	c->inputs_[0] = inputs;
+	c->input_version_ = current_;
+	c->input_version_->Ref();
+	return c;
+}
+
 void VersionSet::SetupOtherInputs(Compaction* c)
 {
 	const int level = c->level();
@@ -1601,7 +2120,7 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
 		}
 	}
 
-	Compaction* c = new Compaction(level);
+	Compaction* c = new Compaction(level, kManualCompaction);
 	c->input_version_ = current_;
 	c->input_version_->Ref();
 	c->inputs_[0] = inputs;
@@ -1609,8 +2128,9 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
 	return c;
 }
 
-Compaction::Compaction(int level) :
-	level_(level), max_output_file_size_(MaxFileSizeForLevel(level)),
+Compaction::Compaction(int level, CompactionReason reason) :
+	level_(level), output_level_(level + 1), reason_(reason),
+			max_output_file_size_(MaxFileSizeForLevel(level)),
 			input_version_(NULL), grandparent_index_(0), seen_key_(false),
 			overlapped_bytes_(0)
 {
@@ -1633,8 +2153,10 @@ bool Compaction::IsTrivialMove() const
 {
 	// Avoid a move if there is lots of overlapping grandparent data.
 	// Otherwise, the move could create a parent file that will require
-	// a very expensive merge later on.
-	return (num_input_files(0) == 1 && num_input_files(1) == 0
+	// a very expensive merge later on.  A file picked for its deletion
+	// markers is rewritten, so that the markers can be dropped.
+	return (output_level_ == level_ + 1 && reason_ != kDeletionCompaction
+			&& num_input_files(0) == 1 && num_input_files(1) == 0
 			&& TotalFileSize(grandparents_) <= kMaxGrandParentOverlapBytes);
 }
 
@@ -1648,13 +2170,43 @@ void Compaction::AddInputDeletions(VersionEdit* edit)
 			edit->DeleteFile(level_ + which, inputs_[which][i]->number);
 		}
 	}
+	for (size_t i = 0; i < dropped_inputs_.size(); i++)
+	{
+		edit->DeleteFile(level_ + 1, dropped_inputs_[i]->number);
+	}
+}
+
+void Compaction::DropParentInput(int i)
+{
+	dropped_inputs_.push_back(inputs_[1][i]);
+	inputs_[1].erase(inputs_[1].begin() + i);
+}
+
+bool Compaction::IsBaseLevelForRange(const Slice& begin, const Slice& end)
+{
+	if ( output_level_ == 0 )
+	{
+		return false;
+	}
+	for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++)
+	{
+		if ( input_version_->OverlapInLevel(lvl, &begin, &end) )
+		{
+			return false;
+		}
+	}
+	return true;
 }
 
 bool Compaction::IsBaseLevelForKey(const Slice& user_key)
 {
 	// Maybe use binary search to find right entry instead of linear search?
+	if ( output_level_ == 0 )
+	{
+		return false;
+	}
 	const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-	for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++)
+	for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++)
 	{
 		const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
 		for (; level_ptrs_[lvl] < files.size();)
@@ -19,7 +19,10 @@
 #include <set>
 #include <vector>
 #include "db/dbformat.h"
+#include "db/file_indexer.h"
 #include "db/version_edit.h"
+#include "leveldb/listener.h"
+#include "leveldb/pinnable_slice.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
 
@@ -31,9 +34,12 @@ namespace log
 class Writer;
 }
 
+class BlobCache;
 class Compaction;
 class Iterator;
 class MemTable;
+class MergeContext;
+class RangeDelAggregator;
 class TableBuilder;
 class TableCache;
 class Version;
@@ -63,11 +69,19 @@ class Version
 	public:
 		// Append to *iters a sequence of iterators that will
 		// yield the contents of this Version when merged together.
+		// Files entirely outside the iterate bounds of the options (user
+		// keys) are not opened.
 		// REQUIRES: This version has been saved (see VersionSet::SaveTo)
 		void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
+		// Add the range deletions of every file in this Version to *range_del.
+		// REQUIRES: This version has been saved (see VersionSet::SaveTo)
+		Status AddRangeTombstones(RangeDelAggregator* range_del);
+
 		// Lookup the value for key.  If found, store it in *val and
 		// return OK.  Else return a non-OK status.  Fills *stats.
+		// Merge operands already collected for key by the caller are in
+		// *merge and are applied to whatever value this version holds.
 		// REQUIRES: lock is not held
 		struct GetStats
 		{
@@ -75,8 +89,13 @@ class Version
 				int seek_file_level; //查询文件的级别
 		};
 		// 通过@key，来查找，获取 @val.
-		Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-				GetStats* stats);
+		// Entries older than *range_del_seq are taken as deleted; it is
+		// raised by the range deletions met in the files searched.  If
+		// "pin" is true, a value read as is from a table is pinned in *val
+		// rather than copied.
+		Status Get(const ReadOptions&, const LookupKey& key,
+				PinnableSlice* val, GetStats* stats, MergeContext* merge,
+				SequenceNumber* range_del_seq, bool pin);
 
 		// Adds "stats" into the current state.  Returns true if a new
 		// compaction may need to be triggered, false otherwise.
@@ -111,6 +130,12 @@ class Version
 			return files_[level].size();
 		}
 
+		// Blob files referred to by the tables of this version, by number
+		const std::vector<BlobFileMetaData>& blob_files() const
+		{
+			return blob_files_;
+		}
+
 		// Return a human readable string that describes this version's contents.
 		std::string DebugString() const;
 
@@ -131,10 +156,21 @@ class Version
 		// 一共有 7级，每一级，是一个vector.
 		std::vector<FileMetaData*> files_[config::kNumLevels];
 
+		// Narrows the search of each level by Get() to the files under the
+		// one of the level above.  Built by Finalize().
+		FileIndexer file_indexer_;
+
+		std::vector<BlobFileMetaData> blob_files_;
+
 		// Next file to compact based on seek stats.
 		FileMetaData* file_to_compact_; //下一个需要压缩的文件指针
 		int file_to_compact_level_; //下一个需要压缩的文件级别
 
+		// File whose share of deletion markers is the largest of those
+		// reaching Options::deletion_compaction_ratio.  Set by Finalize().
+		FileMetaData* deletion_file_to_compact_;
+		int deletion_file_to_compact_level_;
+
 		// Level that should be compacted next and its compaction score.
 		// Score < 1 means compaction is not strictly needed.  These fields
 		// are initialized by Finalize().
@@ -143,7 +179,9 @@ class Version
 
 		explicit Version(VersionSet* vset) :
 			vset_(vset), next_(this), prev_(this), refs_(0), file_to_compact_(
-					NULL), file_to_compact_level_(-1), compaction_score_(-1),
+					NULL), file_to_compact_level_(-1),
+					deletion_file_to_compact_(NULL),
+					deletion_file_to_compact_level_(-1), compaction_score_(-1),
 					compaction_level_(-1)
 		{
 		}
@@ -160,7 +198,8 @@ class VersionSet
 {
 	public:
 		VersionSet(const std::string& dbname, const Options* options,
-				TableCache* table_cache, const InternalKeyComparator*);
+				TableCache* table_cache, BlobCache* blob_cache,
+				const InternalKeyComparator*);
 		~VersionSet();
 
 		// Apply *edit to the current version to form a new descriptor that
@@ -238,6 +277,18 @@ class VersionSet
 			return prev_log_number_;
 		}
 
+		// Return the column families registered in this descriptor, by id.
+		const std::map<uint32_t, std::string>& column_families() const
+		{
+			return column_families_;
+		}
+
+		// Return the largest column family id ever handed out.
+		uint32_t MaxColumnFamily() const
+		{
+			return max_column_family_;
+		}
+
 		// Pick level and inputs for a new compaction.
 		// Returns NULL if there is no compaction to be done.
 		// Otherwise returns a pointer to a heap-allocated object that
@@ -263,13 +314,20 @@ class VersionSet
 		bool NeedsCompaction() const
 		{
 			Version* v = current_;
-			return (v->compaction_score_ >= 1) || (v->file_to_compact_ != NULL);
+			return (v->compaction_score_ >= 1) || (v->file_to_compact_ != NULL)
+					|| (v->deletion_file_to_compact_ != NULL);
 		}
 
 		// Add all files listed in any live version to *live.
 		// May also mutate some internal state.
 		void AddLiveFiles(std::set<uint64_t>* live);
 
+		// Open every table of the current version into the table cache,
+		// using up to "threads" threads.  Fails if some table cannot be
+		// opened.
+		// REQUIRES: mutex held (the workers do not need it)
+		Status LoadTableHandlers(int threads);
+
 		// Return the approximate offset in the database of the data for
 		// "key" as of version "v".
 		uint64_t ApproximateOffsetOf(Version* v, const InternalKey& key);
@@ -284,6 +342,9 @@ class VersionSet
 
 	private:
 		class Builder;
+		struct TableLoader;
+
+		static void LoadTables(void* arg);
 
 		friend class Compaction;
 		friend class Version;
@@ -299,9 +360,17 @@ class VersionSet
 
 		void SetupOtherInputs(Compaction* c);
 
+		// Merge the newest small level-0 files into one level-0 file, or
+		// return NULL if there are too few of them
+		Compaction* PickIntraL0Compaction();
+
 		// Save current contents to *log
 		Status WriteSnapshot(log::Writer* log);
 
+		// Apply the column family changes of edit to *families and *max_id
+		static void ApplyColumnFamilies(const VersionEdit& edit,
+				std::map<uint32_t, std::string>* families, uint32_t* max_id);
+
 		void AppendVersion(Version* v);
 
 		bool ManifestContains(const std::string& record) const;
@@ -310,12 +379,15 @@ class VersionSet
 		const std::string dbname_;
 		const Options* const options_;
 		TableCache* const table_cache_;
+		BlobCache* const blob_cache_;
 		const InternalKeyComparator icmp_;
 		uint64_t next_file_number_;
 		uint64_t manifest_file_number_; // manifest文件中，记载了所有的SSTable文件信息
 		uint64_t last_sequence_;
 		uint64_t log_number_;
 		uint64_t prev_log_number_; // 0 or backing store for memtable being compacted
+		std::map<uint32_t, std::string> column_families_;
+		uint32_t max_column_family_;
 
 		// Opened lazily
 		WritableFile* descriptor_file_;
@@ -351,6 +423,19 @@ class Compaction
 			return level_;
 		}
 
+		// Return the level the outputs go to: "level+1", or level-0 itself
+		// for a compaction that merges level-0 files only (kIntraL0Compaction)
+		int output_level() const
+		{
+			return output_level_;
+		}
+
+		// Why the compaction was picked
+		CompactionReason reason() const
+		{
+			return reason_;
+		}
+
 		// Return the object that holds the edits to the descriptor done
 		// by this compaction.
 		VersionEdit* edit()
@@ -384,10 +469,19 @@ class Compaction
 		void AddInputDeletions(VersionEdit* edit);
 
 		// Returns true if the information we have available guarantees that
-		// the compaction is producing data in "level+1" for which no data exists
-		// in levels greater than "level+1".
+		// the compaction is producing data in "output_level" for which no data
+		// exists in levels greater than "output_level".  Always false for an
+		// intra-L0 compaction, since older level-0 files may hold the key.
 		bool IsBaseLevelForKey(const Slice& user_key);
 
+		// Like IsBaseLevelForKey(), for every user key in [begin, end).
+		bool IsBaseLevelForRange(const Slice& begin, const Slice& end);
+
+		// Stop merging the i-th input at "level+1" ("parent"): a range deletion
+		// from "level" hides all of it from every snapshot, so the compaction
+		// just deletes the file (see AddInputDeletions) without reading it.
+		void DropParentInput(int i);
+
 		// Returns true iff we should stop building the current output
 		// before processing "internal_key".
 		bool ShouldStopBefore(const Slice& internal_key);
@@ -400,15 +494,18 @@ class Compaction
 		friend class Version;
 		friend class VersionSet;
 
-		explicit Compaction(int level);
+		Compaction(int level, CompactionReason reason);
 
 		int level_;
+		int output_level_;
+		CompactionReason reason_;
 		uint64_t max_output_file_size_;
 		Version* input_version_;
 		VersionEdit edit_;
 
 		// Each compaction reads inputs from "level_" and "level_+1"
 		std::vector<FileMetaData*> inputs_[2]; // The two sets of inputs // 将level, level+1，合并到level+1
+		std::vector<FileMetaData*> dropped_inputs_; // See DropParentInput()
 
 		// State used to check for number of of overlapping grandparent files
 		// (parent == level_ + 1, grandparent == level_ + 2)
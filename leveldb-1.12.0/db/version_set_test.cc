@@ -3,7 +3,9 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "db/version_set.h"
+#include "db/file_indexer.h"
 #include "util/logging.h"
+#include "util/random.h"
 #include "util/testharness.h"
 #include "util/testutil.h"
 
@@ -172,6 +174,134 @@ TEST(FindFileTest, OverlappingFiles) {
   ASSERT_TRUE(Overlaps("600", "700"));
 }
 
+class FileIndexerTest {
+ public:
+  std::vector<FileMetaData*> files_[config::kNumLevels];
+  FileIndexer indexer_;
+
+  ~FileIndexerTest() {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      for (size_t i = 0; i < files_[level].size(); i++) {
+        delete files_[level][i];
+      }
+    }
+  }
+
+  void Add(int level, int smallest, int largest) {
+    FileMetaData* f = new FileMetaData;
+    f->number = files_[level].size() + 1;
+    f->smallest = InternalKey(Key(smallest), 100, kTypeValue);
+    f->largest = InternalKey(Key(largest), 100, kTypeValue);
+    files_[level].push_back(f);
+  }
+
+  static std::string Key(int k) {
+    char buf[20];
+    snprintf(buf, sizeof(buf), "%06d", k);
+    return buf;
+  }
+
+  // Check that the range of level+1 the indexer gives for key after the
+  // search of level holds what a search of the whole level finds
+  void Check(int level, int k) {
+    InternalKeyComparator icmp(BytewiseComparator());
+    const Comparator* ucmp = icmp.user_comparator();
+    const std::string user_key = Key(k);
+    InternalKey ikey(user_key, 100, kTypeValue);
+    const std::vector<FileMetaData*>& upper = files_[level];
+    const std::vector<FileMetaData*>& lower = files_[level + 1];
+
+    const size_t index = FindFile(icmp, upper, ikey.Encode());
+    int cmp_smallest = 0, cmp_largest = 0;
+    if (index < upper.size()) {
+      cmp_smallest = ucmp->Compare(user_key, upper[index]->smallest.user_key());
+      cmp_largest = ucmp->Compare(user_key, upper[index]->largest.user_key());
+    }
+    uint32_t left, right;
+    indexer_.GetNextLevelIndex(level, index, cmp_smallest, cmp_largest,
+                               &left, &right);
+    ASSERT_LE(left, right);
+    ASSERT_LE(right, lower.size());
+
+    const uint32_t expected = FindFile(icmp, lower, ikey.Encode());
+    ASSERT_LE(left, expected);
+    if (expected >= right && expected < lower.size()) {
+      // Outside the range only if it cannot hold the key
+      ASSERT_LT(ucmp->Compare(user_key, lower[expected]->smallest.user_key()),
+                0);
+    }
+  }
+};
+
+TEST(FileIndexerTest, Bounds) {
+  Add(1, 100, 200);
+  Add(1, 300, 400);
+  Add(2, 50, 120);
+  Add(2, 150, 180);
+  Add(2, 190, 310);
+  Add(2, 350, 360);
+  Add(2, 500, 600);
+  indexer_.UpdateIndex(BytewiseComparator(), files_);
+
+  uint32_t left, right;
+  // Before the first file
+  indexer_.GetNextLevelIndex(1, 0, -1, -1, &left, &right);
+  ASSERT_EQ(0, left);
+  ASSERT_EQ(1, right);
+  // Inside the first file
+  indexer_.GetNextLevelIndex(1, 0, 1, -1, &left, &right);
+  ASSERT_EQ(0, left);
+  ASSERT_EQ(3, right);
+  // Between the files
+  indexer_.GetNextLevelIndex(1, 1, -1, -1, &left, &right);
+  ASSERT_EQ(2, left);
+  ASSERT_EQ(3, right);
+  // At the largest key of the last file
+  indexer_.GetNextLevelIndex(1, 1, 1, 0, &left, &right);
+  ASSERT_EQ(4, left);
+  ASSERT_EQ(4, right);
+  // Past the last file
+  indexer_.GetNextLevelIndex(1, 2, 0, 0, &left, &right);
+  ASSERT_EQ(4, left);
+  ASSERT_EQ(5, right);
+
+  // Level-0 and empty levels are not narrowed
+  indexer_.GetNextLevelIndex(0, 0, 0, 0, &left, &right);
+  ASSERT_EQ(0, left);
+  ASSERT_EQ(0, right);
+  indexer_.GetNextLevelIndex(2, 3, 0, 0, &left, &right);
+  ASSERT_EQ(0, left);
+  ASSERT_EQ(0, right);
+}
+
+TEST(FileIndexerTest, Random) {
+  Random rnd(301);
+  for (int run = 0; run < 20; run++) {
+    for (int level = 1; level < config::kNumLevels; level++) {
+      int k = rnd.Uniform(50);
+      const int n = rnd.Uniform(1 + 4 * level);
+      for (int i = 0; i < n; i++) {
+        const int smallest = k + rnd.Uniform(30);
+        const int largest = smallest + rnd.Uniform(30);
+        Add(level, smallest, largest);
+        k = largest + 1;
+      }
+    }
+    indexer_.UpdateIndex(BytewiseComparator(), files_);
+    for (int level = 1; level + 1 < config::kNumLevels; level++) {
+      for (int k = 0; k < 1500; k++) {
+        Check(level, k);
+      }
+    }
+    for (int level = 0; level < config::kNumLevels; level++) {
+      for (size_t i = 0; i < files_[level].size(); i++) {
+        delete files_[level][i];
+      }
+      files_[level].clear();
+    }
+  }
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
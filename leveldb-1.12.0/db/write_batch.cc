@@ -7,8 +7,12 @@
 //    count: fixed32
 //    data: record[count]
 // record :=
+//    [kTypeColumnFamily varint32] update    // Absent for the default family
+// update :=
 //    kTypeValue varstring varstring         |
-//    kTypeDeletion varstring
+//    kTypeDeletion varstring                |
+//    kTypeMerge varstring varstring         |
+//    kTypeRangeDeletion varstring varstring
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
@@ -27,6 +31,10 @@ namespace leveldb
 // WriteBatch header has an 8-byte sequence number followed by a 4-byte count.
 static const size_t kHeader = 12;
 
+// Tag of the column family id that precedes the updates of families other
+// than the default one.  Never stored in a memtable, so not a ValueType.
+static const char kTypeColumnFamily = 0x10;
+
 WriteBatch::WriteBatch()
 {
 	Clear();
@@ -40,6 +48,19 @@ WriteBatch::Handler::~Handler()
 {
 }
 
+void WriteBatch::Handler::Merge(const Slice& key, const Slice& value)
+{
+}
+
+void WriteBatch::Handler::DeleteRange(const Slice& begin_key,
+		const Slice& end_key)
+{
+}
+
+void WriteBatch::Handler::SetColumnFamily(uint32_t column_family_id)
+{
+}
+
 void WriteBatch::Clear()
 {
 	rep_.clear();
@@ -60,11 +81,27 @@ Status WriteBatch::Iterate(Handler* handler) const
 	input.remove_prefix(kHeader);
 	Slice key, value;
 	int found = 0;
+	uint32_t column_family = 0;
 	while (!input.empty())
 	{
 		found++;
 		char tag = input[0];
 		input.remove_prefix(1);
+		uint32_t record_family = 0;
+		if ( tag == kTypeColumnFamily )
+		{
+			if ( !GetVarint32(&input, &record_family) || input.empty() )
+			{
+				return Status::Corruption("bad WriteBatch column family");
+			}
+			tag = input[0];
+			input.remove_prefix(1);
+		}
+		if ( record_family != column_family )
+		{
+			column_family = record_family;
+			handler->SetColumnFamily(column_family);
+		}
 		switch (tag)
 		{
 		case kTypeValue:
@@ -88,6 +125,28 @@ Status WriteBatch::Iterate(Handler* handler) const
 				return Status::Corruption("bad WriteBatch Delete");
 			}
 			break;
+		case kTypeMerge:
+			if ( GetLengthPrefixedSlice(&input, &key)
+					&& GetLengthPrefixedSlice(&input, &value) )
+			{
+				handler->Merge(key, value);
+			}
+			else
+			{
+				return Status::Corruption("bad WriteBatch Merge");
+			}
+			break;
+		case kTypeRangeDeletion:
+			if ( GetLengthPrefixedSlice(&input, &key)
+					&& GetLengthPrefixedSlice(&input, &value) )
+			{
+				handler->DeleteRange(key, value);
+			}
+			else
+			{
+				return Status::Corruption("bad WriteBatch DeleteRange");
+			}
+			break;
 		default:
 			return Status::Corruption("unknown WriteBatch tag");
 		}
@@ -124,39 +183,126 @@ void WriteBatchInternal::SetSequence(WriteBatch* b, SequenceNumber seq)
 	EncodeFixed64(&b->rep_[0], seq);
 }
 
+// Mark the update about to be appended to *rep as one of column_family
+static void AppendColumnFamily(std::string* rep,
+		ColumnFamilyHandle* column_family)
+{
+	if ( column_family != NULL && column_family->GetID() != 0 )
+	{
+		rep->push_back(kTypeColumnFamily);
+		PutVarint32(rep, column_family->GetID());
+	}
+}
+
 void WriteBatch::Put(const Slice& key, const Slice& value)
+{
+	Put(NULL, key, value);
+}
+
+void WriteBatch::Put(ColumnFamilyHandle* column_family, const Slice& key,
+		const Slice& value)
 {
 	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	AppendColumnFamily(&rep_, column_family);
 	rep_.push_back(static_cast<char> (kTypeValue));
 	PutLengthPrefixedSlice(&rep_, key);
 	PutLengthPrefixedSlice(&rep_, value);
 }
 
 void WriteBatch::Delete(const Slice& key)
+{
+	Delete(NULL, key);
+}
+
+void WriteBatch::Delete(ColumnFamilyHandle* column_family, const Slice& key)
 {
 	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	AppendColumnFamily(&rep_, column_family);
 	rep_.push_back(static_cast<char> (kTypeDeletion));
 	PutLengthPrefixedSlice(&rep_, key);
 }
 
+void WriteBatch::Merge(const Slice& key, const Slice& value)
+{
+	Merge(NULL, key, value);
+}
+
+void WriteBatch::Merge(ColumnFamilyHandle* column_family, const Slice& key,
+		const Slice& value)
+{
+	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	AppendColumnFamily(&rep_, column_family);
+	rep_.push_back(static_cast<char> (kTypeMerge));
+	PutLengthPrefixedSlice(&rep_, key);
+	PutLengthPrefixedSlice(&rep_, value);
+}
+
+void WriteBatch::DeleteRange(const Slice& begin_key, const Slice& end_key)
+{
+	DeleteRange(NULL, begin_key, end_key);
+}
+
+void WriteBatch::DeleteRange(ColumnFamilyHandle* column_family,
+		const Slice& begin_key, const Slice& end_key)
+{
+	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	AppendColumnFamily(&rep_, column_family);
+	rep_.push_back(static_cast<char> (kTypeRangeDeletion));
+	PutLengthPrefixedSlice(&rep_, begin_key);
+	PutLengthPrefixedSlice(&rep_, end_key);
+}
+
 namespace
 {
 class MemTableInserter: public WriteBatch::Handler
 {
 	public:
 		SequenceNumber sequence_;
-		MemTable* mem_;
+		MemTable* mem_; // NULL while the updates are skipped
+		MemTable* default_mem_;
+		const std::map<uint32_t, MemTable*>* memtables_;
 
 		virtual void Put(const Slice& key, const Slice& value)
 		{
-			mem_->Add(sequence_, kTypeValue, key, value);
+			if ( mem_ != NULL )
+				mem_->Add(sequence_, kTypeValue, key, value);
 			sequence_++;
 		}
 		virtual void Delete(const Slice& key)
 		{
-			mem_->Add(sequence_, kTypeDeletion, key, Slice());
+			if ( mem_ != NULL )
+				mem_->Add(sequence_, kTypeDeletion, key, Slice());
 			sequence_++;
 		}
+		virtual void Merge(const Slice& key, const Slice& value)
+		{
+			if ( mem_ != NULL )
+				mem_->Add(sequence_, kTypeMerge, key, value);
+			sequence_++;
+		}
+		virtual void DeleteRange(const Slice& begin_key, const Slice& end_key)
+		{
+			if ( mem_ != NULL )
+				mem_->Add(sequence_, kTypeRangeDeletion, begin_key, end_key);
+			sequence_++;
+		}
+		virtual void SetColumnFamily(uint32_t column_family_id)
+		{
+			// Updates of other families still use up their sequence numbers
+			mem_ = NULL;
+			if ( memtables_ == NULL )
+			{
+				if ( column_family_id == 0 )
+					mem_ = default_mem_;
+			}
+			else
+			{
+				std::map<uint32_t, MemTable*>::const_iterator iter =
+						memtables_->find(column_family_id);
+				if ( iter != memtables_->end() )
+					mem_ = iter->second;
+			}
+		}
 };
 } // namespace
 
@@ -165,6 +311,18 @@ Status WriteBatchInternal::InsertInto(const WriteBatch* b, MemTable* memtable)
 	MemTableInserter inserter;
 	inserter.sequence_ = WriteBatchInternal::Sequence(b);
 	inserter.mem_ = memtable;
+	inserter.default_mem_ = memtable;
+	inserter.memtables_ = NULL;
+	return b->Iterate(&inserter);
+}
+
+Status WriteBatchInternal::InsertInto(const WriteBatch* b,
+		const std::map<uint32_t, MemTable*>& memtables)
+{
+	MemTableInserter inserter;
+	inserter.sequence_ = WriteBatchInternal::Sequence(b);
+	inserter.memtables_ = &memtables;
+	inserter.SetColumnFamily(0);
 	return b->Iterate(&inserter);
 }
 
@@ -5,6 +5,7 @@
 #ifndef STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
 #define STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
 
+#include <map>
 #include "leveldb/write_batch.h"
 
 namespace leveldb
@@ -44,8 +45,15 @@ class WriteBatchInternal
 
 		static void SetContents(WriteBatch* batch, const Slice& contents);
 
+		// Insert the updates of the default column family into *memtable;
+		// those of other families are skipped.
 		static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
 
+		// Insert the updates of each column family into memtables[id].
+		// Updates of families missing from "memtables" are skipped.
+		static Status InsertInto(const WriteBatch* batch,
+				const std::map<uint32_t, MemTable*>& memtables);
+
 		static void Append(WriteBatch* dst, const WriteBatch* src);
 };
 
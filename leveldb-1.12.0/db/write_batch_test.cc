@@ -38,11 +38,38 @@ static std::string PrintContents(WriteBatch* b) {
         state.append(")");
         count++;
         break;
+      case kTypeMerge:
+        state.append("Merge(");
+        state.append(ikey.user_key.ToString());
+        state.append(", ");
+        state.append(iter->value().ToString());
+        state.append(")");
+        count++;
+        break;
+      case kTypeRangeDeletion:
+      case kTypeBlobIndex:
+        // Range deletions are listed below; blob indexes are only in tables
+        state.append("Unexpected()");
+        break;
     }
     state.append("@");
     state.append(NumberToString(ikey.sequence));
   }
   delete iter;
+  iter = mem->NewRangeDelIterator();
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey ikey;
+    ASSERT_TRUE(ParseInternalKey(iter->key(), &ikey));
+    ASSERT_EQ(kTypeRangeDeletion, ikey.type);
+    state.append("DeleteRange(");
+    state.append(ikey.user_key.ToString());
+    state.append(", ");
+    state.append(iter->value().ToString());
+    state.append(")@");
+    state.append(NumberToString(ikey.sequence));
+    count++;
+  }
+  delete iter;
   if (!s.ok()) {
     state.append("ParseError()");
   } else if (count != WriteBatchInternal::Count(b)) {
@@ -74,6 +101,32 @@ TEST(WriteBatchTest, Multiple) {
             PrintContents(&batch));
 }
 
+TEST(WriteBatchTest, Merge) {
+  WriteBatch batch;
+  batch.Put(Slice("foo"), Slice("1"));
+  batch.Merge(Slice("foo"), Slice("2"));
+  batch.Merge(Slice("bar"), Slice("3"));
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(3, WriteBatchInternal::Count(&batch));
+  ASSERT_EQ("Merge(bar, 3)@102"
+            "Merge(foo, 2)@101"
+            "Put(foo, 1)@100",
+            PrintContents(&batch));
+}
+
+TEST(WriteBatchTest, DeleteRange) {
+  WriteBatch batch;
+  batch.Put(Slice("foo"), Slice("bar"));
+  batch.DeleteRange(Slice("a"), Slice("g"));
+  batch.DeleteRange(Slice("b"), Slice("c"));
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(3, WriteBatchInternal::Count(&batch));
+  ASSERT_EQ("Put(foo, bar)@100"
+            "DeleteRange(a, g)@101"
+            "DeleteRange(b, c)@102",
+            PrintContents(&batch));
+}
+
 TEST(WriteBatchTest, Corruption) {
   WriteBatch batch;
   batch.Put(Slice("foo"), Slice("bar"));
@@ -113,6 +166,79 @@ TEST(WriteBatchTest, Append) {
             PrintContents(&b1));
 }
 
+namespace {
+class TestColumnFamily : public ColumnFamilyHandle {
+ public:
+  TestColumnFamily(uint32_t id, const std::string& name)
+      : id_(id), name_(name) { }
+  virtual const std::string& GetName() const { return name_; }
+  virtual uint32_t GetID() const { return id_; }
+ private:
+  uint32_t id_;
+  std::string name_;
+};
+
+std::string PrintKeys(MemTable* mem) {
+  std::string result;
+  Iterator* iter = mem->NewIterator();
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey ikey;
+    ASSERT_TRUE(ParseInternalKey(iter->key(), &ikey));
+    result.append(ikey.user_key.ToString());
+    result.append("@");
+    result.append(NumberToString(ikey.sequence));
+    result.append(" ");
+  }
+  delete iter;
+  return result;
+}
+}  // namespace
+
+TEST(WriteBatchTest, ColumnFamilies) {
+  TestColumnFamily three(3, "three"), four(4, "four");
+  WriteBatch batch;
+  batch.Put(Slice("a"), Slice("va"));
+  batch.Put(&three, Slice("b"), Slice("vb"));
+  batch.Delete(&three, Slice("c"));
+  batch.Put(&four, Slice("d"), Slice("vd"));
+  batch.Put(NULL, Slice("e"), Slice("ve"));
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(5, WriteBatchInternal::Count(&batch));
+
+  // The plain InsertInto() keeps the default family only
+  ASSERT_EQ("Put(a, va)@100"
+            "Put(e, ve)@104"
+            "CountMismatch()",
+            PrintContents(&batch));
+
+  // Families missing from the map are skipped, keeping their sequence
+  InternalKeyComparator cmp(BytewiseComparator());
+  MemTable* mem0 = new MemTable(cmp);
+  MemTable* mem3 = new MemTable(cmp);
+  mem0->Ref();
+  mem3->Ref();
+  std::map<uint32_t, MemTable*> memtables;
+  memtables[0] = mem0;
+  memtables[3] = mem3;
+  ASSERT_OK(WriteBatchInternal::InsertInto(&batch, memtables));
+  ASSERT_EQ("a@100 e@104 ", PrintKeys(mem0));
+  ASSERT_EQ("b@101 c@102 ", PrintKeys(mem3));
+  mem0->Unref();
+  mem3->Unref();
+
+  // Appending keeps the families of the records
+  WriteBatch b2;
+  WriteBatchInternal::SetSequence(&b2, 200);
+  WriteBatchInternal::Append(&b2, &batch);
+  mem3 = new MemTable(cmp);
+  mem3->Ref();
+  memtables.clear();
+  memtables[3] = mem3;
+  ASSERT_OK(WriteBatchInternal::InsertInto(&b2, memtables));
+  ASSERT_EQ("b@201 c@202 ", PrintKeys(mem3));
+  mem3->Unref();
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -61,6 +61,7 @@ typedef struct leveldb_filterpolicy_t leveldb_filterpolicy_t;
 typedef struct leveldb_iterator_t leveldb_iterator_t;
 typedef struct leveldb_logger_t leveldb_logger_t;
 typedef struct leveldb_options_t leveldb_options_t;
+typedef struct leveldb_pinnableslice_t leveldb_pinnableslice_t;
 typedef struct leveldb_randomfile_t leveldb_randomfile_t;
 typedef struct leveldb_readoptions_t leveldb_readoptions_t;
 typedef struct leveldb_seqfile_t leveldb_seqfile_t;
@@ -92,6 +93,18 @@ extern void leveldb_write(leveldb_t* db, const leveldb_writeoptions_t* options,
 extern char* leveldb_get(leveldb_t* db, const leveldb_readoptions_t* options,
 		const char* key, size_t keylen, size_t* vallen, char** errptr);
 
+/* Returns NULL if not found.  Otherwise a handle on the value, which may
+ refer to memory of the DB rather than to a copy; it must be destroyed
+ before the DB is closed. */
+extern leveldb_pinnableslice_t* leveldb_get_pinned(leveldb_t* db,
+		const leveldb_readoptions_t* options, const char* key, size_t keylen,
+		char** errptr);
+
+extern const char* leveldb_pinnableslice_value(
+		const leveldb_pinnableslice_t* slice, size_t* vallen);
+
+extern void leveldb_pinnableslice_destroy(leveldb_pinnableslice_t* slice);
+
 extern leveldb_iterator_t* leveldb_create_iterator(leveldb_t* db,
 		const leveldb_readoptions_t* options);
 
@@ -208,6 +221,11 @@ extern void leveldb_readoptions_set_fill_cache(leveldb_readoptions_t*,
 		unsigned char);
 extern void leveldb_readoptions_set_snapshot(leveldb_readoptions_t*,
 		const leveldb_snapshot_t*);
+/* A NULL key removes the bound */
+extern void leveldb_readoptions_set_iterate_lower_bound(
+		leveldb_readoptions_t*, const char* key, size_t keylen);
+extern void leveldb_readoptions_set_iterate_upper_bound(
+		leveldb_readoptions_t*, const char* key, size_t keylen);
 
 /* Write options */
 
@@ -19,17 +19,38 @@
 #define STORAGE_LEVELDB_INCLUDE_CACHE_H_
 
 #include <stdint.h>
+#include <string>
 #include "leveldb/slice.h"
+#include "leveldb/status.h"
 
 namespace leveldb
 {
 
 class Cache;
+class Env;
+class SecondaryCache;
 
 // Create a new cache with a fixed size capacity.  This implementation
 // of Cache uses a least-recently-used(最近最久未使用) eviction(收回) policy.
 extern Cache* NewLRUCache(size_t capacity);
 
+// Like NewLRUCache(capacity), over a second, larger tier: the bytes of
+// the entries evicted to make room are handed to "secondary" if they
+// were inserted with a "contents" function (see Cache::Insert), and
+// Cache::secondary() lets clients look them up there on a miss.
+// The caller keeps ownership of "secondary", which must outlive the cache.
+extern Cache* NewLRUCache(size_t capacity, SecondaryCache* secondary);
+
+// Create a secondary cache that keeps up to "capacity" bytes in files
+// under the directory "path", typically on a local SSD.  Entries are
+// appended to a log of fixed-size segment files, and the oldest
+// segment is dropped to make room.  The index lives in memory, so the
+// files of an earlier run under "path" are removed.
+//
+// 二级缓存：被LRU淘汰的block写入本地SSD上的日志文件，内存中保存索引
+extern Status NewLogSecondaryCache(Env* env, const std::string& path,
+		uint64_t capacity, SecondaryCache** result);
+
 class Cache
 {
 	public:
@@ -58,6 +79,17 @@ class Cache
 		virtual Handle* Insert(const Slice& key, void* value, size_t charge,
 				void(*deleter)(const Slice& key, void* value)) = 0;
 
+		// Like Insert(), for a value that the secondary tier of the cache,
+		// if any, may keep once the entry is evicted: "contents" returns
+		// the bytes to keep for it.  The default ignores "contents".
+		virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+				void(*deleter)(const Slice& key, void* value),
+				Slice(*contents)(void* value));
+
+		// The tier holding the entries evicted from this cache, or NULL.
+		// The default is NULL.
+		virtual SecondaryCache* secondary() const;
+
 		// If the cache has no mapping for "key", returns NULL.
 		//
 		// Else return a handle that corresponds to the mapping.  The caller
@@ -100,6 +132,31 @@ class Cache
 		void operator=(const Cache&);
 };
 
+// A larger and slower tier under a Cache.  It keeps a copy of the bytes
+// of entries, and is safe for concurrent use.
+class SecondaryCache
+{
+	public:
+		SecondaryCache()
+		{
+		}
+
+		virtual ~SecondaryCache();
+
+		// Keep a copy of "contents" under "key", unless it is kept already.
+		// May drop older entries to make room, or skip "contents".
+		virtual void Insert(const Slice& key, const Slice& contents) = 0;
+
+		// If an entry for "key" is kept, set *contents to its bytes and
+		// return true.  Else return false.
+		virtual bool Lookup(const Slice& key, std::string* contents) = 0;
+
+	private:
+		// No copying allowed
+		SecondaryCache(const SecondaryCache&);
+		void operator=(const SecondaryCache&);
+};
+
 } // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_UTIL_CACHE_H_
@@ -0,0 +1,48 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a custom CompactionFilter object.
+// The filter is consulted for every live key/value pair that a
+// compaction rewrites, and may drop the entry or replace its value.
+// This lets applications expire records (TTL) or garbage collect
+// values as a side effect of compactions that happen anyway, instead
+// of scanning the whole database and issuing explicit deletes.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+#define STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+
+#include <string>
+
+namespace leveldb
+{
+
+class Slice;
+
+// 压缩过滤器
+class CompactionFilter
+{
+	public:
+		virtual ~CompactionFilter();
+
+		// Return the name of this filter.  Used only for logging.
+		virtual const char* Name() const = 0;
+
+		// Called for the newest version of "key" seen by a compaction out of
+		// "level", provided that version is not visible to any live snapshot
+		// older than it.  Deletion markers are never passed to the filter.
+		//
+		// Return true to remove the entry: the key then reads as deleted.
+		// Otherwise, to rewrite the value, store the new value in *new_value
+		// and set *value_changed to true.  *value_changed is false on entry.
+		//
+		// The filter is invoked from the background compaction thread and
+		// must be thread-safe.
+		virtual bool Filter(int level, const Slice& key,
+				const Slice& existing_value, std::string* new_value,
+				bool* value_changed) const = 0;
+};
+
+}
+
+#endif  // STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
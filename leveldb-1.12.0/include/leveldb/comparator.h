@@ -57,6 +57,12 @@ class Comparator { //比较
   // 找到一个 >= *key的短字符串.并将该字符串赋值给*key.
   // 该函数什么也不干，也是正确的
   virtual void FindShortSuccessor(std::string* key) const = 0;
+
+  // Returns the part of "key" that point lookups match exactly, i.e. all
+  // the keys a lookup may return have the same PointKey().  Used to hash
+  // keys (see Options::data_block_hash_index).  The default returns
+  // "key" itself.
+  virtual Slice PointKey(const Slice& key) const;
 };
 
 // Return a builtin comparator that uses lexicographic byte-wise
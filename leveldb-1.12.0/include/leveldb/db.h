@@ -7,8 +7,11 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string>
+#include <vector>
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/pinnable_slice.h"
 
 namespace leveldb
 {
@@ -20,6 +23,7 @@ static const int kMinorVersion = 12;
 struct Options;
 struct ReadOptions;
 struct WriteOptions;
+struct IngestOptions;
 class WriteBatch;
 
 // Abstract handle to particular state of a DB.
@@ -31,6 +35,36 @@ class Snapshot
 		virtual ~Snapshot();
 };
 
+// A column family is a keyspace of a DB with its own Options (comparator,
+// compression, filter policy, write buffer, ...) and its own tables, that
+// shares the log of the DB: a WriteBatch spanning several families is
+// applied atomically.  Handles are owned by the DB, and stay valid until
+// the family is dropped or the DB is deleted.  Wherever a handle is
+// expected, NULL names the default column family, which is the DB itself.
+class ColumnFamilyHandle
+{
+	public:
+		virtual ~ColumnFamilyHandle();
+
+		virtual const std::string& GetName() const = 0;
+		virtual uint32_t GetID() const = 0;
+};
+
+// A column family to open along with a DB
+struct ColumnFamilyDescriptor
+{
+		std::string name;
+		Options options;
+
+		ColumnFamilyDescriptor()
+		{
+		}
+		ColumnFamilyDescriptor(const std::string& n, const Options& o) :
+			name(n), options(o)
+		{
+		}
+};
+
 // A range of keys
 struct Range
 {
@@ -63,6 +97,15 @@ class DB
 		static Status Open(const Options& options, const std::string& name,
 				DB** dbptr);
 
+		// Like Open() above, and also open the column families described by
+		// "column_families", storing their handles in *handles in the same
+		// order.  Every column family of the database must be listed.  Those
+		// that do not exist yet are created if options.create_if_missing is
+		// true.
+		static Status Open(const Options& options, const std::string& name,
+				const std::vector<ColumnFamilyDescriptor>& column_families,
+				std::vector<ColumnFamilyHandle*>* handles, DB** dbptr);
+
 		DB()
 		{
 		}
@@ -80,12 +123,43 @@ class DB
 		// Note: consider setting options.sync = true.
 		virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+		// Record "value" as a merge operand for "key".  The operand is
+		// combined with the existing value by options.merge_operator
+		// lazily, when "key" is read or compacted, so no Get is needed
+		// beforehand.  Returns a non-OK status if no merge_operator is set.
+		// Note: consider setting options.sync = true.
+		virtual Status Merge(const WriteOptions& options, const Slice& key,
+				const Slice& value);
+
+		// Remove every database entry with a key in [begin_key, end_key).
+		// The deletion is recorded as a single tombstone, so its cost does
+		// not depend on the number of keys in the range.  Does nothing if
+		// end_key <= begin_key.
+		// Note: consider setting options.sync = true.
+		virtual Status DeleteRange(const WriteOptions& options,
+				const Slice& begin_key, const Slice& end_key);
+
+		// Add the table file "fname", built with TableBuilder using the
+		// comparator (and filter policy) of this database, as if all of its
+		// entries had been written at once.  The file bypasses the log, the
+		// memtable and compactions: it is checked, given the next sequence
+		// number and placed in the deepest level that keeps the LSM order.
+		// Returns a non-OK status if the file is not a valid table of
+		// strictly increasing keys.
+		virtual Status IngestExternalFile(const IngestOptions& options,
+				const std::string& fname);
+
 		// Apply the specified updates to the database.
 		// Returns OK on success, non-OK on failure.
 		// Note: consider setting options.sync = true.
 		virtual Status
 				Write(const WriteOptions& options, WriteBatch* updates) = 0;
 
+		// Hand the log records of the writes done so far to the file
+		// system, and make them durable as a sync write would if "sync" is
+		// true.  Lets a series of non-sync writes be made durable at once.
+		virtual Status FlushWAL(bool sync);
+
 		// If the database contains an entry for "key" store the
 		// corresponding value in *value and return OK.
 		//
@@ -96,6 +170,12 @@ class DB
 		virtual Status Get(const ReadOptions& options, const Slice& key,
 				std::string* value) = 0;
 
+		// Same as above, but *value may refer to the memory holding the value
+		// inside the DB (a cached block or a memtable), which it keeps alive,
+		// rather than to a copy of it.  See leveldb/pinnable_slice.h.
+		virtual Status Get(const ReadOptions& options, const Slice& key,
+				PinnableSlice* value);
+
 		// Return a heap-allocated iterator over the contents of the database.
 		// The result of NewIterator() is initially invalid (caller must
 		// call one of the Seek methods on the iterator before using it).
@@ -114,6 +194,35 @@ class DB
 		// use "snapshot" after this call.
 		virtual void ReleaseSnapshot(const Snapshot* snapshot) = 0;
 
+		// Create the column family "name" configured by "options" and store a
+		// handle to it in *handle.  Returns a non-OK status if a family of
+		// that name already exists.
+		virtual Status CreateColumnFamily(const Options& options,
+				const std::string& name, ColumnFamilyHandle** handle);
+
+		// Remove the column family and all of its data, and delete its
+		// handle.  The default column family cannot be dropped.
+		virtual Status DropColumnFamily(ColumnFamilyHandle* column_family);
+
+		// Column family versions of the methods of the same names.
+		virtual Status Put(const WriteOptions& options,
+				ColumnFamilyHandle* column_family, const Slice& key,
+				const Slice& value);
+		virtual Status Delete(const WriteOptions& options,
+				ColumnFamilyHandle* column_family, const Slice& key);
+		virtual Status Get(const ReadOptions& options,
+				ColumnFamilyHandle* column_family, const Slice& key,
+				std::string* value);
+		virtual Status Get(const ReadOptions& options,
+				ColumnFamilyHandle* column_family, const Slice& key,
+				PinnableSlice* value);
+		virtual Iterator* NewIterator(const ReadOptions& options,
+				ColumnFamilyHandle* column_family);
+		virtual bool GetProperty(ColumnFamilyHandle* column_family,
+				const Slice& property, std::string* value);
+		virtual void CompactRange(ColumnFamilyHandle* column_family,
+				const Slice* begin, const Slice* end);
+
 		// DB implementations can export properties about their state
 		// via this method.  If "property" is a valid property understood by this
 		// DB implementation, fills "*value" with its current value and returns
@@ -128,6 +237,8 @@ class DB
 		//     about the internal operation of the DB.
 		//  "leveldb.sstables" - returns a multi-line string that describes all
 		//     of the sstables that make up the db contents.
+		//  "leveldb.statistics" - returns Options::statistics->ToString(), if
+		//     the DB has a Statistics object.
 		virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
 		// For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -73,6 +73,16 @@ class Env
 		virtual Status NewWritableFile(const std::string& fname,
 				WritableFile** result) = 0;
 
+		// Rename the file "old_fname" to "fname" and open it for writing
+		// from its beginning, keeping its contents and the disk space it
+		// already uses: overwriting them needs no block allocation and no
+		// metadata update.  Used to recycle log files.
+		//
+		// The default implementation renames the file and then calls
+		// NewWritableFile(), which truncates it.
+		virtual Status ReuseWritableFile(const std::string& fname,
+				const std::string& old_fname, WritableFile** result);
+
 		// Returns true iff the named file exists.
 		virtual bool FileExists(const std::string& fname) = 0;
 
@@ -145,6 +155,13 @@ class Env
 		// useful for computing deltas of time.
 		virtual uint64_t NowMicros() = 0;
 
+		// Like NowMicros(), in nano-seconds.  The default implementation
+		// is only as precise as NowMicros().
+		virtual uint64_t NowNanos()
+		{
+			return NowMicros() * 1000;
+		}
+
 		// Sleep/delay the thread for the perscribed number of micro-seconds.
 		virtual void SleepForMicroseconds(int micros) = 0;
 
@@ -234,6 +251,22 @@ class WritableFile
 		virtual Status Flush() = 0;
 		virtual Status Sync() = 0;
 
+		// Start writing back the appended data in [offset, offset+nbytes)
+		// without waiting for it, so that a later Sync() has less to do.
+		// The default implementation does nothing.
+		virtual Status RangeSync(uint64_t offset, uint64_t nbytes)
+		{
+			return Status::OK();
+		}
+
+		// Whether Sync() may run while another thread appends to the file,
+		// in which case it syncs at least the data appended before the
+		// call.  The default implementation returns false.
+		virtual bool IsSyncThreadSafe() const
+		{
+			return false;
+		}
+
 	private:
 		// No copying allowed
 		WritableFile(const WritableFile&);
@@ -319,6 +352,11 @@ class EnvWrapper: public Env
 		{
 			return target_->NewWritableFile(f, r);
 		}
+		Status ReuseWritableFile(const std::string& f, const std::string& o,
+				WritableFile** r)
+		{
+			return target_->ReuseWritableFile(f, o, r);
+		}
 		bool FileExists(const std::string& f)
 		{
 			return target_->FileExists(f);
@@ -375,6 +413,10 @@ class EnvWrapper: public Env
 		{
 			return target_->NowMicros();
 		}
+		uint64_t NowNanos()
+		{
+			return target_->NowNanos();
+		}
 		void SleepForMicroseconds(int micros)
 		{
 			target_->SleepForMicroseconds(micros);
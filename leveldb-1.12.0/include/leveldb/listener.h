@@ -0,0 +1,103 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// An EventListener is told about the background work of the DBs it is
+// registered with through Options::listeners: memtable flushes,
+// compactions, and changes of the write stall condition.
+//
+// Callbacks run on the thread doing the work, without any lock of the DB
+// held, so they may call back into the DB.  They should return quickly
+// since the work (or the write that stalled) waits for them.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_LISTENER_H_
+#define STORAGE_LEVELDB_INCLUDE_LISTENER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "leveldb/status.h"
+
+namespace leveldb
+{
+
+class DB;
+
+struct FlushJobInfo
+{
+		std::string db_name;
+		uint64_t file_number; // The level-0 (or deeper) table written
+		int level;
+		uint64_t file_size; // Including any blob file written along
+		uint64_t micros;
+};
+
+enum CompactionReason
+{
+	kLevelSize, // A level holds too many bytes (or level-0 files)
+	kSeekCompaction, // A file took too many seeks
+	kManualCompaction, // CompactRange()
+	kDeletionCompaction, // A table holds too many deletion markers
+	kIntraL0Compaction // Level-0 files merged into one level-0 file
+};
+
+struct CompactionJobInfo
+{
+		std::string db_name;
+		CompactionReason reason;
+		int level; // Inputs are from "level" and "level+1"
+		int output_level; // "level+1", or 0 for kIntraL0Compaction
+		bool trivial_move; // The single input is moved down, not rewritten
+		std::vector<uint64_t> input_files;
+		std::vector<uint64_t> output_files;
+
+		// The remaining fields are set for completed compactions only
+		Status status;
+		uint64_t bytes_read;
+		uint64_t bytes_written;
+		uint64_t micros;
+};
+
+enum WriteStallCondition
+{
+	kStallNormal,
+	kStallDelayed, // Each write is delayed by 1ms
+	kStallStopped // Writes wait for a flush or compaction
+};
+
+enum WriteStallCause
+{
+	kStallCauseNone,
+	kStallCauseMemtableLimit, // The previous memtable is still being flushed
+	kStallCauseL0FileCountLimit
+};
+
+struct WriteStallInfo
+{
+		std::string db_name;
+		WriteStallCondition condition;
+		WriteStallCondition prev_condition;
+		WriteStallCause cause;
+};
+
+class EventListener
+{
+	public:
+		virtual ~EventListener();
+
+		// A memtable was written to a table and installed
+		virtual void OnFlushCompleted(DB* db, const FlushJobInfo& info);
+
+		// A compaction was picked; its output files are not known yet
+		virtual void OnCompactionBegin(DB* db, const CompactionJobInfo& info);
+
+		// The compaction succeeded or failed (see info.status)
+		virtual void OnCompactionCompleted(DB* db, const CompactionJobInfo& info);
+
+		// Writes to the DB became delayed, stopped or normal again
+		virtual void OnStallConditionsChanged(DB* db, const WriteStallInfo& info);
+};
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_LISTENER_H_
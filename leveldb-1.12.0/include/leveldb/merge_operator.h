@@ -0,0 +1,48 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a custom MergeOperator object to
+// support read-modify-write updates (counters, appends, set unions, ...)
+// without a Get() followed by a Put().  DB::Merge() only records an
+// operand; the operator combines the operands with the existing value
+// lazily, when the key is read or when a compaction rewrites it.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+#define STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+
+#include <string>
+
+namespace leveldb
+{
+
+class Slice;
+
+// 合并操作
+class MergeOperator
+{
+	public:
+		virtual ~MergeOperator();
+
+		// Return the name of this operator.  Used only for logging.
+		virtual const char* Name() const = 0;
+
+		// Combine the operands recorded for "key" with the value they apply to
+		// and store the result in *new_value.
+		//
+		// existing_value is NULL if the key had no value (it never existed or
+		// was deleted) before the first operand.  operands[0,n-1] are ordered
+		// from oldest to newest, and n >= 1.
+		//
+		// Return false if the operands cannot be applied; the read (or the
+		// compaction) that needed the value then fails with a corruption error.
+		//
+		// The operator may be invoked concurrently from multiple threads and
+		// must be thread-safe.
+		virtual bool Merge(const Slice& key, const Slice* existing_value,
+				const Slice* operands, int n, std::string* new_value) const = 0;
+};
+
+}
+
+#endif  // STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
@@ -6,16 +6,24 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <stddef.h>
+#include <stdint.h>
+#include <vector>
 
 namespace leveldb
 {
 
 class Cache;
+class CompactionFilter;
 class Comparator;
 class Env;
+class EventListener;
 class FilterPolicy;
 class Logger;
+class MergeOperator;
+class Slice;
 class Snapshot;
+class Statistics;
+class WriteBufferManager;
 
 // DB contents are stored in a set of blocks, each of which holds a
 // sequence of key,value pairs.  Each block may be compressed before
@@ -29,6 +37,16 @@ enum CompressionType
 	kSnappyCompression = 0x1
 };
 
+// Each block is stored with a checksum of its contents.  The following
+// enum describes which function computes it.
+enum ChecksumType
+{
+	// NOTE: do not change the values of existing entries, as these are
+	// part of the persistent format on disk.
+	kCRC32c = 0x0,
+	kxxHash64 = 0x1
+};
+
 // Options to control the behavior of a database (passed to DB::Open)
 struct Options
 {
@@ -70,6 +88,17 @@ struct Options
 		// Default: NULL
 		Logger* info_log;
 
+		// If non-NULL, counters and latency histograms of the DB are
+		// collected there (see leveldb/statistics.h).  It must outlive the
+		// DB.
+		// Default: NULL
+		Statistics* statistics;
+
+		// Told about the flushes, compactions and write stalls of the DB
+		// (see leveldb/listener.h).  They must outlive the DB.
+		// Default: empty
+		std::vector<EventListener*> listeners;
+
 		// -------------------
 		// Parameters that affect performance
 
@@ -85,13 +114,71 @@ struct Options
 		// Default: 4MB
 		size_t write_buffer_size; //当memtable或sstable大小达到该值时，保存
 
+		// If non-NULL, bounds the memory of the memtables of all the DBs
+		// sharing it (see leveldb/write_buffer_manager.h).  It must outlive
+		// them.
+		//
+		// Default: NULL
+		WriteBufferManager* write_buffer_manager;
+
+		// Number of obsolete write-ahead log files kept to be reused for
+		// new logs instead of being deleted.  Writing over a file that
+		// already has its blocks saves allocating them, and the metadata
+		// update each sync would otherwise write.  The records of a reused
+		// log carry its number so that recovery can tell them from the
+		// older log they overwrite; logs written this way cannot be read
+		// by releases that do not know about recycling.
+		//
+		// Default: 0
+		size_t recycle_log_file_num;
+
+		// If non-zero, the writeback of the write-ahead log and of the
+		// tables being written is started in the background every time
+		// this many bytes have been appended to them (sync_file_range() on
+		// Linux).  The dirty data then never piles up, so neither a sync
+		// nor the kernel's own writeback has to write megabytes at once.
+		//
+		// Default: 0
+		uint64_t bytes_per_sync;
+
+		// If true, writes with WriteOptions::sync do not sync the log
+		// themselves: a dedicated thread syncs it once for all the writes
+		// logged since its previous sync, while the next writes go on
+		// appending to it, and each sync write returns once the log is
+		// synced past its own record.  A sync write may then be seen by
+		// readers before it returns.  Ignored if the log files of the Env
+		// cannot be synced while being written (see
+		// WritableFile::IsSyncThreadSafe).
+		//
+		// Default: false
+		bool background_wal_sync;
+
+		// If true, DB::Open does not write the last memtable recovered from
+		// the logs to a table before returning: the background compaction
+		// does, while the DB serves requests, and the logs it came from are
+		// kept until then.  Only a memtable that starts with a log is left
+		// this way, which is the usual case.
+		//
+		// Default: false
+		bool avoid_flush_during_recovery;
+
 		// Number of open files that can be used by the DB.  You may need to
 		// increase this if your database has a large working set (budget
 		// one open file per 2MB of working set).
 		//
+		// If -1, files are never closed to make room: every live table is
+		// opened by DB::Open (see max_file_opening_threads) and stays open,
+		// so no read pays for opening one.
+		//
 		// Default: 1000
 		int max_open_files;
 
+		// Number of threads DB::Open uses to open the tables when
+		// max_open_files is -1.
+		//
+		// Default: 16
+		int max_file_opening_threads;
+
 		// Control over blocks (user data is stored in a set of blocks, and
 		// a block is the unit of reading from disk).
 
@@ -100,6 +187,14 @@ struct Options
 		// Default: NULL
 		Cache* block_cache;
 
+		// If non-NULL, use the specified cache for rows: the entries of a
+		// user key found in a table file are kept under (file, user key), so
+		// that repeated Gets of a hot key do not have to search the blocks
+		// of the table again.  Unlike block_cache, leveldb does not create
+		// one when this is NULL.
+		// Default: NULL
+		Cache* row_cache;
+
 		// Approximate size of user data packed per block.  Note that the
 		// block size specified here corresponds to uncompressed data.  The
 		// actual size of the unit read from disk may be smaller if
@@ -115,6 +210,19 @@ struct Options
 		// Default: 16
 		int block_restart_interval; //当key达到这么多时，就开始新的重启点。
 
+		// If true, every data block gets a small hash table from its keys to
+		// the restart points they follow, so that seeking to a key present
+		// in the block skips the binary search over its restart points.  It
+		// costs about 1.3 bytes per key.  Blocks with more than 254 restart
+		// points are left without one.  Tables built with it stay readable
+		// by versions of leveldb that do not know about it.
+		//
+		// REQUIRES: the comparator only considers keys with equal bytes
+		// (in the part returned by Comparator::PointKey) equal.
+		//
+		// Default: false
+		bool data_block_hash_index;
+
 		// Compress blocks using the specified compression algorithm.  This
 		// parameter can be changed dynamically.
 		//
@@ -131,6 +239,14 @@ struct Options
 		// efficiently detect that and will switch to uncompressed mode.
 		CompressionType compression; //压缩
 
+		// Checksum stored with every block of the tables written from now
+		// on.  Tables record the type per block, so it may be changed on an
+		// existing DB, but a table using kxxHash64 cannot be read by a
+		// version of leveldb that does not know it.
+		//
+		// Default: kCRC32c
+		ChecksumType checksum;
+
 		// If non-NULL, use the specified filter policy to reduce disk reads.
 		// Many applications will benefit from passing the result of
 		// NewBloomFilterPolicy() here.
@@ -138,6 +254,47 @@ struct Options
 		// Default: NULL
 		const FilterPolicy* filter_policy;
 
+		// If non-NULL, every live key/value pair rewritten by a compaction is
+		// passed through this filter, which may drop the entry or change its
+		// value.  See leveldb/compaction_filter.h.
+		//
+		// Default: NULL
+		const CompactionFilter* compaction_filter;
+
+		// If non-NULL, DB::Merge() may be used to record operands that this
+		// operator folds into the existing value of a key.  The same operator
+		// must be supplied every time a DB containing merge operands is opened.
+		// See leveldb/merge_operator.h.
+		//
+		// Default: NULL
+		const MergeOperator* merge_operator;
+
+		// Values of at least this many bytes are written to separate blob
+		// files when the memtable is flushed, and the tables only hold a
+		// reference to them, so that compactions do not copy the values
+		// from level to level.  Reads resolve the references transparently.
+		// Zero keeps all values in the tables.
+		//
+		// Default: 0
+		size_t min_blob_size;
+
+		// Values overwritten or deleted by a compaction leave garbage in the
+		// blob files they were in.  Once a blob file's share of garbage
+		// reaches this ratio, compactions copy its remaining values to a new
+		// blob file; it is removed when no value of it is referenced.
+		//
+		// Default: 0.5
+		double blob_gc_ratio;
+
+		// A table whose deletion markers make up at least this share of its
+		// entries is compacted into the next level, even if no level is too
+		// large, so that iterators stop walking over the markers once their
+		// keys are gone from the levels below.  Suited to workloads that
+		// delete keys in order, as a queue does.  Zero disables it.
+		//
+		// Default: 0
+		double deletion_compaction_ratio;
+
 		// Create an Options object with default values for all fields.
 		Options();
 };
@@ -162,8 +319,23 @@ struct ReadOptions
 		// Default: NULL
 		const Snapshot* snapshot;
 
+		// If non-NULL, an iterator yields no key before *iterate_lower_bound
+		// (inclusive) or at or after *iterate_upper_bound (exclusive): its
+		// seeks are clamped to the bounds and it becomes invalid on reaching
+		// one, without scanning on for the next key.  Table files and blocks
+		// entirely outside the bounds are not read.  The bounds are copied
+		// when the iterator is created.
+		//
+		// For a DB iterator the bounds are user keys.  A Table iterator
+		// compares them with the keys of the table, and uses them only to
+		// avoid reading blocks: it may still yield keys outside them.
+		// Default: NULL
+		const Slice* iterate_lower_bound;
+		const Slice* iterate_upper_bound;
+
 		ReadOptions() :
-			verify_checksums(false), fill_cache(true), snapshot(NULL)
+			verify_checksums(false), fill_cache(true), snapshot(NULL),
+					iterate_lower_bound(NULL), iterate_upper_bound(NULL)
 		{
 		}
 };
@@ -195,6 +367,23 @@ struct WriteOptions
 		}
 };
 
+// Options that control DB::IngestExternalFile
+struct IngestOptions
+{
+		// If true, the file is renamed into the database instead of being
+		// copied, which saves rewriting it.  It falls back to copying when
+		// the rename fails (e.g. across file systems).  The file is moved
+		// back if it is rejected.
+		//
+		// Default: false
+		bool move_file;
+
+		IngestOptions() :
+			move_file(false)
+		{
+		}
+};
+
 } // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
@@ -0,0 +1,87 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PerfContext counts and times the stages of the operations made by one
+// thread (memtable lookups, table opens, block reads, filter checks, ...),
+// and an IOStatsContext the file I/O they did, so that a slow operation can
+// be broken down.  Both are thread-local: reset them, run the operation,
+// and read them from the same thread.
+//
+// Nothing is collected unless the perf level of the thread says so:
+//
+//      leveldb::SetPerfLevel(leveldb::kEnableTime);
+//      leveldb::GetPerfContext()->Reset();
+//      leveldb::GetIOStatsContext()->Reset();
+//      db->Get(leveldb::ReadOptions(), key, &value);
+//      ... GetPerfContext()->ToString(), GetIOStatsContext()->ToString() ...
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PERF_CONTEXT_H_
+#define STORAGE_LEVELDB_INCLUDE_PERF_CONTEXT_H_
+
+#include <stdint.h>
+#include <string>
+
+namespace leveldb
+{
+
+enum PerfLevel
+{
+	kDisable = 0, // Collect nothing
+	kEnableCount = 1, // Collect the counts only
+	kEnableTime = 2 // Collect the counts and the times as well
+};
+
+// Set and get the perf level of the calling thread.  The default is
+// kDisable.
+extern void SetPerfLevel(PerfLevel level);
+extern PerfLevel GetPerfLevel();
+
+// Times are in nanoseconds
+struct PerfContext
+{
+		void Reset(); // Set all the fields to zero
+
+		// "name = value" for every field
+		std::string ToString() const;
+
+		uint64_t db_mutex_lock_nanos; // Waiting for the DB mutex
+		uint64_t get_from_memtable_count; // Memtables looked up by Get
+		uint64_t get_from_memtable_time;
+		uint64_t get_from_output_files_time; // Tables looked up by Get
+		uint64_t find_table_nanos; // Opening tables missing from TableCache
+		uint64_t block_cache_hit_count;
+		uint64_t block_cache_miss_count;
+		uint64_t block_read_count; // Blocks read from the files
+		uint64_t block_read_byte;
+		uint64_t block_read_time;
+		uint64_t bloom_sst_hit_count; // Table filter checks that passed
+		uint64_t bloom_sst_miss_count; // ... that saved a block read
+		uint64_t internal_key_skipped_count; // Hidden entries DBIter skipped
+		uint64_t internal_delete_skipped_count; // ... deletions among them
+		uint64_t write_wal_time; // Writing the log, including syncs
+		uint64_t write_memtable_time; // Inserting a batch into the memtable
+};
+
+struct IOStatsContext
+{
+		void Reset(); // Set all the fields to zero
+
+		// "name = value" for every field
+		std::string ToString() const;
+
+		uint64_t bytes_read;
+		uint64_t bytes_written;
+		uint64_t read_nanos;
+		uint64_t write_nanos;
+		uint64_t fsync_nanos;
+		uint64_t open_nanos; // Opening files
+};
+
+// The contexts of the calling thread
+extern PerfContext* GetPerfContext();
+extern IOStatsContext* GetIOStatsContext();
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PERF_CONTEXT_H_
@@ -0,0 +1,115 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PinnableSlice is a Slice that may refer to memory of the DB, such as a
+// block held in the block cache or a memtable, which it keeps alive
+// ("pinned") until it is reset or destroyed, so that DB::Get does not have
+// to copy the value.  Values that have to be computed are stored in a
+// buffer of the PinnableSlice instead.
+//
+// A PinnableSlice holding pinned memory must be reset or destroyed before
+// the DB it came from is deleted.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
+#define STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
+
+#include <string>
+#include "leveldb/slice.h"
+
+namespace leveldb
+{
+
+class PinnableSlice: public Slice
+{
+	public:
+		typedef void (*CleanupFunction)(void* arg1, void* arg2);
+
+		PinnableSlice() :
+			buf_(&self_space_), function_(NULL), arg1_(NULL), arg2_(NULL)
+		{
+		}
+
+		// Values that are not pinned are stored in *buf, which must outlive
+		// the PinnableSlice.
+		explicit PinnableSlice(std::string* buf) :
+			buf_(buf), function_(NULL), arg1_(NULL), arg2_(NULL)
+		{
+		}
+
+		~PinnableSlice()
+		{
+			Reset();
+		}
+
+		// Refer to "s", which stays valid until (*function)(arg1, arg2) is
+		// called when the PinnableSlice is reset or destroyed.
+		void PinSlice(const Slice& s, CleanupFunction function, void* arg1,
+				void* arg2)
+		{
+			Reset();
+			Slice::operator=(s);
+			function_ = function;
+			arg1_ = arg1;
+			arg2_ = arg2;
+		}
+
+		// Refer to a copy of "s"
+		void PinSelf(const Slice& s)
+		{
+			Reset();
+			buf_->assign(s.data(), s.size());
+			Slice::operator=(*buf_);
+		}
+
+		// Refer to the contents of GetSelf(), which the caller has just
+		// filled in.
+		void PinSelf()
+		{
+			Release();
+			Slice::operator=(*buf_);
+		}
+
+		// The buffer holding values that are not pinned
+		std::string* GetSelf()
+		{
+			return buf_;
+		}
+
+		// Does it refer to memory of the DB rather than to its buffer?
+		bool IsPinned() const
+		{
+			return function_ != NULL;
+		}
+
+		// Release any pinned memory and become empty
+		void Reset()
+		{
+			Release();
+			clear();
+		}
+
+	private:
+		std::string self_space_;
+		std::string* buf_;
+		CleanupFunction function_;
+		void* arg1_;
+		void* arg2_;
+
+		void Release()
+		{
+			if ( function_ != NULL )
+			{
+				(*function_)(arg1_, arg2_);
+				function_ = NULL;
+			}
+		}
+
+		// No copying allowed
+		PinnableSlice(const PinnableSlice&);
+		void operator=(const PinnableSlice&);
+};
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PINNABLE_SLICE_H_
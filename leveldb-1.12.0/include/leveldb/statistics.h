@@ -0,0 +1,86 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Statistics object collects counters ("tickers") and latency
+// histograms for the DBs that share it through Options::statistics.  It
+// may be read at any time while they run, e.g. through the
+// "leveldb.statistics" property:
+//
+//      options.statistics = leveldb::NewStatistics();
+//      ... open and use the DB ...
+//      fprintf(stderr, "%s", options.statistics->ToString().c_str());
+
+#ifndef STORAGE_LEVELDB_INCLUDE_STATISTICS_H_
+#define STORAGE_LEVELDB_INCLUDE_STATISTICS_H_
+
+#include <stdint.h>
+#include <string>
+
+namespace leveldb
+{
+
+enum Ticker
+{
+	kBlockCacheHit = 0,
+	kBlockCacheMiss,
+	kBloomFilterUseful, // Table lookups a filter saved
+	kBytesWritten, // Size of the batches written
+	kBytesRead, // Size of the values returned by Get
+	kKeysWritten,
+	kKeysRead, // Successful Gets
+	kWALFileSynced,
+	kWALFileBytes,
+	kStallMicros, // Writes delayed or stopped for compactions
+	kFlushWriteBytes, // Memtables written to level-0
+	kCompactReadBytes,
+	kCompactWriteBytes,
+	kSecondaryCacheHit, // Block cache misses found in its secondary tier
+	kSecondaryCacheMiss,
+	kNumTickers
+};
+
+enum HistogramType
+{
+	kDBGet = 0,
+	kDBWrite,
+	kDBSeek,
+	kCompactionTime,
+	kWALFileSyncMicros,
+	kNumHistograms
+};
+
+// Names used by ToString(), e.g. "leveldb.block.cache.hit"
+extern const char* TickerName(Ticker ticker);
+extern const char* HistogramName(HistogramType type);
+
+class Statistics
+{
+	public:
+		virtual ~Statistics();
+
+		// Add "count" to the ticker
+		virtual void RecordTick(Ticker ticker, uint64_t count) = 0;
+		virtual uint64_t GetTickerCount(Ticker ticker) const = 0;
+
+		// Add a sample, in micro-seconds, to the histogram
+		virtual void MeasureTime(HistogramType type, uint64_t micros) = 0;
+
+		// Return the buckets and percentiles of the histogram
+		virtual std::string GetHistogramString(HistogramType type) const = 0;
+
+		// Zero the tickers and empty the histograms
+		virtual void Reset() = 0;
+
+		// Return one line per ticker and one per histogram (count and
+		// percentiles)
+		virtual std::string ToString() const = 0;
+};
+
+// Create a thread-safe Statistics object.  The caller deletes it after
+// the DBs using it.
+extern Statistics* NewStatistics();
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_STATISTICS_H_
@@ -51,6 +51,11 @@ class Table
 		// call one of the Seek methods on the iterator before using it).
 		Iterator* NewIterator(const ReadOptions&) const;
 
+		// Returns a new iterator over the range deletion entries of the
+		// table (see TableBuilder::AddRangeDeletion).  The iterator is empty
+		// if the table has none.
+		Iterator* NewRangeDelIterator() const;
+
 		// Given a key, return an approximate byte offset in the file where
 		// the data for that key begins (or would begin if the key were
 		// present in the file).  The returned value is in terms of file
@@ -72,14 +77,20 @@ class Table
 		// Calls (*handle_result)(arg, ...) with the entry found after a call
 		// to Seek(key).  May not make such a call if filter policy says
 		// that key is not present.
+		//
+		// If "block" is non-NULL and such a call is made, *block is set to
+		// the iterator over the block holding the entry, and the slices
+		// passed to handle_result stay valid until the caller deletes it.
+		// Otherwise *block is set to NULL.
 		friend class TableCache;
 		Status
 				InternalGet(const ReadOptions&, const Slice& key, void* arg,
 						void(*handle_result)(void* arg, const Slice& k,
-								const Slice& v));
+								const Slice& v), Iterator** block = NULL);
 
 		void ReadMeta(const Footer& footer);
 		void ReadFilter(const Slice& filter_handle_value);
+		void ReadRangeDel(const Slice& range_del_handle_value);
 
 		// No copying allowed
 		Table(const Table&);
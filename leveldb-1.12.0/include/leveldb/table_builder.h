@@ -49,6 +49,13 @@ class TableBuilder
 		// REQUIRES: Finish(), Abandon() have not been called
 		void Add(const Slice& key, const Slice& value);
 
+		// Add a range deletion entry.  Range deletions are kept in a meta
+		// block of their own rather than among the data blocks, and are not
+		// counted by NumEntries().
+		// REQUIRES: key is after any previously added range deletion key.
+		// REQUIRES: Finish(), Abandon() have not been called
+		void AddRangeDeletion(const Slice& key, const Slice& value);
+
 		// Advanced operation: flush any buffered key/value pairs to file.
 		// Can be used to ensure that two adjacent entries never live in
 		// the same data block.  Most clients should not need to use this method.
@@ -73,6 +80,9 @@ class TableBuilder
 		// Number of calls to Add() so far.
 		uint64_t NumEntries() const;
 
+		// Number of calls to AddRangeDeletion() so far.
+		uint64_t NumRangeDeletions() const;
+
 		// Size of the file generated so far.  If invoked after a successful
 		// Finish() call, returns the size of the final generated file.
 		uint64_t FileSize() const;
@@ -21,12 +21,14 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_H_
 #define STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_H_
 
+#include <stdint.h>
 #include <string>
 #include "leveldb/status.h"
 
 namespace leveldb
 {
 
+class ColumnFamilyHandle;
 class Slice;
 
 // 批处理 写
@@ -45,6 +47,26 @@ class WriteBatch
 		// 加入 k.
 		void Delete(const Slice& key);
 
+		// Record "value" as a merge operand for "key".  The DB's
+		// Options::merge_operator combines it with the existing value.
+		void Merge(const Slice& key, const Slice& value);
+
+		// Erase every mapping whose key is in [begin_key, end_key), using a
+		// single range tombstone instead of one deletion per key.
+		void DeleteRange(const Slice& begin_key, const Slice& end_key);
+
+		// Like the above, for the column family "column_family" of the DB
+		// the batch is written to.  A NULL column_family names the default
+		// family.  A batch may span any number of families of one DB and is
+		// still applied atomically.
+		void Put(ColumnFamilyHandle* column_family, const Slice& key,
+				const Slice& value);
+		void Delete(ColumnFamilyHandle* column_family, const Slice& key);
+		void Merge(ColumnFamilyHandle* column_family, const Slice& key,
+				const Slice& value);
+		void DeleteRange(ColumnFamilyHandle* column_family,
+				const Slice& begin_key, const Slice& end_key);
+
 		// Clear all updates buffered in this batch.
 		void Clear();
 
@@ -55,6 +77,15 @@ class WriteBatch
 				virtual ~Handler();
 				virtual void Put(const Slice& key, const Slice& value) = 0;
 				virtual void Delete(const Slice& key) = 0;
+				// The default implementation ignores merge operands.
+				virtual void Merge(const Slice& key, const Slice& value);
+				// The default implementation ignores range deletions.
+				virtual void DeleteRange(const Slice& begin_key,
+						const Slice& end_key);
+				// The updates that follow belong to the column family with
+				// the given id (0 for the default family) until the next
+				// call.  The default implementation ignores it.
+				virtual void SetColumnFamily(uint32_t column_family_id);
 		};
 		// 使用该 iterator，利用 @handler提供的接口来处理所有的key。
 		Status Iterate(Handler* handler) const;
@@ -0,0 +1,64 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A WriteBufferManager bounds the memory taken by the memtables of all the
+// DBs and column families that share it through Options.  Each DB still
+// switches memtables at its own write_buffer_size; in addition, once the
+// memtables together reach the budget of the manager, the next write to a
+// DB flushes the largest memtable of that DB.
+//
+// The memory may also be charged against a block cache, so that a single
+// budget covers both the cached blocks and the memtables.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
+#define STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
+
+#include <stddef.h>
+
+namespace leveldb
+{
+
+class Cache;
+
+class WriteBufferManager
+{
+	public:
+		// Allow "buffer_size" bytes of memtables.  If "cache" is non-NULL,
+		// memtable memory is also charged against it, and it must outlive
+		// the manager.
+		explicit WriteBufferManager(size_t buffer_size, Cache* cache = NULL);
+
+		// REQUIRES: no memtable uses this manager any more
+		~WriteBufferManager();
+
+		size_t buffer_size() const
+		{
+			return buffer_size_;
+		}
+
+		// Bytes taken by the memtables using this manager
+		size_t memory_usage() const;
+
+		// Have the memtables reached the budget?
+		bool ShouldFlush() const;
+
+		// Account for memtable memory being allocated or released.  Called
+		// by the memtables themselves.
+		void ReserveMem(size_t bytes);
+		void FreeMem(size_t bytes);
+
+	private:
+		struct Rep;
+
+		const size_t buffer_size_;
+		Rep* rep_;
+
+		// No copying allowed
+		WriteBufferManager(const WriteBufferManager&);
+		void operator=(const WriteBufferManager&);
+};
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
@@ -74,6 +74,14 @@ typedef intptr_t OnceType;
 #define LEVELDB_ONCE_INIT 0
 extern void InitOnce(port::OnceType*, void(*initializer)());
 
+// Storage class specifier of thread-local variables, which must be of
+// POD types:
+//      static LEVELDB_THREAD_LOCAL int counter;
+#define LEVELDB_THREAD_LOCAL __thread
+
+// Atomically add "delta" to *ptr and return the new value
+extern uint64_t AtomicAdd(volatile uint64_t* ptr, uint64_t delta);
+
 // A type that holds a pointer that can be read or written atomically
 // (i.e., without word-tearing.)
 class AtomicPointer
@@ -122,6 +122,13 @@ typedef pthread_once_t OnceType;
 #define LEVELDB_ONCE_INIT PTHREAD_ONCE_INIT
 extern void InitOnce(OnceType* once, void(*initializer)());
 
+#define LEVELDB_THREAD_LOCAL __thread
+
+inline uint64_t AtomicAdd(volatile uint64_t* ptr, uint64_t delta)
+{
+	return __sync_add_and_fetch(ptr, delta);
+}
+
 inline bool Snappy_Compress(const char* input, size_t length,
 		::std::string* output)
 {
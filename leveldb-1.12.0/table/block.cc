@@ -24,9 +24,9 @@ inline uint32_t Block::NumRestarts() const
 	return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
 }
 
-Block::Block(const BlockContents& contents) :
+Block::Block(const BlockContents& contents, bool hash_index) :
 	data_(contents.data.data()), size_(contents.data.size()), owned_(
-			contents.heap_allocated)
+			contents.heap_allocated), num_buckets_(0)
 {
 	if ( size_ < sizeof(uint32_t) )
 	{
@@ -45,6 +45,15 @@ Block::Block(const BlockContents& contents) :
 		{
 			// 重启点的位置
 			restart_offset_ = size_ - (1 + NumRestarts()) * sizeof(uint32_t);
+			if ( hash_index && NumRestarts() > 0 )
+			{
+				// The entries start after the hash index, if any
+				const uint32_t first = DecodeFixed32(data_ + restart_offset_);
+				if ( first <= restart_offset_ )
+				{
+					num_buckets_ = first;
+				}
+			}
 		}
 	}
 }
@@ -108,6 +117,7 @@ class Block::Iter: public Iterator
 		uint32_t const restarts_; // Offset of restart array (list of fixed32)
 		// 重启点的个数
 		uint32_t const num_restarts_; // Number of uint32_t entries in restart array
+		uint32_t const num_buckets_; // Number of hash index buckets at data_
 
 		// current_ is offset in data_ of current entry.  >= restarts_ if !Valid
 		// 当前 节点在 data_中的偏移
@@ -118,6 +128,20 @@ class Block::Iter: public Iterator
 		Slice value_;
 		Status status_;
 
+		// Entries of one restart interval, decoded once by Prev() or
+		// SeekToLast() so that further Prev() calls within the interval do
+		// not have to decode it again from its restart point.
+		struct CachedEntry
+		{
+				uint32_t offset; // Of the entry in data_
+				uint32_t key_offset; // Of its key in prev_keys_
+				uint32_t key_size;
+				Slice value;
+		};
+		std::vector<CachedEntry> prev_entries_;
+		std::string prev_keys_;
+		int prev_index_; // Entry of prev_entries_ at current_, if any
+
 		inline int Compare(const Slice& a, const Slice& b) const
 		{
 			return comparator_->Compare(a, b);
@@ -156,10 +180,11 @@ class Block::Iter: public Iterator
 		// @restarts, 重启点在block中的偏移
 		// @num_restarts，重启点的个数
 		Iter(const Comparator* comparator, const char* data, uint32_t restarts,
-				uint32_t num_restarts) :
+				uint32_t num_restarts, uint32_t num_buckets) :
 			comparator_(comparator), data_(data), restarts_(restarts),
-					num_restarts_(num_restarts), current_(restarts_),
-					restart_index_(num_restarts_)
+					num_restarts_(num_restarts), num_buckets_(num_buckets),
+					current_(restarts_),
+					restart_index_(num_restarts_), prev_index_(-1)
 		{
 			assert(num_restarts_ > 0);
 		}
@@ -193,6 +218,18 @@ class Block::Iter: public Iterator
 		{
 			assert(Valid());
 
+			if ( prev_index_ > 0 && prev_entries_[prev_index_].offset
+					== current_ )
+			{
+				// The previous entry is in the same restart interval
+				const CachedEntry& entry = prev_entries_[--prev_index_];
+				current_ = entry.offset;
+				key_.assign(prev_keys_.data() + entry.key_offset,
+						entry.key_size);
+				value_ = entry.value;
+				return;
+			}
+
 			// Scan backwards to a restart point before current_
 			const uint32_t original = current_;
 			// 首先要找到上个重启点
@@ -210,14 +247,16 @@ class Block::Iter: public Iterator
 
 			// 从上一个重启点开始，慢慢往后移动
 			SeekToRestartPoint(restart_index_);
-			do
-			{
-				// Loop until end of current entry hits the start of original entry
-			} while (ParseNextKey() && NextEntryOffset() < original);
+			DecodeIntervalUntil(original);
 		}
 
 		virtual void Seek(const Slice& target)
 		{
+			if ( num_buckets_ > 0 && HashSeek(target) )
+			{
+				return;
+			}
+
 			// Binary search in restart array to find the last restart point
 			// with a key < target
 			uint32_t left = 0;
@@ -276,13 +315,66 @@ class Block::Iter: public Iterator
 		{
 			// 找到上个重启点
 			SeekToRestartPoint(num_restarts_ - 1);
-			while (ParseNextKey() && NextEntryOffset() < restarts_)
+			DecodeIntervalUntil(restarts_);
+		}
+
+	private:
+		// Decode the entries from the restart point the iterator was just
+		// positioned at up to the last one before offset "limit", keeping
+		// them for Prev().
+		void DecodeIntervalUntil(uint32_t limit)
+		{
+			prev_entries_.clear();
+			prev_keys_.clear();
+			prev_index_ = -1;
+			while (ParseNextKey())
 			{
-				// Keep skipping
+				CachedEntry entry;
+				entry.offset = current_;
+				entry.key_offset = prev_keys_.size();
+				entry.key_size = key_.size();
+				entry.value = value_;
+				prev_entries_.push_back(entry);
+				prev_keys_.append(key_);
+				if ( NextEntryOffset() >= limit )
+				{
+					break;
+				}
+			}
+			if ( Valid() )
+			{
+				prev_index_ = prev_entries_.size() - 1;
 			}
 		}
 
-	private:
+		// Seek to "target" starting from the restart interval the hash index
+		// gives for its point key.  Returns false, leaving the iterator in
+		// an unspecified state, unless it lands on that point key.
+		bool HashSeek(const Slice& target)
+		{
+			const Slice point_key = comparator_->PointKey(target);
+			const uint8_t restart_index = static_cast<uint8_t> (data_[HashIndexHash(
+					point_key) % num_buckets_]);
+			if ( restart_index >= num_restarts_ )
+			{
+				return false; // Not in the block, or a collision
+			}
+
+			// Every key before the restart interval where the point key first
+			// appears is smaller than "target".  But a key missing from the
+			// block may share its bucket with another one, so only a result
+			// with the same point key is sure to be right.
+			SeekToRestartPoint(restart_index);
+			while (ParseNextKey())
+			{
+				if ( Compare(key_, target) >= 0 )
+				{
+					return comparator_->PointKey(key_) == point_key;
+				}
+			}
+			return !status_.ok();
+		}
+
 		void CorruptionError()
 		{
 			current_ = restarts_;
@@ -341,7 +433,8 @@ Iterator* Block::NewIterator(const Comparator* cmp)
 	}
 	else
 	{
-		return new Iter(cmp, data_, restart_offset_, num_restarts);
+		return new Iter(cmp, data_, restart_offset_, num_restarts,
+				num_buckets_);
 	}
 }
 
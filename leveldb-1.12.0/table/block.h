@@ -8,6 +8,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include "leveldb/iterator.h"
+#include "leveldb/slice.h"
 
 namespace leveldb
 {
@@ -23,8 +24,10 @@ class Comparator;
 class Block
 {
 	public:
-		// Initialize the block with the specified contents.
-		explicit Block(const BlockContents& contents);
+		// Initialize the block with the specified contents.  If "hash_index"
+		// is true, the block may start with a hash index of its keys (see
+		// Options::data_block_hash_index).
+		explicit Block(const BlockContents& contents, bool hash_index = false);
 
 		~Block();
 
@@ -32,6 +35,12 @@ class Block
 		{
 			return size_;
 		}
+
+		// The bytes the block was initialized with (empty if malformed)
+		Slice contents() const
+		{
+			return Slice(data_, size_);
+		}
 		Iterator* NewIterator(const Comparator* comparator);
 
 	private:
@@ -42,6 +51,7 @@ class Block
 		// 重启点数组在data_中的偏移
 		uint32_t restart_offset_; // Offset in data_ of restart array
 		bool owned_; // Block owns data_[]；//true，需要自己释放
+		uint32_t num_buckets_; // Size of the hash index at data_, or zero
 
 		// No copying allowed
 		Block(const Block&);
@@ -25,6 +25,11 @@
 //     restarts: uint32[num_restarts]
 //     num_restarts: uint32
 // restarts[i] contains the offset within the block of the ith restart point.
+//
+// A data block with a hash index starts with it (see table/format.h):
+//     buckets: uint8[num_buckets]
+// and restarts[0] == num_buckets.  Readers unaware of the index never
+// look before the first restart point, so they skip it.
 
 #include "table/block_builder.h"
 
@@ -32,13 +37,15 @@
 #include <assert.h>
 #include "leveldb/comparator.h"
 #include "leveldb/table_builder.h"
+#include "table/format.h"
 #include "util/coding.h"
 
 namespace leveldb
 {
 
-BlockBuilder::BlockBuilder(const Options* options) :
-	options_(options), restarts_(), counter_(0), finished_(false)
+BlockBuilder::BlockBuilder(const Options* options, bool hash_index) :
+	options_(options), restarts_(), counter_(0), finished_(false),
+			hash_index_(hash_index)
 {
 	assert(options->block_restart_interval >= 1);
 	// 第一个的key的起始位置为0.
@@ -53,18 +60,47 @@ void BlockBuilder::Reset()
 	counter_ = 0;
 	finished_ = false;
 	last_key_.clear();
+	hash_entries_.clear();
 }
 
 size_t BlockBuilder::CurrentSizeEstimate() const
 {
 	return (buffer_.size() + // Raw data buffer
 			restarts_.size() * sizeof(uint32_t) + // Restart array
-			sizeof(uint32_t)); // Restart array length
+			sizeof(uint32_t) + // Restart array length
+			static_cast<size_t> (hash_entries_.size() / kHashIndexUtilRatio)); // Hash index
 }
 
 // 将 vector<uint32_t> restart_编码后，放入到buffer_ 中
 Slice BlockBuilder::Finish()
 {
+	if ( hash_index_ && !hash_entries_.empty() && restarts_.size()
+			<= kHashIndexMaxRestarts )
+	{
+		// Put the hash index in front of the entries
+		const uint32_t num_buckets = static_cast<uint32_t> (
+				hash_entries_.size() / kHashIndexUtilRatio) + 1;
+		std::string buckets(num_buckets, static_cast<char> (kHashIndexNoEntry));
+		for (size_t i = 0; i < hash_entries_.size(); i++)
+		{
+			char* bucket = &buckets[hash_entries_[i].first % num_buckets];
+			const uint8_t b = static_cast<uint8_t> (*bucket);
+			if ( b == kHashIndexNoEntry )
+			{
+				*bucket = static_cast<char> (hash_entries_[i].second);
+			}
+			else if ( b != hash_entries_[i].second )
+			{
+				*bucket = static_cast<char> (kHashIndexCollision);
+			}
+		}
+		buffer_.insert(0, buckets);
+		for (size_t i = 0; i < restarts_.size(); i++)
+		{
+			restarts_[i] += num_buckets;
+		}
+	}
+
 	// Append restart array
 	for (size_t i = 0; i < restarts_.size(); i++)
 	{
@@ -104,6 +140,17 @@ void BlockBuilder::Add(const Slice& key, const Slice& value)
 		restarts_.push_back(buffer_.size());
 		counter_ = 0;
 	}
+	if ( hash_index_ )
+	{
+		const Slice point_key = options_->comparator->PointKey(key);
+		if ( buffer_.empty() || point_key
+				!= options_->comparator->PointKey(last_key_piece) )
+		{
+			hash_entries_.push_back(std::make_pair(HashIndexHash(point_key),
+					static_cast<uint32_t> (restarts_.size() - 1)));
+		}
+	}
+
 	// 不相同的部分
 	const size_t non_shared = key.size() - shared;
 
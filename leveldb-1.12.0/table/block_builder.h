@@ -5,6 +5,8 @@
 #ifndef STORAGE_LEVELDB_TABLE_BLOCK_BUILDER_H_
 #define STORAGE_LEVELDB_TABLE_BLOCK_BUILDER_H_
 
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <stdint.h>
@@ -26,7 +28,9 @@ struct Options;
 class BlockBuilder
 {
 	public:
-		explicit BlockBuilder(const Options* options);
+		// If "hash_index" is true, the block starts with a hash index of
+		// its keys (see Options::data_block_hash_index).
+		explicit BlockBuilder(const Options* options, bool hash_index = false);
 
 		// Reset the contents as if the BlockBuilder was just constructed.
 		void Reset();
@@ -58,6 +62,11 @@ class BlockBuilder
 		bool finished_; // Has Finish() been called?
 		std::string last_key_; //上次加入的key
 
+		const bool hash_index_;
+		// (hash of the point key, restart index) of every key whose point
+		// key differs from that of the previous key
+		std::vector<std::pair<uint32_t, uint32_t> > hash_entries_;
+
 		// No copying allowed
 		BlockBuilder(const BlockBuilder&);
 		void operator=(const BlockBuilder&);
@@ -9,6 +9,8 @@
 #include "table/block.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/hash.h"
+#include "util/perf_context_imp.h"
 
 namespace leveldb
 {
@@ -45,6 +47,10 @@ void Footer::EncodeTo(std::string* dst) const
 	metaindex_handle_.EncodeTo(dst);
 	index_handle_.EncodeTo(dst);
 	dst->resize(2 * BlockHandle::kMaxEncodedLength); // Padding，填充
+	if ( data_block_hash_index_ )
+	{
+		(*dst)[dst->size() - 1] = kDataBlockHashIndexFlag;
+	}
 	PutFixed32(dst, static_cast<uint32_t> (kTableMagicNumber & 0xffffffffu)); //低32bit.
 	PutFixed32(dst, static_cast<uint32_t> (kTableMagicNumber >> 32)); //高32bit.
 	assert(dst->size() == original_size + kEncodedLength);
@@ -72,6 +78,8 @@ Status Footer::DecodeFrom(Slice* input)
 	}
 	if ( result.ok() )
 	{
+		data_block_hash_index_ = (magic_ptr[-1] & kDataBlockHashIndexFlag) != 0;
+
 		// We skip over any leftover data (just padding for now) in "input"
 		const char* end = magic_ptr + 8;
 		*input = Slice(end, input->data() + input->size() - end);
@@ -82,16 +90,39 @@ Status Footer::DecodeFrom(Slice* input)
 // @file，指向文件的指针; @options，读取参数
 // 读的参数(block的大小和偏移)，根据 @handle来定
 // 读完后的数据，都放入 @result中。result->heap_allocated == true时，需要自己释放内存
+uint32_t BlockChecksum(ChecksumType type, const char* data, size_t n,
+		char block_type)
+{
+	if ( type == kxxHash64 )
+	{
+		// The hash is not incremental: the type byte is hashed seeded with
+		// the hash of the contents.  The trailer has room for 32 bits only.
+		const uint64_t h = XXHash64(data, n, 0);
+		return static_cast<uint32_t> (XXHash64(&block_type, 1, h));
+	}
+	uint32_t crc = crc32c::Value(data, n);
+	crc = crc32c::Extend(crc, &block_type, 1);
+	return crc32c::Mask(crc);
+}
+
+uint32_t HashIndexHash(const Slice& point_key)
+{
+	return Hash(point_key.data(), point_key.size(), 0x7a3e9c15);
+}
+
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
 		const BlockHandle& handle, BlockContents* result)
 {
 	result->data = Slice();
 	result->cachable = false;
 	result->heap_allocated = false;
+	PERF_TIMER_GUARD(block_read_time);
+	PERF_COUNTER_ADD(block_read_count, 1);
 
 	// Read the block contents as well as the type/crc footer.
 	// See table_builder.cc for the code that built this structure.
 	size_t n = static_cast<size_t> (handle.size()); // 返回block大小
+	PERF_COUNTER_ADD(block_read_byte, n + kBlockTrailerSize);
 	char* buf = new char[n + kBlockTrailerSize];
 	Slice contents;
 	// 读出来的数据，可能存在 contents 和 buf中[contents指向buf]； 也可能只存于contents中。
@@ -110,10 +141,18 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
 
 	// Check the crc of the type and the block contents
 	const char* data = contents.data(); // Pointer to where Read put the data
+	const unsigned char type = static_cast<unsigned char> (data[n]);
+	const int checksum_type = type >> kChecksumTypeShift;
+	if ( checksum_type != kCRC32c && checksum_type != kxxHash64 )
+	{
+		delete[] buf;
+		return Status::Corruption("bad block checksum type");
+	}
 	if ( options.verify_checksums )
 	{
-		const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1)); //存储的crc
-		const uint32_t actual = crc32c::Value(data, n + 1); //算出来的crc
+		const uint32_t crc = DecodeFixed32(data + n + 1); //存储的crc
+		const uint32_t actual = BlockChecksum(
+				static_cast<ChecksumType> (checksum_type), data, n, data[n]); //算出来的crc
 		if ( actual != crc )
 		{
 			delete[] buf;
@@ -122,7 +161,7 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
 		}
 	}
 
-	switch (data[n])
+	switch (type & kCompressionTypeMask)
 	{
 	case kNoCompression:
 		if ( data != buf ) // 数据只存与contents中
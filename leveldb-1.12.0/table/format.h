@@ -74,13 +74,16 @@ class BlockHandle
  * |------------------------------------|
  * |Padding(填充)                        |
  * |------------------------------------|
+ * |Flags(1byte, the last padding byte)  |
+ * |------------------------------------|
  * |Magic Number(8bytes)                |
  * |------------------------------------|
  ************************/
 class Footer
 {
 	public:
-		Footer()
+		Footer() :
+			data_block_hash_index_(false)
 		{
 		}
 
@@ -104,6 +107,18 @@ class Footer
 			index_handle_ = h;
 		}
 
+		// Whether the data blocks may start with a hash index.  Recorded in
+		// the padding, which the handles never reach since their varints
+		// take at most 9 bytes each.
+		bool data_block_hash_index() const
+		{
+			return data_block_hash_index_;
+		}
+		void set_data_block_hash_index(bool b)
+		{
+			data_block_hash_index_ = b;
+		}
+
 		void EncodeTo(std::string* dst) const;
 		Status DecodeFrom(Slice* input);
 
@@ -118,6 +133,12 @@ class Footer
 	private:
 		BlockHandle metaindex_handle_; //里面指明了 偏移 + 大小
 		BlockHandle index_handle_;
+		bool data_block_hash_index_;
+
+		enum
+		{
+			kDataBlockHashIndexFlag = 0x1
+		};
 };
 
 // kTableMagicNumber was picked by running
@@ -128,6 +149,30 @@ static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// The type byte of the trailer holds the CompressionType in its low bits
+// and the ChecksumType above them.  Tables written before checksum types
+// existed have zero there, which is kCRC32c.
+static const int kChecksumTypeShift = 4;
+static const char kCompressionTypeMask = (1 << kChecksumTypeShift) - 1;
+
+// Checksum of the block contents data[0,n-1] and the type byte that
+// follows them, which need not be stored right after them
+extern uint32_t BlockChecksum(ChecksumType type, const char* data, size_t n,
+		char block_type);
+
+// The hash index of a data block (see Options::data_block_hash_index) is
+// an array of one byte buckets in front of its first entry, so that the
+// first restart point is the number of buckets.  A bucket holds the index
+// of the restart interval where the keys hashing to it first appear, or
+// one of the markers below.
+static const uint8_t kHashIndexNoEntry = 255;
+static const uint8_t kHashIndexCollision = 254;
+static const uint32_t kHashIndexMaxRestarts = 254;
+static const double kHashIndexUtilRatio = 0.75; // Keys per bucket
+
+// Hash of "point_key", modulo the number of buckets for its bucket
+extern uint32_t HashIndexHash(const Slice& point_key);
+
 struct BlockContents
 {
 		Slice data; // Actual contents of data
@@ -14,6 +14,8 @@
 #include "table/format.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
+#include "util/perf_context_imp.h"
+#include "util/statistics_imp.h"
 
 namespace leveldb
 {
@@ -24,6 +26,7 @@ struct Table::Rep
 		{
 			delete filter;
 			delete[] filter_data;
+			delete range_del_block;
 			delete index_block;
 		}
 
@@ -33,9 +36,11 @@ struct Table::Rep
 		uint64_t cache_id;
 		FilterBlockReader* filter; //指向filter的指针
 		const char* filter_data;
+		Block* range_del_block; // NULL if the table has no range deletions
 
 		BlockHandle metaindex_handle; // Handle to metaindex_block: saved from footer
 		Block* index_block;
+		bool data_block_hash_index; // Data blocks may have a hash index
 };
 
 Status Table::Open(const Options& options, RandomAccessFile* file,
@@ -81,10 +86,12 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
 		rep->file = file;
 		rep->metaindex_handle = footer.metaindex_handle(); // 指向 meta-index
 		rep->index_block = index_block; // 指向 index-block
+		rep->data_block_hash_index = footer.data_block_hash_index();
 		rep->cache_id 	// 缓存
 				= (options.block_cache ? options.block_cache->NewId() : 0);
 		rep->filter_data = NULL;
 		rep->filter = NULL;
+		rep->range_del_block = NULL;
 		*table = new Table(rep);
 		(*table)->ReadMeta(footer);
 	}
@@ -99,13 +106,13 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
 
 void Table::ReadMeta(const Footer& footer)
 {
-	if ( rep_->options.filter_policy == NULL )
+	// An empty metaindex block holds just its restart array (one restart
+	// point plus the count), so there is nothing to read.
+	if ( footer.metaindex_handle().size() <= 2 * sizeof(uint32_t) )
 	{
 		return; // Do not need any metadata
 	}
 
-	// TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
-	// it is an empty block.
 	ReadOptions opt;
 	BlockContents contents; // meta-index-block
 	// 通过Footer的Meta-Index-handle，来读取 Meta-index-Block的内容
@@ -117,12 +124,20 @@ void Table::ReadMeta(const Footer& footer)
 	Block* meta = new Block(contents); // Meta block
 
 	Iterator* iter = meta->NewIterator(BytewiseComparator());
-	std::string key = "filter.";
-	key.append(rep_->options.filter_policy->Name());
-	iter->Seek(key);
-	if ( iter->Valid() && iter->key() == Slice(key) )
+	if ( rep_->options.filter_policy != NULL )
 	{
-		ReadFilter(iter->value());
+		std::string key = "filter.";
+		key.append(rep_->options.filter_policy->Name());
+		iter->Seek(key);
+		if ( iter->Valid() && iter->key() == Slice(key) )
+		{
+			ReadFilter(iter->value());
+		}
+	}
+	iter->Seek("rangedel");
+	if ( iter->Valid() && iter->key() == Slice("rangedel") )
+	{
+		ReadRangeDel(iter->value());
 	}
 	delete iter;
 	delete meta;
@@ -154,6 +169,25 @@ void Table::ReadFilter(const Slice& filter_handle_value)
 			block.data);
 }
 
+// Range deletions are needed by every lookup that touches the table, so
+// the block is read once here and kept for the lifetime of the table.
+void Table::ReadRangeDel(const Slice& range_del_handle_value)
+{
+	Slice v = range_del_handle_value;
+	BlockHandle handle;
+	if ( !handle.DecodeFrom(&v).ok() )
+	{
+		return;
+	}
+	ReadOptions opt;
+	opt.verify_checksums = true;
+	BlockContents contents;
+	if ( ReadBlock(rep_->file, opt, handle, &contents).ok() )
+	{
+		rep_->range_del_block = new Block(contents);
+	}
+}
+
 Table::~Table()
 {
 	delete rep_;
@@ -170,6 +204,12 @@ static void DeleteCachedBlock(const Slice& key, void* value)
 	delete block;
 }
 
+// What the secondary tier of the block cache keeps of an evicted block
+static Slice CachedBlockContents(void* value)
+{
+	return reinterpret_cast<Block*> (value)->contents();
+}
+
 static void ReleaseBlock(void* arg, void* h)
 {
 	Cache* cache = reinterpret_cast<Cache*> (arg);
@@ -205,19 +245,48 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 			cache_handle = block_cache->Lookup(key);
 			if ( cache_handle != NULL )
 			{
+				PERF_COUNTER_ADD(block_cache_hit_count, 1);
+				RecordTick(table->rep_->options.statistics, kBlockCacheHit);
 				block = reinterpret_cast<Block*> (block_cache->Value(
 						cache_handle));
 			}
 			else
 			{
-				s = ReadBlock(table->rep_->file, options, handle, &contents);
+				PERF_COUNTER_ADD(block_cache_miss_count, 1);
+				RecordTick(table->rep_->options.statistics, kBlockCacheMiss);
+				// Look in the secondary tier before the table file
+				SecondaryCache* secondary = block_cache->secondary();
+				std::string secondary_contents;
+				if ( secondary != NULL && secondary->Lookup(key,
+						&secondary_contents) )
+				{
+					RecordTick(table->rep_->options.statistics,
+							kSecondaryCacheHit);
+					char* buf = new char[secondary_contents.size()];
+					memcpy(buf, secondary_contents.data(),
+							secondary_contents.size());
+					contents.data = Slice(buf, secondary_contents.size());
+					contents.cachable = true;
+					contents.heap_allocated = true;
+				}
+				else
+				{
+					if ( secondary != NULL )
+					{
+						RecordTick(table->rep_->options.statistics,
+								kSecondaryCacheMiss);
+					}
+					s = ReadBlock(table->rep_->file, options, handle, &contents);
+				}
 				if ( s.ok() )
 				{
-					block = new Block(contents);
+					block = new Block(contents,
+							table->rep_->data_block_hash_index);
 					if ( contents.cachable && options.fill_cache )
 					{
 						cache_handle = block_cache->Insert(key, block,
-								block->size(), &DeleteCachedBlock);
+								block->size(), &DeleteCachedBlock,
+								&CachedBlockContents);
 					}
 				}
 			}
@@ -227,7 +296,7 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 			s = ReadBlock(table->rep_->file, options, handle, &contents);
 			if ( s.ok() )
 			{
-				block = new Block(contents);
+				block = new Block(contents, table->rep_->data_block_hash_index);
 			}
 		}
 	}
@@ -256,13 +325,27 @@ Iterator* Table::NewIterator(const ReadOptions& options) const
 {
 	return NewTwoLevelIterator(rep_->index_block->NewIterator(
 			rep_->options.comparator), &Table::BlockReader,
-			const_cast<Table*> (this), options);
+			const_cast<Table*> (this), options, rep_->options.comparator);
+}
+
+Iterator* Table::NewRangeDelIterator() const
+{
+	if ( rep_->range_del_block == NULL )
+	{
+		return NewEmptyIterator();
+	}
+	return rep_->range_del_block->NewIterator(rep_->options.comparator);
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k,
-		void* arg, void(*saver)(void*, const Slice&, const Slice&))
+		void* arg, void(*saver)(void*, const Slice&, const Slice&),
+		Iterator** block)
 {
 	Status s;
+	if ( block != NULL )
+	{
+		*block = NULL;
+	}
 	Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
 	iiter->Seek(k);
 	if ( iiter->Valid() )
@@ -274,9 +357,15 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
 				&& !filter->KeyMayMatch(handle.offset(), k) )
 		{
 			// Not found
+			PERF_COUNTER_ADD(bloom_sst_miss_count, 1);
+			RecordTick(rep_->options.statistics, kBloomFilterUseful);
 		}
 		else
 		{
+			if ( filter != NULL )
+			{
+				PERF_COUNTER_ADD(bloom_sst_hit_count, 1);
+			}
 			Iterator* block_iter = BlockReader(this, options, iiter->value());
 			block_iter->Seek(k);
 			if ( block_iter->Valid() )
@@ -284,7 +373,14 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
 				(*saver)(arg, block_iter->key(), block_iter->value());
 			}
 			s = block_iter->status();
-			delete block_iter;
+			if ( block != NULL && s.ok() && block_iter->Valid() )
+			{
+				*block = block_iter; // The caller keeps the block
+			}
+			else
+			{
+				delete block_iter;
+			}
 		}
 	}
 	if ( s.ok() )
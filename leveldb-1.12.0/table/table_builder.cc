@@ -24,6 +24,7 @@ struct TableBuilder::Rep
 		Options index_block_options;
 		WritableFile* file;
 		uint64_t offset;
+		uint64_t synced_offset; // Writeback started up to here
 		Status status;
 		BlockBuilder data_block;
 		BlockBuilder index_block;
@@ -31,6 +32,8 @@ struct TableBuilder::Rep
 		int64_t num_entries; //当前data block的个数，初始0
 		bool closed; // Either Finish() or Abandon() has been called.
 		FilterBlockBuilder* filter_block; //根据filter数据快速定位key是否在block中
+		BlockBuilder range_del_block; // Range deletions, written as a meta block
+		int64_t num_range_deletions;
 
 		// We do not emit the index entry for a block until we have seen the
 		// first key for the next data block.  This allows us to use shorter
@@ -48,10 +51,13 @@ struct TableBuilder::Rep
 
 		Rep(const Options& opt, WritableFile* f) :
 			options(opt), index_block_options(opt), file(f), offset(0),
-					data_block(&options), index_block(&index_block_options),
+					synced_offset(0),
+					data_block(&options, opt.data_block_hash_index),
+					index_block(&index_block_options),
 					num_entries(0), closed(false),
 					filter_block(opt.filter_policy == NULL ? NULL
 							: new FilterBlockBuilder(opt.filter_policy)),
+					range_del_block(&options), num_range_deletions(0),
 					pending_index_entry(false)
 		{
 			index_block_options.block_restart_interval = 1;
@@ -84,6 +90,13 @@ Status TableBuilder::ChangeOptions(const Options& options)
 		return Status::InvalidArgument(
 				"changing comparator while building table");
 	}
+	if ( options.data_block_hash_index
+			!= rep_->options.data_block_hash_index )
+	{
+		// Recorded once for the whole table, in the footer
+		return Status::InvalidArgument(
+				"changing data_block_hash_index while building table");
+	}
 
 	// Note that any live BlockBuilders point to rep_->options and therefore
 	// will automatically pick up the updated options.
@@ -204,19 +217,36 @@ void TableBuilder::WriteRawBlock(const Slice& block_contents,
 	if ( r->status.ok() )
 	{
 		char trailer[kBlockTrailerSize];
-		trailer[0] = type;
-		uint32_t crc = crc32c::Value(block_contents.data(),
-				block_contents.size());
-		crc = crc32c::Extend(crc, trailer, 1); // Extend crc to cover block type
-		EncodeFixed32(trailer + 1, crc32c::Mask(crc));
+		const ChecksumType checksum = r->options.checksum;
+		trailer[0] = type | (checksum << kChecksumTypeShift);
+		const uint32_t crc = BlockChecksum(checksum, block_contents.data(),
+				block_contents.size(), trailer[0]);
+		EncodeFixed32(trailer + 1, crc);
 		r->status = r->file->Append(Slice(trailer, kBlockTrailerSize));
 		if ( r->status.ok() )
 		{
 			r->offset += block_contents.size() + kBlockTrailerSize;
+			if ( r->options.bytes_per_sync > 0 && r->offset
+					- r->synced_offset >= r->options.bytes_per_sync )
+			{
+				r->status = r->file->RangeSync(r->synced_offset, r->offset
+						- r->synced_offset);
+				r->synced_offset = r->offset;
+			}
 		}
 	}
 }
 
+void TableBuilder::AddRangeDeletion(const Slice& key, const Slice& value)
+{
+	Rep* r = rep_;
+	assert(!r->closed);
+	if ( !ok() )
+		return;
+	r->range_del_block.Add(key, value);
+	r->num_range_deletions++;
+}
+
 Status TableBuilder::status() const
 {
 	return rep_->status;
@@ -230,6 +260,7 @@ Status TableBuilder::Finish()
 	r->closed = true;
 
 	BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+	BlockHandle range_del_block_handle;
 
 	// Write filter block
 	if ( ok() && r->filter_block != NULL )
@@ -238,10 +269,19 @@ Status TableBuilder::Finish()
 				&filter_block_handle);
 	}
 
+	// Write range deletion block
+	if ( ok() && r->num_range_deletions > 0 )
+	{
+		WriteBlock(&r->range_del_block, &range_del_block_handle);
+	}
+
 	// Write metaindex block
 	if ( ok() )
 	{
-		BlockBuilder meta_index_block(&r->options);
+		// Meta block names are plain strings, read back in bytewise order
+		Options meta_options = r->options;
+		meta_options.comparator = BytewiseComparator();
+		BlockBuilder meta_index_block(&meta_options);
 		if ( r->filter_block != NULL )
 		{
 			// Add mapping from "filter.Name" to location of filter data
@@ -251,6 +291,13 @@ Status TableBuilder::Finish()
 			filter_block_handle.EncodeTo(&handle_encoding);
 			meta_index_block.Add(key, handle_encoding);
 		}
+		if ( r->num_range_deletions > 0 )
+		{
+			// Keys are kept sorted: "filter." < "rangedel"
+			std::string handle_encoding;
+			range_del_block_handle.EncodeTo(&handle_encoding);
+			meta_index_block.Add("rangedel", handle_encoding);
+		}
 
 		// TODO(postrelease): Add stats and other meta blocks
 		WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -276,6 +323,7 @@ Status TableBuilder::Finish()
 		Footer footer;
 		footer.set_metaindex_handle(metaindex_block_handle);
 		footer.set_index_handle(index_block_handle);
+		footer.set_data_block_hash_index(r->options.data_block_hash_index);
 		std::string footer_encoding;
 		footer.EncodeTo(&footer_encoding);
 		r->status = r->file->Append(footer_encoding);
@@ -299,6 +347,11 @@ uint64_t TableBuilder::NumEntries() const
 	return rep_->num_entries;
 }
 
+uint64_t TableBuilder::NumRangeDeletions() const
+{
+	return rep_->num_range_deletions;
+}
+
 uint64_t TableBuilder::FileSize() const
 {
 	return rep_->offset;
@@ -250,7 +250,7 @@ class BlockConstructor: public Constructor
 		{
 			delete block_;
 			block_ = NULL;
-			BlockBuilder builder(&options);
+			BlockBuilder builder(&options, options.data_block_hash_index);
 
 			for (KVMap::const_iterator it = data.begin(); it != data.end(); ++it)
 			{
@@ -262,7 +262,7 @@ class BlockConstructor: public Constructor
 			contents.data = data_;
 			contents.cachable = false;
 			contents.heap_allocated = false;
-			block_ = new Block(contents);
+			block_ = new Block(contents, options.data_block_hash_index);
 			return Status::OK();
 		}
 		virtual Iterator* NewIterator() const
@@ -511,6 +511,7 @@ struct TestArgs
 		TestType type;
 		bool reverse_compare;
 		int restart_interval;
+		bool hash_index;
 };
 
 static const TestArgs kTestArgList[] =
@@ -521,6 +522,9 @@ static const TestArgs kTestArgList[] =
 { TABLE_TEST, true, 16 },
 { TABLE_TEST, true, 1 },
 { TABLE_TEST, true, 1024 },
+{ TABLE_TEST, false, 16, true },
+{ TABLE_TEST, false, 1, true },
+{ TABLE_TEST, true, 16, true },
 
 { BLOCK_TEST, false, 16 },
 { BLOCK_TEST, false, 1 },
@@ -528,6 +532,9 @@ static const TestArgs kTestArgList[] =
 { BLOCK_TEST, true, 16 },
 { BLOCK_TEST, true, 1 },
 { BLOCK_TEST, true, 1024 },
+{ BLOCK_TEST, false, 16, true },
+{ BLOCK_TEST, false, 1, true },
+{ BLOCK_TEST, true, 16, true },
 
 // Restart interval does not matter for memtables
 		{ MEMTABLE_TEST, false, 16 },
@@ -553,6 +560,7 @@ class Harness
 			options_ = Options();
 
 			options_.block_restart_interval = args.restart_interval;
+			options_.data_block_hash_index = args.hash_index;
 			// Use shorter block size for tests to exercise block boundary
 			// conditions more.
 			options_.block_size = 256;
@@ -1016,6 +1024,100 @@ TEST(TableTest, ApproximateOffsetOfPlain)
 
 }
 
+TEST(TableTest, HashIndexIgnoredByOldReaders)
+{
+	Options options;
+	options.data_block_hash_index = true;
+	options.block_restart_interval = 4;
+	BlockBuilder builder(&options, true);
+	for (int i = 0; i < 200; i += 2)
+	{
+		char key[20];
+		snprintf(key, sizeof(key), "k%06d", i);
+		builder.Add(key, "v");
+	}
+	std::string data = builder.Finish().ToString();
+	BlockContents contents;
+	contents.data = data;
+	contents.cachable = false;
+	contents.heap_allocated = false;
+	Block with_index(contents, true);
+	Block without_index(contents, false);
+	Iterator* a = with_index.NewIterator(BytewiseComparator());
+	Iterator* b = without_index.NewIterator(BytewiseComparator());
+	for (int i = 0; i <= 200; i++)
+	{
+		char key[20];
+		snprintf(key, sizeof(key), "k%06d", i);
+		a->Seek(key);
+		b->Seek(key);
+		ASSERT_EQ(a->Valid(), b->Valid());
+		if ( a->Valid() )
+		{
+			ASSERT_EQ(a->key().ToString(), b->key().ToString());
+		}
+	}
+	int count = 0;
+	for (b->SeekToFirst(); b->Valid(); b->Next())
+	{
+		count++;
+	}
+	ASSERT_EQ(100, count);
+	delete a;
+	delete b;
+}
+
+TEST(TableTest, ChecksumTypes)
+{
+	const ChecksumType types[] = { kCRC32c, kxxHash64 };
+	for (int t = 0; t < 2; t++)
+	{
+		Options options;
+		options.block_size = 256;
+		options.checksum = types[t];
+		StringSink sink;
+		TableBuilder builder(options, &sink);
+		for (int i = 0; i < 1000; i++)
+		{
+			char key[20];
+			snprintf(key, sizeof(key), "k%06d", i);
+			builder.Add(key, std::string(i % 50, 'v'));
+		}
+		ASSERT_OK(builder.Finish());
+
+		ReadOptions ro;
+		ro.verify_checksums = true;
+		for (int corrupt = 0; corrupt < 2; corrupt++)
+		{
+			std::string contents = sink.contents();
+			if ( corrupt )
+			{
+				contents[1] ^= 0x40; // Inside the first data block
+			}
+			StringSource source(contents);
+			Table* table = NULL;
+			ASSERT_OK(Table::Open(options, &source, contents.size(), &table));
+			Iterator* iter = table->NewIterator(ro);
+			int count = 0;
+			for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+			{
+				count++;
+			}
+			if ( corrupt )
+			{
+				ASSERT_TRUE(iter->status().IsCorruption());
+			}
+			else
+			{
+				ASSERT_OK(iter->status());
+				ASSERT_EQ(1000, count);
+			}
+			delete iter;
+			delete table;
+		}
+	}
+}
+
 static bool SnappyCompressionSupported()
 {
 	std::string out;
@@ -4,6 +4,7 @@
 
 #include "table/two_level_iterator.h"
 
+#include "leveldb/comparator.h"
 #include "leveldb/table.h"
 #include "table/block.h"
 #include "table/format.h"
@@ -22,7 +23,8 @@ class TwoLevelIterator: public Iterator
 {
 	public:
 		TwoLevelIterator(Iterator* index_iter, BlockFunction block_function,
-				void* arg, const ReadOptions& options);
+				void* arg, const ReadOptions& options,
+				const Comparator* comparator);
 
 		virtual ~TwoLevelIterator();
 
@@ -69,14 +71,37 @@ class TwoLevelIterator: public Iterator
 			if ( status_.ok() && !s.ok() )
 				status_ = s;
 		}
-		void SkipEmptyDataBlocksForward();
-		void SkipEmptyDataBlocksBackward();
+		// Only Next() and Prev() stop at the bounds: seeks still find the
+		// entries past them, which a merging iterator relies on when it
+		// changes direction.
+		void SkipEmptyDataBlocksForward(bool bounded);
+		void SkipEmptyDataBlocksBackward(bool bounded);
 		void SetDataIterator(Iterator* data_iter);
 		void InitDataBlock();
 
+		// Does the block at index_iter_ end at or past the upper bound, so
+		// that all later blocks lie past it?
+		bool BlockEndsPastUpperBound() const
+		{
+			return comparator_ != NULL && options_.iterate_upper_bound != NULL
+					&& comparator_->Compare(index_iter_.key(), upper_bound_) >= 0;
+		}
+		// Does the block at index_iter_ end before the lower bound, so that
+		// all earlier blocks lie before it too?
+		bool BlockEndsBeforeLowerBound() const
+		{
+			return comparator_ != NULL && options_.iterate_lower_bound != NULL
+					&& comparator_->Compare(index_iter_.key(), lower_bound_) < 0;
+		}
+
 		BlockFunction block_function_;
 		void* arg_;
-		const ReadOptions options_;
+		ReadOptions options_; // Bounds point at our copies of them
+		const Comparator* const comparator_;
+		std::string lower_bound_;
+		std::string upper_bound_;
+		Slice lower_bound_slice_;
+		Slice upper_bound_slice_;
 		Status status_;
 		IteratorWrapper index_iter_;
 		IteratorWrapper data_iter_; // May be NULL
@@ -86,10 +111,25 @@ class TwoLevelIterator: public Iterator
 };
 
 TwoLevelIterator::TwoLevelIterator(Iterator* index_iter,
-		BlockFunction block_function, void* arg, const ReadOptions& options) :
-	block_function_(block_function), arg_(arg), options_(options), index_iter_(
-			index_iter), data_iter_(NULL)
+		BlockFunction block_function, void* arg, const ReadOptions& options,
+		const Comparator* comparator) :
+	block_function_(block_function), arg_(arg), options_(options),
+			comparator_(comparator), index_iter_(index_iter), data_iter_(NULL)
 {
+	// Block iterators are created long after the caller's bounds may have
+	// gone away
+	if ( options.iterate_lower_bound != NULL )
+	{
+		lower_bound_ = options.iterate_lower_bound->ToString();
+		lower_bound_slice_ = lower_bound_;
+		options_.iterate_lower_bound = &lower_bound_slice_;
+	}
+	if ( options.iterate_upper_bound != NULL )
+	{
+		upper_bound_ = options.iterate_upper_bound->ToString();
+		upper_bound_slice_ = upper_bound_;
+		options_.iterate_upper_bound = &upper_bound_slice_;
+	}
 }
 
 TwoLevelIterator::~TwoLevelIterator()
@@ -102,7 +142,7 @@ void TwoLevelIterator::Seek(const Slice& target)
 	InitDataBlock();
 	if ( data_iter_.iter() != NULL )
 		data_iter_.Seek(target);
-	SkipEmptyDataBlocksForward();
+	SkipEmptyDataBlocksForward(false);
 }
 
 void TwoLevelIterator::SeekToFirst()
@@ -111,7 +151,7 @@ void TwoLevelIterator::SeekToFirst()
 	InitDataBlock();
 	if ( data_iter_.iter() != NULL )
 		data_iter_.SeekToFirst();
-	SkipEmptyDataBlocksForward();
+	SkipEmptyDataBlocksForward(false);
 }
 
 void TwoLevelIterator::SeekToLast()
@@ -120,31 +160,31 @@ void TwoLevelIterator::SeekToLast()
 	InitDataBlock();
 	if ( data_iter_.iter() != NULL )
 		data_iter_.SeekToLast();
-	SkipEmptyDataBlocksBackward();
+	SkipEmptyDataBlocksBackward(false);
 }
 
 void TwoLevelIterator::Next()
 {
 	assert(Valid());
 	data_iter_.Next();
-	SkipEmptyDataBlocksForward();
+	SkipEmptyDataBlocksForward(true);
 }
 
 void TwoLevelIterator::Prev()
 {
 	assert(Valid());
 	data_iter_.Prev();
-	SkipEmptyDataBlocksBackward();
+	SkipEmptyDataBlocksBackward(true);
 }
 
 // seek forward，一直找到 data_iter有值的数据
-void TwoLevelIterator::SkipEmptyDataBlocksForward()
+void TwoLevelIterator::SkipEmptyDataBlocksForward(bool bounded)
 {
 	// data_iter_ 无效
 	while (data_iter_.iter() == NULL || !data_iter_.Valid())
 	{
 		// Move to next block
-		if ( !index_iter_.Valid() )
+		if ( !index_iter_.Valid() || (bounded && BlockEndsPastUpperBound()) )
 		{
 			SetDataIterator(NULL);
 			return;
@@ -157,7 +197,7 @@ void TwoLevelIterator::SkipEmptyDataBlocksForward()
 }
 
 // seek backward，一直找到 data_iter有值的数据
-void TwoLevelIterator::SkipEmptyDataBlocksBackward()
+void TwoLevelIterator::SkipEmptyDataBlocksBackward(bool bounded)
 {
 	while (data_iter_.iter() == NULL || !data_iter_.Valid())
 	{
@@ -168,6 +208,11 @@ void TwoLevelIterator::SkipEmptyDataBlocksBackward()
 			return;
 		}
 		index_iter_.Prev();
+		if ( bounded && index_iter_.Valid() && BlockEndsBeforeLowerBound() )
+		{
+			SetDataIterator(NULL);
+			return;
+		}
 		InitDataBlock();
 		if ( data_iter_.iter() != NULL )
 			data_iter_.SeekToLast(); // seek last.
@@ -210,9 +255,11 @@ void TwoLevelIterator::InitDataBlock()
 } // namespace
 
 Iterator* NewTwoLevelIterator(Iterator* index_iter,
-		BlockFunction block_function, void* arg, const ReadOptions& options)
+		BlockFunction block_function, void* arg, const ReadOptions& options,
+		const Comparator* comparator)
 {
-	return new TwoLevelIterator(index_iter, block_function, arg, options);
+	return new TwoLevelIterator(index_iter, block_function, arg, options,
+			comparator);
 }
 
 } // namespace leveldb
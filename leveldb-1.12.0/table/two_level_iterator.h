@@ -10,6 +10,7 @@
 namespace leveldb
 {
 
+class Comparator;
 struct ReadOptions;
 
 // Return a new two level iterator.  A two-level iterator contains an
@@ -21,10 +22,17 @@ struct ReadOptions;
 //
 // Uses a supplied function to convert an index_iter value into
 // an iterator over the contents of the corresponding block.
+//
+// If "comparator" (which orders the keys of the blocks) is non-NULL, the
+// iterate_lower_bound and iterate_upper_bound of "options" are keys of
+// the blocks, and blocks whose index key shows they lie entirely outside
+// the bounds are not moved into by Next() and Prev(); seeks ignore the
+// bounds.  Index keys must be at least as large as every key of their
+// block and smaller than the keys of the next one.
 extern Iterator* NewTwoLevelIterator(Iterator* index_iter,
 		Iterator* (*block_function)(void* arg, const ReadOptions& options,
 				const Slice& index_value), void* arg,
-		const ReadOptions& options);
+		const ReadOptions& options, const Comparator* comparator = NULL);
 
 } // namespace leveldb
 
@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 
 #include "leveldb/cache.h"
 #include "port/port.h"
@@ -18,6 +19,22 @@ Cache::~Cache()
 {
 }
 
+Cache::Handle* Cache::Insert(const Slice& key, void* value, size_t charge,
+		void(*deleter)(const Slice& key, void* value),
+		Slice(*contents)(void* value))
+{
+	return Insert(key, value, charge, deleter);
+}
+
+SecondaryCache* Cache::secondary() const
+{
+	return NULL;
+}
+
+SecondaryCache::~SecondaryCache()
+{
+}
+
 namespace
 {
 
@@ -32,6 +49,7 @@ struct LRUHandle
 {
 		void* value; // 这个存储的是cache的数据
 		void (*deleter)(const Slice&, void* value); // 数据从Cache中清除时执行的清理函数；
+		Slice (*contents)(void* value); // Bytes kept by the secondary tier, or NULL
 		// @next_hash: 指向节点在hash table链表中的下一个hash(key)相同的元素,
 		// 碰撞时Leveldb采用的是链表法。最后一个节点的next_hash为NULL
 		LRUHandle* next_hash;
@@ -189,9 +207,15 @@ class LRUCache
 			capacity_ = capacity;
 		}
 
-		// Like Cache methods, but with an extra "hash" parameter.
+		// Key and bytes of the evicted entries that had a "contents" function
+		typedef std::vector<std::pair<std::string, std::string> >
+				SpilledEntries;
+
+		// Like Cache methods, but with an extra "hash" parameter.  Insert()
+		// appends the entries it evicts for the secondary tier to *spilled.
 		Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
-				size_t charge, void(*deleter)(const Slice& key, void* value));
+				size_t charge, void(*deleter)(const Slice& key, void* value),
+				Slice(*contents)(void* value), SpilledEntries* spilled);
 		Cache::Handle* Lookup(const Slice& key, uint32_t hash);
 		void Release(Cache::Handle* handle);
 		void Erase(const Slice& key, uint32_t hash);
@@ -284,7 +308,8 @@ void LRUCache::Release(Cache::Handle* handle)
 }
 
 Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
-		size_t charge, void(*deleter)(const Slice& key, void* value))
+		size_t charge, void(*deleter)(const Slice& key, void* value),
+		Slice(*contents)(void* value), SpilledEntries* spilled)
 {
 	MutexLock l(&mutex_);
 
@@ -292,6 +317,7 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
 			+ key.size()));
 	e->value = value;
 	e->deleter = deleter;
+	e->contents = contents;
 	e->charge = charge;
 	e->key_length = key.size();
 	e->hash = hash;
@@ -312,6 +338,15 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
 	while (usage_ > capacity_ && lru_.next != &lru_)
 	{
 		LRUHandle* old = lru_.next;
+		if ( old->contents != NULL )
+		{
+			const Slice bytes = (*old->contents)(old->value);
+			if ( !bytes.empty() )
+			{
+				spilled->push_back(std::make_pair(old->key().ToString(),
+						bytes.ToString()));
+			}
+		}
 		LRU_Remove(old);
 		table_.Remove(old->key(), old->hash);
 		Unref(old);
@@ -344,6 +379,7 @@ class ShardedLRUCache: public Cache
 {
 	private:
 		LRUCache shard_[kNumShards]; // shard_[16];
+		SecondaryCache* secondary_;
 		port::Mutex id_mutex_;
 		uint64_t last_id_;
 
@@ -358,8 +394,8 @@ class ShardedLRUCache: public Cache
 		}
 
 	public:
-		explicit ShardedLRUCache(size_t capacity) :
-			last_id_(0)
+		ShardedLRUCache(size_t capacity, SecondaryCache* secondary) :
+			secondary_(secondary), last_id_(0)
 		{
 			const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
 			for (int s = 0; s < kNumShards; s++)
@@ -373,8 +409,29 @@ class ShardedLRUCache: public Cache
 		virtual Handle* Insert(const Slice& key, void* value, size_t charge,
 				void(*deleter)(const Slice& key, void* value))
 		{
+			LRUCache::SpilledEntries spilled;
+			const uint32_t hash = HashSlice(key);
+			return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+					NULL, &spilled);
+		}
+		virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+				void(*deleter)(const Slice& key, void* value),
+				Slice(*contents)(void* value))
+		{
+			LRUCache::SpilledEntries spilled;
 			const uint32_t hash = HashSlice(key);
-			return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+			Handle* h = shard_[Shard(hash)].Insert(key, hash, value, charge,
+					deleter, secondary_ != NULL ? contents : NULL, &spilled);
+			// Outside the shard lock, since the secondary tier may do I/O
+			for (size_t i = 0; i < spilled.size(); i++)
+			{
+				secondary_->Insert(spilled[i].first, spilled[i].second);
+			}
+			return h;
+		}
+		virtual SecondaryCache* secondary() const
+		{
+			return secondary_;
 		}
 		virtual Handle* Lookup(const Slice& key)
 		{
@@ -406,7 +463,12 @@ class ShardedLRUCache: public Cache
 
 Cache* NewLRUCache(size_t capacity)
 {
-	return new ShardedLRUCache(capacity);
+	return new ShardedLRUCache(capacity, NULL);
+}
+
+Cache* NewLRUCache(size_t capacity, SecondaryCache* secondary)
+{
+	return new ShardedLRUCache(capacity, secondary);
 }
 
 } // namespace leveldb
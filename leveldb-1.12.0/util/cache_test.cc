@@ -4,7 +4,9 @@
 
 #include "leveldb/cache.h"
 
+#include <map>
 #include <vector>
+#include "leveldb/env.h"
 #include "util/coding.h"
 #include "util/testharness.h"
 
@@ -179,6 +181,102 @@ TEST(CacheTest, NewId) {
   ASSERT_NE(a, b);
 }
 
+namespace {
+class MapSecondaryCache : public SecondaryCache {
+ public:
+  std::map<std::string, std::string> entries;
+
+  virtual void Insert(const Slice& key, const Slice& contents) {
+    entries[key.ToString()] = contents.ToString();
+  }
+  virtual bool Lookup(const Slice& key, std::string* contents) {
+    std::map<std::string, std::string>::const_iterator it =
+        entries.find(key.ToString());
+    if (it == entries.end()) {
+      return false;
+    }
+    *contents = it->second;
+    return true;
+  }
+};
+
+void DeleteString(const Slice& key, void* v) {
+  delete reinterpret_cast<std::string*>(v);
+}
+Slice StringContents(void* v) {
+  return *reinterpret_cast<std::string*>(v);
+}
+}
+
+TEST(CacheTest, SecondaryTier) {
+  MapSecondaryCache secondary;
+  ASSERT_TRUE(cache_->secondary() == NULL);
+  Cache* cache = NewLRUCache(kCacheSize, &secondary);
+  ASSERT_TRUE(cache->secondary() == &secondary);
+
+  // Only the entries evicted for room, and inserted with a "contents"
+  // function, go to the secondary tier
+  cache->Release(cache->Insert(EncodeKey(-1), new std::string("x"), 1,
+                               &DeleteString));
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    cache->Release(cache->Insert(EncodeKey(i),
+                                 new std::string(EncodeKey(1000 + i)), 1,
+                                 &DeleteString, &StringContents));
+  }
+  ASSERT_GE(secondary.entries.size(), kCacheSize / 2);
+  ASSERT_EQ(0, secondary.entries.count(EncodeKey(-1)));
+  for (std::map<std::string, std::string>::const_iterator it =
+           secondary.entries.begin(); it != secondary.entries.end(); ++it) {
+    ASSERT_EQ(DecodeKey(it->first) + 1000, DecodeKey(it->second));
+    ASSERT_TRUE(cache->Lookup(it->first) == NULL);
+  }
+
+  const size_t spilled = secondary.entries.size();
+  delete cache;
+  ASSERT_EQ(spilled, secondary.entries.size());
+}
+
+TEST(CacheTest, LogSecondaryCache) {
+  Env* env = Env::Default();
+  const std::string dir = test::TmpDir() + "/secondary_cache_test";
+  const uint64_t capacity = 256 << 10;
+  SecondaryCache* secondary;
+  ASSERT_OK(NewLogSecondaryCache(env, dir, capacity, &secondary));
+
+  // 1KB entries, four times the capacity: only the newest are kept
+  std::string contents, value;
+  const int n = 1024;
+  for (int i = 0; i < n; i++) {
+    contents.assign(1024, static_cast<char>('a' + i % 26));
+    PutFixed32(&contents, i);
+    secondary->Insert(EncodeKey(i), contents);
+  }
+  secondary->Insert(EncodeKey(n - 1), "ignored");
+  for (int i = 0; i < n; i++) {
+    if (!secondary->Lookup(EncodeKey(i), &value)) {
+      ASSERT_LT(i, n - capacity / 2048);  // At least half of it is in use
+      continue;
+    }
+    ASSERT_LE(static_cast<uint64_t>(n - i) * 1024, capacity + (64 << 10));
+    ASSERT_EQ(1028, value.size());
+    ASSERT_EQ(static_cast<char>('a' + i % 26), value[0]);
+    ASSERT_EQ(i, DecodeFixed32(value.data() + 1024));
+  }
+  ASSERT_TRUE(!secondary->Lookup(EncodeKey(0), &value));
+
+  std::vector<std::string> files;
+  ASSERT_OK(env->GetChildren(dir, &files));
+  ASSERT_GT(files.size(), 2);  // "." and ".." besides the segments
+  delete secondary;
+
+  // Segment files go with the cache, or with the next one on the path
+  ASSERT_OK(env->GetChildren(dir, &files));
+  for (size_t i = 0; i < files.size(); i++) {
+    ASSERT_TRUE(files[i].find(".cache") == std::string::npos);
+  }
+  env->DeleteDir(dir);
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -16,6 +16,11 @@ Comparator::~Comparator()
 {
 }
 
+Slice Comparator::PointKey(const Slice& key) const
+{
+	return key;
+}
+
 namespace
 {
 class BytewiseComparatorImpl: public Comparator //比较
@@ -3,13 +3,23 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 //
 // A portable implementation of crc32c, optimized to handle
-// four bytes at a time.
+// four bytes at a time, and one using the crc32 instruction of SSE4.2,
+// picked at run time.
 
 #include "util/crc32c.h"
 
+#include <assert.h>
 #include <stdint.h>
+#include <string.h>
+#include "port/port.h"
 #include "util/coding.h"
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LEVELDB_CRC32C_SSE42
+#include <cpuid.h>
+#include <nmmintrin.h>
+#endif
+
 namespace leveldb
 {
 namespace crc32c
@@ -198,7 +208,7 @@ static inline uint32_t LE_LOAD32(const uint8_t *p)
 	return DecodeFixed32(reinterpret_cast<const char*> (p));
 }
 
-uint32_t Extend(uint32_t crc, const char* buf, size_t size)
+uint32_t ExtendPortable(uint32_t crc, const char* buf, size_t size)
 {
 	const uint8_t *p = reinterpret_cast<const uint8_t *> (buf);
 	const uint8_t *e = p + size;
@@ -253,5 +263,191 @@ uint32_t Extend(uint32_t crc, const char* buf, size_t size)
 	return l ^ 0xffffffffu;
 }
 
+#ifdef LEVELDB_CRC32C_SSE42
+
+// Large buffers are cut into three streams of kLong (then kShort) bytes
+// whose crcs the CPU computes in parallel, as the crc32 instruction has a
+// latency of three cycles but a throughput of one.  The crc of a stream
+// is then shifted over the length of the next and combined with it.
+static const size_t kLong = 8192;
+static const size_t kShort = 256;
+
+// Operators shifting a crc over kLong and kShort zero bytes, by byte of
+// the crc
+static uint32_t long_shift_[4][256];
+static uint32_t short_shift_[4][256];
+
+// Multiply the GF(2) 32x32 matrix "mat" by the vector "vec"
+static uint32_t MatrixTimes(const uint32_t* mat, uint32_t vec)
+{
+	uint32_t sum = 0;
+	while (vec != 0)
+	{
+		if ( vec & 1 )
+		{
+			sum ^= *mat;
+		}
+		vec >>= 1;
+		mat++;
+	}
+	return sum;
+}
+
+static void MatrixSquare(uint32_t* square, const uint32_t* mat)
+{
+	for (int n = 0; n < 32; n++)
+	{
+		square[n] = MatrixTimes(mat, mat[n]);
+	}
+}
+
+// Build the tables shifting a crc over "len" zero bytes.
+// REQUIRES: len is a power of two
+static void BuildShiftTables(uint32_t shift[4][256], size_t len)
+{
+	// The operator for one zero bit, squared up to "len" bytes
+	uint32_t odd[32], even[32];
+	odd[0] = 0x82f63b78u; // Reflected crc32c polynomial
+	uint32_t row = 1;
+	for (int n = 1; n < 32; n++)
+	{
+		odd[n] = row;
+		row <<= 1;
+	}
+	MatrixSquare(even, odd); // 2 bits
+	MatrixSquare(odd, even); // 4 bits
+	uint32_t* op = odd;
+	while (true)
+	{
+		MatrixSquare(even, odd);
+		op = even;
+		len >>= 1;
+		if ( len == 0 )
+		{
+			break;
+		}
+		MatrixSquare(odd, even);
+		op = odd;
+		len >>= 1;
+		if ( len == 0 )
+		{
+			break;
+		}
+	}
+	for (uint32_t n = 0; n < 256; n++)
+	{
+		shift[0][n] = MatrixTimes(op, n);
+		shift[1][n] = MatrixTimes(op, n << 8);
+		shift[2][n] = MatrixTimes(op, n << 16);
+		shift[3][n] = MatrixTimes(op, n << 24);
+	}
+}
+
+static inline uint32_t Shift(const uint32_t shift[4][256], uint32_t crc)
+{
+	return shift[0][crc & 0xff] ^ shift[1][(crc >> 8) & 0xff]
+			^ shift[2][(crc >> 16) & 0xff] ^ shift[3][crc >> 24];
+}
+
+static inline uint64_t LoadWord(const uint8_t* p)
+{
+	uint64_t word;
+	memcpy(&word, p, sizeof(word));
+	return word;
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t ExtendSSE42(uint32_t crc, const char* buf, size_t size)
+{
+	const uint8_t* p = reinterpret_cast<const uint8_t*> (buf);
+	uint64_t crc0 = crc ^ 0xffffffffu;
+
+	// Process bytes until p is 8-byte aligned
+	while (size > 0 && (reinterpret_cast<uintptr_t> (p) & 7) != 0)
+	{
+		crc0 = _mm_crc32_u8(crc0, *p++);
+		size--;
+	}
+
+#define STREAMS(len, shift) do {                                  \
+    uint64_t crc1 = 0, crc2 = 0;                                  \
+    const uint8_t* end = p + (len);                               \
+    do {                                                          \
+      crc0 = _mm_crc32_u64(crc0, LoadWord(p));                    \
+      crc1 = _mm_crc32_u64(crc1, LoadWord(p + (len)));            \
+      crc2 = _mm_crc32_u64(crc2, LoadWord(p + 2 * (len)));        \
+      p += 8;                                                     \
+    } while (p < end);                                            \
+    crc0 = Shift(shift, crc0) ^ crc1;                             \
+    crc0 = Shift(shift, crc0) ^ crc2;                             \
+    p += 2 * (len);                                               \
+    size -= 3 * (len);                                            \
+} while (0)
+
+	while (size >= 3 * kLong)
+	{
+		STREAMS(kLong, long_shift_);
+	}
+	while (size >= 3 * kShort)
+	{
+		STREAMS(kShort, short_shift_);
+	}
+#undef STREAMS
+
+	// Process bytes 8 at a time, then the last few
+	while (size >= 8)
+	{
+		crc0 = _mm_crc32_u64(crc0, LoadWord(p));
+		p += 8;
+		size -= 8;
+	}
+	while (size > 0)
+	{
+		crc0 = _mm_crc32_u8(crc0, *p++);
+		size--;
+	}
+	return static_cast<uint32_t> (crc0) ^ 0xffffffffu;
+}
+
+#endif  // LEVELDB_CRC32C_SSE42
+
+static port::OnceType once = LEVELDB_ONCE_INIT;
+static bool hardware_accelerated = false;
+static uint32_t (*extend_function)(uint32_t, const char*, size_t) =
+		&ExtendPortable;
+
+static void InitModule()
+{
+#ifdef LEVELDB_CRC32C_SSE42
+	unsigned int eax, ebx, ecx, edx;
+	if ( __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2) != 0 )
+	{
+		BuildShiftTables(long_shift_, kLong);
+		BuildShiftTables(short_shift_, kShort);
+		hardware_accelerated = true;
+		extend_function = &ExtendSSE42;
+	}
+#endif
+}
+
+bool IsHardwareAccelerated()
+{
+	port::InitOnce(&once, InitModule);
+	return hardware_accelerated;
+}
+
+uint32_t ExtendHardware(uint32_t crc, const char* buf, size_t size)
+{
+	port::InitOnce(&once, InitModule);
+	assert(hardware_accelerated);
+	return extend_function(crc, buf, size);
+}
+
+uint32_t Extend(uint32_t crc, const char* buf, size_t size)
+{
+	port::InitOnce(&once, InitModule);
+	return extend_function(crc, buf, size);
+}
+
 } // namespace crc32c
 } // namespace leveldb
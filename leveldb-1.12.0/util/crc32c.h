@@ -15,9 +15,18 @@ namespace crc32c
 
 // Return the crc32c of concat(A, data[0,n-1]) where init_crc is the
 // crc32c of some string A.  Extend() is often used to maintain the
-// crc32c of a stream of data.
+// crc32c of a stream of data.  It uses the crc32 instruction of SSE4.2
+// when the CPU has it.
 extern uint32_t Extend(uint32_t init_crc, const char* data, size_t n);
 
+// The implementations Extend() picks from, for tests and benchmarks.
+extern uint32_t ExtendPortable(uint32_t init_crc, const char* data, size_t n);
+// REQUIRES: IsHardwareAccelerated()
+extern uint32_t ExtendHardware(uint32_t init_crc, const char* data, size_t n);
+
+// Does Extend() use the crc32 instruction?
+extern bool IsHardwareAccelerated();
+
 // Return the crc32c of data[0,n-1]
 inline uint32_t Value(const char* data, size_t n)
 {
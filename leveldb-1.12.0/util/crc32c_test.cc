@@ -3,6 +3,7 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "util/crc32c.h"
+#include "util/random.h"
 #include "util/testharness.h"
 
 namespace leveldb {
@@ -56,6 +57,28 @@ TEST(CRC, Extend) {
             Extend(Value("hello ", 6), "world", 5));
 }
 
+TEST(CRC, Implementations) {
+  // Cover unaligned starts and both the short and long interleaved streams
+  Random rnd(301);
+  std::string data;
+  for (int i = 0; i < 3 * 8192 * 2 + 3 * 256 + 100; i++) {
+    data.push_back(static_cast<char>(rnd.Uniform(256)));
+  }
+  const size_t sizes[] = { 0, 1, 7, 8, 9, 100, 767, 768, 769, 1000,
+                           3 * 8192 - 1, 3 * 8192, 3 * 8192 + 777,
+                           3 * 8192 * 2 + 3 * 256 + 13 };
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (size_t offset = 0; offset < 8; offset++) {
+      const char* p = data.data() + offset;
+      const uint32_t expected = ExtendPortable(0x1234, p, sizes[i]);
+      ASSERT_EQ(expected, Extend(0x1234, p, sizes[i]));
+      if (IsHardwareAccelerated()) {
+        ASSERT_EQ(expected, ExtendHardware(0x1234, p, sizes[i]));
+      }
+    }
+  }
+}
+
 TEST(CRC, Mask) {
   uint32_t crc = Value("foo", 3);
   ASSERT_NE(crc, Mask(crc));
@@ -11,6 +11,18 @@ Env::~Env()
 {
 }
 
+Status Env::ReuseWritableFile(const std::string& fname,
+		const std::string& old_fname, WritableFile** result)
+{
+	Status s = RenameFile(old_fname, fname);
+	if ( !s.ok() )
+	{
+		*result = NULL;
+		return s;
+	}
+	return NewWritableFile(fname, result);
+}
+
 SequentialFile::~SequentialFile()
 {
 }
@@ -25,6 +25,7 @@
 #include "port/port.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/perf_context_imp.h"
 #include "util/posix_logger.h"
 
 namespace leveldb
@@ -56,9 +57,11 @@ class PosixSequentialFile: public SequentialFile
 
 		virtual Status Read(size_t n, Slice* result, char* scratch)
 		{
+			IOSTATS_TIMER_GUARD(read_nanos);
 			Status s;
 			size_t r = fread_unlocked(scratch, 1, n, file_);
 			*result = Slice(scratch, r);
+			IOSTATS_ADD(bytes_read, r);
 			if ( r < n )
 			{
 				if ( feof(file_) )
@@ -104,9 +107,11 @@ class PosixRandomAccessFile: public RandomAccessFile
 		virtual Status Read(uint64_t offset, size_t n, Slice* result,
 				char* scratch) const
 		{
+			IOSTATS_TIMER_GUARD(read_nanos);
 			Status s;
 			ssize_t r = pread(fd_, scratch, n, static_cast<off_t> (offset));
 			*result = Slice(scratch, (r < 0) ? 0 : r);
+			IOSTATS_ADD(bytes_read, result->size());
 			if ( r < 0 )
 			{
 				// An error: return a non-ok status
@@ -213,6 +218,7 @@ class PosixMmapReadableFile: public RandomAccessFile
 			{
 				*result = Slice(reinterpret_cast<char*> (mmapped_region_)
 						+ offset, n);
+				IOSTATS_ADD(bytes_read, n);
 			}
 			return s;
 		}
@@ -235,6 +241,7 @@ class PosixMmapFile: public WritableFile
 		char* dst_; // Where to write next  (in range [base_,limit_])
 		char* last_sync_; // Where have we synced up to，上次同步的地址
 		uint64_t file_offset_; // Offset of base_ in file // base_在文件中的偏移地址
+		uint64_t file_size_; // Space the file holds on disk
 
 		// Have we done an munmap of unsynced data?
 		bool pending_sync_;
@@ -283,11 +290,33 @@ class PosixMmapFile: public WritableFile
 			return result;
 		}
 
+		// Grow the file to "size" bytes.  Allocating the blocks up front
+		// means that filling them is not an allocation, so a later
+		// fdatasync() has no metadata to write.
+		bool Allocate(uint64_t size)
+		{
+#if defined(OS_LINUX)
+			if ( fallocate(fd_, 0, file_size_, size - file_size_) == 0 )
+			{
+				file_size_ = size;
+				return true;
+			}
+			// Not supported by the file system: fall back to a sparse file
+#endif
+			if ( ftruncate(fd_, size) < 0 )
+			{
+				return false;
+			}
+			file_size_ = size;
+			return true;
+		}
+
 		bool MapNewRegion()
 		{
 			assert(base_ == NULL);
-			//改变文件大小
-			if ( ftruncate(fd_, file_offset_ + map_size_) < 0 )
+			//改变文件大小；a reused file may be large enough already
+			if ( file_offset_ + map_size_ > file_size_ && !Allocate(
+					file_offset_ + map_size_) )
 			{
 				return false;
 			}
@@ -306,11 +335,14 @@ class PosixMmapFile: public WritableFile
 		}
 
 	public:
-		PosixMmapFile(const std::string& fname, int fd, size_t page_size) :
+		// "file_size" is the size of a reused file, whose contents get
+		// overwritten
+		PosixMmapFile(const std::string& fname, int fd, size_t page_size,
+				uint64_t file_size = 0) :
 			filename_(fname), fd_(fd), page_size_(page_size), map_size_(
 					Roundup(65536, page_size)), base_(NULL), limit_(NULL),
-					dst_(NULL), last_sync_(NULL), file_offset_(0),
-					pending_sync_(false)
+					dst_(NULL), last_sync_(NULL), file_offset_(0), file_size_(
+							file_size), pending_sync_(false)
 		{
 			assert((page_size & (page_size - 1)) == 0);
 		}
@@ -325,6 +357,8 @@ class PosixMmapFile: public WritableFile
 
 		virtual Status Append(const Slice& data)
 		{
+			IOSTATS_TIMER_GUARD(write_nanos);
+			IOSTATS_ADD(bytes_written, data.size());
 			const char* src = data.data();
 			size_t left = data.size();
 			while (left > 0)
@@ -357,7 +391,7 @@ class PosixMmapFile: public WritableFile
 			{
 				s = IOError(filename_, errno);
 			}
-			else if ( unused > 0 )
+			else if ( file_size_ > file_offset_ - unused )
 			{
 				// Trim the extra space at the end of the file
 				if ( ftruncate(fd_, file_offset_ - unused) < 0 )
@@ -387,8 +421,18 @@ class PosixMmapFile: public WritableFile
 
 		virtual Status Sync()
 		{
+			IOSTATS_TIMER_GUARD(fsync_nanos);
 			Status s;
 
+#if defined(OS_LINUX)
+			// The kernel tracks the pages written through the mapping as
+			// dirty, so fdatasync() syncs them as msync() would, without
+			// looking at the state Append() changes.
+			if ( fdatasync(fd_) < 0 )
+			{
+				s = IOError(filename_, errno);
+			}
+#else
 			if ( pending_sync_ )
 			{
 				// Some unmapped data was not synced
@@ -411,9 +455,36 @@ class PosixMmapFile: public WritableFile
 					s = IOError(filename_, errno);
 				}
 			}
+#endif
 
 			return s;
 		}
+
+		virtual bool IsSyncThreadSafe() const
+		{
+#if defined(OS_LINUX)
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		virtual Status RangeSync(uint64_t offset, uint64_t nbytes)
+		{
+#if defined(OS_LINUX)
+			// Leave out the last partial page: it is still being written,
+			// and writing it back now would only make the next append wait
+			// for the write.
+			const uint64_t end = (offset + nbytes) & ~static_cast<uint64_t> (
+					page_size_ - 1);
+			if ( end > offset && sync_file_range(fd_, offset, end - offset,
+					SYNC_FILE_RANGE_WRITE) < 0 )
+			{
+				return IOError(filename_, errno);
+			}
+#endif
+			return Status::OK();
+		}
 };
 
 // 对整个文件，加锁 / 解锁
@@ -470,6 +541,7 @@ class PosixEnv: public Env
 		virtual Status NewSequentialFile(const std::string& fname,
 				SequentialFile** result)
 		{
+			IOSTATS_TIMER_GUARD(open_nanos);
 			FILE* f = fopen(fname.c_str(), "r");
 			if ( f == NULL )
 			{
@@ -486,6 +558,7 @@ class PosixEnv: public Env
 		virtual Status NewRandomAccessFile(const std::string& fname,
 				RandomAccessFile** result)
 		{
+			IOSTATS_TIMER_GUARD(open_nanos);
 			*result = NULL;
 			Status s;
 			int fd = open(fname.c_str(), O_RDONLY);
@@ -526,6 +599,7 @@ class PosixEnv: public Env
 		virtual Status NewWritableFile(const std::string& fname,
 				WritableFile** result)
 		{
+			IOSTATS_TIMER_GUARD(open_nanos);
 			Status s;
 			const int fd =
 					open(fname.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
@@ -541,6 +615,31 @@ class PosixEnv: public Env
 			return s;
 		}
 
+		virtual Status ReuseWritableFile(const std::string& fname,
+				const std::string& old_fname, WritableFile** result)
+		{
+			IOSTATS_TIMER_GUARD(open_nanos);
+			*result = NULL;
+			if ( rename(old_fname.c_str(), fname.c_str()) != 0 )
+			{
+				return IOError(old_fname, errno);
+			}
+			const int fd = open(fname.c_str(), O_RDWR, 0644);
+			if ( fd < 0 )
+			{
+				return IOError(fname, errno);
+			}
+			struct stat sbuf;
+			if ( fstat(fd, &sbuf) != 0 )
+			{
+				Status s = IOError(fname, errno);
+				close(fd);
+				return s;
+			}
+			*result = new PosixMmapFile(fname, fd, page_size_, sbuf.st_size);
+			return Status::OK();
+		}
+
 		// 判断文件，或文件夹是否存在
 		virtual bool FileExists(const std::string& fname)
 		{
@@ -722,6 +821,13 @@ class PosixEnv: public Env
 			return static_cast<uint64_t> (tv.tv_sec) * 1000000 + tv.tv_usec;
 		}
 
+		virtual uint64_t NowNanos()
+		{
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			return static_cast<uint64_t> (ts.tv_sec) * 1000000000 + ts.tv_nsec;
+		}
+
 		virtual void SleepForMicroseconds(int micros)
 		{
 			usleep(micros);
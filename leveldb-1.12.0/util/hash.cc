@@ -53,4 +53,91 @@ uint32_t Hash(const char* data, size_t n, uint32_t seed)
 	return h;
 }
 
+static const uint64_t kPrime64_1 = 11400714785074694791ull;
+static const uint64_t kPrime64_2 = 14029467366897019727ull;
+static const uint64_t kPrime64_3 = 1609587929392839161ull;
+static const uint64_t kPrime64_4 = 9650029242287828579ull;
+static const uint64_t kPrime64_5 = 2870177450012600261ull;
+
+static inline uint64_t RotateLeft64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t XXHash64Round(uint64_t acc, uint64_t input)
+{
+	acc += input * kPrime64_2;
+	acc = RotateLeft64(acc, 31);
+	return acc * kPrime64_1;
+}
+
+static inline uint64_t XXHash64Merge(uint64_t acc, uint64_t val)
+{
+	acc ^= XXHash64Round(0, val);
+	return acc * kPrime64_1 + kPrime64_4;
+}
+
+uint64_t XXHash64(const char* data, size_t n, uint64_t seed)
+{
+	const char* limit = data + n;
+	uint64_t h;
+
+	// Four lanes of eight bytes while 32 bytes are left
+	if ( n >= 32 )
+	{
+		uint64_t v1 = seed + kPrime64_1 + kPrime64_2;
+		uint64_t v2 = seed + kPrime64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - kPrime64_1;
+		do
+		{
+			v1 = XXHash64Round(v1, DecodeFixed64(data));
+			v2 = XXHash64Round(v2, DecodeFixed64(data + 8));
+			v3 = XXHash64Round(v3, DecodeFixed64(data + 16));
+			v4 = XXHash64Round(v4, DecodeFixed64(data + 24));
+			data += 32;
+		} while (data + 32 <= limit);
+		h = RotateLeft64(v1, 1) + RotateLeft64(v2, 7) + RotateLeft64(v3, 12)
+				+ RotateLeft64(v4, 18);
+		h = XXHash64Merge(h, v1);
+		h = XXHash64Merge(h, v2);
+		h = XXHash64Merge(h, v3);
+		h = XXHash64Merge(h, v4);
+	}
+	else
+	{
+		h = seed + kPrime64_5;
+	}
+	h += n;
+
+	// Pick up the remaining bytes
+	while (data + 8 <= limit)
+	{
+		h ^= XXHash64Round(0, DecodeFixed64(data));
+		h = RotateLeft64(h, 27) * kPrime64_1 + kPrime64_4;
+		data += 8;
+	}
+	if ( data + 4 <= limit )
+	{
+		h ^= static_cast<uint64_t> (DecodeFixed32(data)) * kPrime64_1;
+		h = RotateLeft64(h, 23) * kPrime64_2 + kPrime64_3;
+		data += 4;
+	}
+	while (data < limit)
+	{
+		h ^= static_cast<uint64_t> (static_cast<unsigned char> (*data))
+				* kPrime64_5;
+		h = RotateLeft64(h, 11) * kPrime64_1;
+		data++;
+	}
+
+	// Avalanche
+	h ^= h >> 33;
+	h *= kPrime64_2;
+	h ^= h >> 29;
+	h *= kPrime64_3;
+	h ^= h >> 32;
+	return h;
+}
+
 } // namespace leveldb
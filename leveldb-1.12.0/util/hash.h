@@ -14,6 +14,10 @@ namespace leveldb {
 
 extern uint32_t Hash(const char* data, size_t n, uint32_t seed);
 
+// xxHash64 of Yann Collet: a fast 64-bit hash of good quality, usable as
+// a checksum (see kxxHash64).
+extern uint64_t XXHash64(const char* data, size_t n, uint64_t seed);
+
 }
 
 #endif  // STORAGE_LEVELDB_UTIL_HASH_H_
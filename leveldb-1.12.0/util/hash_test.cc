@@ -0,0 +1,26 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/hash.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+class HASH { };
+
+TEST(HASH, XXHash64) {
+  ASSERT_EQ(0xef46db3751d8e999ull, XXHash64("", 0, 0));
+  ASSERT_EQ(0x44bc2cf5ad770999ull, XXHash64("abc", 3, 0));
+  const char* text = "Nobody inspects the spammish repetition";
+  ASSERT_EQ(0xfbcea83c8a378bf1ull, XXHash64(text, strlen(text), 0));
+  ASSERT_NE(XXHash64("abc", 3, 0), XXHash64("abc", 3, 1));
+  ASSERT_NE(XXHash64(text, strlen(text), 0),
+            XXHash64(text, strlen(text) - 1, 0));
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
@@ -27,6 +27,14 @@ class Histogram
 
 		std::string ToString() const;
 
+		double Count() const
+		{
+			return num_;
+		}
+		double Median() const;
+		double Percentile(double p) const;
+		double Average() const;
+
 	private:
 		double min_;
 		double max_;
@@ -41,9 +49,6 @@ class Histogram
 		static const double kBucketLimit[kNumBuckets];
 		double buckets_[kNumBuckets];
 
-		double Median() const;
-		double Percentile(double p) const;
-		double Average() const;
 		double StandardDeviation() const;
 };
 
@@ -13,10 +13,19 @@ namespace leveldb
 Options::Options() :
 	comparator(BytewiseComparator()), create_if_missing(false),
 			error_if_exists(false), paranoid_checks(false),
-			env(Env::Default()), info_log(NULL), write_buffer_size(4 << 20),
-			max_open_files(1000), block_cache(NULL), block_size(4096),
-			block_restart_interval(16), compression(kSnappyCompression),
-			filter_policy(NULL)
+			env(Env::Default()), info_log(NULL), statistics(NULL),
+			write_buffer_size(4 << 20),
+			write_buffer_manager(NULL), recycle_log_file_num(0),
+			bytes_per_sync(0), background_wal_sync(false),
+			avoid_flush_during_recovery(false),
+			max_open_files(1000),
+			max_file_opening_threads(16), block_cache(NULL), row_cache(NULL),
+			block_size(4096),
+			block_restart_interval(16), data_block_hash_index(false),
+			compression(kSnappyCompression),
+			checksum(kCRC32c), filter_policy(NULL), compaction_filter(NULL),
+			merge_operator(NULL), min_blob_size(0), blob_gc_ratio(0.5),
+			deletion_compaction_ratio(0)
 {
 }
 
@@ -0,0 +1,96 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/perf_context_imp.h"
+
+#include <string.h>
+#include "util/logging.h"
+
+namespace leveldb
+{
+
+LEVELDB_THREAD_LOCAL PerfLevel perf_level = kDisable;
+LEVELDB_THREAD_LOCAL PerfContext perf_context;
+LEVELDB_THREAD_LOCAL IOStatsContext iostats_context;
+
+void SetPerfLevel(PerfLevel level)
+{
+	perf_level = level;
+}
+
+PerfLevel GetPerfLevel()
+{
+	return perf_level;
+}
+
+PerfContext* GetPerfContext()
+{
+	return &perf_context;
+}
+
+IOStatsContext* GetIOStatsContext()
+{
+	return &iostats_context;
+}
+
+static void AppendField(std::string* result, const char* name, uint64_t value)
+{
+	if ( !result->empty() )
+	{
+		result->append(", ");
+	}
+	result->append(name);
+	result->append(" = ");
+	AppendNumberTo(result, value);
+}
+
+void PerfContext::Reset()
+{
+	memset(this, 0, sizeof(*this));
+}
+
+#define PERF_CONTEXT_FIELD(name) AppendField(&result, #name, name)
+
+std::string PerfContext::ToString() const
+{
+	std::string result;
+	PERF_CONTEXT_FIELD(db_mutex_lock_nanos);
+	PERF_CONTEXT_FIELD(get_from_memtable_count);
+	PERF_CONTEXT_FIELD(get_from_memtable_time);
+	PERF_CONTEXT_FIELD(get_from_output_files_time);
+	PERF_CONTEXT_FIELD(find_table_nanos);
+	PERF_CONTEXT_FIELD(block_cache_hit_count);
+	PERF_CONTEXT_FIELD(block_cache_miss_count);
+	PERF_CONTEXT_FIELD(block_read_count);
+	PERF_CONTEXT_FIELD(block_read_byte);
+	PERF_CONTEXT_FIELD(block_read_time);
+	PERF_CONTEXT_FIELD(bloom_sst_hit_count);
+	PERF_CONTEXT_FIELD(bloom_sst_miss_count);
+	PERF_CONTEXT_FIELD(internal_key_skipped_count);
+	PERF_CONTEXT_FIELD(internal_delete_skipped_count);
+	PERF_CONTEXT_FIELD(write_wal_time);
+	PERF_CONTEXT_FIELD(write_memtable_time);
+	return result;
+}
+
+void IOStatsContext::Reset()
+{
+	memset(this, 0, sizeof(*this));
+}
+
+std::string IOStatsContext::ToString() const
+{
+	std::string result;
+	PERF_CONTEXT_FIELD(bytes_read);
+	PERF_CONTEXT_FIELD(bytes_written);
+	PERF_CONTEXT_FIELD(read_nanos);
+	PERF_CONTEXT_FIELD(write_nanos);
+	PERF_CONTEXT_FIELD(fsync_nanos);
+	PERF_CONTEXT_FIELD(open_nanos);
+	return result;
+}
+
+#undef PERF_CONTEXT_FIELD
+
+} // namespace leveldb
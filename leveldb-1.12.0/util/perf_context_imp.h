@@ -0,0 +1,83 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Helpers that update the PerfContext and IOStatsContext of the calling
+// thread.  They cost a thread-local load and a branch when the perf level
+// leaves the metric out.
+
+#ifndef STORAGE_LEVELDB_UTIL_PERF_CONTEXT_IMP_H_
+#define STORAGE_LEVELDB_UTIL_PERF_CONTEXT_IMP_H_
+
+#include "leveldb/env.h"
+#include "leveldb/perf_context.h"
+#include "port/port.h"
+
+namespace leveldb
+{
+
+extern LEVELDB_THREAD_LOCAL PerfLevel perf_level;
+extern LEVELDB_THREAD_LOCAL PerfContext perf_context;
+extern LEVELDB_THREAD_LOCAL IOStatsContext iostats_context;
+
+// Adds the nanoseconds between its construction and its destruction, or
+// the first call to Stop(), to *metric if the perf level includes times.
+class PerfStepTimer
+{
+	public:
+		explicit PerfStepTimer(uint64_t* metric) :
+			metric_(metric), start_(perf_level >= kEnableTime ? Now() : 0)
+		{
+		}
+
+		~PerfStepTimer()
+		{
+			Stop();
+		}
+
+		void Stop()
+		{
+			if ( start_ != 0 )
+			{
+				*metric_ += Now() - start_;
+				start_ = 0;
+			}
+		}
+
+	private:
+		uint64_t* metric_;
+		uint64_t start_;
+
+		static uint64_t Now()
+		{
+			return Env::Default()->NowNanos();
+		}
+
+		// No copying allowed
+		PerfStepTimer(const PerfStepTimer&);
+		void operator=(const PerfStepTimer&);
+};
+
+#define PERF_COUNTER_ADD(metric, value) \
+	do { \
+		if ( perf_level >= kEnableCount ) \
+			perf_context.metric += (value); \
+	} while (0)
+
+#define PERF_TIMER_GUARD(metric) \
+	PerfStepTimer perf_step_timer_ ## metric(&perf_context.metric)
+
+#define PERF_TIMER_STOP(metric) perf_step_timer_ ## metric.Stop()
+
+#define IOSTATS_ADD(metric, value) \
+	do { \
+		if ( perf_level >= kEnableCount ) \
+			iostats_context.metric += (value); \
+	} while (0)
+
+#define IOSTATS_TIMER_GUARD(metric) \
+	PerfStepTimer iostats_step_timer_ ## metric(&iostats_context.metric)
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_PERF_CONTEXT_IMP_H_
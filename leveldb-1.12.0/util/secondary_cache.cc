@@ -0,0 +1,311 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <assert.h>
+#include <stdio.h>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "leveldb/cache.h"
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/mutexlock.h"
+
+namespace leveldb
+{
+
+namespace
+{
+
+// Each entry is a record of the log:
+//    crc: fixed32 (masked, of the rest of the record)
+//    key length: fixed32
+//    contents length: fixed32
+//    key: char[key length]
+//    contents: char[contents length]
+static const size_t kRecordHeaderSize = 12;
+
+// Records are gathered in memory and written a segment at a time
+static const size_t kMaxSegmentSize = 4 << 20;
+static const size_t kMinSegmentSize = 64 << 10;
+
+static const char kSegmentSuffix[] = ".cache";
+
+// Check the record "record" written for "key" and set *contents to its
+// contents
+static bool ParseRecord(const Slice& record, const Slice& key,
+		std::string* contents)
+{
+	if ( record.size() < kRecordHeaderSize )
+	{
+		return false;
+	}
+	const char* p = record.data();
+	const uint32_t crc = crc32c::Unmask(DecodeFixed32(p));
+	const uint32_t key_length = DecodeFixed32(p + 4);
+	const uint32_t contents_length = DecodeFixed32(p + 8);
+	if ( kRecordHeaderSize + key_length + contents_length != record.size()
+			|| crc32c::Value(p + 4, record.size() - 4) != crc
+			|| Slice(p + kRecordHeaderSize, key_length) != key )
+	{
+		return false;
+	}
+	contents->assign(p + kRecordHeaderSize + key_length, contents_length);
+	return true;
+}
+
+class LogSecondaryCache: public SecondaryCache
+{
+	public:
+		LogSecondaryCache(Env* env, const std::string& path, uint64_t capacity) :
+			env_(env), path_(path), next_number_(1)
+		{
+			uint64_t segment_size = capacity / 4;
+			if ( segment_size > kMaxSegmentSize )
+			{
+				segment_size = kMaxSegmentSize;
+			}
+			if ( segment_size < kMinSegmentSize )
+			{
+				segment_size = kMinSegmentSize;
+			}
+			segment_size_ = segment_size;
+			max_segments_ = capacity / segment_size;
+			if ( max_segments_ < 1 )
+			{
+				max_segments_ = 1;
+			}
+		}
+
+		virtual ~LogSecondaryCache()
+		{
+			while (!segments_.empty())
+			{
+				DropOldestSegment();
+			}
+		}
+
+		virtual void Insert(const Slice& key, const Slice& contents)
+		{
+			const size_t size = kRecordHeaderSize + key.size() + contents.size();
+			if ( size > segment_size_ )
+			{
+				return;
+			}
+
+			MutexLock l(&mutex_);
+			const std::string k = key.ToString();
+			if ( index_.find(k) != index_.end() )
+			{
+				return;
+			}
+			if ( buffer_.size() + size > segment_size_ )
+			{
+				WriteBuffer();
+			}
+
+			Location loc;
+			loc.segment = NULL;
+			loc.offset = buffer_.size();
+			loc.size = size;
+			const size_t start = buffer_.size();
+			buffer_.resize(start + 4);
+			PutFixed32(&buffer_, key.size());
+			PutFixed32(&buffer_, contents.size());
+			buffer_.append(key.data(), key.size());
+			buffer_.append(contents.data(), contents.size());
+			EncodeFixed32(&buffer_[start], crc32c::Mask(crc32c::Value(
+					buffer_.data() + start + 4, size - 4)));
+			buffer_keys_.push_back(k);
+			index_[k] = loc;
+		}
+
+		virtual bool Lookup(const Slice& key, std::string* contents)
+		{
+			Segment* segment;
+			Location loc;
+			{
+				MutexLock l(&mutex_);
+				std::map<std::string, Location>::const_iterator it =
+						index_.find(key.ToString());
+				if ( it == index_.end() )
+				{
+					return false;
+				}
+				loc = it->second;
+				if ( loc.segment == NULL )
+				{
+					return ParseRecord(Slice(buffer_.data() + loc.offset,
+							loc.size), key, contents);
+				}
+				// Keep the segment while reading it without the lock
+				segment = loc.segment;
+				segment->refs++;
+			}
+
+			std::string scratch;
+			scratch.resize(loc.size);
+			Slice record;
+			Status s = segment->file->Read(loc.offset, loc.size, &record,
+					&scratch[0]);
+			const bool found = s.ok() && ParseRecord(record, key, contents);
+
+			MutexLock l(&mutex_);
+			UnrefSegment(segment);
+			return found;
+		}
+
+	private:
+		// A segment file written out, and the keys of its records
+		struct Segment
+		{
+				uint64_t number;
+				RandomAccessFile* file;
+				std::vector<std::string> keys;
+				int refs; // One from segments_, one per read in progress
+		};
+
+		// Where a record is: in "segment", or in buffer_ if segment is NULL
+		struct Location
+		{
+				Segment* segment;
+				uint64_t offset;
+				uint64_t size;
+		};
+
+		std::string SegmentFileName(uint64_t number) const
+		{
+			char buf[100];
+			snprintf(buf, sizeof(buf), "/%06llu%s",
+					static_cast<unsigned long long> (number), kSegmentSuffix);
+			return path_ + buf;
+		}
+
+		// Write buffer_ to a new segment file, dropping the oldest segment
+		// if there are too many.  A failure loses the buffered records,
+		// which only costs reads from the slower storage later.
+		// REQUIRES: mutex_ held
+		void WriteBuffer()
+		{
+			const std::string fname = SegmentFileName(next_number_);
+			WritableFile* file;
+			Status s = env_->NewWritableFile(fname, &file);
+			if ( s.ok() )
+			{
+				s = file->Append(buffer_);
+				if ( s.ok() )
+				{
+					s = file->Close();
+				}
+				delete file;
+			}
+			RandomAccessFile* reader = NULL;
+			if ( s.ok() )
+			{
+				s = env_->NewRandomAccessFile(fname, &reader);
+			}
+
+			if ( s.ok() )
+			{
+				Segment* segment = new Segment;
+				segment->number = next_number_;
+				segment->file = reader;
+				segment->refs = 1;
+				segment->keys.swap(buffer_keys_);
+				for (size_t i = 0; i < segment->keys.size(); i++)
+				{
+					index_[segment->keys[i]].segment = segment;
+				}
+				segments_.push_back(segment);
+			}
+			else
+			{
+				env_->DeleteFile(fname);
+				for (size_t i = 0; i < buffer_keys_.size(); i++)
+				{
+					index_.erase(buffer_keys_[i]);
+				}
+			}
+			next_number_++;
+			buffer_.clear();
+			buffer_keys_.clear();
+
+			while (segments_.size() > max_segments_)
+			{
+				DropOldestSegment();
+			}
+		}
+
+		// REQUIRES: mutex_ held, or no other user left
+		void DropOldestSegment()
+		{
+			Segment* segment = segments_.front();
+			segments_.pop_front();
+			for (size_t i = 0; i < segment->keys.size(); i++)
+			{
+				index_.erase(segment->keys[i]);
+			}
+			UnrefSegment(segment);
+		}
+
+		// REQUIRES: mutex_ held, or no other user left
+		void UnrefSegment(Segment* segment)
+		{
+			assert(segment->refs > 0);
+			segment->refs--;
+			if ( segment->refs == 0 )
+			{
+				delete segment->file;
+				env_->DeleteFile(SegmentFileName(segment->number));
+				delete segment;
+			}
+		}
+
+		Env* const env_;
+		const std::string path_;
+		size_t segment_size_;
+		size_t max_segments_;
+
+		// mutex_ protects the following state.
+		port::Mutex mutex_;
+		uint64_t next_number_;
+		std::string buffer_; // Records of the segment being filled
+		std::vector<std::string> buffer_keys_;
+		std::deque<Segment*> segments_; // Oldest first
+		std::map<std::string, Location> index_;
+};
+
+} // namespace
+
+Status NewLogSecondaryCache(Env* env, const std::string& path,
+		uint64_t capacity, SecondaryCache** result)
+{
+	*result = NULL;
+	env->CreateDir(path); // Ignore error: it may exist already
+
+	// Segments of an earlier run cannot be found without their index
+	std::vector<std::string> children;
+	Status s = env->GetChildren(path, &children);
+	if ( !s.ok() )
+	{
+		return s;
+	}
+	const size_t suffix_length = sizeof(kSegmentSuffix) - 1;
+	for (size_t i = 0; i < children.size(); i++)
+	{
+		const std::string& name = children[i];
+		if ( name.size() > suffix_length && name.compare(name.size()
+				- suffix_length, suffix_length, kSegmentSuffix) == 0 )
+		{
+			env->DeleteFile(path + "/" + children[i]);
+		}
+	}
+	*result = new LogSecondaryCache(env, path, capacity);
+	return s;
+}
+
+} // namespace leveldb
@@ -0,0 +1,143 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/statistics.h"
+
+#include <stdio.h>
+#include "port/port.h"
+#include "util/histogram.h"
+#include "util/mutexlock.h"
+
+namespace leveldb
+{
+
+static const char* kTickerNames[kNumTickers] =
+{
+	"leveldb.block.cache.hit",
+	"leveldb.block.cache.miss",
+	"leveldb.bloom.filter.useful",
+	"leveldb.bytes.written",
+	"leveldb.bytes.read",
+	"leveldb.number.keys.written",
+	"leveldb.number.keys.read",
+	"leveldb.wal.synced",
+	"leveldb.wal.bytes",
+	"leveldb.stall.micros",
+	"leveldb.flush.write.bytes",
+	"leveldb.compact.read.bytes",
+	"leveldb.compact.write.bytes",
+	"leveldb.secondary.cache.hit",
+	"leveldb.secondary.cache.miss",
+};
+
+static const char* kHistogramNames[kNumHistograms] =
+{
+	"leveldb.db.get.micros",
+	"leveldb.db.write.micros",
+	"leveldb.db.seek.micros",
+	"leveldb.compaction.times.micros",
+	"leveldb.wal.file.sync.micros",
+};
+
+const char* TickerName(Ticker ticker)
+{
+	return kTickerNames[ticker];
+}
+
+const char* HistogramName(HistogramType type)
+{
+	return kHistogramNames[type];
+}
+
+Statistics::~Statistics()
+{
+}
+
+namespace
+{
+
+class StatisticsImpl: public Statistics
+{
+	public:
+		StatisticsImpl()
+		{
+			Reset();
+		}
+
+		virtual void RecordTick(Ticker ticker, uint64_t count)
+		{
+			port::AtomicAdd(&tickers_[ticker], count);
+		}
+
+		virtual uint64_t GetTickerCount(Ticker ticker) const
+		{
+			return port::AtomicAdd(&tickers_[ticker], 0);
+		}
+
+		virtual void MeasureTime(HistogramType type, uint64_t micros)
+		{
+			MutexLock l(&mu_[type]);
+			histograms_[type].Add(micros);
+		}
+
+		virtual std::string GetHistogramString(HistogramType type) const
+		{
+			MutexLock l(&mu_[type]);
+			return histograms_[type].ToString();
+		}
+
+		virtual void Reset()
+		{
+			for (int i = 0; i < kNumTickers; i++)
+			{
+				tickers_[i] = 0;
+			}
+			for (int i = 0; i < kNumHistograms; i++)
+			{
+				MutexLock l(&mu_[i]);
+				histograms_[i].Clear();
+			}
+		}
+
+		virtual std::string ToString() const
+		{
+			std::string result;
+			char buf[200];
+			for (int i = 0; i < kNumTickers; i++)
+			{
+				snprintf(buf, sizeof(buf), "%s COUNT : %llu\n",
+						kTickerNames[i],
+						static_cast<unsigned long long> (GetTickerCount(
+								static_cast<Ticker> (i))));
+				result.append(buf);
+			}
+			for (int i = 0; i < kNumHistograms; i++)
+			{
+				MutexLock l(&mu_[i]);
+				const Histogram& h = histograms_[i];
+				const bool empty = (h.Count() == 0);
+				snprintf(buf, sizeof(buf), "%s P50 : %.2f P95 : %.2f "
+					"P99 : %.2f AVG : %.2f COUNT : %.0f\n", kHistogramNames[i],
+						empty ? 0.0 : h.Median(), empty ? 0.0 : h.Percentile(95),
+						empty ? 0.0 : h.Percentile(99), empty ? 0.0 : h.Average(),
+						h.Count());
+				result.append(buf);
+			}
+			return result;
+		}
+
+	private:
+		mutable volatile uint64_t tickers_[kNumTickers];
+		mutable port::Mutex mu_[kNumHistograms]; // Guards each histogram
+		Histogram histograms_[kNumHistograms];
+};
+
+} // namespace
+
+Statistics* NewStatistics()
+{
+	return new StatisticsImpl;
+}
+
+} // namespace leveldb
@@ -0,0 +1,59 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Helpers that update an optional Statistics object (see
+// Options::statistics).  They do nothing, and read no clock, when it is
+// NULL.
+
+#ifndef STORAGE_LEVELDB_UTIL_STATISTICS_IMP_H_
+#define STORAGE_LEVELDB_UTIL_STATISTICS_IMP_H_
+
+#include "leveldb/env.h"
+#include "leveldb/statistics.h"
+
+namespace leveldb
+{
+
+inline void RecordTick(Statistics* statistics, Ticker ticker,
+		uint64_t count = 1)
+{
+	if ( statistics != NULL )
+	{
+		statistics->RecordTick(ticker, count);
+	}
+}
+
+// Records the micro-seconds between its construction and its destruction
+// in a histogram.
+class StopWatch
+{
+	public:
+		StopWatch(Env* env, Statistics* statistics, HistogramType type) :
+			env_(env), statistics_(statistics), type_(type), start_(
+					statistics != NULL ? env->NowMicros() : 0)
+		{
+		}
+
+		~StopWatch()
+		{
+			if ( statistics_ != NULL )
+			{
+				statistics_->MeasureTime(type_, env_->NowMicros() - start_);
+			}
+		}
+
+	private:
+		Env* const env_;
+		Statistics* const statistics_;
+		const HistogramType type_;
+		const uint64_t start_;
+
+		// No copying allowed
+		StopWatch(const StopWatch&);
+		void operator=(const StopWatch&);
+};
+
+} // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_STATISTICS_IMP_H_
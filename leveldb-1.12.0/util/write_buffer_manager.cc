@@ -0,0 +1,116 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/write_buffer_manager.h"
+
+#include <assert.h>
+#include <string>
+#include <vector>
+#include "leveldb/cache.h"
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/mutexlock.h"
+
+namespace leveldb
+{
+
+namespace
+{
+// Memtable memory is charged to the cache in entries of this size, which
+// are pinned so that the cache cannot evict the charge.
+const size_t kDummyEntrySize = 64 << 10;
+
+void DeleteDummyEntry(const Slice& key, void* value)
+{
+}
+} // namespace
+
+struct WriteBufferManager::Rep
+{
+		port::Mutex mu;
+		size_t memory_used;
+
+		Cache* cache;
+		uint64_t cache_id;
+		std::vector<Cache::Handle*> dummy_handles;
+
+		std::string DummyKey(size_t i) const
+		{
+			char buf[16];
+			EncodeFixed64(buf, cache_id);
+			EncodeFixed64(buf + 8, i);
+			return std::string(buf, sizeof(buf));
+		}
+
+		// Make the entries charged to the cache cover memory_used
+		void UpdateCacheCharge()
+		{
+			while (dummy_handles.size() * kDummyEntrySize < memory_used)
+			{
+				const std::string key = DummyKey(dummy_handles.size());
+				dummy_handles.push_back(cache->Insert(key, NULL,
+						kDummyEntrySize, &DeleteDummyEntry));
+			}
+			while (!dummy_handles.empty() && (dummy_handles.size() - 1)
+					* kDummyEntrySize >= memory_used)
+			{
+				cache->Release(dummy_handles.back());
+				dummy_handles.pop_back();
+				cache->Erase(DummyKey(dummy_handles.size()));
+			}
+		}
+};
+
+WriteBufferManager::WriteBufferManager(size_t buffer_size, Cache* cache) :
+	buffer_size_(buffer_size), rep_(new Rep)
+{
+	rep_->memory_used = 0;
+	rep_->cache = cache;
+	rep_->cache_id = (cache != NULL) ? cache->NewId() : 0;
+}
+
+WriteBufferManager::~WriteBufferManager()
+{
+	assert(rep_->memory_used == 0);
+	if ( rep_->cache != NULL )
+	{
+		rep_->memory_used = 0;
+		rep_->UpdateCacheCharge();
+	}
+	delete rep_;
+}
+
+size_t WriteBufferManager::memory_usage() const
+{
+	MutexLock l(&rep_->mu);
+	return rep_->memory_used;
+}
+
+bool WriteBufferManager::ShouldFlush() const
+{
+	return memory_usage() >= buffer_size_;
+}
+
+void WriteBufferManager::ReserveMem(size_t bytes)
+{
+	MutexLock l(&rep_->mu);
+	rep_->memory_used += bytes;
+	if ( rep_->cache != NULL )
+	{
+		rep_->UpdateCacheCharge();
+	}
+}
+
+void WriteBufferManager::FreeMem(size_t bytes)
+{
+	MutexLock l(&rep_->mu);
+	assert(rep_->memory_used >= bytes);
+	rep_->memory_used -= bytes;
+	if ( rep_->cache != NULL )
+	{
+		rep_->UpdateCacheCharge();
+	}
+}
+
+} // namespace leveldb